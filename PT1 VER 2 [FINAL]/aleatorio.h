@@ -0,0 +1,237 @@
+#ifndef ALEATORIO_H
+#define ALEATORIO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+
+/*
+ * Geradores pseudoaleatórios por canal para o simulador de sensores, no
+ * lugar de rand(): cada thread tem o próprio gerador (sem estado global,
+ * sem disputa entre threads) e a sequência de um canal depende apenas da
+ * semente e do número do canal, sendo reproduzível entre execuções.
+ *
+ * O gerador é o xoshiro256** em 4 faixas independentes, avançadas juntas
+ * com as extensões vetoriais do GCC (instruções SIMD quando a arquitetura
+ * as tem). A sequência de um canal é a intercalação das 4 faixas, de modo
+ * que pedir um valor de cada vez ou um lote inteiro produz exatamente os
+ * mesmos números.
+ */
+
+#define ALEATORIO_FAIXAS 4
+
+typedef uint64_t VetorAleatorio __attribute__((vector_size(ALEATORIO_FAIXAS * sizeof(uint64_t))));
+
+typedef struct {
+    VetorAleatorio s[4];                 // Estado das 4 faixas do xoshiro256**
+    uint64_t saida[ALEATORIO_FAIXAS];    // Último passo, consumido valor a valor
+    unsigned int usados;                 // Valores de `saida` já entregues
+    int tem_gauss;                       // `gauss` guarda o par do último Box-Muller
+    float gauss;
+} GeradorAleatorio;
+
+typedef enum {
+    RUIDO_UNIFORME = 0,      // Uniforme entre min e max
+    RUIDO_GAUSSIANO,         // Normal em torno de `media`, limitada a [min, max]
+    RUIDO_PASSEIO,           // Passeio aleatório com passos normais, refletido em [min, max]
+    RUIDO_NUM
+} TipoRuido;
+
+static const char *const NOMES_RUIDOS[RUIDO_NUM] = { "uniforme", "gaussiano", "passeio" };
+
+typedef struct {
+    TipoRuido tipo;
+    float min, max;
+    float media;             // RUIDO_GAUSSIANO
+    float desvio;            // Desvio-padrão (gaussiano) ou do passo (passeio)
+} ModeloRuido;
+
+// Um canal de ruído: modelo, gerador próprio e, no passeio, a posição atual
+typedef struct {
+    ModeloRuido modelo;
+    GeradorAleatorio gerador;
+    float valor;
+} FonteRuido;
+
+/**
+ * @brief Passo do splitmix64, usado apenas para espalhar a semente.
+ */
+static inline uint64_t aleatorio_splitmix64(uint64_t *x) {
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+/**
+ * @brief Inicializa o gerador do canal @p canal a partir de @p semente.
+ *
+ * Canais diferentes com a mesma semente recebem sequências independentes.
+ */
+static inline void aleatorio_semear(GeradorAleatorio *g, uint64_t semente, uint32_t canal) {
+    uint64_t x = semente ^ ((uint64_t)(canal + 1) * 0xD1B54A32D192ED03ull);
+    memset(g, 0, sizeof(*g));
+    for (int i = 0; i < 4; i++) {
+        for (int f = 0; f < ALEATORIO_FAIXAS; f++) g->s[i][f] = aleatorio_splitmix64(&x);
+    }
+    g->usados = ALEATORIO_FAIXAS;
+}
+
+// Rotação à esquerda de cada faixa (macro: vetores de 32 bytes não são
+// passados por valor, para não depender da ABI com ou sem AVX)
+#define ALEATORIO_ROTL(x, k) (((x) << (k)) | ((x) >> (64 - (k))))
+
+/**
+ * @brief Avança as 4 faixas de uma vez e grava em @p r um valor de cada uma.
+ */
+static inline void aleatorio_passo(GeradorAleatorio *g, VetorAleatorio *r) {
+    VetorAleatorio *s = g->s;
+    *r = ALEATORIO_ROTL(s[1] * 5, 7) * 9;
+    VetorAleatorio t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = ALEATORIO_ROTL(s[3], 45);
+}
+
+/**
+ * @brief Próximo valor de 64 bits da sequência do canal.
+ */
+static inline uint64_t aleatorio_u64(GeradorAleatorio *g) {
+    if (g->usados == ALEATORIO_FAIXAS) {
+        VetorAleatorio r;
+        aleatorio_passo(g, &r);
+        memcpy(g->saida, &r, sizeof(r));
+        g->usados = 0;
+    }
+    return g->saida[g->usados++];
+}
+
+/**
+ * @brief Converte um valor de 64 bits em um float uniforme em [0, 1).
+ */
+static inline float aleatorio_unitario(uint64_t x) {
+    return (float)(uint32_t)(x >> 40) * 0x1.0p-24f;
+}
+
+/**
+ * @brief Valor uniforme entre @p min e @p max.
+ */
+static inline float aleatorio_float(GeradorAleatorio *g, float min, float max) {
+    return min + aleatorio_unitario(aleatorio_u64(g)) * (max - min);
+}
+
+/**
+ * @brief Preenche @p buf com @p n valores uniformes em [0, 1).
+ *
+ * Os valores pendentes de uma chamada escalar anterior saem primeiro; o
+ * restante é gerado 4 a 4 direto no buffer, sem passar por `saida`.
+ */
+static inline void aleatorio_unitarios(GeradorAleatorio *g, float *buf, size_t n) {
+    size_t i = 0;
+    while (i < n && g->usados < ALEATORIO_FAIXAS) buf[i++] = aleatorio_unitario(g->saida[g->usados++]);
+    for (; i + ALEATORIO_FAIXAS <= n; i += ALEATORIO_FAIXAS) {
+        VetorAleatorio r;
+        aleatorio_passo(g, &r);
+        r >>= 40;
+        for (int f = 0; f < ALEATORIO_FAIXAS; f++) buf[i + f] = (float)(uint32_t)r[f] * 0x1.0p-24f;
+    }
+    while (i < n) buf[i++] = aleatorio_unitario(aleatorio_u64(g));
+}
+
+/**
+ * @brief Transforma um par de uniformes em duas normais padrão (Box-Muller).
+ */
+static inline void aleatorio_box_muller(float u1, float u2, float *z0, float *z1) {
+    float raio = sqrtf(-2.0f * logf(1.0f - u1));   // 1 - u1 está em (0, 1]
+    float angulo = 6.28318530718f * u2;
+    *z0 = raio * cosf(angulo);
+    *z1 = raio * sinf(angulo);
+}
+
+/**
+ * @brief Próximo valor normal padrão (média 0, desvio 1) da sequência.
+ */
+static inline float aleatorio_gauss(GeradorAleatorio *g) {
+    if (g->tem_gauss) {
+        g->tem_gauss = 0;
+        return g->gauss;
+    }
+    float u1 = aleatorio_unitario(aleatorio_u64(g));
+    float u2 = aleatorio_unitario(aleatorio_u64(g));
+    float z0;
+    aleatorio_box_muller(u1, u2, &z0, &g->gauss);
+    g->tem_gauss = 1;
+    return z0;
+}
+
+/**
+ * @brief Preenche @p buf com @p n normais padrão, na mesma sequência que
+ *        @p n chamadas a aleatorio_gauss().
+ */
+static inline void aleatorio_gaussianos(GeradorAleatorio *g, float *buf, size_t n) {
+    size_t i = 0;
+    if (n > 0 && g->tem_gauss) {
+        buf[i++] = g->gauss;
+        g->tem_gauss = 0;
+    }
+    size_t pares = (n - i) / 2;
+    aleatorio_unitarios(g, buf + i, pares * 2);
+    for (size_t p = 0; p < pares; p++, i += 2) aleatorio_box_muller(buf[i], buf[i + 1], &buf[i], &buf[i + 1]);
+    if (i < n) buf[i] = aleatorio_gauss(g);
+}
+
+/**
+ * @brief Inicializa uma fonte de ruído com o modelo e o gerador do canal.
+ */
+static inline void ruido_init(FonteRuido *r, const ModeloRuido *modelo, uint64_t semente, uint32_t canal) {
+    r->modelo = *modelo;
+    aleatorio_semear(&r->gerador, semente, canal);
+    r->valor = modelo->tipo == RUIDO_PASSEIO ? (modelo->min + modelo->max) / 2.0f : modelo->media;
+}
+
+/**
+ * @brief Preenche @p buf com as próximas @p n amostras da fonte.
+ */
+static inline void ruido_preencher(FonteRuido *r, float *buf, size_t n) {
+    const ModeloRuido *m = &r->modelo;
+    switch (m->tipo) {
+    case RUIDO_UNIFORME:
+        aleatorio_unitarios(&r->gerador, buf, n);
+        for (size_t i = 0; i < n; i++) buf[i] = m->min + buf[i] * (m->max - m->min);
+        break;
+    case RUIDO_GAUSSIANO:
+        aleatorio_gaussianos(&r->gerador, buf, n);
+        for (size_t i = 0; i < n; i++) buf[i] = fminf(m->max, fmaxf(m->min, m->media + m->desvio * buf[i]));
+        break;
+    case RUIDO_PASSEIO: {
+        // Dependência entre amostras: a soma acumulada é sequencial
+        aleatorio_gaussianos(&r->gerador, buf, n);
+        float v = r->valor;
+        for (size_t i = 0; i < n; i++) {
+            v += m->desvio * buf[i];
+            if (v > m->max) v = 2.0f * m->max - v;
+            if (v < m->min) v = 2.0f * m->min - v;
+            buf[i] = v = fminf(m->max, fmaxf(m->min, v));
+        }
+        r->valor = v;
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Próxima amostra da fonte.
+ */
+static inline float ruido_amostra(FonteRuido *r) {
+    float v;
+    ruido_preencher(r, &v, 1);
+    return v;
+}
+
+#endif // ALEATORIO_H
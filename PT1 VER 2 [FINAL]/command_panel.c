@@ -4,6 +4,9 @@
 #include <sys/ipc.h>
 #include <sys/msg.h>
 #include <unistd.h>
+#include <getopt.h>
+
+#include "instancia.h"
 
 #define MSG_KEY 5678 // Chave da fila de mensagens
 
@@ -33,6 +36,9 @@ void display_menu() {
     printf("9 - Desligar Farol Baixo\n");
     printf("10 - Desligar Farol Alto\n");
     printf("11 - Desligar Farol\n");
+    printf("12 - Pausar\n");
+    printf("13 - Retomar\n");
+    printf("14 - Avançar Passo\n");
     printf("0 - Sair\n");
     printf("Escolha uma opção: ");
 }
@@ -68,7 +74,8 @@ void send_message(int msg_queue_id, Message msg) {
  * por um menu textual, escolhendo ações como controle de setas, faróis e pedais.
  *
  * Principais funcionalidades:
- *  - Criação ou acesso à fila de mensagens identificada por `MSG_KEY`.
+ *  - Criação ou acesso à fila de mensagens identificada por `MSG_KEY`, na
+ *    instância dada em --instancia ou em VEICULO_INSTANCIA (ver instancia.h).
  *  - Monitoramento de mensagens recebidas:
  *    - Se o comando "Encerrar" for detectado, o programa finaliza.
  *  - Envio de comandos escolhidos pelo usuário para o controlador.
@@ -80,12 +87,28 @@ void send_message(int msg_queue_id, Message msg) {
  *
  * @return Retorna 0 ao encerrar o programa.
  */
-int main() {
+int main(int argc, char *argv[]) {
+    static const struct option opcoes[] = {
+        {"instancia", required_argument, NULL, 'I'},
+        {"help",      no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
     Message msg;
     int msg_queue_id, option;
 
+    instancia_do_ambiente();
+    int opt;
+    while ((opt = getopt_long(argc, argv, "I:h", opcoes, NULL)) != -1) {
+        if (opt == 'I') {
+            instancia_definir(optarg, "--instancia");
+            continue;
+        }
+        printf("Uso: %s [-I|--instancia <n>]   (padrão: $%s ou 0)\n", argv[0], INSTANCIA_AMBIENTE);
+        return opt == 'h' ? 0 : EXIT_FAILURE;
+    }
+
     // Criar ou acessar a fila de mensagens
-    msg_queue_id = msgget(MSG_KEY, IPC_CREAT | 0666);
+    msg_queue_id = msgget(chave_ipc(MSG_KEY), IPC_CREAT | 0666);
     if (msg_queue_id < 0) {
         perror("Erro ao criar/acessar a fila de mensagens");
         exit(EXIT_FAILURE);
@@ -146,6 +169,15 @@ int main() {
             case 11:
                 strcpy(msg.command, "Desligar Farol");
                 break;
+            case 12:
+                strcpy(msg.command, "Pausar");
+                break;
+            case 13:
+                strcpy(msg.command, "Retomar");
+                break;
+            case 14:
+                strcpy(msg.command, "Avançar Passo");
+                break;
             case 0:
                 printf("Encerrando Painel de Comandos...\n");
                 printf("Encerrando controlador...\n\n");
@@ -6,14 +6,21 @@
 #include <sys/shm.h>
 #include <sys/msg.h>
 #include <sys/types.h>
-#include <semaphore.h>
-#include <fcntl.h>
 #include <string.h>
 #include <pthread.h>
 #include <stdbool.h>
 #include <math.h>
+#include <time.h>
+#include <stdint.h>
+#include <errno.h>
+#include <getopt.h>
+#include <semaphore.h>
+
+#include "ipc_shared.h"
+#include "instancia.h"
+#include "perfil_limitador.h"
+#include "rastreio.h"
 
-#define SHM_KEY_SENSORS 1234      // Chave para os dados dos sensores
 #define SHM_KEY_TRIGGERS 4321     // Chave para o status dos acionadores
 #define MSG_KEY 5678              // Chave da fila de mensagens
 
@@ -23,12 +30,9 @@
 #define MAX_TEMP_MOTOR 140
 #define BASE_TEMP 80
 
-// Estrutura para os dados
-typedef struct {
-    float velocidade; // Velocidade do carro (km/h)
-    int rpm;        // Rotação do motor (RPM)
-    float temperatura; // Temperatura do motor
-} SensorData;
+// Período do loop de controle
+#define PERIODO_PADRAO_MS 1000    // Período padrão do loop de controle
+#define PERIODO_MIN_MS 1          // Menor período aceito em --periodo
 
 // Estrutura para o status dos acionadores
 typedef struct {
@@ -46,30 +50,57 @@ SensorData *shared_data;      // Ponteiro para os dados dos sensores
 Status_trigg *status_trigg;   // Ponteiro para o status dos acionadores
 int shm_id_sensors, shm_id_triggers; // IDs das memórias compartilhadas
 int msg_queue_id;             // ID da fila de mensagens
-sem_t *sem_sync;              // Semáforo para sincronização
 volatile sig_atomic_t running = 1; // Variável para controlar execução do programa
+volatile sig_atomic_t alternar_pausa = 0; // SIGUSR1 recebidos (lidos pelo loop de controle)
+bool reinicio_quente = false;      // --warm: adota o estado deixado por outro controlador
+bool preservar_estado = false;     // --preservar: mantém os segmentos ao encerrar
+unsigned int periodo_controle_ms = PERIODO_PADRAO_MS; // Período do loop (--periodo)
+
+// Estado de execução do ciclo de controle. Só o loop de controle o altera
+// (comandos e SIGUSR1 são tratados nele); o ctlstat o lê em stats->execucao.
+static EstadoExecucao execucao = EXEC_RODANDO;
+static uint32_t passos_pendentes = 0;     // Ciclos liberados no estado EXEC_PASSO
+static sig_atomic_t pausas_tratadas = 0;  // SIGUSR1 já convertidos em transição
+
+// Estatísticas publicadas em memória compartilhada (contadores do relatório,
+// iterações, comandos, fila e espera pela trava)
+ControllerStats *stats;
+int shm_id_stats = -1;
+static __thread ThreadStats *stats_thread = NULL; // Slot da thread corrente
+
+// Tabela de canais do sensor_sim (somente leitura), anexada quando existe
+#define CANAIS_VERIFICACAO_NS 1000000000ull // Intervalo para anexar ou soltar a tabela
+const TabelaCanais *tabela_canais = NULL;
+int shm_id_canais = -1;
+uint64_t *canais_vistos = NULL;   // Última contagem de atualizações vista, por canal
+uint64_t canais_verificado_ns = 0;
 
-// Variáveis de relatório
-int cont_vel_sup = 0;
-int cont_vel_inf = 0;
-int cont_rpm_sup = 0;
-int cont_rpm_inf = 0;
-int cont_max_temp = 0;
+// Perfil dos limitadores: lido de --limites e recarregado com SIGHUP pela
+// thread de recarga; o loop de controle lê o perfil publicado sem trava
+PublicacaoPerfil perfil;
+TabelaContadores contadores_regras;   // Disparos por regra (relatório)
+_Atomic uint64_t *estatistica_regra[REGRAS_MAX * 2]; // Contador das estatísticas de cada regra
+const char *arquivo_perfil = NULL;
+sem_t sem_recarga;                // Postado pelo handler de SIGHUP
 
 
 /**
  * @brief Função callback para tratar sinais recebidos pelo programa.
  * 
- * Trata os sinais SIGUSR1 e SIGUSR2.
+ * Trata os sinais SIGUSR1, SIGUSR2 e SIGHUP.
  * 
- * - Se o sinal for SIGUSR1: pausa o loop principal do programa, aguardando no semáforo.
+ * - Se o sinal for SIGUSR1: pausa ou retoma o ciclo de controle. O handler
+ *   apenas conta o sinal; a transição é feita pelo loop de controle (ver
+ *   run_state_poll_signal()).
  * - Se o sinal for SIGUSR2: envia uma mensagem "Encerrar" para o Painel de Comando e 
  *   sinaliza para encerrar o programa.
+ * - Se o sinal for SIGHUP: acorda a thread que recarrega o perfil dos
+ *   limitadores.
+ * - Se o sinal for SIGPROF: acorda a thread que exporta o rastreio.
  */
 void signal_handler(int signal) {
     if (signal == SIGUSR1) {
-        printf("Teste pausado (SIGUSR1 recebido)\n");
-        sem_wait(sem_sync); // Pausa o controlador (espera no semáforo)
+        alternar_pausa++;
     } else if (signal == SIGUSR2) {
         printf("Encerrando o programa (SIGUSR2 recebido)\n");
         
@@ -81,36 +112,168 @@ void signal_handler(int signal) {
             perror("Erro ao enviar mensagem de encerramento para o Painel de Comando");
         }
         running = 0; // Sinaliza o encerramento do programa
+    } else if (signal == SIGHUP) {
+        sem_post(&sem_recarga); // Recarga feita por profile_reloader()
+    } else if (signal == SIGPROF) {
+        rastreio_pedir_exportacao();
     }
 }
 
 
 /**
- * @brief Instala os handlers para os sinais SIGUSR1 e SIGUSR2.
+ * @brief Instala os handlers para os sinais SIGUSR1, SIGUSR2, SIGHUP e SIGPROF.
  *
- * SIGUSR1: Pausa o loop principal do programa.
+ * SIGUSR1: Pausa ou retoma o ciclo de controle (como "Pausar"/"Retomar").
  * SIGUSR2: Encerra o programa e envia uma mensagem "Encerrar" para o Painel de Comando.
+ * SIGHUP: Relê o arquivo do perfil dos limitadores (--limites).
+ * SIGPROF: Exporta o rastreio do loop de controle (--rastreio).
  */
 void setup_signals() {
+    if (sem_init(&sem_recarga, 0, 0) == -1) {
+        perror("Erro ao criar o semáforo de recarga do perfil");
+        exit(EXIT_FAILURE);
+    }
     struct sigaction sa;
     sa.sa_handler = signal_handler;
     sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
     sigaction(SIGUSR1, &sa, NULL);
     sigaction(SIGUSR2, &sa, NULL);
+    sigaction(SIGHUP, &sa, NULL);
+    sigaction(SIGPROF, &sa, NULL);
+}
+
+
+/**
+ * @brief Traz os dados compartilhados de volta às faixas válidas.
+ *
+ * Chamada com a trava já tomada. Valores que não fazem sentido voltam aos
+ * iniciais e os acionadores são normalizados para true/false.
+ */
+void sanitize_shared_state() {
+    if (!isfinite(shared_data->velocidade) || shared_data->velocidade < 0.0 ||
+        shared_data->velocidade > 1000.0) {
+        shared_data->velocidade = 0.0;
+    }
+    if (shared_data->rpm < 0 || shared_data->rpm > 20000) {
+        shared_data->rpm = 800;
+    }
+    if (!isfinite(shared_data->temperatura) || shared_data->temperatura < -50.0 ||
+        shared_data->temperatura > 1000.0) {
+        shared_data->temperatura = BASE_TEMP;
+    }
+
+    // Um bool com outro byte que não 0/1 é comportamento indefinido
+    uint8_t *bytes = (uint8_t *)status_trigg;
+    for (size_t i = 0; i < sizeof(Status_trigg); i++) bytes[i] = bytes[i] != 0;
+}
+
+/**
+ * @brief Revalida os dados compartilhados deixados por um dono morto da trava.
+ *
+ * Chamada com a trava já tomada, quando o processo que a detinha morreu no
+ * meio da seção crítica (callback de trava_lock()).
+ */
+void revalidate_shared_state() {
+    fprintf(stderr, "Aviso: dono da trava morreu na seção crítica; revalidando os dados\n");
+    sanitize_shared_state();
+}
+
+/**
+ * @brief Anexa um segmento já existente, conferindo o tamanho.
+ *
+ * @param chave Chave do segmento.
+ * @param tamanho Tamanho esperado (o do layout compilado).
+ * @param shm_id Recebe o ID do segmento.
+ * @return Endereço do segmento, ou NULL se ele não existe ou tem outro tamanho.
+ */
+void *attach_existing_segment(key_t chave, size_t tamanho, int *shm_id) {
+    int id = shmget(chave, 0, 0);
+    if (id < 0) return NULL;
+    struct shmid_ds info;
+    if (shmctl(id, IPC_STAT, &info) < 0 || info.shm_segsz != tamanho) return NULL;
+    void *p = shmat(id, NULL, 0);
+    if (p == (void *)-1) return NULL;
+    *shm_id = id;
+    return p;
 }
 
+/**
+ * @brief Adota os sensores e acionadores deixados por um controlador anterior.
+ *
+ * Usado com --warm. Os dois segmentos precisam existir com o tamanho deste
+ * executável e o cabeçalho dos sensores precisa ter o magic e a versão
+ * atuais. Os valores não são tocados: o sensor_sim, anexado aos mesmos
+ * segmentos, continua escrevendo sem perceber a troca do controlador. Se
+ * o controlador anterior morreu com a trava, ela é recuperada aqui; de
+ * todo modo, os valores passam pelas faixas da revalidação, porque o
+ * segmento é gravável por todos.
+ *
+ * @return true se o estado foi adotado; false para seguir com a
+ *         inicialização normal.
+ */
+bool adopt_shared_memory() {
+    shared_data = attach_existing_segment(chave_ipc(SHM_KEY_SENSORS), sizeof(SensorData), &shm_id_sensors);
+    if (shared_data == NULL) {
+        fprintf(stderr, "Reinício a quente: memória dos sensores ausente ou de outro tamanho\n");
+        return false;
+    }
+    if (__atomic_load_n(&shared_data->magic, __ATOMIC_ACQUIRE) != SENSORES_MAGIC ||
+        shared_data->versao != SENSORES_VERSAO) {
+        fprintf(stderr, "Reinício a quente: cabeçalho dos sensores inválido (versão %u, esperada %u)\n",
+                shared_data->versao, SENSORES_VERSAO);
+        shmdt(shared_data);
+        shared_data = NULL;
+        return false;
+    }
+    status_trigg = attach_existing_segment(chave_ipc(SHM_KEY_TRIGGERS), sizeof(Status_trigg), &shm_id_triggers);
+    if (status_trigg == NULL) {
+        fprintf(stderr, "Reinício a quente: memória dos acionadores ausente ou de outro tamanho\n");
+        shmdt(shared_data);
+        shared_data = NULL;
+        return false;
+    }
+
+    trava_init(&shared_data->trava);  // Já pronta: não reinicializa
+    trava_lock(&shared_data->trava, revalidate_shared_state);
+    int32_t anterior = shared_data->pid;
+    // Com o anterior vivo, os dois controladores disputariam as mesmas
+    // saídas e o mesmo estado (EPERM: existe, mas é de outro usuário)
+    if (anterior > 0 && anterior != getpid() && (kill(anterior, 0) == 0 || errno == EPERM)) {
+        trava_unlock(&shared_data->trava);
+        fprintf(stderr, "Reinício a quente: o controlador PID %d ainda está em execução.\n"
+                "Encerre-o com --preservar (ou deixe-o cair) antes de iniciar com --warm.\n",
+                anterior);
+        exit(EXIT_FAILURE);
+    }
+    shared_data->pid = getpid();
+    shared_data->reinicios++;
+    sanitize_shared_state();
+    printf("Estado adotado do controlador PID %d (reinício a quente nº %u): "
+           "%.0f km/h, %d RPM, %.2f ºC\n", anterior, shared_data->reinicios,
+           shared_data->velocidade, shared_data->rpm, shared_data->temperatura);
+    trava_unlock(&shared_data->trava);
+    return true;
+}
 
 /**
  * @brief Cria e inicializa memórias compartilhadas para sensores e acionadores.
  *
  * Cria memória compartilhada para SensorData e Status_trigg, associa-as e
- * inicializa os campos com valores padrão.
+ * inicializa os campos com valores padrão. Com --warm, tenta antes adotar
+ * o estado existente (ver adopt_shared_memory()).
  *
  * @return Nada.
  */
 void init_shared_memory() {
+    if (reinicio_quente) {
+        if (adopt_shared_memory()) return;
+        fprintf(stderr, "Reinício a quente indisponível; inicializando o estado\n");
+        reinicio_quente = false;
+    }
+
     // Criar memória compartilhada para SensorData
-    shm_id_sensors = shmget(SHM_KEY_SENSORS, sizeof(SensorData), IPC_CREAT | 0666);
+    shm_id_sensors = shmget(chave_ipc(SHM_KEY_SENSORS), sizeof(SensorData), IPC_CREAT | 0666);
     if (shm_id_sensors < 0) {
         perror("Erro ao criar memória compartilhada para sensores");
         exit(EXIT_FAILURE);
@@ -121,9 +284,10 @@ void init_shared_memory() {
         shmctl(shm_id_sensors, IPC_RMID, NULL);
         exit(EXIT_FAILURE);
     }
+    trava_init(&shared_data->trava);
 
     // Criar memória compartilhada para Status_trigg
-    shm_id_triggers = shmget(SHM_KEY_TRIGGERS, sizeof(Status_trigg), IPC_CREAT | 0666);
+    shm_id_triggers = shmget(chave_ipc(SHM_KEY_TRIGGERS), sizeof(Status_trigg), IPC_CREAT | 0666);
     if (shm_id_triggers < 0) {
         perror("Erro ao criar memória compartilhada para acionadores");
         shmctl(shm_id_sensors, IPC_RMID, NULL);
@@ -137,7 +301,13 @@ void init_shared_memory() {
         exit(EXIT_FAILURE);
     }
 
-    // Inicializar valores nas memórias compartilhadas
+    // Inicializar valores nas memórias compartilhadas. O magic só é
+    // publicado no fim, para que um --warm nunca adote um estado pela metade
+    trava_lock(&shared_data->trava, NULL);
+    __atomic_store_n(&shared_data->magic, 0, __ATOMIC_RELAXED);
+    shared_data->versao = SENSORES_VERSAO;
+    shared_data->pid = getpid();
+    shared_data->reinicios = 0;
     shared_data->velocidade = 0.0;
     shared_data->rpm = 800;
     shared_data->temperatura = 0.0;
@@ -146,6 +316,8 @@ void init_shared_memory() {
     status_trigg->seta_esq = false;
     status_trigg->farol_baixo = false;
     status_trigg->farol_alto = false;
+    __atomic_store_n(&shared_data->magic, SENSORES_MAGIC, __ATOMIC_RELEASE);
+    trava_unlock(&shared_data->trava);
 
     printf("Memórias compartilhadas inicializadas com sucesso.\n");
 }
@@ -155,17 +327,26 @@ void init_shared_memory() {
  *        mensagens residuais.
  *
  * Cria a fila de mensagens com a chave MSG_KEY e remove mensagens residuais
- * que por ventura tenham sido enviadas anteriormente.
+ * que por ventura tenham sido enviadas anteriormente. No reinício a quente
+ * os comandos pendentes são mantidos e processados normalmente.
  *
  * @return Nada.
  */
 void init_message_queue() {
-    msg_queue_id = msgget(MSG_KEY, IPC_CREAT | 0666);
+    msg_queue_id = msgget(chave_ipc(MSG_KEY), IPC_CREAT | 0666);
     if (msg_queue_id < 0) {
         perror("Erro ao criar fila de mensagens");
         exit(EXIT_FAILURE);
     }
-    
+
+    if (reinicio_quente) {
+        struct msqid_ds info;
+        if (msgctl(msg_queue_id, IPC_STAT, &info) == 0) {
+            printf("Mensagens pendentes na fila adotadas: %lu\n", (unsigned long)info.msg_qnum);
+        }
+        return;
+    }
+
     // Remover todas as mensagens residuais
     Message msg;
     while (msgrcv(msg_queue_id, &msg, sizeof(msg) - sizeof(long), 0, IPC_NOWAIT) > 0) {
@@ -175,19 +356,240 @@ void init_message_queue() {
 
 
 /**
- * @brief Inicializa o semáforo de sincronização entre threads
+ * @brief Cria o segmento de estatísticas lido pelo ctlstat.
  *
- * Limpa o nome do semáforo e o cria com o valor inicial de 1.
+ * O segmento é zerado e só recebe o STATS_MAGIC depois de inicializado,
+ * para que leitores nunca vejam um layout incompleto.
  *
- * @return Nenhum
+ * @return Nada.
  */
-void init_semaphore() {
-    sem_unlink("/sem_sync");
-    sem_sync = sem_open("/sem_sync", O_CREAT | O_EXCL, 0666, 1);
-    if (sem_sync == SEM_FAILED) {
-        perror("Erro ao criar semáforo");
+void init_stats_memory() {
+    shm_id_stats = shmget(chave_ipc(SHM_KEY_STATS), sizeof(ControllerStats), IPC_CREAT | 0644);
+    if (shm_id_stats < 0) {
+        perror("Erro ao criar memória compartilhada para estatísticas");
+        exit(EXIT_FAILURE);
+    }
+    stats = (ControllerStats *)shmat(shm_id_stats, NULL, 0);
+    if (stats == (void *)-1) {
+        perror("Erro ao associar memória compartilhada para estatísticas");
+        shmctl(shm_id_stats, IPC_RMID, NULL);
         exit(EXIT_FAILURE);
     }
+
+    memset(stats, 0, sizeof(ControllerStats));
+    stats->versao = STATS_VERSAO;
+    stats->pid = getpid();
+    contencao_iniciar(&stats->contencao, "controller");
+    __atomic_store_n(&stats->magic, STATS_MAGIC, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Associa a thread corrente ao seu slot de contadores.
+ *
+ * @param id Slot da thread no segmento de estatísticas.
+ */
+void stats_register_thread(StatsThread id) {
+    stats_thread = &stats->threads[id];
+    rastreio_registrar_thread(NOMES_THREADS[id]);
+}
+
+/**
+ * @brief Retorna o instante atual do relógio monotônico em nanossegundos.
+ */
+static inline uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Entra na seção crítica dos dados compartilhados contabilizando a espera.
+ *
+ * O tempo de espera é somado ao slot da thread corrente (threads que não se
+ * registraram não contabilizam) e ao sítio @p ponto do perfil de contenção.
+ * Use pela macro sync_lock(), que cria um ponto por chamada.
+ */
+void sync_lock_em(PontoContencao *ponto) {
+    RASTREIO_ESCOPO("trava");
+    uint64_t inicio = now_ns();
+    trava_lock(&shared_data->trava, revalidate_shared_state);
+    uint64_t obtida = now_ns();
+    uint64_t espera = obtida - inicio;
+    contencao_entrou(contencao_sitio(stats ? &stats->contencao : NULL, ponto), espera, obtida);
+    if (stats_thread == NULL) return;
+
+    stats_inc(&stats_thread->lock_aquisicoes);
+    stats_add(&stats_thread->lock_espera_ns, espera);
+    if (espera > stats_get(&stats_thread->lock_espera_max_ns)) {
+        atomic_store_explicit(&stats_thread->lock_espera_max_ns, espera, memory_order_relaxed);
+    }
+}
+
+#define sync_lock() sync_lock_em(PONTO_CONTENCAO())
+
+/**
+ * @brief Sai da seção crítica dos dados compartilhados.
+ *
+ * O tempo com a trava vai para o sítio da aquisição depois de liberá-la.
+ */
+void sync_unlock() {
+    uint64_t liberada = now_ns();
+    trava_unlock(&shared_data->trava);
+    contencao_saiu(liberada);
+}
+
+/**
+ * @brief Dorme até um instante absoluto do relógio monotônico.
+ *
+ * Retorna antes do prazo se o programa estiver encerrando.
+ *
+ * @param alvo_ns Instante de despertar em nanossegundos.
+ */
+void sleep_until_ns(uint64_t alvo_ns) {
+    struct timespec alvo = {
+        .tv_sec = (time_t)(alvo_ns / 1000000000ull),
+        .tv_nsec = (long)(alvo_ns % 1000000000ull),
+    };
+    RASTREIO_ESCOPO("dormir");
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &alvo, NULL) == EINTR) {
+        if (!running) return;
+    }
+}
+
+/**
+ * @brief Aguarda o próximo período do loop de controle.
+ *
+ * Se a iteração ultrapassou o prazo, conta o overrun e descarta os períodos
+ * perdidos, mantendo a fase.
+ *
+ * @param proximo_ns Prazo absoluto da iteração corrente, avançado para o próximo.
+ * @param periodo_ns Período do loop.
+ */
+void wait_next_period(uint64_t *proximo_ns, uint64_t periodo_ns) {
+    *proximo_ns += periodo_ns;
+    uint64_t agora = now_ns();
+    if (agora >= *proximo_ns) {
+        RASTREIO_MARCA("overrun");
+        stats_inc(&stats->overruns);
+        *proximo_ns += ((agora - *proximo_ns) / periodo_ns + 1) * periodo_ns;
+    }
+    sleep_until_ns(*proximo_ns);
+}
+
+/**
+ * @brief Atualiza a profundidade da fila de mensagens nas estatísticas.
+ */
+void stats_update_queue_depth() {
+    struct msqid_ds info;
+    if (msgctl(msg_queue_id, IPC_STAT, &info) < 0) return;
+
+    uint32_t profundidade = (uint32_t)info.msg_qnum;
+    atomic_store_explicit(&stats->fila_profundidade, profundidade, memory_order_relaxed);
+    if (profundidade > atomic_load_explicit(&stats->fila_profundidade_max, memory_order_relaxed)) {
+        atomic_store_explicit(&stats->fila_profundidade_max, profundidade, memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Solta a tabela de canais (o sensor_sim encerrou ou foi reiniciado).
+ */
+void detach_channel_table() {
+    shmdt((const void *)tabela_canais);
+    tabela_canais = NULL;
+    free(canais_vistos);
+    canais_vistos = NULL;
+    atomic_store_explicit(&stats->canais_num, 0, memory_order_relaxed);
+    atomic_store_explicit(&stats->canais_hz_total, 0, memory_order_relaxed);
+}
+
+/**
+ * @brief Anexa, somente para leitura, a tabela de canais do sensor_sim.
+ *
+ * A tabela é opcional: sem ela, o controlador usa apenas o resumo em
+ * SensorData. As contagens atuais de cada canal são o ponto de partida,
+ * para que as leituras anteriores ao anexo não contem como perdidas.
+ */
+void attach_channel_table() {
+    int id = shmget(chave_ipc(SHM_KEY_CANAIS), 0, 0);
+    if (id < 0) return;
+    const TabelaCanais *t = (const TabelaCanais *)shmat(id, NULL, SHM_RDONLY);
+    if (t == (void *)-1) return;
+
+    struct shmid_ds info;
+    if (__atomic_load_n(&t->magic, __ATOMIC_ACQUIRE) != CANAIS_MAGIC || t->versao != CANAIS_VERSAO ||
+        t->num_canais > MAX_CANAIS || shmctl(id, IPC_STAT, &info) < 0 ||
+        info.shm_segsz < canais_tamanho(t->num_canais)) {
+        shmdt((const void *)t);
+        return;
+    }
+    canais_vistos = (uint64_t *)calloc(t->num_canais ? t->num_canais : 1, sizeof(uint64_t));
+    if (canais_vistos == NULL) {
+        shmdt((const void *)t);
+        return;
+    }
+
+    uint32_t hz_total = 0;
+    for (uint32_t i = 0; i < t->num_canais; i++) {
+        canais_vistos[i] = stats_get(&t->canais[i].atualizacoes);
+        hz_total += t->canais[i].hz;
+    }
+    tabela_canais = t;
+    shm_id_canais = id;
+    atomic_store_explicit(&stats->canais_num, t->num_canais, memory_order_relaxed);
+    atomic_store_explicit(&stats->canais_hz_total, hz_total, memory_order_relaxed);
+    printf("Tabela de canais anexada: %u canais, %u leituras/s (sensor_sim PID %d)\n",
+           t->num_canais, hz_total, t->pid);
+}
+
+/**
+ * @brief Varre a tabela de canais do sensor_sim.
+ *
+ * Para cada canal, compara a contagem de atualizações com a da varredura
+ * anterior: uma diferença d > 0 é uma leitura nova vista pelo controle e
+ * d - 1 leituras substituídas antes de ele as ler. Com canais mais
+ * rápidos que o loop de controle, a fração substituída e o tempo da
+ * varredura mostram até onde o controlador acompanha o sensor_sim.
+ *
+ * Uma vez por segundo, anexa a tabela se ela apareceu, ou a solta se o
+ * sensor_sim a removeu.
+ */
+void scan_channels() {
+    uint64_t agora = now_ns();
+    if (agora - canais_verificado_ns >= CANAIS_VERIFICACAO_NS) {
+        canais_verificado_ns = agora;
+        struct shmid_ds info;
+        if (tabela_canais != NULL &&
+            (shmctl(shm_id_canais, IPC_STAT, &info) < 0 || (info.shm_perm.mode & SHM_DEST))) {
+            printf("Tabela de canais removida pelo sensor_sim.\n");
+            detach_channel_table();
+        }
+        if (tabela_canais == NULL) attach_channel_table();
+    }
+    if (tabela_canais == NULL) return;
+
+    uint64_t inicio = now_ns();
+    uint64_t novas = 0, lidas = 0, atrasos = 0;
+    for (uint32_t i = 0; i < tabela_canais->num_canais; i++) {
+        const CanalCompartilhado *c = &tabela_canais->canais[i];
+        uint64_t n = atomic_load_explicit((_Atomic uint64_t *)&c->atualizacoes, memory_order_acquire);
+        if (n != canais_vistos[i]) {
+            novas += n - canais_vistos[i];
+            lidas++;
+            canais_vistos[i] = n;
+        }
+        atrasos += stats_get(&c->atrasos);
+    }
+    uint64_t duracao = now_ns() - inicio;
+
+    stats_add(&stats->canais_atualizacoes, novas);
+    stats_add(&stats->canais_lidas, lidas);
+    stats_add(&stats->canais_sobrescritas, novas - lidas);
+    atomic_store_explicit(&stats->canais_atrasos, atrasos, memory_order_relaxed);
+    stats_inc(&stats->canais_varreduras);
+    stats_add(&stats->canais_varredura_ns, duracao);
+    if (duracao > stats_get(&stats->canais_varredura_max_ns)) {
+        atomic_store_explicit(&stats->canais_varredura_max_ns, duracao, memory_order_relaxed);
+    }
 }
 
 /**
@@ -205,6 +607,241 @@ float calculate_engine_temp(float velocidade, int rpm) {
     return (float)fmin(MAX_TEMP_MOTOR, temp);
 }
 
+/**
+ * @brief Muda o estado de execução do ciclo de controle.
+ *
+ * @param novo Novo estado.
+ * @param origem Quem pediu a transição (exibido no console).
+ */
+void run_state_set(EstadoExecucao novo, const char *origem) {
+    if (novo != EXEC_PASSO) passos_pendentes = 0;
+    if (novo == execucao) return;
+    printf("Execução: %s -> %s (%s)\n", NOMES_EXECUCAO[execucao], NOMES_EXECUCAO[novo], origem);
+    execucao = novo;
+    atomic_store_explicit(&stats->execucao, (uint32_t)novo, memory_order_relaxed);
+}
+
+/**
+ * @brief Trata um comando de estado de execução.
+ *
+ * "Pausar" congela o ciclo de controle; "Retomar" o libera; "Avançar
+ * Passo" pausa (se necessário) e libera exatamente um ciclo a mais. Passos
+ * pedidos antes de o ciclo anterior executar se acumulam.
+ */
+void run_state_command(ComandoId cmd) {
+    switch (cmd) {
+    case CMD_PAUSAR:
+        if (execucao == EXEC_RODANDO) run_state_set(EXEC_PAUSADO, "comando");
+        break;
+    case CMD_RETOMAR:
+        run_state_set(EXEC_RODANDO, "comando");
+        break;
+    case CMD_PASSO:
+        run_state_set(EXEC_PASSO, "comando");
+        passos_pendentes++;
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Converte os SIGUSR1 recebidos em transições pausa/retomada.
+ *
+ * O handler só incrementa um contador; cada sinal ainda não tratado
+ * alterna entre rodando e pausado.
+ */
+void run_state_poll_signal() {
+    while (pausas_tratadas != alternar_pausa) {
+        pausas_tratadas++;
+        run_state_set(execucao == EXEC_RODANDO ? EXEC_PAUSADO : EXEC_RODANDO, "SIGUSR1");
+    }
+}
+
+/**
+ * @brief Indica se o ciclo de controle pode executar nesta iteração.
+ */
+static inline bool run_state_allows_control() {
+    return execucao == EXEC_RODANDO || (execucao == EXEC_PASSO && passos_pendentes > 0);
+}
+
+/**
+ * @brief Contabiliza um ciclo de controle executado.
+ *
+ * No modo passo a passo, o último ciclo liberado volta o estado para
+ * pausado.
+ */
+void run_state_control_done() {
+    if (execucao != EXEC_PASSO) return;
+    stats_inc(&stats->passos);
+    if (--passos_pendentes == 0) run_state_set(EXEC_PAUSADO, "passo concluído");
+}
+
+/**
+ * @brief Aplica um comando recebido do painel.
+ *
+ * Atualiza, sob a trava, o status dos acionadores ou os dados dos
+ * sensores (no caso dos pedais).
+ *
+ * @param cmd Comando já convertido por comando_id().
+ */
+void apply_command(ComandoId cmd) {
+    switch (cmd) {
+    case CMD_LIGAR_SETA_ESQ:
+        sync_lock();
+        status_trigg->seta_esq = true;
+        sync_unlock();
+        break;
+    case CMD_DESLIGAR_SETA_ESQ:
+        sync_lock();
+        status_trigg->seta_esq = false;
+        sync_unlock();
+        break;
+    case CMD_LIGAR_SETA_DIR:
+        sync_lock();
+        status_trigg->seta_dir = true;
+        sync_unlock();
+        break;
+    case CMD_DESLIGAR_SETA_DIR:
+        sync_lock();
+        status_trigg->seta_dir = false;
+        sync_unlock();
+        break;
+    case CMD_LIGAR_FAROL_BAIXO:
+        sync_lock();
+        status_trigg->farol_baixo = true;
+        sync_unlock();
+        break;
+    case CMD_DESLIGAR_FAROL_BAIXO:
+        sync_lock();
+        status_trigg->farol_baixo = false;
+        sync_unlock();
+        break;
+    case CMD_LIGAR_FAROL_ALTO:
+        sync_lock();
+        status_trigg->farol_alto = true;
+        sync_unlock();
+        break;
+    case CMD_DESLIGAR_FAROL_ALTO:
+        sync_lock();
+        status_trigg->farol_alto = false;
+        sync_unlock();
+        break;
+    case CMD_DESLIGAR_FAROL:
+        sync_lock();
+        status_trigg->farol_baixo = false;
+        status_trigg->farol_alto = false;
+        sync_unlock();
+        break;
+    case CMD_PEDAL_ACELERADOR:
+        sync_lock();
+        if (shared_data->velocidade <= 200.0){
+            shared_data->velocidade += 10.0; // Aumentar a velocidade em 10 km/h
+            shared_data->rpm += 200; // Aumentar o RPM em 200
+            shared_data->temperatura = calculate_engine_temp(shared_data->velocidade, shared_data->rpm);
+        }
+        sync_unlock();
+        break;
+    case CMD_PEDAL_FREIO:
+        sync_lock();
+        if (shared_data->velocidade > 10.0){
+            shared_data->velocidade -= 10.0; // Diminuir a velocidade em 10 km/h
+            shared_data->rpm -= 200; // Diminuir o RPM em 200
+            shared_data->temperatura = calculate_engine_temp(shared_data->velocidade, shared_data->rpm);
+        } else {
+            shared_data->velocidade = 0.0;
+            shared_data->rpm = 800;
+            shared_data->temperatura = calculate_engine_temp(shared_data->velocidade, shared_data->rpm);
+        }
+        sync_unlock();
+        break;
+    case CMD_ENCERRAR:
+        raise(SIGUSR2);
+        break;
+    case CMD_PAUSAR:
+    case CMD_RETOMAR:
+    case CMD_PASSO:
+        run_state_command(cmd);
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Vincula as regras de um programa aos contadores de disparos.
+ *
+ * Os contadores com o nome de um dos limitadores originais (vel_sup,
+ * vel_inf, rpm_sup, rpm_inf, temp) também alimentam as estatísticas lidas
+ * pelo ctlstat.
+ *
+ * @return false se não há contadores livres.
+ */
+bool bind_rule_counters(ProgramaRegras *prog) {
+    static const char *const NOMES[] = { "vel_sup", "vel_inf", "rpm_sup", "rpm_inf", "temp" };
+    static uint32_t vinculados = 0;   // Contadores já associados
+    _Atomic uint64_t *const estatisticas[] = {
+        &stats->cont_vel_sup, &stats->cont_vel_inf, &stats->cont_rpm_sup,
+        &stats->cont_rpm_inf, &stats->cont_max_temp
+    };
+
+    if (!regras_vincular(prog, &contadores_regras)) return false;
+    for (; vinculados < contadores_regras.num; vinculados++) {
+        estatistica_regra[vinculados] = NULL;
+        for (int k = 0; k < 5; k++) {
+            if (strcmp(contadores_regras.c[vinculados].nome, NOMES[k]) == 0) {
+                estatistica_regra[vinculados] = estatisticas[k];
+            }
+        }
+    }
+    return true;
+}
+
+
+/**
+ * @brief Relê o arquivo do perfil dos limitadores e publica o novo perfil.
+ *
+ * Um arquivo inválido é rejeitado e o perfil em uso continua valendo. O
+ * perfil substituído é liberado depois do período de graça.
+ */
+void reload_profile() {
+    if (arquivo_perfil == NULL) {
+        fprintf(stderr, "SIGHUP ignorado: nenhum arquivo de perfil dos limitadores (use --limites)\n");
+        return;
+    }
+    PerfilLimitador *novo = malloc(sizeof(*novo));
+    if (novo == NULL) {
+        perror("Erro ao alocar o perfil dos limitadores");
+        return;
+    }
+    if (!perfil_ler(arquivo_perfil, novo) || !bind_rule_counters(&novo->programa)) {
+        free(novo);
+        perfil.rejeitados++;
+        fprintf(stderr, "Perfil dos limitadores mantido (geração %u).\n", perfil_atual(&perfil)->geracao);
+        return;
+    }
+    uint64_t graca_ns = perfil_trocar(&perfil, novo, &running);
+    perfil_imprimir(novo);
+    printf("Perfil anterior liberado após %.2f ms de período de graça.\n", graca_ns / 1e6);
+}
+
+
+/**
+ * @brief Thread de recarga do perfil dos limitadores: espera o SIGHUP e
+ *        faz a leitura do arquivo e a troca fora do loop de controle.
+ */
+void *profile_reloader(void *arg) {
+    (void)arg;
+    rastreio_registrar_thread("recarga");
+    while (running) {
+        if (sem_wait(&sem_recarga) == -1) continue; // EINTR
+        if (!running) break;
+        RASTREIO_CHAMADA("reload_profile", reload_profile());
+    }
+    return NULL;
+}
+
+
 /**
  * @brief Função principal de controle do veículo.
  *
@@ -215,137 +852,125 @@ float calculate_engine_temp(float velocidade, int rpm) {
  * diversos acionadores, como setas, faróis, e pedais do veículo.
  *
  * A função garante a correta sincronização de dados compartilhados utilizando
- * semáforos e gerencia o estado dos acionadores do veículo.
+ * a trava robusta do segmento dos sensores e gerencia o estado dos
+ * acionadores do veículo.
+ *
+ * Com a execução pausada ("Pausar" ou SIGUSR1), só o ciclo de controle
+ * (limitadores e escrita dos valores corrigidos) fica congelado: os dados
+ * continuam sendo exibidos e os comandos do painel continuam sendo lidos,
+ * de modo que o painel pode retomar ou avançar um passo ("Avançar Passo").
  */
 void process_control() {
+    stats_register_thread(STATS_TH_CONTROLE);
+
+    // Prazos absolutos em fase fixa: o período não acumula o tempo gasto
+    // com impressão e IPC em cada iteração
+    const uint64_t periodo_ns = (uint64_t)periodo_controle_ms * 1000000ull;
+    uint64_t proximo_ns = now_ns();
+
     while (running) {
         float aux_vel, aux_temp;
         int aux_rpm;
-        
-        sem_wait(sem_sync); // Garantir exclusão mútua
+
+        run_state_poll_signal();
+        const bool controlar = run_state_allows_control();
+
+        stats_inc(&stats_thread->iteracoes);
+
+        sync_lock(); // Garantir exclusão mútua
 
         // Ler dados dos sensores da memória compartilhada
         aux_vel = shared_data->velocidade;
         aux_rpm = shared_data->rpm;
         aux_temp = shared_data->temperatura;
 
-        sem_post(sem_sync);
+        sync_unlock();
+
+        // Acompanhar os canais individuais do sensor_sim (se houver tabela)
+        RASTREIO_CHAMADA("scan_channels", scan_channels());
         
         // Exibir dados dos sensores
-        printf("\n===== Dados dos Sensores =====\n");
-        printf("Velocidade: %.0f km/h\n", aux_vel);
-        printf("RPM: %d\n", aux_rpm);
-        printf("Temperatura: %.2f ºC\n", aux_temp);
-
-        // Iniciar limitadores de valores proibidos
-        if (aux_vel > 200.0){
-            aux_vel *= 0.9; // Desacelerar 10%
-            cont_vel_sup++;
-        } else if (aux_vel < 20.0){
-            aux_vel *= 1.1; // Acelerar 10%
-            cont_vel_inf++;
+        {
+            RASTREIO_ESCOPO("printf");
+            printf("\n===== Dados dos Sensores =====\n");
+            printf("Velocidade: %.0f km/h\n", aux_vel);
+            printf("RPM: %d\n", aux_rpm);
+            printf("Temperatura: %.2f ºC\n", aux_temp);
+            if (!controlar) {
+                printf("Controle %s (limitadores congelados)\n", NOMES_EXECUCAO[execucao]);
+            }
         }
-        if (aux_rpm > 8000){
-            aux_rpm *= 0.9; // o motor deve "cortar"
-            cont_rpm_sup++;
-        } else if (aux_rpm < 800){
-            aux_rpm = 0; 
-            cont_rpm_inf++;
-            printf("\n========= O motor apagou =========\n");
-            raise(SIGUSR2);
-        } else if (aux_temp >= 140.0){
-            printf("\n========= ALERTA DE TEMPERATURA =========\n");
-            cont_max_temp++;
-            aux_vel *= 0.9;
-            aux_rpm *= 0.9;
+
+        // Iniciar limitadores de valores proibidos: regras do perfil
+        // publicado (lido sem trava), aplicadas na ordem do perfil
+        if (controlar) {
+            RASTREIO_ESCOPO("limitadores");
+            const ProgramaRegras *prog = &perfil_atual(&perfil)->programa;
+            const float entradas[ENTRADA_NUM] = { aux_vel, (float)aux_rpm, aux_temp };
+            float saidas[ALVO_NUM] = { aux_vel, (float)aux_rpm, 0.0f };
+            for (uint32_t m = regras_avaliar(prog, entradas); m; m &= m - 1) {
+                uint32_t r = (uint32_t)__builtin_ctz(m);
+                unsigned int eventos = regras_aplicar(prog, r, saidas);
+                uint16_t c = prog->contador[r];
+                contadores_regras.c[c].disparos++;
+                if (estatistica_regra[c]) stats_inc(estatistica_regra[c]);
+                if (eventos & EVENTO_DESLIGAR) {
+                    printf("\n========= O motor apagou =========\n");
+                    raise(SIGUSR2);
+                }
+                if (eventos & EVENTO_ALERTA) printf("\n========= ALERTA DE TEMPERATURA =========\n");
+            }
+            aux_vel = saidas[ALVO_VELOCIDADE];
+            aux_rpm = (int)saidas[ALVO_RPM];
         }
 
-        sem_wait(sem_sync); // Garantir exclusão mútua
+        sync_lock(); // Garantir exclusão mútua
 
         // Atualizar dados dos sensores na memória compartilhada
-        shared_data->velocidade = aux_vel;
-        shared_data->rpm = aux_rpm;
-        shared_data->temperatura = calculate_engine_temp(aux_vel, aux_rpm);
+        if (controlar) {
+            shared_data->velocidade = aux_vel;
+            shared_data->rpm = aux_rpm;
+            shared_data->temperatura = calculate_engine_temp(aux_vel, aux_rpm);
+        }
 
         // Exibir dados dos acionadores
-        printf("\n===== Dados dos Acionadores =====\n");
-        printf("Seta Direita: %s\n", status_trigg->seta_dir ? "Ligado" : "Desligado");
-        printf("Seta Esquerda: %s\n", status_trigg->seta_esq ? "Ligado" : "Desligado");
-        printf("Farol Baixo: %s\n", status_trigg->farol_baixo ? "Ligado" : "Desligado");
-        printf("Farol Alto: %s\n", status_trigg->farol_alto ? "Ligado" : "Desligado");
+        {
+            RASTREIO_ESCOPO("printf");
+            printf("\n===== Dados dos Acionadores =====\n");
+            printf("Seta Direita: %s\n", status_trigg->seta_dir ? "Ligado" : "Desligado");
+            printf("Seta Esquerda: %s\n", status_trigg->seta_esq ? "Ligado" : "Desligado");
+            printf("Farol Baixo: %s\n", status_trigg->farol_baixo ? "Ligado" : "Desligado");
+            printf("Farol Alto: %s\n", status_trigg->farol_alto ? "Ligado" : "Desligado");
+        }
         
-        sem_post(sem_sync);
+        sync_unlock();
+
+        if (controlar) {
+            run_state_control_done();
+        } else {
+            stats_inc(&stats->ciclos_congelados);
+        }
 
         // Ler comandos do painel (fila de mensagens)
+        stats_update_queue_depth();
         Message msg;
-        if (msgrcv(msg_queue_id, &msg, sizeof(msg) - sizeof(long), 1, IPC_NOWAIT) > 0) {
+        ssize_t lidos;
+        RASTREIO_CHAMADA("msgrcv", lidos = msgrcv(msg_queue_id, &msg, sizeof(msg) - sizeof(long), 1, IPC_NOWAIT));
+        if (lidos > 0) {
             printf("\nComando recebido do Painel: %s\n", msg.command);
 
             // Processar o comando recebido
-            if (strcmp(msg.command, "Ligar Seta Esquerda") == 0) {
-                sem_wait(sem_sync);
-                status_trigg->seta_esq = true;
-                sem_post(sem_sync);
-            } else if (strcmp(msg.command, "Desligar Seta Esquerda") == 0) {
-                sem_wait(sem_sync);
-                status_trigg->seta_esq = false;
-                sem_post(sem_sync);
-            } else if (strcmp(msg.command, "Ligar Seta Direita") == 0) {
-                sem_wait(sem_sync);
-                status_trigg->seta_dir = true;
-                sem_post(sem_sync);
-            } else if (strcmp(msg.command, "Desligar Seta Direita") == 0) {
-                sem_wait(sem_sync);
-                status_trigg->seta_dir = false;
-                sem_post(sem_sync);
-            } else if (strcmp(msg.command, "Ligar Farol Baixo") == 0) {
-                sem_wait(sem_sync);
-                status_trigg->farol_baixo = true;
-                sem_post(sem_sync);
-            } else if (strcmp(msg.command, "Desligar Farol Baixo") == 0) {
-                sem_wait(sem_sync);
-                status_trigg->farol_baixo = false;
-                sem_post(sem_sync);
-            } else if (strcmp(msg.command, "Ligar Farol Alto") == 0) {
-                sem_wait(sem_sync);
-                status_trigg->farol_alto = true;
-                sem_post(sem_sync);
-            } else if (strcmp(msg.command, "Desligar Farol Alto") == 0) {
-                sem_wait(sem_sync);
-                status_trigg->farol_alto = false;
-                sem_post(sem_sync);
-            } else if (strcmp(msg.command, "Desligar Farol") == 0) {
-                sem_wait(sem_sync);
-                status_trigg->farol_baixo = false;
-                status_trigg->farol_alto = false;
-                sem_post(sem_sync);
-            } else if (strcmp(msg.command, "Acionar Pedal do Acelerador") == 0) {
-                sem_wait(sem_sync);
-                if (shared_data->velocidade <= 200.0){
-                    shared_data->velocidade += 10.0; // Aumentar a velocidade em 10 km/h
-                    shared_data->rpm += 200; // Aumentar o RPM em 200
-                    shared_data->temperatura = calculate_engine_temp(shared_data->velocidade, shared_data->rpm);
-                }
-                sem_post(sem_sync);
-            } else if (strcmp(msg.command, "Acionar Pedal do Freio") == 0) {
-                sem_wait(sem_sync);
-                if (shared_data->velocidade > 10.0){
-                    shared_data->velocidade -= 10.0; // Diminuir a velocidade em 10 km/h
-                    shared_data->rpm -= 200; // Diminuir o RPM em 200
-                    shared_data->temperatura = calculate_engine_temp(shared_data->velocidade, shared_data->rpm);
-                } else {
-                    shared_data->velocidade = 0.0;
-                    shared_data->rpm = 800;
-                    shared_data->temperatura = calculate_engine_temp(shared_data->velocidade, shared_data->rpm);
-                }
-                sem_post(sem_sync);
-            } else if (strcmp(msg.command, "Encerrar") == 0){
-                raise(SIGUSR2);
+            ComandoId cmd = comando_id(msg.command);
+            if (cmd == CMD_INVALIDO) {
+                stats_inc(&stats->comandos_invalidos);
+            } else {
+                stats_inc(&stats->comandos[cmd]);
+                apply_command(cmd);
             }
         }
 
-        // Simular tempo de processamento
-        sleep(1);
+        perfil_quiescente(&perfil); // Nenhum perfil lido até aqui segue em uso
+        wait_next_period(&proximo_ns, periodo_ns);
     }
 }
 
@@ -356,8 +981,7 @@ void process_control() {
  * Esta função garante a limpeza segura dos recursos alocados durante
  * a execução do programa. Os recursos tratados incluem:
  *  - Memória compartilhada utilizada para armazenar dados dos sensores
- *    e acionadores (SensorData e Status_trigg).
- *  - Semáforo usado para sincronização entre threads.
+ *    e acionadores (SensorData e Status_trigg), com a trava embutida.
  *
  * A função é protegida contra múltiplas execuções usando uma verificação
  * interna, garantindo que os recursos sejam liberados apenas uma vez.
@@ -376,62 +1000,179 @@ void cleanup() {
 
     printf("Limpando recursos...\n");
 
-    // Desanexar e remover memória compartilhada para SensorData
+    // Desanexar e remover memória compartilhada para SensorData e
+    // Status_trigg (com --preservar, apenas desanexar: o próximo controlador
+    // pode adotá-las com --warm)
+    if (tabela_canais != NULL) detach_channel_table();
     if (shared_data != NULL) shmdt(shared_data);
-    shmctl(shm_id_sensors, IPC_RMID, NULL);
-
-    // Desanexar e remover memória compartilhada para Status_trigg
     if (status_trigg != NULL) shmdt(status_trigg);
-    shmctl(shm_id_triggers, IPC_RMID, NULL);
-
-    // Fechar e remover semáforo
-    if (sem_sync != NULL) {
-        sem_close(sem_sync);
-        sem_unlink("/sem_sync");
+    if (preservar_estado) {
+        printf("Sensores e acionadores preservados para um reinício a quente.\n");
+    } else {
+        shmctl(shm_id_sensors, IPC_RMID, NULL);
+        shmctl(shm_id_triggers, IPC_RMID, NULL);
     }
 
+    // Remover o segmento de estatísticas (leitores anexados mantêm a cópia
+    // até se desanexarem)
+    if (stats != NULL) shmdt(stats);
+    shmctl(shm_id_stats, IPC_RMID, NULL);
+
     printf("Recursos liberados com sucesso!\n");
 }
 
 
+/**
+ * @brief Exibe a ajuda da linha de comando.
+ */
+void print_usage(const char *prog) {
+    printf("Uso: %s [opções]\n", prog);
+    printf("  -p, --periodo <ms>  Período do loop de controle (padrão %d ms)\n", PERIODO_PADRAO_MS);
+    printf("  -w, --warm          Reinício a quente: adota sensores, acionadores e\n");
+    printf("                      comandos pendentes deixados por outro controlador\n");
+    printf("  -k, --preservar     Ao encerrar, mantém sensores e acionadores para um --warm\n");
+    printf("  -I, --instancia <n> Instância da pilha (chaves IPC próprias; padrão: $%s ou 0)\n",
+           INSTANCIA_AMBIENTE);
+    printf("  -l, --limites <arq> Perfil dos limitadores; relido com SIGHUP\n");
+    printf("  -T, --rastreio <arq> Rastreia o loop de controle e exporta o rastreio\n");
+    printf("                      (JSON do Chrome/Perfetto) com SIGPROF e ao encerrar\n");
+    printf("  -h, --help          Mostra esta ajuda\n");
+}
+
 /**
  * @brief Função principal do Controlador.
  *
- * Inicializa todos os recursos necessários, como memória compartilhada, fila de mensagens
- * e semáforo. Em seguida, executa o loop principal do controlador que processa
- * mensagens recebidas do Painel de Comando e atualiza os valores dos sensores e
- * acionadores.
+ * Inicializa todos os recursos necessários, como memória compartilhada (com a
+ * trava dos dados) e fila de mensagens. Em seguida, executa o loop principal
+ * do controlador que processa mensagens recebidas do Painel de Comando e
+ * atualiza os valores dos sensores e acionadores.
  *
  * Ao final, exibe um relatório sobre os acionamentos dos limitadores e
  * libera todos os recursos alocados.
  *
  * @return 0 se o programa for executado com sucesso.
  */
-int main() {
+int main(int argc, char *argv[]) {
+    static const struct option opcoes[] = {
+        {"periodo",   required_argument, NULL, 'p'},
+        {"warm",      no_argument,       NULL, 'w'},
+        {"preservar", no_argument,       NULL, 'k'},
+        {"instancia", required_argument, NULL, 'I'},
+        {"limites",   required_argument, NULL, 'l'},
+        {"rastreio",  required_argument, NULL, 'T'},
+        {"help",      no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+    uint64_t inicio_ns = now_ns();
+    instancia_do_ambiente();
+    int opt;
+    while ((opt = getopt_long(argc, argv, "p:wkI:l:T:h", opcoes, NULL)) != -1) {
+        switch (opt) {
+        case 'p': {
+            char *fim;
+            long ms = strtol(optarg, &fim, 10);
+            if (*fim != '\0' || ms < PERIODO_MIN_MS || ms > 60000) {
+                fprintf(stderr, "Período inválido: %s (use %d a 60000 ms)\n", optarg, PERIODO_MIN_MS);
+                return EXIT_FAILURE;
+            }
+            periodo_controle_ms = (unsigned int)ms;
+            break;
+        }
+        case 'w': reinicio_quente = true; break;
+        case 'k': preservar_estado = true; break;
+        case 'I': instancia_definir(optarg, "--instancia"); break;
+        case 'l': arquivo_perfil = optarg; break;
+        case 'T': rastreio_arquivo = optarg; break;
+        case 'h':
+            print_usage(argv[0]);
+            return 0;
+        default:
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Perfil inicial dos limitadores (o padrão sem --limites)
+    PerfilLimitador *inicial = malloc(sizeof(*inicial));
+    if (inicial == NULL) {
+        perror("Erro ao alocar o perfil dos limitadores");
+        return EXIT_FAILURE;
+    }
+    if (arquivo_perfil != NULL ? !perfil_ler(arquivo_perfil, inicial) : !perfil_padrao(inicial)) {
+        return EXIT_FAILURE;
+    }
+    perfil_iniciar(&perfil, inicial);
+    perfil_imprimir(inicial);
+
     setup_signals();
+    if (instancia_ipc != 0) {
+        printf("Instância %d (fila de mensagens 0x%x)\n", instancia_ipc, (unsigned int)chave_ipc(MSG_KEY));
+    }
 
     // Inicializar IPCs
     init_shared_memory();
     init_message_queue();
-    init_semaphore();
+    init_stats_memory();
+    if (!bind_rule_counters(&inicial->programa)) exit(EXIT_FAILURE);
 
+    if (reinicio_quente) {
+        printf("Reinício a quente concluído em %.2f ms.\n", (now_ns() - inicio_ns) / 1e6);
+    }
     printf("Controlador inicializado. Aguardando dados...\n");
 
-    // Executar o loop principal do controlador
+    // Executar o loop principal do controlador, com a recarga do perfil
+    // dos limitadores em uma thread à parte
+    if (rastreio_arquivo) rastreio_iniciar(rastreio_arquivo, "controller");
+    pthread_t th_recarga;
+    if (pthread_create(&th_recarga, NULL, profile_reloader, NULL) != 0) {
+        perror("Erro ao criar thread de recarga do perfil");
+        exit(EXIT_FAILURE);
+    }
     process_control();
+    sem_post(&sem_recarga); // Acorda a thread de recarga para que veja running == 0
+    pthread_join(th_recarga, NULL);
+    rastreio_encerrar();
 
     // Relatório dos acionadores
     printf("\n======== RELATÓRIO DOS LIMITADORES ===========\n\n");
-    printf("Limite superior da velocidade %d vezes atingido.\n", cont_vel_sup);
-    printf("Limite inferior da velocidade %d vezes atingido.\n", cont_vel_inf);
-    printf("Limite superior do RPM %d vezes atingido.\n", cont_rpm_sup);
-    printf("Limite inferior do RPM %d vezes atingido.\n", cont_rpm_inf);
-    printf("Limite de temperatura %d vezes atingido.\n", cont_max_temp);
-    printf("Acionamentos Totais: %d.\n", (cont_vel_sup + cont_vel_inf + cont_rpm_sup + cont_rpm_inf + cont_max_temp));
+    uint64_t acionamentos = 0;
+    for (uint32_t c = 0; c < contadores_regras.num; c++) {
+        const ContadorRegra *r = &contadores_regras.c[c];
+        printf("Regra %-8s (%s): %llu vezes.\n", r->nome, r->descricao, (unsigned long long)r->disparos);
+        acionamentos += r->disparos;
+    }
+    printf("Acionamentos Totais: %llu.\n", (unsigned long long)acionamentos);
+    printf("Perfil dos limitadores: \"%s\" (geração %u), %u trocas, %u arquivos rejeitados.\n",
+           perfil_atual(&perfil)->nome, perfil_atual(&perfil)->geracao, perfil.trocas, perfil.rejeitados);
+    printf("Período de controle: %u ms, %llu overruns.\n", periodo_controle_ms,
+           (unsigned long long)stats_get(&stats->overruns));
+    printf("Ciclos de controle passo a passo: %llu, congelados na pausa: %llu.\n",
+           (unsigned long long)stats_get(&stats->passos),
+           (unsigned long long)stats_get(&stats->ciclos_congelados));
+    printf("Trava recuperada de um processo morto %llu vezes.\n",
+           (unsigned long long)atomic_load(&shared_data->trava.recuperacoes));
+    uint64_t varreduras = stats_get(&stats->canais_varreduras);
+    if (varreduras > 0) {
+        uint64_t publicadas = stats_get(&stats->canais_atualizacoes);
+        uint64_t sobrescritas = stats_get(&stats->canais_sobrescritas);
+        printf("Canais do sensor_sim: %llu leituras novas, %llu vistas pelo controle e %llu "
+               "substituídas antes da leitura (%.1f%%).\n",
+               (unsigned long long)publicadas, (unsigned long long)stats_get(&stats->canais_lidas),
+               (unsigned long long)sobrescritas, publicadas ? 100.0 * sobrescritas / publicadas : 0.0);
+        printf("Varredura dos canais: %llu vezes, média %.1f us, máx. %.1f us; "
+               "%llu períodos perdidos pelo sensor_sim.\n", (unsigned long long)varreduras,
+               stats_get(&stats->canais_varredura_ns) / 1e3 / varreduras,
+               stats_get(&stats->canais_varredura_max_ns) / 1e3,
+               (unsigned long long)stats_get(&stats->canais_atrasos));
+    }
+    printf("\nContenção da trava por ponto de aquisição:\n");
+    const TabelaContencao *tabela_contencao = &stats->contencao;
+    contencao_relatorio(stdout, &tabela_contencao, 1);
     printf("===================================================\n\n");
 
     // Limpar recursos antes de sair
     cleanup();
+    free((void *)perfil_atual(&perfil));
 
     return 0;
 }
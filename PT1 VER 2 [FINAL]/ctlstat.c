@@ -0,0 +1,270 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include "ipc_shared.h"
+#include "instancia.h"
+
+volatile sig_atomic_t running = 1;
+
+/**
+ * @brief Handler para SIGINT: encerra o laço de amostragem.
+ */
+void sigint_handler(int signal) {
+    (void)signal;
+    running = 0;
+}
+
+/**
+ * @brief Anexa o segmento de estatísticas do controlador somente para leitura.
+ *
+ * O ctlstat nunca cria o segmento nem escreve nele, portanto não perturba o
+ * controlador. Encerra o programa se o segmento não existir ou se o layout
+ * publicado for de outra versão.
+ *
+ * @return Ponteiro para o segmento anexado.
+ */
+const ControllerStats *attach_stats() {
+    int shm_id = shmget(chave_ipc(SHM_KEY_STATS), sizeof(ControllerStats), 0);
+    if (shm_id < 0) {
+        perror("Segmento de estatísticas não encontrado (o controlador está rodando?)");
+        exit(EXIT_FAILURE);
+    }
+    const ControllerStats *stats = (const ControllerStats *)shmat(shm_id, NULL, SHM_RDONLY);
+    if (stats == (void *)-1) {
+        perror("Erro ao associar memória de estatísticas");
+        exit(EXIT_FAILURE);
+    }
+    if (__atomic_load_n(&stats->magic, __ATOMIC_ACQUIRE) != STATS_MAGIC ||
+        stats->versao != STATS_VERSAO) {
+        fprintf(stderr, "Segmento de estatísticas incompatível (versão %u, esperada %u)\n",
+                stats->versao, STATS_VERSAO);
+        exit(EXIT_FAILURE);
+    }
+    return stats;
+}
+
+/**
+ * @brief Anexa a tabela de canais do sensor_sim somente para leitura, se existir.
+ *
+ * Anexada a cada relatório, pois o sensor_sim cria um segmento novo a cada
+ * execução.
+ *
+ * @return A tabela, ou NULL se o sensor_sim não estiver rodando ou for de
+ *         outra versão.
+ */
+const TabelaCanais *attach_channel_table() {
+    int shm_id = shmget(chave_ipc(SHM_KEY_CANAIS), 0, 0);
+    if (shm_id < 0) return NULL;
+    const TabelaCanais *tabela = (const TabelaCanais *)shmat(shm_id, NULL, SHM_RDONLY);
+    if (tabela == (void *)-1) return NULL;
+    if (__atomic_load_n(&tabela->magic, __ATOMIC_ACQUIRE) != CANAIS_MAGIC ||
+        tabela->versao != CANAIS_VERSAO) {
+        shmdt(tabela);
+        return NULL;
+    }
+    return tabela;
+}
+
+// Cópia local dos contadores, usada para calcular as taxas por intervalo
+typedef struct {
+    uint64_t iteracoes[STATS_NUM_THREADS];
+    uint64_t lock_aquisicoes[STATS_NUM_THREADS];
+    uint64_t lock_espera_ns[STATS_NUM_THREADS];
+    uint64_t limitadores[5];
+    uint64_t comandos[CMD_NUM];
+    uint64_t comandos_invalidos;
+    uint64_t canais_atualizacoes;
+    uint64_t canais_sobrescritas;
+    uint64_t canais_atrasos;
+} Amostra;
+
+/**
+ * @brief Copia os contadores publicados para uma amostra local.
+ */
+void read_sample(const ControllerStats *stats, Amostra *a) {
+    for (int i = 0; i < STATS_NUM_THREADS; i++) {
+        a->iteracoes[i] = stats_get(&stats->threads[i].iteracoes);
+        a->lock_aquisicoes[i] = stats_get(&stats->threads[i].lock_aquisicoes);
+        a->lock_espera_ns[i] = stats_get(&stats->threads[i].lock_espera_ns);
+    }
+    a->limitadores[0] = stats_get(&stats->cont_vel_sup);
+    a->limitadores[1] = stats_get(&stats->cont_vel_inf);
+    a->limitadores[2] = stats_get(&stats->cont_rpm_sup);
+    a->limitadores[3] = stats_get(&stats->cont_rpm_inf);
+    a->limitadores[4] = stats_get(&stats->cont_max_temp);
+    for (int i = 0; i < CMD_NUM; i++) {
+        a->comandos[i] = stats_get(&stats->comandos[i]);
+    }
+    a->comandos_invalidos = stats_get(&stats->comandos_invalidos);
+    a->canais_atualizacoes = stats_get(&stats->canais_atualizacoes);
+    a->canais_sobrescritas = stats_get(&stats->canais_sobrescritas);
+    a->canais_atrasos = stats_get(&stats->canais_atrasos);
+}
+
+/**
+ * @brief Imprime os totais e as taxas do último intervalo.
+ *
+ * @param stats Segmento anexado (para os valores instantâneos).
+ * @param ant Amostra anterior.
+ * @param atual Amostra atual.
+ * @param intervalo Duração do intervalo em segundos.
+ */
+void print_report(const ControllerStats *stats, const Amostra *ant, const Amostra *atual,
+                  double intervalo) {
+    static const char *const nomes_limitadores[5] = {
+        "vel_sup", "vel_inf", "rpm_sup", "rpm_inf", "max_temp",
+    };
+
+    printf("\n===== ctlstat (controlador PID %d) =====\n", stats->pid);
+    printf("%-10s %12s %10s %12s %12s %12s\n",
+           "thread", "iteracoes", "iter/s", "locks/s", "espera_med", "espera_max");
+    for (int i = 0; i < STATS_NUM_THREADS; i++) {
+        uint64_t d_iter = atual->iteracoes[i] - ant->iteracoes[i];
+        uint64_t d_lock = atual->lock_aquisicoes[i] - ant->lock_aquisicoes[i];
+        uint64_t d_espera = atual->lock_espera_ns[i] - ant->lock_espera_ns[i];
+        double media_us = d_lock ? (double)d_espera / d_lock / 1000.0 : 0.0;
+        double max_us = stats_get(&stats->threads[i].lock_espera_max_ns) / 1000.0;
+        printf("%-10s %12llu %10.1f %12.1f %10.1fus %10.1fus\n",
+               NOMES_THREADS[i], (unsigned long long)atual->iteracoes[i],
+               d_iter / intervalo, d_lock / intervalo, media_us, max_us);
+    }
+
+    printf("\nLimitadores:");
+    for (int i = 0; i < 5; i++) {
+        printf("  %s=%llu (+%llu)", nomes_limitadores[i],
+               (unsigned long long)atual->limitadores[i],
+               (unsigned long long)(atual->limitadores[i] - ant->limitadores[i]));
+    }
+    printf("\n");
+
+    printf("Overruns do loop de controle: %llu\n",
+           (unsigned long long)stats_get(&stats->overruns));
+    uint32_t execucao = atomic_load_explicit((_Atomic uint32_t *)&stats->execucao,
+                                             memory_order_relaxed);
+    printf("Execução do controle: %s (passos: %llu, ciclos congelados: %llu)\n",
+           execucao < EXEC_NUM ? NOMES_EXECUCAO[execucao] : "?",
+           (unsigned long long)stats_get(&stats->passos),
+           (unsigned long long)stats_get(&stats->ciclos_congelados));
+    printf("Fila de mensagens: %u mensagens (máx. %u)\n",
+           atomic_load_explicit((_Atomic uint32_t *)&stats->fila_profundidade, memory_order_relaxed),
+           atomic_load_explicit((_Atomic uint32_t *)&stats->fila_profundidade_max, memory_order_relaxed));
+
+    uint32_t num_canais = atomic_load_explicit((_Atomic uint32_t *)&stats->canais_num, memory_order_relaxed);
+    if (num_canais > 0) {
+        uint64_t d_novas = atual->canais_atualizacoes - ant->canais_atualizacoes;
+        uint64_t d_sobrescritas = atual->canais_sobrescritas - ant->canais_sobrescritas;
+        uint64_t varreduras = stats_get(&stats->canais_varreduras);
+        printf("Canais do sensor_sim: %u (%u leituras/s configuradas), %.0f leituras/s, "
+               "%.1f%% substituídas antes da leitura, %.0f períodos perdidos/s\n",
+               num_canais,
+               atomic_load_explicit((_Atomic uint32_t *)&stats->canais_hz_total, memory_order_relaxed),
+               d_novas / intervalo, d_novas ? 100.0 * d_sobrescritas / d_novas : 0.0,
+               (atual->canais_atrasos >= ant->canais_atrasos
+                    ? atual->canais_atrasos - ant->canais_atrasos : 0) / intervalo);
+        printf("Varredura dos canais: média %.1f us, máx. %.1f us\n",
+               varreduras ? stats_get(&stats->canais_varredura_ns) / 1e3 / varreduras : 0.0,
+               stats_get(&stats->canais_varredura_max_ns) / 1e3);
+    } else {
+        printf("Canais do sensor_sim: tabela não anexada\n");
+    }
+
+    printf("Comandos/s:");
+    for (int i = 0; i < CMD_NUM; i++) {
+        uint64_t d = atual->comandos[i] - ant->comandos[i];
+        if (atual->comandos[i] == 0) continue;
+        printf("\n  %-28s %8llu  %8.1f/s", NOMES_COMANDOS[i],
+               (unsigned long long)atual->comandos[i], d / intervalo);
+    }
+    printf("\n  %-28s %8llu\n", "(inválidos)", (unsigned long long)atual->comandos_invalidos);
+    fflush(stdout);
+}
+
+/**
+ * @brief Imprime o ranking de contenção da trava do controlador e do sensor_sim.
+ *
+ * Os sítios dos dois processos são ordenados juntos pelo tempo total de
+ * espera, acumulado desde o início de cada um.
+ */
+void print_contention(const ControllerStats *stats) {
+    const TabelaCanais *canais = attach_channel_table();
+    const TabelaContencao *tabelas[2] = { &stats->contencao, canais ? &canais->contencao : NULL };
+
+    printf("\nContenção da trava por ponto de aquisição:\n");
+    contencao_relatorio(stdout, tabelas, 2);
+    fflush(stdout);
+    if (canais != NULL) shmdt(canais);
+}
+
+/**
+ * @brief Ponto de entrada do ctlstat.
+ *
+ * Uso: ./ctlstat [--instancia <n>] [intervalo_em_segundos]
+ *
+ * Anexa o segmento de estatísticas do controlador em modo somente leitura e,
+ * a cada intervalo (1 s por padrão), imprime os totais e as taxas de cada
+ * contador e o ranking de contenção da trava (incluindo os sítios do
+ * sensor_sim, se estiver rodando). Encerra com Ctrl + C ou quando o
+ * controlador remove o segmento.
+ *
+ * @return 0 ao encerrar.
+ */
+int main(int argc, char *argv[]) {
+    static const struct option opcoes[] = {
+        {"instancia", required_argument, NULL, 'I'},
+        {NULL, 0, NULL, 0}
+    };
+    double intervalo = 1.0;
+    instancia_do_ambiente();
+    int opt;
+    while ((opt = getopt_long(argc, argv, "I:", opcoes, NULL)) != -1) {
+        if (opt != 'I') {
+            fprintf(stderr, "Uso: %s [--instancia <n>] [intervalo_em_segundos]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+        instancia_definir(optarg, "--instancia");
+    }
+    if (optind < argc) {
+        intervalo = atof(argv[optind]);
+        if (intervalo <= 0.0) {
+            fprintf(stderr, "Uso: %s [--instancia <n>] [intervalo_em_segundos]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = sigint_handler;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+
+    const ControllerStats *stats = attach_stats();
+
+    Amostra ant, atual;
+    read_sample(stats, &ant);
+
+    while (running) {
+        usleep((useconds_t)(intervalo * 1000000.0));
+
+        // O controlador marca o segmento para remoção ao encerrar
+        struct shmid_ds info;
+        if (shmctl(shmget(chave_ipc(SHM_KEY_STATS), 0, 0), IPC_STAT, &info) < 0) {
+            printf("\nControlador encerrado.\n");
+            break;
+        }
+
+        read_sample(stats, &atual);
+        print_report(stats, &ant, &atual, intervalo);
+        print_contention(stats);
+        ant = atual;
+    }
+
+    shmdt(stats);
+    return 0;
+}
@@ -0,0 +1,59 @@
+#ifndef INSTANCIA_H
+#define INSTANCIA_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/types.h>
+
+/*
+ * Instâncias independentes da pilha (controlador, sensor_sim, painel e
+ * ctlstat) no mesmo host. Todas as chaves IPC são derivadas da chave base
+ * e do número da instância, dado em --instancia ou na variável de ambiente
+ * VEICULO_INSTANCIA (a opção prevalece). A instância 0, o padrão, usa as
+ * chaves originais; a instância n usa `base | (n << 16)`, e como as chaves
+ * base são menores que 65536, instâncias diferentes nunca colidem.
+ */
+
+#define INSTANCIA_AMBIENTE "VEICULO_INSTANCIA"
+#define INSTANCIA_MAX 32767
+
+static int instancia_ipc = 0;    // Instância deste processo
+
+/**
+ * @brief Define a instância a partir de um texto (opção ou ambiente).
+ *
+ * Encerra o programa se o texto não for um número de 0 a INSTANCIA_MAX.
+ *
+ * @param texto Número da instância.
+ * @param origem De onde veio o valor, para a mensagem de erro.
+ */
+static inline void instancia_definir(const char *texto, const char *origem) {
+    char *fim;
+    long n = strtol(texto, &fim, 10);
+    if (*texto == '\0' || *fim != '\0' || n < 0 || n > INSTANCIA_MAX) {
+        fprintf(stderr, "Instância inválida em %s: %s (use 0 a %d)\n", origem, texto, INSTANCIA_MAX);
+        exit(EXIT_FAILURE);
+    }
+    instancia_ipc = (int)n;
+}
+
+/**
+ * @brief Lê a instância de VEICULO_INSTANCIA, se definida.
+ *
+ * Deve ser chamada antes de tratar as opções, para que --instancia prevaleça.
+ */
+static inline void instancia_do_ambiente(void) {
+    const char *valor = getenv(INSTANCIA_AMBIENTE);
+    if (valor != NULL && *valor != '\0') instancia_definir(valor, INSTANCIA_AMBIENTE);
+}
+
+/**
+ * @brief Chave IPC de um recurso na instância deste processo.
+ *
+ * @param base Chave do recurso na instância 0 (menor que 65536).
+ */
+static inline key_t chave_ipc(key_t base) {
+    return (key_t)(base | (instancia_ipc << 16));
+}
+
+#endif // INSTANCIA_H
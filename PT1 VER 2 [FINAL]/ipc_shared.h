@@ -0,0 +1,257 @@
+#ifndef IPC_SHARED_H
+#define IPC_SHARED_H
+
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include "trava_robusta.h"
+#include "contencao.h"
+
+/*
+ * Layouts compartilhados entre o controlador, o simulador dos sensores e as
+ * ferramentas auxiliares (ctlstat). Qualquer alteração aqui exige recompilar
+ * todos os executáveis da pasta, por isso o campo `versao` do segmento é
+ * verificado ao anexar.
+ */
+
+#define SHM_KEY_SENSORS 1234      // Chave da memória dos sensores
+#define SHM_KEY_CANAIS 1235       // Chave da tabela de canais do sensor_sim
+#define SHM_KEY_STATS 5432        // Chave do segmento de estatísticas
+
+#define STATS_MAGIC  0x53544154u  // "STAT"
+#define STATS_VERSAO 5
+
+#define SENSORES_MAGIC  0x53454E53u  // "SENS"
+#define SENSORES_VERSAO 1
+
+#define CANAIS_MAGIC  0x43414E53u    // "CANS"
+#define CANAIS_VERSAO 2
+
+// Dados dos sensores, escritos pelo sensor_sim e pelo controlador. A trava
+// embutida protege estes campos e o status dos acionadores.
+//
+// O cabeçalho é preenchido pelo controlador depois de inicializar os
+// valores; um controlador reiniciado com --warm só adota o segmento se o
+// magic, a versão e o tamanho conferem.
+typedef struct {
+    uint32_t magic;             // SENSORES_MAGIC depois da inicialização
+    uint32_t versao;            // SENSORES_VERSAO
+    int32_t pid;                // PID do controlador que inicializou ou adotou
+    uint32_t reinicios;         // Reinícios a quente que adotaram o segmento
+    float velocidade;           // Velocidade do carro (km/h)
+    int rpm;                    // Rotação do motor (RPM)
+    float temperatura;          // Temperatura do motor (ºC)
+    TravaCompartilhada trava;   // Mutex robusto entre processos
+} SensorData;
+
+// Grandezas medidas pelos canais do sensor_sim
+typedef enum {
+    GRANDEZA_VELOCIDADE = 0,
+    GRANDEZA_RPM,
+    GRANDEZA_TEMPERATURA,
+    GRANDEZA_NUM
+} Grandeza;
+
+static const char *const NOMES_GRANDEZAS[GRANDEZA_NUM] = { "velocidade", "rpm", "temperatura" };
+
+#define MAX_CANAIS 1024           // Limite de canais da tabela
+#define CANAL_NOME_MAX 24         // Tamanho do nome de um canal (com o '\0')
+#define CANAL_HZ_MIN 1            // Faixa de frequências aceita para um canal
+#define CANAL_HZ_MAX 10000
+
+// Um canal publicado pelo sensor_sim. Cada canal tem um único escritor (a
+// thread do grupo de timers a que pertence), que grava o valor e o instante
+// e só então incrementa `atualizacoes` (release). Um slot por linha de
+// cache, para que threads vizinhas não disputem a mesma linha.
+typedef struct {
+    char nome[CANAL_NOME_MAX];
+    uint32_t grandeza;                   // Grandeza
+    uint32_t hz;                         // Frequência configurada
+    _Atomic float valor;                 // Última leitura
+    _Atomic uint64_t t_ns;               // CLOCK_MONOTONIC da última leitura
+    _Atomic uint64_t atualizacoes;       // Leituras publicadas desde o início
+    _Atomic uint64_t atrasos;            // Períodos perdidos pelo sensor_sim
+} __attribute__((aligned(64))) CanalCompartilhado;
+
+// Tabela de canais (tamanho variável: num_canais slots após o cabeçalho).
+// Criada pelo sensor_sim a cada execução e removida quando ele encerra; os
+// campos de SensorData continuam sendo o resumo lido pelos limitadores.
+typedef struct {
+    uint32_t magic;                      // CANAIS_MAGIC quando pronto
+    uint32_t versao;                     // CANAIS_VERSAO
+    int32_t pid;                         // PID do sensor_sim
+    uint32_t num_canais;
+    uint32_t num_threads;                // Threads do grupo de timers
+    TabelaContencao contencao;           // Contenção da trava nos pontos do sensor_sim
+    CanalCompartilhado canais[] __attribute__((aligned(64)));
+} TabelaCanais;
+
+/**
+ * @brief Tamanho do segmento de uma tabela com @p num_canais canais.
+ */
+static inline size_t canais_tamanho(uint32_t num_canais) {
+    return sizeof(TabelaCanais) + (size_t)num_canais * sizeof(CanalCompartilhado);
+}
+
+// Comandos reconhecidos pelo controlador (mesma ordem da tabela de nomes)
+typedef enum {
+    CMD_LIGAR_SETA_ESQ = 0,
+    CMD_DESLIGAR_SETA_ESQ,
+    CMD_LIGAR_SETA_DIR,
+    CMD_DESLIGAR_SETA_DIR,
+    CMD_LIGAR_FAROL_BAIXO,
+    CMD_DESLIGAR_FAROL_BAIXO,
+    CMD_LIGAR_FAROL_ALTO,
+    CMD_DESLIGAR_FAROL_ALTO,
+    CMD_DESLIGAR_FAROL,
+    CMD_PEDAL_ACELERADOR,
+    CMD_PEDAL_FREIO,
+    CMD_ENCERRAR,
+    CMD_PAUSAR,              // Congela o ciclo de controle
+    CMD_RETOMAR,             // Volta a executar o ciclo de controle
+    CMD_PASSO,               // Pausa e executa um único ciclo de controle
+    CMD_NUM,
+    CMD_INVALIDO = -1
+} ComandoId;
+
+static const char *const NOMES_COMANDOS[CMD_NUM] = {
+    "Ligar Seta Esquerda",
+    "Desligar Seta Esquerda",
+    "Ligar Seta Direita",
+    "Desligar Seta Direita",
+    "Ligar Farol Baixo",
+    "Desligar Farol Baixo",
+    "Ligar Farol Alto",
+    "Desligar Farol Alto",
+    "Desligar Farol",
+    "Acionar Pedal do Acelerador",
+    "Acionar Pedal do Freio",
+    "Encerrar",
+    "Pausar",
+    "Retomar",
+    "Avançar Passo",
+};
+
+/**
+ * @brief Converte o texto de um comando do painel no seu identificador.
+ *
+ * @param texto Texto recebido na fila de mensagens.
+ * @return O ComandoId correspondente ou CMD_INVALIDO.
+ */
+static inline ComandoId comando_id(const char *texto) {
+    for (int i = 0; i < CMD_NUM; i++) {
+        if (strcmp(texto, NOMES_COMANDOS[i]) == 0) return (ComandoId)i;
+    }
+    return CMD_INVALIDO;
+}
+
+// Estado de execução do ciclo de controle (comandos "Pausar", "Retomar" e
+// "Avançar Passo", ou SIGUSR1). A exibição dos dados e a leitura dos
+// comandos continuam em qualquer estado.
+typedef enum {
+    EXEC_RODANDO = 0,
+    EXEC_PAUSADO,
+    EXEC_PASSO,              // Pausado, com ciclos de controle liberados
+    EXEC_NUM
+} EstadoExecucao;
+
+static const char *const NOMES_EXECUCAO[EXEC_NUM] = {
+    "rodando", "pausado", "passo",
+};
+
+// Threads do controlador que publicam contadores próprios
+typedef enum {
+    STATS_TH_CONTROLE = 0,   // Loop principal (process_control)
+    STATS_NUM_THREADS
+} StatsThread;
+
+static const char *const NOMES_THREADS[STATS_NUM_THREADS] = {
+    "controle",
+};
+
+// Contadores de uma thread. Cada thread escreve apenas no próprio slot,
+// alinhado em linha de cache para não haver falso compartilhamento.
+typedef struct {
+    _Atomic uint64_t iteracoes;          // Voltas do loop da thread
+    _Atomic uint64_t lock_aquisicoes;    // Aquisições da trava dos dados compartilhados
+    _Atomic uint64_t lock_espera_ns;     // Tempo total esperando a trava
+    _Atomic uint64_t lock_espera_max_ns; // Maior espera observada
+} __attribute__((aligned(64))) ThreadStats;
+
+// Segmento de estatísticas publicado pelo controlador
+typedef struct {
+    uint32_t magic;                      // STATS_MAGIC quando pronto
+    uint32_t versao;                     // STATS_VERSAO
+    int32_t pid;                         // PID do controlador
+
+    ThreadStats threads[STATS_NUM_THREADS];
+
+    // Limitadores (escritos apenas pela thread de controle)
+    _Atomic uint64_t cont_vel_sup;
+    _Atomic uint64_t cont_vel_inf;
+    _Atomic uint64_t cont_rpm_sup;
+    _Atomic uint64_t cont_rpm_inf;
+    _Atomic uint64_t cont_max_temp;
+
+    // Iterações do loop de controle que ultrapassaram o prazo do período
+    _Atomic uint64_t overruns;
+
+    // Estado de execução (EstadoExecucao), ciclos de controle executados
+    // passo a passo e iterações em que o controle ficou congelado na pausa
+    _Atomic uint32_t execucao;
+    _Atomic uint64_t passos;
+    _Atomic uint64_t ciclos_congelados;
+
+    // Comandos recebidos do painel, por tipo
+    _Atomic uint64_t comandos[CMD_NUM];
+    _Atomic uint64_t comandos_invalidos;
+
+    // Profundidade da fila de mensagens na última leitura
+    _Atomic uint32_t fila_profundidade;
+    _Atomic uint32_t fila_profundidade_max;
+
+    // Tabela de canais do sensor_sim, varrida a cada iteração do controle
+    _Atomic uint32_t canais_num;             // Canais anexados (0: sem tabela)
+    _Atomic uint32_t canais_hz_total;        // Soma das frequências configuradas
+    _Atomic uint64_t canais_atualizacoes;    // Leituras publicadas pelo sensor_sim
+    _Atomic uint64_t canais_lidas;           // Leituras novas vistas pelo controle
+    _Atomic uint64_t canais_sobrescritas;    // Substituídas antes de o controle as ler
+    _Atomic uint64_t canais_atrasos;         // Períodos perdidos pelo sensor_sim
+    _Atomic uint64_t canais_varreduras;
+    _Atomic uint64_t canais_varredura_ns;    // Tempo total das varreduras
+    _Atomic uint64_t canais_varredura_max_ns;
+
+    // Contenção da trava dos dados compartilhados, por ponto de aquisição
+    TabelaContencao contencao;
+} ControllerStats;
+
+/**
+ * @brief Incrementa um contador com escritor único.
+ *
+ * Como cada contador tem uma única thread escritora, basta um load e um
+ * store relaxados, sem instrução atômica de leitura-modificação-escrita.
+ */
+static inline void stats_inc(_Atomic uint64_t *contador) {
+    atomic_store_explicit(contador,
+                          atomic_load_explicit(contador, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+}
+
+/**
+ * @brief Soma um valor a um contador com escritor único.
+ */
+static inline void stats_add(_Atomic uint64_t *contador, uint64_t valor) {
+    atomic_store_explicit(contador,
+                          atomic_load_explicit(contador, memory_order_relaxed) + valor,
+                          memory_order_relaxed);
+}
+
+/**
+ * @brief Lê um contador publicado (para o relatório e para o ctlstat).
+ */
+static inline uint64_t stats_get(const _Atomic uint64_t *contador) {
+    return atomic_load_explicit((_Atomic uint64_t *)contador, memory_order_relaxed);
+}
+
+#endif // IPC_SHARED_H
@@ -0,0 +1,378 @@
+#ifndef REGRAS_H
+#define REGRAS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+/*
+ * Motor de regras dos limitadores. Cada regra tem uma entrada (velocidade,
+ * RPM ou temperatura), um comparador, um limiar, ações e um contador, e
+ * pertence a um grupo: dentro de um grupo só a primeira regra disparada
+ * vale, como em uma cadeia de `else if`; grupos diferentes são
+ * independentes.
+ *
+ * Forma textual de uma regra (linha `regra` do arquivo de perfil):
+ *
+ *   regra <contador> <grupo> <entrada> <comparador> <limiar> [<limiar>] <ação>...
+ *
+ *   comparador: >  >=  <  <=  entre (dois limiares, extremos excluídos)
+ *   ação:       multiplicar:<alvo>=<valor>  somar:<alvo>=<valor>  zerar:<alvo>
+ *               desligar (o motor apagou)   alerta (alerta de temperatura)
+ *   alvo:       velocidade  rpm  duty
+ *
+ * Limiares e valores são números ou nomes de parâmetros do perfil
+ * (`vel_max`, `-passo_duty`...), resolvidos na compilação.
+ *
+ * Na compilação, cada regra vira um intervalo aberto (inf, sup) sobre uma
+ * entrada (`x >= t` vira `x > t'` com t' o float imediatamente abaixo de
+ * t) e cada grupo com mais de uma regra vira uma máscara. A avaliação é um
+ * laço sem desvios que monta a máscara das regras disparadas, seguido da
+ * resolução dos grupos (fica o bit mais baixo de cada grupo); em lote,
+ * cada regra é testada contra uma coluna de amostras, o que o compilador
+ * vetoriza.
+ */
+
+#define REGRAS_MAX 32                // Bits da máscara de disparos
+#define REGRA_ACOES_MAX 4
+#define REGRA_NOME_MAX 16
+#define REGRA_DESCRICAO_MAX 48
+#define REGRA_LINHA_MAX 160
+
+typedef enum {
+    ENTRADA_VELOCIDADE = 0,
+    ENTRADA_RPM,
+    ENTRADA_TEMPERATURA,
+    ENTRADA_NUM
+} EntradaRegra;
+
+static const char *const NOMES_ENTRADAS[ENTRADA_NUM] = { "velocidade", "rpm", "temperatura" };
+
+typedef enum {
+    ALVO_VELOCIDADE = 0,
+    ALVO_RPM,
+    ALVO_DUTY,                       // Duty cycle do motor (0 a 10)
+    ALVO_NUM
+} AlvoRegra;
+
+static const char *const NOMES_ALVOS[ALVO_NUM] = { "velocidade", "rpm", "duty" };
+
+typedef enum {
+    ACAO_MULTIPLICAR = 0,
+    ACAO_SOMAR,
+    ACAO_ZERAR,
+    ACAO_DESLIGAR,                   // Evento: o motor apagou
+    ACAO_ALERTA,                     // Evento: alerta de temperatura
+    ACAO_NUM
+} TipoAcao;
+
+static const char *const NOMES_ACOES[ACAO_NUM] = { "multiplicar", "somar", "zerar", "desligar", "alerta" };
+
+// Eventos devolvidos por regras_aplicar(), tratados pelo controlador
+#define EVENTO_DESLIGAR (1u << 0)
+#define EVENTO_ALERTA   (1u << 1)
+
+typedef struct {
+    uint8_t tipo;                    // TipoAcao
+    uint8_t alvo;                    // AlvoRegra (multiplicar, somar, zerar)
+    float valor;
+} AcaoRegra;
+
+// Programa compilado: vetores por regra, na ordem do arquivo
+typedef struct {
+    uint32_t num_regras;
+    uint32_t num_grupos;             // Grupos com mais de uma regra
+    uint32_t grupos[REGRAS_MAX];     // Máscara das regras de cada grupo
+    uint8_t entrada[REGRAS_MAX];
+    float inf[REGRAS_MAX];           // Dispara se inf < x < sup
+    float sup[REGRAS_MAX];
+    uint8_t num_acoes[REGRAS_MAX];
+    AcaoRegra acoes[REGRAS_MAX][REGRA_ACOES_MAX];
+    uint16_t contador[REGRAS_MAX];   // Índice na TabelaContadores (regras_vincular)
+    char nome[REGRAS_MAX][REGRA_NOME_MAX];
+    char descricao[REGRAS_MAX][REGRA_DESCRICAO_MAX];
+} ProgramaRegras;
+
+// Contadores de disparos por nome, preservados entre trocas de perfil.
+// Só a thread de controle incrementa (disparos[regra.contador]); só a de
+// recarga acrescenta nomes, antes de publicar o programa que os usa.
+typedef struct {
+    char nome[REGRA_NOME_MAX];
+    char descricao[REGRA_DESCRICAO_MAX];   // Da regra mais recente com o nome
+    uint64_t disparos;
+} ContadorRegra;
+
+typedef struct {
+    ContadorRegra c[REGRAS_MAX * 2];
+    uint32_t num;
+} TabelaContadores;
+
+// Resolve um nome de parâmetro (sem sinal) em um valor; false se não existe
+typedef bool (*ResolverParametro)(const void *ctx, const char *nome, float *valor);
+
+/**
+ * @brief Converte um limiar ou valor (número ou parâmetro, com `-` opcional).
+ */
+static inline bool regras_valor(const char *texto, ResolverParametro resolver, const void *ctx, float *v) {
+    char *fim;
+    float n = strtof(texto, &fim);
+    if (fim != texto && *fim == '\0') {
+        *v = n;
+        return isfinite(n);
+    }
+    bool negativo = texto[0] == '-';
+    if (!resolver || !resolver(ctx, texto + negativo, v)) return false;
+    if (negativo) *v = -*v;
+    return true;
+}
+
+/**
+ * @brief Índice de um nome em uma tabela de nomes, ou -1.
+ */
+static inline int regras_indice(const char *const *nomes, int num, const char *nome) {
+    for (int i = 0; i < num; i++) {
+        if (strcmp(nomes[i], nome) == 0) return i;
+    }
+    return -1;
+}
+
+/**
+ * @brief Compila uma lista de regras em texto.
+ *
+ * @param p Programa resultante.
+ * @param linhas Regras, sem a palavra `regra`.
+ * @param num Número de regras.
+ * @param origem Nome do arquivo (ou "perfil padrão"), para as mensagens.
+ * @param numeros Linha de origem de cada regra (NULL: 1, 2, ...).
+ * @param resolver Resolve os parâmetros do perfil.
+ * @param alvos Máscara (1 << AlvoRegra) dos alvos que o controlador aceita.
+ * @return true se todas as regras compilaram; os erros vão para stderr.
+ */
+static inline bool regras_compilar(ProgramaRegras *p, const char *const *linhas, int num,
+                                   const char *origem, const int *numeros,
+                                   ResolverParametro resolver, const void *ctx, uint32_t alvos) {
+    memset(p, 0, sizeof(*p));
+    if (num > REGRAS_MAX) {
+        fprintf(stderr, "%s: %d regras (máximo %d)\n", origem, num, REGRAS_MAX);
+        return false;
+    }
+
+    char grupos[REGRAS_MAX][REGRA_NOME_MAX];
+    uint32_t mascaras[REGRAS_MAX] = {0};
+    int num_grupos = 0;
+
+    for (int i = 0; i < num; i++) {
+        int linha = numeros ? numeros[i] : i + 1;
+        char copia[REGRA_LINHA_MAX], *campos[6 + REGRA_ACOES_MAX];
+        int n = 0;
+        snprintf(copia, sizeof(copia), "%s", linhas[i]);
+        for (char *tok = strtok(copia, " \t\r\n"); tok; tok = strtok(NULL, " \t\r\n")) {
+            if (n == (int)(sizeof(campos) / sizeof(campos[0]))) {
+                fprintf(stderr, "%s:%d: regra com campos demais\n", origem, linha);
+                return false;
+            }
+            campos[n++] = tok;
+        }
+        if (n < 6) {
+            fprintf(stderr, "%s:%d: use \"regra <contador> <grupo> <entrada> <comparador> "
+                            "<limiar> <ação>...\"\n", origem, linha);
+            return false;
+        }
+
+        // Contador e grupo
+        if (strlen(campos[0]) >= REGRA_NOME_MAX || strlen(campos[1]) >= REGRA_NOME_MAX) {
+            fprintf(stderr, "%s:%d: nome de contador ou grupo longo demais\n", origem, linha);
+            return false;
+        }
+        memcpy(p->nome[i], campos[0], strlen(campos[0]) + 1);
+        int g = 0;
+        while (g < num_grupos && strcmp(grupos[g], campos[1]) != 0) g++;
+        if (g == num_grupos) memcpy(grupos[num_grupos++], campos[1], strlen(campos[1]) + 1);
+        mascaras[g] |= 1u << i;
+
+        // Condição: intervalo aberto (inf, sup)
+        int e = regras_indice(NOMES_ENTRADAS, ENTRADA_NUM, campos[2]);
+        if (e < 0) {
+            fprintf(stderr, "%s:%d: entrada desconhecida: %s\n", origem, linha, campos[2]);
+            return false;
+        }
+        p->entrada[i] = (uint8_t)e;
+        const char *comp = campos[3];
+        int k = 4;
+        float a, b = 0.0f;
+        bool entre = strcmp(comp, "entre") == 0;
+        if (!regras_valor(campos[k++], resolver, ctx, &a) ||
+            (entre && (k >= n || !regras_valor(campos[k++], resolver, ctx, &b)))) {
+            fprintf(stderr, "%s:%d: limiar inválido\n", origem, linha);
+            return false;
+        }
+        float inf = -INFINITY, sup = INFINITY;
+        if (strcmp(comp, ">") == 0) inf = a;
+        else if (strcmp(comp, ">=") == 0) inf = nextafterf(a, -INFINITY);
+        else if (strcmp(comp, "<") == 0) sup = a;
+        else if (strcmp(comp, "<=") == 0) sup = nextafterf(a, INFINITY);
+        else if (entre && a < b) inf = a, sup = b;
+        else {
+            fprintf(stderr, "%s:%d: comparador inválido: %s\n", origem, linha, comp);
+            return false;
+        }
+        p->inf[i] = inf;
+        p->sup[i] = sup;
+        if (entre) {
+            snprintf(p->descricao[i], REGRA_DESCRICAO_MAX, "%s entre %g e %g", campos[2], a, b);
+        } else {
+            snprintf(p->descricao[i], REGRA_DESCRICAO_MAX, "%s %s %g", campos[2], comp, a);
+        }
+
+        // Ações
+        if (k == n) {
+            fprintf(stderr, "%s:%d: regra sem ação\n", origem, linha);
+            return false;
+        }
+        for (; k < n; k++) {
+            if (p->num_acoes[i] == REGRA_ACOES_MAX) {
+                fprintf(stderr, "%s:%d: mais de %d ações\n", origem, linha, REGRA_ACOES_MAX);
+                return false;
+            }
+            char acao[REGRA_LINHA_MAX];
+            snprintf(acao, sizeof(acao), "%s", campos[k]);
+            char *valor = strchr(acao, '=');
+            if (valor) *valor++ = '\0';
+            char *alvo = strchr(acao, ':');
+            if (alvo) *alvo++ = '\0';
+            int t = regras_indice(NOMES_ACOES, ACAO_NUM, acao);
+            bool precisa_alvo = t == ACAO_MULTIPLICAR || t == ACAO_SOMAR || t == ACAO_ZERAR;
+            bool precisa_valor = t == ACAO_MULTIPLICAR || t == ACAO_SOMAR;
+            int alv = alvo ? regras_indice(NOMES_ALVOS, ALVO_NUM, alvo) : -1;
+            AcaoRegra *ac = &p->acoes[i][p->num_acoes[i]];
+            if (t < 0 || precisa_alvo != (alvo != NULL) || precisa_valor != (valor != NULL) ||
+                (precisa_alvo && (alv < 0 || !(alvos & (1u << alv)))) ||
+                (precisa_valor && !regras_valor(valor, resolver, ctx, &ac->valor))) {
+                fprintf(stderr, "%s:%d: ação inválida: %s\n", origem, linha, campos[k]);
+                return false;
+            }
+            ac->tipo = (uint8_t)t;
+            ac->alvo = (uint8_t)(alv < 0 ? 0 : alv);
+            p->num_acoes[i]++;
+        }
+    }
+
+    p->num_regras = (uint32_t)num;
+    for (int g = 0; g < num_grupos; g++) {
+        if (mascaras[g] & (mascaras[g] - 1)) p->grupos[p->num_grupos++] = mascaras[g];
+    }
+    return true;
+}
+
+/**
+ * @brief Associa cada regra a um contador da tabela (pelo nome), criando os
+ *        que faltam. Chamada antes de o programa ser publicado.
+ *
+ * @return false se a tabela está cheia.
+ */
+static inline bool regras_vincular(ProgramaRegras *p, TabelaContadores *t) {
+    for (uint32_t i = 0; i < p->num_regras; i++) {
+        uint32_t c = 0;
+        while (c < t->num && strcmp(t->c[c].nome, p->nome[i]) != 0) c++;
+        if (c == t->num) {
+            if (t->num == sizeof(t->c) / sizeof(t->c[0])) {
+                fprintf(stderr, "Contadores de regras esgotados\n");
+                return false;
+            }
+            memcpy(t->c[c].nome, p->nome[i], REGRA_NOME_MAX);
+            t->num++;
+        }
+        memcpy(t->c[c].descricao, p->descricao[i], REGRA_DESCRICAO_MAX);
+        p->contador[i] = (uint16_t)c;
+    }
+    return true;
+}
+
+/**
+ * @brief Mantém, em cada grupo, apenas a primeira regra disparada.
+ */
+static inline uint32_t regras_resolver(const ProgramaRegras *p, uint32_t m) {
+    for (uint32_t g = 0; g < p->num_grupos; g++) {
+        uint32_t b = m & p->grupos[g];
+        m = (m & ~p->grupos[g]) | (b & (0u - b));
+    }
+    return m;
+}
+
+/**
+ * @brief Avalia o programa em uma amostra.
+ *
+ * @return Máscara das regras disparadas (bit i: regra i).
+ */
+static inline uint32_t regras_avaliar(const ProgramaRegras *p, const float entradas[ENTRADA_NUM]) {
+    uint32_t m = 0;
+    for (uint32_t i = 0; i < p->num_regras; i++) {
+        float x = entradas[p->entrada[i]];
+        m |= (uint32_t)((x > p->inf[i]) & (x < p->sup[i])) << i;
+    }
+    return regras_resolver(p, m);
+}
+
+/**
+ * @brief Avalia o programa em @p n amostras, dadas em colunas por entrada.
+ *
+ * @param mascaras Saída: máscara de disparos de cada amostra.
+ */
+static inline void regras_avaliar_lote(const ProgramaRegras *p, const float *const colunas[ENTRADA_NUM],
+                                       size_t n, uint32_t *mascaras) {
+    memset(mascaras, 0, n * sizeof(*mascaras));
+    for (uint32_t i = 0; i < p->num_regras; i++) {
+        const float *x = colunas[p->entrada[i]];
+        const float inf = p->inf[i], sup = p->sup[i];
+        for (size_t j = 0; j < n; j++) mascaras[j] |= (uint32_t)((x[j] > inf) & (x[j] < sup)) << i;
+    }
+    if (p->num_grupos > 0) {
+        for (size_t j = 0; j < n; j++) mascaras[j] = regras_resolver(p, mascaras[j]);
+    }
+}
+
+/**
+ * @brief Soma os disparos de cada regra em @p n máscaras.
+ */
+static inline void regras_contar(const uint32_t *mascaras, size_t n, uint64_t disparos[REGRAS_MAX]) {
+    for (size_t j = 0; j < n; j++) {
+        for (uint32_t m = mascaras[j]; m; m &= m - 1) disparos[__builtin_ctz(m)]++;
+    }
+}
+
+/**
+ * @brief Aplica as ações da regra @p i às saídas.
+ *
+ * @param saidas Valores dos alvos, alterados na ordem das ações.
+ * @return Eventos (EVENTO_*) pedidos pela regra.
+ */
+static inline unsigned int regras_aplicar(const ProgramaRegras *p, uint32_t i, float saidas[ALVO_NUM]) {
+    unsigned int eventos = 0;
+    for (uint32_t a = 0; a < p->num_acoes[i]; a++) {
+        const AcaoRegra *ac = &p->acoes[i][a];
+        switch (ac->tipo) {
+        case ACAO_MULTIPLICAR: saidas[ac->alvo] *= ac->valor; break;
+        case ACAO_SOMAR:       saidas[ac->alvo] += ac->valor; break;
+        case ACAO_ZERAR:       saidas[ac->alvo] = 0.0f; break;
+        case ACAO_DESLIGAR:    eventos |= EVENTO_DESLIGAR; break;
+        case ACAO_ALERTA:      eventos |= EVENTO_ALERTA; break;
+        }
+    }
+    return eventos;
+}
+
+/**
+ * @brief Disparos de um contador pelo nome (0 se não existe).
+ */
+static inline uint64_t regras_disparos(const TabelaContadores *t, const char *nome) {
+    for (uint32_t c = 0; c < t->num; c++) {
+        if (strcmp(t->c[c].nome, nome) == 0) return t->c[c].disparos;
+    }
+    return 0;
+}
+
+#endif // REGRAS_H
@@ -1,46 +1,163 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <signal.h>
 #include <unistd.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
 #include <pthread.h>
+#include <getopt.h>
 #include <sys/ipc.h>
 #include <sys/shm.h>
-#include <semaphore.h>
-#include <fcntl.h>
 #include <time.h>
 #include <math.h>
 
-#define SHM_KEY_SENSORS 1234      // Chave da memória dos sensores
-#define NUM_SENSORS 3             // Quantidade de sensores (velocidade, RPM, temperatura)
+#include "ipc_shared.h"
+#include "aleatorio.h"
+#include "instancia.h"
+#include "rastreio.h"
+
+#define LOTE_RUIDO 64             // Amostras de ruído geradas de uma vez por canal
+#define LOTE_BENCHMARK 4096       // Tamanho do lote no modo --benchmark
+#define THREADS_BENCHMARK 3       // Threads da segunda coluna do --benchmark (uma por sensor antigo)
+#define MAX_GRUPOS 16             // Limite de threads do grupo de timers
+#define RESUMO_PERIODO_NS 10000000ull  // Intervalo mínimo entre atualizações do resumo (10 ms)
+#define IMPRIME_ATE_HZ 1          // Canais até esta frequência imprimem cada leitura
 
 // Definições de constantes da função de cálculo da temperatura do motor
-#define FACTOR_ACELERACAO 0.1 
+#define FACTOR_ACELERACAO 0.1
 #define FATOR_RESFRIAMENTO_AR 0.05
 #define MAX_TEMP_MOTOR 140
 #define BASE_TEMP 80
 
+// Faixa padrão de cada grandeza: velocidade entre 0 e 200 km/h, RPM entre
+// 500 e 8000 e temperatura entre 20ºC e 120ºC
+static const float FAIXA_GRANDEZA[GRANDEZA_NUM][2] = {
+    {0.0f, 200.0f}, {500.0f, 8000.0f}, {20.0f, 120.0f}
+};
 
-// Estrutura para os dados dos sensores
+// Um canal da tabela carregada na inicialização
 typedef struct {
-    float velocidade;   // Velocidade do carro (km/h)
-    int rpm;            // Rotação do motor (RPM)
-    float temperatura;  // Temperatura do motor (ºC)
-} SensorData;
-
-// Ponteiro para a memória compartilhada
+    char nome[CANAL_NOME_MAX];
+    Grandeza grandeza;
+    uint32_t hz;
+    bool calculada;           // Temperatura pela fórmula do enunciado, sem ruído
+    ModeloRuido modelo;
+} ConfigCanal;
+
+// Estado de um canal, usado apenas pela thread do grupo a que pertence
+typedef struct {
+    ConfigCanal config;
+    FonteRuido fonte;
+    float lote[LOTE_RUIDO];
+    size_t pos;
+    uint64_t periodo_ns;
+    uint64_t proximo_ns;      // Prazo absoluto da próxima leitura
+    CanalCompartilhado *pub;  // Slot do canal na tabela compartilhada
+} CanalSensor;
+
+// Uma thread do grupo de timers e os canais que ela atende
+typedef struct {
+    int id;
+    int *canais;
+    int num_canais;
+    uint64_t hz_total;
+    _Atomic uint64_t atraso_max_ns;  // Maior atraso de uma leitura (zerado a cada resumo)
+} GrupoTimers;
+
+// Tabela padrão: os três sensores originais, um por segundo
+static const ConfigCanal TABELA_PADRAO[] = {
+    { "Velocidade",  GRANDEZA_VELOCIDADE,  1, false, { RUIDO_UNIFORME, 0, 0, 0, 0 } },
+    { "RPM",         GRANDEZA_RPM,         1, false, { RUIDO_UNIFORME, 0, 0, 0, 0 } },
+    { "Temperatura", GRANDEZA_TEMPERATURA, 1, true,  { RUIDO_UNIFORME, 0, 0, 0, 0 } },
+};
+
+// Ponteiro para a memória compartilhada (com a trava embutida)
 SensorData *shared_data;
 
-// Semáforo para sincronização
-sem_t *sem_sync;
+// Tabela de canais publicada (SHM_KEY_CANAIS) e o estado local de cada canal
+TabelaCanais *tabela;
+int shm_id_canais = -1;
+ConfigCanal configs[MAX_CANAIS];
+CanalSensor *canais;
+int num_canais = 0;
+
+// Canais de cada grandeza, para montar o resumo em SensorData
+int *canais_grandeza[GRANDEZA_NUM];
+int num_canais_grandeza[GRANDEZA_NUM];
+_Atomic uint64_t ultimo_resumo_ns[GRANDEZA_NUM];
+
+GrupoTimers grupos[MAX_GRUPOS];
+int num_grupos = 0;
+
+volatile sig_atomic_t running = 1;
+
+/**
+ * @brief Handler para SIGINT: encerra as threads dos timers.
+ */
+void sigint_handler(int signal) {
+    (void)signal;
+    running = 0;
+}
+
+/**
+ * @brief Handler para SIGPROF: acorda a thread que exporta o rastreio.
+ */
+void sigprof_handler(int signal) {
+    (void)signal;
+    rastreio_pedir_exportacao();
+}
 
 /**
- * @brief Gera um valor flutuante aleatório entre @p min e @p max.
+ * @brief Retorna o instante atual de CLOCK_MONOTONIC em nanossegundos.
+ */
+static inline uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Dorme até um instante absoluto do relógio monotônico.
  *
- * @param min Valor mínimo do intervalo.
- * @param max Valor máximo do intervalo.
- * @return Valor flutuante aleatório entre @p min e @p max.
+ * Retorna antes do prazo se o programa estiver encerrando.
  */
-float random_float(float min, float max) {
-    return min + ((float)rand() / (float)RAND_MAX) * (max - min);
+void sleep_until_ns(uint64_t alvo_ns) {
+    struct timespec alvo = {
+        .tv_sec = (time_t)(alvo_ns / 1000000000ull),
+        .tv_nsec = (long)(alvo_ns % 1000000000ull),
+    };
+    RASTREIO_ESCOPO("dormir");
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &alvo, NULL) == EINTR) {
+        if (!running) return;
+    }
+}
+
+/**
+ * @brief Monta um modelo de ruído para a faixa [min, max].
+ *
+ * O gaussiano fica centrado na faixa com desvio de 1/6 dela; o passeio
+ * começa no meio da faixa e anda, por leitura, com desvio de 1/50 dela.
+ */
+ModeloRuido noise_model(TipoRuido tipo, float min, float max) {
+    ModeloRuido m = { tipo, min, max, (min + max) / 2.0f, 0.0f };
+    m.desvio = (max - min) / (tipo == RUIDO_PASSEIO ? 50.0f : 6.0f);
+    return m;
+}
+
+/**
+ * @brief Próxima leitura sorteada de um canal.
+ *
+ * As leituras são geradas em lotes de LOTE_RUIDO; o lote é refeito
+ * quando se esgota.
+ */
+float channel_next(CanalSensor *c) {
+    if (c->pos == 0 || c->pos == LOTE_RUIDO) {
+        ruido_preencher(&c->fonte, c->lote, LOTE_RUIDO);
+        c->pos = 0;
+    }
+    return c->lote[c->pos++];
 }
 
 /**
@@ -59,123 +176,433 @@ float calculate_engine_temp(float velocidade, int rpm) {
 }
 
 /**
- * @brief Simula o funcionamento de um sensor de velocidade.
+ * @brief Revalida os sensores deixados por um dono morto da trava.
  *
- * Esta função executa continuamente em uma thread separada,
- * gerando valores aleatórios de velocidade entre 0 e 200 km/h.
- * Os valores são armazenados na memória compartilhada, garantindo
- * exclusão mútua através de um semáforo. A velocidade atualizada
- * é então exibida no console. A função simula um atraso entre
- * leituras para imitar o comportamento de um sensor real.
+ * Chamada com a trava já tomada quando outro processo (por exemplo, o
+ * controlador) morreu no meio da seção crítica.
+ */
+void revalidate_sensors() {
+    fprintf(stderr, "[Sensores] Dono da trava morreu na seção crítica; revalidando os dados\n");
+    if (!isfinite(shared_data->velocidade) || shared_data->velocidade < 0.0) {
+        shared_data->velocidade = 0.0;
+    }
+    if (shared_data->rpm < 0) shared_data->rpm = 800;
+    if (!isfinite(shared_data->temperatura)) {
+        shared_data->temperatura = calculate_engine_temp(shared_data->velocidade, shared_data->rpm);
+    }
+}
+
+/**
+ * @brief Trava os dados dos sensores, contabilizando a espera no sítio @p ponto.
  *
- * @param arg Argumento para a thread (não utilizado).
- * @return NULL
+ * Use pela macro sensors_lock(), que cria um ponto por chamada.
  */
-void *sensor_velocidade(void *arg) {
-    (void)arg; // Silenciar warning de parâmetro não utilizado
+static inline void sensors_lock_em(PontoContencao *ponto) {
+    RASTREIO_ESCOPO("trava");
+    uint64_t inicio = now_ns();
+    trava_lock(&shared_data->trava, revalidate_sensors);
+    uint64_t obtida = now_ns();
+    contencao_entrou(contencao_sitio(tabela ? &tabela->contencao : NULL, ponto), obtida - inicio, obtida);
+}
 
-    while (1) {
-        // valor de teste
-        //float velocidade = 100.0;
+#define sensors_lock() sensors_lock_em(PONTO_CONTENCAO())
 
-        float velocidade = random_float(0, 200); // Velocidade entre 0 e 200 km/h
+/**
+ * @brief Libera os dados dos sensores.
+ */
+static inline void sensors_unlock() {
+    uint64_t liberada = now_ns();
+    trava_unlock(&shared_data->trava);
+    contencao_saiu(liberada);
+}
 
-        sem_wait(sem_sync); // Entrar na seção crítica
-        shared_data->velocidade = velocidade;
-        sem_post(sem_sync); // Sair da seção crítica
+/**
+ * @brief Procura um nome em uma tabela de nomes.
+ *
+ * @return O índice do nome, ou -1 se não estiver na tabela.
+ */
+int find_name(const char *const *nomes, int quantidade, const char *nome) {
+    for (int i = 0; i < quantidade; i++) {
+        if (strcmp(nomes[i], nome) == 0) return i;
+    }
+    return -1;
+}
 
-        printf("[Sensor Velocidade] Atualizado: %.0f km/h\n", velocidade);
-        sleep(1); // Simular tempo entre leituras
+/**
+ * @brief Carrega a tabela de canais de um arquivo texto.
+ *
+ * Cada linha descreve um canal: `nome grandeza hz ruido [min max]`, em que
+ * a grandeza é velocidade, rpm ou temperatura, hz vai de CANAL_HZ_MIN a
+ * CANAL_HZ_MAX e o ruído é uniforme, gaussiano ou passeio (ou calculada,
+ * apenas para temperatura: a fórmula do enunciado). Sem min e max, vale a
+ * faixa padrão da grandeza. Linhas vazias e o que vem depois de '#' são
+ * ignorados. Qualquer erro encerra o programa indicando a linha.
+ */
+void load_channel_table(const char *arquivo) {
+    FILE *f = fopen(arquivo, "r");
+    if (f == NULL) {
+        perror("Erro ao abrir a tabela de canais");
+        exit(EXIT_FAILURE);
+    }
+
+    char linha[256];
+    int n_linha = 0;
+    while (fgets(linha, sizeof(linha), f) != NULL) {
+        n_linha++;
+        char *comentario = strchr(linha, '#');
+        if (comentario) *comentario = '\0';
+
+        char nome[64], grandeza[32], ruido[32];
+        unsigned int hz;
+        float min, max;
+        int campos = sscanf(linha, "%63s %31s %u %31s %f %f", nome, grandeza, &hz, ruido, &min, &max);
+        if (campos <= 0) continue;
+        if (campos != 4 && campos != 6) {
+            fprintf(stderr, "%s:%d: esperado 'nome grandeza hz ruido [min max]'\n", arquivo, n_linha);
+            exit(EXIT_FAILURE);
+        }
+        if (num_canais == MAX_CANAIS) {
+            fprintf(stderr, "%s:%d: mais de %d canais\n", arquivo, n_linha, MAX_CANAIS);
+            exit(EXIT_FAILURE);
+        }
+
+        ConfigCanal *c = &configs[num_canais];
+        int g = find_name(NOMES_GRANDEZAS, GRANDEZA_NUM, grandeza);
+        int r = find_name(NOMES_RUIDOS, RUIDO_NUM, ruido);
+        bool calculada = strcmp(ruido, "calculada") == 0;
+        if (strlen(nome) >= CANAL_NOME_MAX) {
+            fprintf(stderr, "%s:%d: nome com mais de %d caracteres\n", arquivo, n_linha, CANAL_NOME_MAX - 1);
+            exit(EXIT_FAILURE);
+        }
+        if (g < 0) {
+            fprintf(stderr, "%s:%d: grandeza inválida: %s (use velocidade, rpm ou temperatura)\n",
+                    arquivo, n_linha, grandeza);
+            exit(EXIT_FAILURE);
+        }
+        if (hz < CANAL_HZ_MIN || hz > CANAL_HZ_MAX) {
+            fprintf(stderr, "%s:%d: frequência inválida: %u Hz (use %d a %d)\n",
+                    arquivo, n_linha, hz, CANAL_HZ_MIN, CANAL_HZ_MAX);
+            exit(EXIT_FAILURE);
+        }
+        if (r < 0 && !(calculada && g == GRANDEZA_TEMPERATURA)) {
+            fprintf(stderr, "%s:%d: ruído inválido: %s (use uniforme, gaussiano ou passeio%s)\n",
+                    arquivo, n_linha, ruido, g == GRANDEZA_TEMPERATURA ? ", ou calculada" : "");
+            exit(EXIT_FAILURE);
+        }
+        if (campos == 4) {
+            min = FAIXA_GRANDEZA[g][0];
+            max = FAIXA_GRANDEZA[g][1];
+        } else if (!(min < max)) {
+            fprintf(stderr, "%s:%d: faixa inválida: %g a %g\n", arquivo, n_linha, min, max);
+            exit(EXIT_FAILURE);
+        }
+
+        strcpy(c->nome, nome);
+        c->grandeza = (Grandeza)g;
+        c->hz = hz;
+        c->calculada = calculada;
+        c->modelo = noise_model(calculada ? RUIDO_UNIFORME : (TipoRuido)r, min, max);
+        num_canais++;
+    }
+    fclose(f);
+
+    if (num_canais == 0) {
+        fprintf(stderr, "%s: nenhum canal definido\n", arquivo);
+        exit(EXIT_FAILURE);
     }
-    return NULL;
 }
 
+/**
+ * @brief Usa a tabela padrão (os três sensores originais, a 1 Hz).
+ *
+ * @param tipo Modelo de ruído da velocidade e do RPM (--ruido).
+ */
+void load_default_table(TipoRuido tipo) {
+    num_canais = (int)(sizeof(TABELA_PADRAO) / sizeof(TABELA_PADRAO[0]));
+    for (int i = 0; i < num_canais; i++) {
+        configs[i] = TABELA_PADRAO[i];
+        Grandeza g = configs[i].grandeza;
+        configs[i].modelo = noise_model(tipo, FAIXA_GRANDEZA[g][0], FAIXA_GRANDEZA[g][1]);
+    }
+}
 
 /**
- * @brief Simula o funcionamento de um sensor de RPM.
+ * @brief Cria a tabela de canais compartilhada, com o tamanho da tabela carregada.
  *
- * Esta função executa continuamente em uma thread separada,
- * gerando valores aleatórios de RPM entre 500 e 8000.
- * Os valores são armazenados na memória compartilhada, garantindo
- * exclusão mútua através de um semáforo. O valor atualizado
- * é então exibido no console. A função simula um atraso entre
- * leituras para imitar o comportamento de um sensor real.
+ * Uma tabela deixada por uma execução anterior é marcada para remoção (quem
+ * ainda a tiver anexada percebe e anexa a nova) e um segmento novo é
+ * criado. O CANAIS_MAGIC só é publicado depois de os descritores estarem
+ * preenchidos.
+ */
+void init_channel_memory() {
+    int antigo = shmget(chave_ipc(SHM_KEY_CANAIS), 0, 0);
+    if (antigo >= 0) shmctl(antigo, IPC_RMID, NULL);
+
+    size_t tamanho = canais_tamanho((uint32_t)num_canais);
+    shm_id_canais = shmget(chave_ipc(SHM_KEY_CANAIS), tamanho, IPC_CREAT | IPC_EXCL | 0644);
+    if (shm_id_canais < 0) {
+        perror("Erro ao criar memória compartilhada para a tabela de canais");
+        exit(EXIT_FAILURE);
+    }
+    tabela = (TabelaCanais *)shmat(shm_id_canais, NULL, 0);
+    if (tabela == (void *)-1) {
+        perror("Erro ao associar memória compartilhada para a tabela de canais");
+        shmctl(shm_id_canais, IPC_RMID, NULL);
+        exit(EXIT_FAILURE);
+    }
+
+    memset(tabela, 0, tamanho);
+    tabela->versao = CANAIS_VERSAO;
+    tabela->pid = getpid();
+    tabela->num_canais = (uint32_t)num_canais;
+    tabela->num_threads = (uint32_t)num_grupos;
+    contencao_iniciar(&tabela->contencao, "sensor_sim");
+    for (int i = 0; i < num_canais; i++) {
+        strcpy(tabela->canais[i].nome, configs[i].nome);
+        tabela->canais[i].grandeza = configs[i].grandeza;
+        tabela->canais[i].hz = configs[i].hz;
+        canais[i].pub = &tabela->canais[i];
+    }
+    __atomic_store_n(&tabela->magic, CANAIS_MAGIC, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Prepara o estado local de cada canal e o índice por grandeza.
  *
- * @param arg Argumento para a thread (não utilizado).
- * @return NULL
+ * Cada canal com ruído tem o próprio gerador, derivado da semente e do
+ * número do canal: a mesma semente e a mesma tabela reproduzem as leituras.
  */
-void *sensor_rpm(void *arg) {
-    (void)arg;
+void init_channels(uint64_t semente) {
+    canais = (CanalSensor *)calloc((size_t)num_canais, sizeof(CanalSensor));
+    if (canais == NULL) {
+        perror("Erro ao alocar os canais");
+        exit(EXIT_FAILURE);
+    }
+    uint64_t inicio = now_ns();
+    for (int i = 0; i < num_canais; i++) {
+        CanalSensor *c = &canais[i];
+        c->config = configs[i];
+        ruido_init(&c->fonte, &c->config.modelo, semente, (uint32_t)i);
+        c->periodo_ns = 1000000000ull / c->config.hz;
+        c->proximo_ns = inicio;
+    }
 
-    while (1) {
-        // valor de teste
-        //int rpm = 3000;
-        int rpm = (int)random_float(500, 8000); // RPM entre 500 e 8000
+    for (int g = 0; g < GRANDEZA_NUM; g++) {
+        canais_grandeza[g] = (int *)malloc((size_t)num_canais * sizeof(int));
+        if (canais_grandeza[g] == NULL) {
+            perror("Erro ao alocar os canais");
+            exit(EXIT_FAILURE);
+        }
+        num_canais_grandeza[g] = 0;
+    }
+    for (int i = 0; i < num_canais; i++) {
+        Grandeza g = configs[i].grandeza;
+        canais_grandeza[g][num_canais_grandeza[g]++] = i;
+    }
+}
 
-        sem_wait(sem_sync); 
-        shared_data->rpm = rpm;
-        sem_post(sem_sync);
+/**
+ * @brief Compara dois canais pela frequência, da maior para a menor (qsort).
+ */
+int compare_rate_desc(const void *a, const void *b) {
+    uint32_t ha = configs[*(const int *)a].hz, hb = configs[*(const int *)b].hz;
+    return ha < hb ? 1 : ha > hb ? -1 : 0;
+}
 
-        printf("[Sensor RPM] Atualizado: %d RPM\n", rpm);
-        sleep(1); // Simular tempo entre leituras
+/**
+ * @brief Distribui os canais entre as threads do grupo de timers.
+ *
+ * Os canais mais rápidos são distribuídos primeiro, cada um para a thread
+ * com a menor soma de frequências até então, equilibrando as leituras
+ * por segundo de cada thread.
+ */
+void assign_channels(int threads) {
+    num_grupos = threads < num_canais ? threads : num_canais;
+    for (int k = 0; k < num_grupos; k++) {
+        grupos[k].id = k;
+        grupos[k].canais = (int *)malloc((size_t)num_canais * sizeof(int));
+        if (grupos[k].canais == NULL) {
+            perror("Erro ao alocar os grupos de timers");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    int ordem[MAX_CANAIS];
+    for (int i = 0; i < num_canais; i++) ordem[i] = i;
+    qsort(ordem, (size_t)num_canais, sizeof(int), compare_rate_desc);
+    for (int i = 0; i < num_canais; i++) {
+        GrupoTimers *menor = &grupos[0];
+        for (int k = 1; k < num_grupos; k++) {
+            if (grupos[k].hz_total < menor->hz_total) menor = &grupos[k];
+        }
+        menor->canais[menor->num_canais++] = ordem[i];
+        menor->hz_total += configs[ordem[i]].hz;
     }
-    return NULL;
 }
 
+/**
+ * @brief Atualiza em SensorData o resumo de uma grandeza.
+ *
+ * O resumo é o que o controlador lê nos limitadores: a média dos canais de
+ * velocidade e de RPM e a maior temperatura entre as sondas. Para não
+ * disputar a trava a cada leitura dos canais rápidos, cada grandeza é
+ * resumida no máximo a cada RESUMO_PERIODO_NS (a thread que vencer o
+ * compare-and-swap escreve).
+ */
+void publish_summary(Grandeza g, uint64_t agora) {
+    uint64_t ultimo = atomic_load_explicit(&ultimo_resumo_ns[g], memory_order_relaxed);
+    if (ultimo != 0 && agora - ultimo < RESUMO_PERIODO_NS) return;
+    if (!atomic_compare_exchange_strong(&ultimo_resumo_ns[g], &ultimo, agora)) return;
+
+    float soma = 0.0f, maximo = -INFINITY;
+    int n = 0;
+    for (int k = 0; k < num_canais_grandeza[g]; k++) {
+        const CanalCompartilhado *c = &tabela->canais[canais_grandeza[g][k]];
+        if (atomic_load_explicit(&c->atualizacoes, memory_order_acquire) == 0) continue;
+        float v = atomic_load_explicit(&c->valor, memory_order_relaxed);
+        soma += v;
+        if (v > maximo) maximo = v;
+        n++;
+    }
+    if (n == 0) return;
+
+    sensors_lock(); // Entrar na seção crítica
+    switch (g) {
+    case GRANDEZA_VELOCIDADE:  shared_data->velocidade = soma / n; break;
+    case GRANDEZA_RPM:         shared_data->rpm = (int)(soma / n); break;
+    case GRANDEZA_TEMPERATURA: shared_data->temperatura = maximo; break;
+    default: break;
+    }
+    sensors_unlock(); // Sair da seção crítica
+}
 
 /**
- * @brief Simula o funcionamento de um sensor de temperatura.
+ * @brief Faz uma leitura de um canal e a publica.
  *
- * Esta função executa continuamente em uma thread separada,
- * gerando valores aleatórios de temperatura entre 20ºC e 120ºC,
- * ou com a função calculate_engine_temp().
- * Os valores são armazenados na memória compartilhada, garantindo
- * exclusão mútua através de um semáforo. A temperatura atualizada
- * é então exibida no console. A função simula um atraso entre
- * leituras para imitar o comportamento de um sensor real.
- * 
- * @note Esta função utiliza por default a função calculate_engine_temp() 
- * para calcular a temperatura do motor.
+ * Canais com ruído tiram o próximo valor do seu lote; a temperatura
+ * calculada usa a velocidade e o RPM atuais de SensorData. O valor vai
+ * para o slot do canal na tabela compartilhada e, conforme a grandeza,
+ * para o resumo em SensorData. Canais lentos (até IMPRIME_ATE_HZ) exibem
+ * cada leitura no console, como os sensores originais.
+ */
+void update_channel(CanalSensor *c, uint64_t agora) {
+    RASTREIO_ESCOPO(c->config.nome);
+    float valor;
+    if (c->config.calculada) {
+        sensors_lock();
+        float velocidade = shared_data->velocidade;
+        int rpm = shared_data->rpm;
+        sensors_unlock();
+        valor = calculate_engine_temp(velocidade, rpm);
+    } else {
+        valor = channel_next(c);
+    }
+    if (c->config.grandeza == GRANDEZA_RPM) valor = (float)(int)valor;
+
+    // O contador é publicado depois do valor: quem o lê com acquire vê o valor novo
+    atomic_store_explicit(&c->pub->valor, valor, memory_order_relaxed);
+    atomic_store_explicit(&c->pub->t_ns, agora, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    stats_inc(&c->pub->atualizacoes);
+
+    publish_summary(c->config.grandeza, agora);
+
+    if (c->config.hz <= IMPRIME_ATE_HZ) {
+        RASTREIO_ESCOPO("printf");
+        switch (c->config.grandeza) {
+        case GRANDEZA_VELOCIDADE:
+            printf("[Sensor %s] Atualizado: %.0f km/h\n", c->config.nome, valor);
+            break;
+        case GRANDEZA_RPM:
+            printf("[Sensor %s] Atualizado: %d RPM\n", c->config.nome, (int)valor);
+            break;
+        default:
+            printf("[Sensor %s] Atualizado: %.2f ºC\n", c->config.nome, valor);
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Thread do grupo de timers: atende os canais que lhe couberam.
  *
- * @param arg Argumento para a thread (não utilizado).
+ * Cada canal tem um prazo absoluto; a thread dorme até o prazo mais
+ * próximo entre os seus canais (clock_nanosleep com TIMER_ABSTIME), faz
+ * as leituras vencidas e avança cada prazo em fase fixa. Se a thread não
+ * der conta, os períodos perdidos de um canal são contados em `atrasos` e
+ * pulados, mantendo a fase, em vez de acumularem leituras atrasadas.
+ *
+ * @param arg GrupoTimers da thread.
  * @return NULL
  */
-void *sensor_temperatura(void *arg) {
-    (void)arg; 
-
-    while (1) {
-        float temperatura, velocidade;
-        int rpm;
-        
-        // valor de teste
-        //temperatura = 90.0;
-        
-        //temperatura = random_float(20.0, 120.0); // Temperatura entre 20ºC e 120ºC
-
-        sem_wait(sem_sync); 
-        rpm = shared_data->rpm;
-        velocidade = shared_data->velocidade;
-        sem_post(sem_sync); 
-        
-        temperatura = calculate_engine_temp(velocidade, rpm);
-
-        sem_wait(sem_sync); 
-        shared_data->temperatura = temperatura;
-        sem_post(sem_sync);
-
-        printf("[Sensor Temperatura] Atualizado: %.2f ºC\n", temperatura);
-        sleep(1); // Simular tempo entre leituras
+void *timer_group(void *arg) {
+    GrupoTimers *g = (GrupoTimers *)arg;
+    char nome[RASTREIO_NOME_MAX];
+    snprintf(nome, sizeof(nome), "timer_%d", g->id);
+    rastreio_registrar_thread(nome);
+
+    while (running) {
+        uint64_t agora = now_ns();
+        uint64_t proximo = UINT64_MAX;
+        for (int k = 0; k < g->num_canais; k++) {
+            CanalSensor *c = &canais[g->canais[k]];
+            if (c->proximo_ns <= agora) {
+                uint64_t atraso = agora - c->proximo_ns;
+                if (atraso > atomic_load_explicit(&g->atraso_max_ns, memory_order_relaxed)) {
+                    atomic_store_explicit(&g->atraso_max_ns, atraso, memory_order_relaxed);
+                }
+                update_channel(c, agora);
+                c->proximo_ns += c->periodo_ns;
+                if (agora >= c->proximo_ns) {
+                    uint64_t perdidos = (agora - c->proximo_ns) / c->periodo_ns + 1;
+                    c->proximo_ns += perdidos * c->periodo_ns;
+                    stats_add(&c->pub->atrasos, perdidos);
+                }
+            }
+            if (c->proximo_ns < proximo) proximo = c->proximo_ns;
+        }
+        sleep_until_ns(proximo);
     }
     return NULL;
 }
 
+/**
+ * @brief Exibe, uma vez por segundo, as leituras feitas e os atrasos.
+ *
+ * Só é usado quando algum canal passa de IMPRIME_ATE_HZ, quando imprimir
+ * cada leitura deixaria de ser legível.
+ */
+void print_rates(uint64_t *leituras_ant, uint64_t *atrasos_ant, uint64_t *inicio_ns) {
+    uint64_t leituras = 0, atrasos = 0, hz_total = 0, atraso_max = 0;
+    for (int i = 0; i < num_canais; i++) {
+        leituras += stats_get(&tabela->canais[i].atualizacoes);
+        atrasos += stats_get(&tabela->canais[i].atrasos);
+        hz_total += configs[i].hz;
+    }
+    for (int k = 0; k < num_grupos; k++) {
+        uint64_t a = atomic_exchange_explicit(&grupos[k].atraso_max_ns, 0, memory_order_relaxed);
+        if (a > atraso_max) atraso_max = a;
+    }
+    uint64_t agora = now_ns();
+    double dt = (agora - *inicio_ns) / 1e9;
+    printf("[Canais] %d canais em %d threads: %.0f leituras/s de %llu configuradas, "
+           "%.0f períodos perdidos/s, atraso máx %.3f ms\n",
+           num_canais, num_grupos, (leituras - *leituras_ant) / dt, (unsigned long long)hz_total,
+           (atrasos - *atrasos_ant) / dt, atraso_max / 1e6);
+    fflush(stdout);
+    *leituras_ant = leituras;
+    *atrasos_ant = atrasos;
+    *inicio_ns = agora;
+}
+
 
 /**
  * @brief Cria e inicializa a memória compartilhada para os dados dos sensores.
  *
  * Esta função cria uma memória compartilhada para armazenar os dados dos
  * sensores (velocidade, RPM e temperatura) e a associa ao espaço de endereçamento
- * do processo.
+ * do processo. A trava embutida no segmento é inicializada pelo primeiro
+ * processo a anexá-lo (este ou o controlador).
  *
  * @note Esta função utiliza a chave SHM_KEY_SENSORS para criar a memória
  * compartilhada.
@@ -183,7 +610,7 @@ void *sensor_temperatura(void *arg) {
  * @return Nada.
  */
 void init_shared_memory() {
-    int shm_id = shmget(SHM_KEY_SENSORS, sizeof(SensorData), IPC_CREAT | 0666);
+    int shm_id = shmget(chave_ipc(SHM_KEY_SENSORS), sizeof(SensorData), IPC_CREAT | 0666);
     if (shm_id < 0) {
         perror("Erro ao criar memória compartilhada");
         exit(EXIT_FAILURE);
@@ -194,70 +621,263 @@ void init_shared_memory() {
         perror("Erro ao associar memória compartilhada");
         exit(EXIT_FAILURE);
     }
+    trava_init(&shared_data->trava);
 }
 
+// Uma thread do modo --benchmark
+typedef struct {
+    int tipo;                 // TipoRuido, ou -1 para rand()
+    uint32_t canal;
+    uint64_t semente;
+    size_t amostras;
+    double soma;              // Impede que o compilador descarte as amostras
+} TrabalhoBenchmark;
 
 /**
- * @brief Inicializa o semáforo para sincronizar o acesso
- *        à memória compartilhada.
+ * @brief Gera as amostras de uma thread do benchmark.
  *
- * Cria o semáforo "/sem_sync" com valor inicial de 1.
+ * Com tipo -1, reproduz o gerador antigo (rand() a cada amostra, estado
+ * global compartilhado entre as threads); caso contrário, enche lotes de
+ * LOTE_BENCHMARK com a fonte de ruído da própria thread.
+ */
+void *benchmark_worker(void *arg) {
+    TrabalhoBenchmark *t = (TrabalhoBenchmark *)arg;
+    float lote[LOTE_BENCHMARK];
+    double soma = 0.0;
+    if (t->tipo < 0) {
+        for (size_t i = 0; i < t->amostras; i++) {
+            soma += 0.0f + ((float)rand() / (float)RAND_MAX) * 200.0f;
+        }
+    } else {
+        FonteRuido fonte;
+        ModeloRuido modelo = noise_model((TipoRuido)t->tipo, FAIXA_GRANDEZA[GRANDEZA_VELOCIDADE][0],
+                                         FAIXA_GRANDEZA[GRANDEZA_VELOCIDADE][1]);
+        ruido_init(&fonte, &modelo, t->semente, t->canal);
+        for (size_t feitas = 0; feitas < t->amostras; feitas += LOTE_BENCHMARK) {
+            size_t n = t->amostras - feitas < LOTE_BENCHMARK ? t->amostras - feitas : LOTE_BENCHMARK;
+            ruido_preencher(&fonte, lote, n);
+            for (size_t i = 0; i < n; i++) soma += lote[i];
+        }
+    }
+    t->soma = soma;
+    return NULL;
+}
+
+/**
+ * @brief Mede a taxa de geração de amostras com @p threads threads.
  *
- * @return Nada.
+ * @return Milhões de amostras por segundo, somando as threads.
  */
-void init_semaphore() {
-    sem_sync = sem_open("/sem_sync", O_CREAT, 0666, 1);
-    if (sem_sync == SEM_FAILED) {
-        perror("Erro ao criar semáforo");
-        exit(EXIT_FAILURE);
+double benchmark_rate(int tipo, int threads, size_t amostras, uint64_t semente) {
+    pthread_t ids[threads];
+    TrabalhoBenchmark trabalhos[threads];
+    uint64_t inicio = now_ns();
+    for (int i = 0; i < threads; i++) {
+        trabalhos[i] = (TrabalhoBenchmark){ tipo, (uint32_t)i, semente, amostras, 0.0 };
+        if (pthread_create(&ids[i], NULL, benchmark_worker, &trabalhos[i]) != 0) {
+            perror("Erro ao criar thread do benchmark");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (int i = 0; i < threads; i++) pthread_join(ids[i], NULL);
+    double s = (now_ns() - inicio) / 1e9;
+    return (double)amostras * threads / s / 1e6;
+}
+
+/**
+ * @brief Compara rand() com os geradores por canal e sai.
+ *
+ * Usa 1 thread e @p threads threads.
+ */
+void run_benchmark(size_t amostras, uint64_t semente, int threads) {
+    printf("Benchmark: %zu amostras por thread (lotes de %d)\n\n", amostras, LOTE_BENCHMARK);
+    printf("%-22s %14s %14s\n", "Gerador", "1 thread", "");
+    printf("%-22s %14s %11d threads\n", "", "(M amostras/s)", threads);
+    printf("%-22s %14.1f %14.1f\n", "rand() (antigo)",
+           benchmark_rate(-1, 1, amostras, semente), benchmark_rate(-1, threads, amostras, semente));
+    for (int tipo = 0; tipo < RUIDO_NUM; tipo++) {
+        printf("xoshiro256** %-9s %14.1f %14.1f\n", NOMES_RUIDOS[tipo],
+               benchmark_rate(tipo, 1, amostras, semente),
+               benchmark_rate(tipo, threads, amostras, semente));
     }
 }
 
+/**
+ * @brief Exibe a ajuda da linha de comando.
+ */
+void print_usage(const char *prog) {
+    printf("Uso: %s [opções]\n", prog);
+    printf("  -c, --canais <arquivo>  Tabela de canais (padrão: velocidade, RPM e\n");
+    printf("                          temperatura a 1 Hz)\n");
+    printf("  -t, --threads <n>       Threads do grupo de timers (padrão: uma por CPU,\n");
+    printf("                          até %d)\n", MAX_GRUPOS);
+    printf("  -s, --semente <n>       Semente dos geradores (padrão: derivada do relógio)\n");
+    printf("  -r, --ruido <modelo>    Modelo de ruído da velocidade e do RPM da tabela\n");
+    printf("                          padrão: uniforme (padrão), gaussiano ou passeio\n");
+    printf("  -b, --benchmark <n>     Mede a geração de <n> amostras por thread e sai\n");
+    printf("  -I, --instancia <n>     Instância da pilha (padrão: $%s ou 0)\n", INSTANCIA_AMBIENTE);
+    printf("  -T, --rastreio <arq>    Rastreia as threads dos timers e exporta o rastreio\n");
+    printf("                          (JSON do Chrome/Perfetto) com SIGPROF e ao encerrar\n");
+    printf("  -h, --help              Mostra esta ajuda\n");
+}
 
 /**
  * @brief Ponto de entrada do programa para simulação de sensores.
  *
- * Inicializa os recursos necessários, incluindo memória compartilhada
- * e semáforo, e cria threads para simular sensores de velocidade, RPM
- * e temperatura. Cada thread executa continuamente, atualizando os
- * valores dos sensores na memória compartilhada. O programa aguarda
- * a finalização das threads e, em seguida, libera os recursos
+ * Inicializa os recursos necessários, incluindo a memória compartilhada
+ * e a trava embutida nela, carrega a tabela de canais e distribui os
+ * canais entre um pequeno grupo de threads de timers, cada canal na sua
+ * frequência (de 1 Hz a 10 kHz). As leituras vão para a tabela de canais
+ * compartilhada e, resumidas por grandeza, para SensorData. O programa
+ * roda até Ctrl+C; então aguarda as threads e libera os recursos
  * alocados antes de encerrar.
  *
  * @return 0 se o programa for executado com sucesso.
  */
-int main() {
-    srand(time(NULL)); // Inicializar a semente para geração de números aleatórios
-
-    // Inicializar memória compartilhada e semáforo
-    init_shared_memory();
-    init_semaphore();
+int main(int argc, char *argv[]) {
+    static const struct option opcoes[] = {
+        {"canais",    required_argument, NULL, 'c'},
+        {"threads",   required_argument, NULL, 't'},
+        {"semente",   required_argument, NULL, 's'},
+        {"ruido",     required_argument, NULL, 'r'},
+        {"benchmark", required_argument, NULL, 'b'},
+        {"instancia", required_argument, NULL, 'I'},
+        {"rastreio",  required_argument, NULL, 'T'},
+        {"help",      no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+    const char *arquivo_canais = NULL;
+    int threads = 0;
+    uint64_t semente = now_ns() ^ ((uint64_t)getpid() << 32);
+    TipoRuido tipo = RUIDO_UNIFORME;
+    long long amostras_benchmark = 0;
+    instancia_do_ambiente();
+    int opt;
+    while ((opt = getopt_long(argc, argv, "c:t:s:r:b:I:T:h", opcoes, NULL)) != -1) {
+        switch (opt) {
+        case 'c': arquivo_canais = optarg; break;
+        case 't':
+            threads = atoi(optarg);
+            if (threads < 1 || threads > MAX_GRUPOS) {
+                fprintf(stderr, "Número de threads inválido: %s (use 1 a %d)\n", optarg, MAX_GRUPOS);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 's': {
+            char *fim;
+            semente = strtoull(optarg, &fim, 0);
+            if (*fim != '\0') {
+                fprintf(stderr, "Semente inválida: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        }
+        case 'r': {
+            int t = find_name(NOMES_RUIDOS, RUIDO_NUM, optarg);
+            if (t < 0) {
+                fprintf(stderr, "Modelo de ruído inválido: %s (use uniforme, gaussiano ou passeio)\n", optarg);
+                return EXIT_FAILURE;
+            }
+            tipo = (TipoRuido)t;
+            break;
+        }
+        case 'b':
+            amostras_benchmark = atoll(optarg);
+            if (amostras_benchmark <= 0) {
+                fprintf(stderr, "Número de amostras inválido: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'I': instancia_definir(optarg, "--instancia"); break;
+        case 'T': rastreio_arquivo = optarg; break;
+        case 'h':
+            print_usage(argv[0]);
+            return 0;
+        default:
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
 
-    // Criar threads para os sensores
-    pthread_t threads[NUM_SENSORS];
+    if (amostras_benchmark > 0) {
+        srand((unsigned int)semente);
+        run_benchmark((size_t)amostras_benchmark, semente, threads ? threads : THREADS_BENCHMARK);
+        return 0;
+    }
 
-    if (pthread_create(&threads[0], NULL, sensor_velocidade, NULL) != 0) {
-        perror("Erro ao criar thread para sensor de velocidade");
-        exit(EXIT_FAILURE);
+    if (arquivo_canais) {
+        load_channel_table(arquivo_canais);
+    } else {
+        load_default_table(tipo);
+    }
+    if (threads == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus < 1 ? 1 : cpus > MAX_GRUPOS ? MAX_GRUPOS : (int)cpus;
     }
 
-    if (pthread_create(&threads[1], NULL, sensor_rpm, NULL) != 0) {
-        perror("Erro ao criar thread para sensor de RPM");
-        exit(EXIT_FAILURE);
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = sigint_handler;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sa.sa_handler = sigprof_handler;
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGPROF, &sa, NULL);
+
+    // Inicializar memória compartilhada, a trava e a tabela de canais
+    init_shared_memory();
+    init_channels(semente);
+    assign_channels(threads);
+    init_channel_memory();
+
+    bool alta_taxa = false;
+    uint64_t hz_total = 0;
+    for (int i = 0; i < num_canais; i++) {
+        hz_total += configs[i].hz;
+        if (configs[i].hz > IMPRIME_ATE_HZ) alta_taxa = true;
+    }
+    printf("%d canais (%llu leituras/s) em %d threads de timers, semente %llu (repita com --semente %llu)\n",
+           num_canais, (unsigned long long)hz_total, num_grupos,
+           (unsigned long long)semente, (unsigned long long)semente);
+    if (!arquivo_canais) printf("Ruído %s\n", NOMES_RUIDOS[tipo]);
+    if (instancia_ipc != 0) printf("Instância %d\n", instancia_ipc);
+
+    // Criar as threads do grupo de timers (e a de exportação do rastreio)
+    if (rastreio_arquivo) rastreio_iniciar(rastreio_arquivo, "sensor_sim");
+    pthread_t ids[MAX_GRUPOS];
+    for (int k = 0; k < num_grupos; k++) {
+        if (pthread_create(&ids[k], NULL, timer_group, &grupos[k]) != 0) {
+            perror("Erro ao criar thread do grupo de timers");
+            exit(EXIT_FAILURE);
+        }
     }
 
-    if (pthread_create(&threads[2], NULL, sensor_temperatura, NULL) != 0) {
-        perror("Erro ao criar thread para sensor de temperatura");
-        exit(EXIT_FAILURE);
+    uint64_t leituras_ant = 0, atrasos_ant = 0, resumo_ns = now_ns();
+    while (running) {
+        sleep(1);
+        if (running && alta_taxa) print_rates(&leituras_ant, &atrasos_ant, &resumo_ns);
     }
 
-    // Aguardar que as threads (sensores) terminem
-    for (int i = 0; i < NUM_SENSORS; i++) {
-        pthread_join(threads[i], NULL);
+    // Aguardar que as threads terminem
+    for (int k = 0; k < num_grupos; k++) {
+        pthread_join(ids[k], NULL);
     }
+    rastreio_encerrar();
 
-    // Fechar o semáforo e desconectar a memória compartilhada
-    sem_close(sem_sync);
+    uint64_t leituras = 0, atrasos = 0;
+    for (int i = 0; i < num_canais; i++) {
+        leituras += stats_get(&tabela->canais[i].atualizacoes);
+        atrasos += stats_get(&tabela->canais[i].atrasos);
+    }
+    printf("\nLeituras publicadas: %llu, períodos perdidos: %llu\n",
+           (unsigned long long)leituras, (unsigned long long)atrasos);
+    printf("\nContenção da trava por ponto de aquisição:\n");
+    const TabelaContencao *tabela_contencao = &tabela->contencao;
+    contencao_relatorio(stdout, &tabela_contencao, 1);
+
+    // Remover a tabela de canais e desconectar a memória dos sensores
+    shmdt(tabela);
+    shmctl(shm_id_canais, IPC_RMID, NULL);
     shmdt(shared_data);
 
     return 0;
@@ -0,0 +1,52 @@
+/**
+ * @file teste_regras.c
+ * @brief Teste de carga de perfis dos limitadores (make teste).
+ *
+ * Grava perfis temporários e confere se perfil_ler() aceita uma regra com
+ * REGRA_ACOES_MAX ações e recusa uma com uma ação a mais, que escreveria
+ * além de acoes[i] e corromperia as ações da regra seguinte.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "perfil_limitador.h"
+
+/**
+ * @brief Grava um perfil com uma única regra e tenta carregá-lo.
+ * @param acoes Número de ações "alerta" da regra.
+ * @return Resultado de perfil_ler().
+ */
+static bool carregar_regra(int acoes) {
+    char arquivo[] = "/tmp/teste_regras_XXXXXX";
+    int fd = mkstemp(arquivo);
+    if (fd < 0) {
+        perror("Erro ao criar o perfil temporário");
+        exit(EXIT_FAILURE);
+    }
+    FILE *f = fdopen(fd, "w");
+    fprintf(f, "regra r vel velocidade > 0");
+    for (int a = 0; a < acoes; a++) fprintf(f, " alerta");
+    fprintf(f, "\nregra z rpm rpm > 0 alerta\n");
+    fclose(f);
+
+    static PerfilLimitador perfil;
+    bool ok = perfil_ler(arquivo, &perfil);
+    unlink(arquivo);
+    return ok && perfil.programa.num_acoes[0] == acoes && perfil.programa.num_acoes[1] == 1;
+}
+
+int main(void) {
+    int falhas = 0;
+    if (!carregar_regra(REGRA_ACOES_MAX)) {
+        fprintf(stderr, "FALHOU: regra com %d ações foi recusada\n", REGRA_ACOES_MAX);
+        falhas++;
+    }
+    if (carregar_regra(REGRA_ACOES_MAX + 1)) {
+        fprintf(stderr, "FALHOU: regra com %d ações foi aceita\n", REGRA_ACOES_MAX + 1);
+        falhas++;
+    }
+    printf("%s\n", falhas ? "[ERRO] Teste das regras falhou." : "[OK] Teste das regras passou.");
+    return falhas ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,98 @@
+#ifndef TRAVA_ROBUSTA_H
+#define TRAVA_ROBUSTA_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+/*
+ * Trava dos dados compartilhados do veículo (substitui o semáforo
+ * /sem_sync). É um mutex PTHREAD_PROCESS_SHARED e PTHREAD_MUTEX_ROBUST
+ * embutido no próprio segmento protegido: se um processo morrer com a
+ * trava (por exemplo, um kill -9 no sensor_sim no meio da seção crítica),
+ * o próximo a travá-la recebe EOWNERDEAD, revalida os dados e segue, em
+ * vez de todos os processos ficarem bloqueados para sempre.
+ */
+
+#define TRAVA_NAO_INICIADA 0
+#define TRAVA_INICIANDO    1
+#define TRAVA_PRONTA       2
+
+#define TRAVA_ESPERA_INIT_MS 1000   // Espera máxima pela inicialização de outro processo
+
+typedef struct {
+    _Atomic uint32_t estado;            // TRAVA_NAO_INICIADA, TRAVA_INICIANDO, TRAVA_PRONTA
+    _Atomic uint64_t recuperacoes;      // Vezes em que o dono morreu com a trava
+    pthread_mutex_t mutex;
+} TravaCompartilhada;
+
+/**
+ * @brief Inicializa o mutex embutido no segmento.
+ *
+ * O primeiro processo a anexar o segmento (controlador ou sensor_sim)
+ * inicializa o mutex; os demais esperam que ele fique pronto. Se a
+ * inicialização de outro processo não terminar a tempo (ele morreu no
+ * meio), o mutex é inicializado de novo.
+ *
+ * @param t Trava dentro da memória compartilhada (zerada quando o segmento é criado).
+ */
+static inline void trava_init(TravaCompartilhada *t) {
+    uint32_t esperado = TRAVA_NAO_INICIADA;
+    if (!atomic_compare_exchange_strong(&t->estado, &esperado, TRAVA_INICIANDO)) {
+        for (int ms = 0; ms < TRAVA_ESPERA_INIT_MS; ms++) {
+            if (atomic_load_explicit(&t->estado, memory_order_acquire) == TRAVA_PRONTA) return;
+            usleep(1000);
+        }
+        fprintf(stderr, "Aviso: inicialização da trava não concluída; reinicializando\n");
+    }
+
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    if (pthread_mutex_init(&t->mutex, &attr) != 0) {
+        perror("Erro ao inicializar a trava compartilhada");
+        exit(EXIT_FAILURE);
+    }
+    pthread_mutexattr_destroy(&attr);
+    atomic_store_explicit(&t->estado, TRAVA_PRONTA, memory_order_release);
+}
+
+/**
+ * @brief Trava os dados compartilhados, recuperando a trava de um dono morto.
+ *
+ * Com EOWNERDEAD a seção crítica do processo morto pode ter ficado pela
+ * metade: revalidar() corrige os dados antes de a trava ser marcada como
+ * consistente. O chamador fica com a trava nos dois casos.
+ *
+ * @param t Trava compartilhada.
+ * @param revalidar Função que revalida os dados protegidos (pode ser NULL).
+ * @return true se a trava foi recuperada de um dono morto.
+ */
+static inline bool trava_lock(TravaCompartilhada *t, void (*revalidar)(void)) {
+    int r = pthread_mutex_lock(&t->mutex);
+    if (r == 0) return false;
+    if (r == EOWNERDEAD) {
+        atomic_fetch_add_explicit(&t->recuperacoes, 1, memory_order_relaxed);
+        if (revalidar) revalidar();
+        pthread_mutex_consistent(&t->mutex);
+        return true;
+    }
+    errno = r;
+    perror("Erro ao travar os dados compartilhados");
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief Libera a trava dos dados compartilhados.
+ */
+static inline void trava_unlock(TravaCompartilhada *t) {
+    pthread_mutex_unlock(&t->mutex);
+}
+
+#endif // TRAVA_ROBUSTA_H
@@ -0,0 +1,325 @@
+#ifndef AGREGADOS_H
+#define AGREGADOS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <stdatomic.h>
+
+#include "ipc_shared.h"
+
+/*
+ * Estatísticas incrementais de velocidade, RPM e temperatura em janelas
+ * deslizantes de 1 s, 10 s e 60 s (JANELAS_AGR_S), sem guardar nem
+ * reprocessar as amostras.
+ *
+ * As amostras são resumidas em quadros de 10 ms (mínimo, máximo, soma e
+ * quantidade). Cada janela mantém os quadros dentro dela em um anel, a
+ * soma corrente para a média e duas filas monotônicas (deques) para o
+ * mínimo e o máximo: um quadro entra uma vez e sai uma vez, então o custo
+ * é O(1) amortizado por quadro e exato.
+ *
+ * Os percentis vêm de um histograma de AGR_BINS classes na faixa do sinal,
+ * dividido em AGR_PAINEIS painéis de 1/20 da janela: cada amostra soma 1
+ * em uma classe e, quando um painel sai da janela, as contagens dele são
+ * subtraídas do total. O erro do percentil é de no máximo uma classe, e a
+ * janela dos percentis avança em passos de um painel (cobre de 100% a 105%
+ * da janela).
+ *
+ * Toda a memória é alocada em agregador_init(); depois disso o consumo é
+ * constante, qualquer que seja o tempo de execução. Uso exclusivo da
+ * thread de controle.
+ */
+
+#define AGR_QUADRO_NS 10000000ull    // Resolução dos quadros (10 ms)
+#define AGR_PAINEIS   20             // Painéis de histograma por janela
+#define AGR_BINS      128            // Classes do histograma de cada janela
+
+// Resumo das amostras de um quadro
+typedef struct {
+    uint32_t id;             // Número do quadro desde o início
+    uint32_t n;
+    float min, max;
+    double soma;
+} QuadroAgr;
+
+// Fila monotônica de ids de quadros (anel com capacidade = quadros da janela)
+typedef struct {
+    uint32_t *ids;
+    uint32_t inicio, tamanho;
+} DequeAgr;
+
+typedef struct {
+    uint32_t quadros;                 // Quadros na janela
+    uint32_t quadros_painel;          // Quadros por painel do histograma
+    QuadroAgr *anel;                  // Quadro id em anel[id % quadros]
+    DequeAgr dq_min, dq_max;          // Valores crescentes / decrescentes
+    uint32_t expirar;                 // Próximo quadro a sair da janela
+    double soma;
+    uint64_t n;
+
+    uint32_t painel;                  // Painel corrente
+    uint32_t paineis[AGR_PAINEIS + 1][AGR_BINS];
+    uint32_t total[AGR_BINS];         // Soma dos painéis
+    uint64_t hist_n;
+} JanelaAgr;
+
+typedef struct {
+    float lo, hi;                     // Faixa do histograma
+    QuadroAgr atual;                  // Quadro em formação
+    JanelaAgr janelas[AGR_NUM_JANELAS];
+} SerieAgr;
+
+typedef struct {
+    uint64_t t0_ns;
+    uint32_t quadro;                  // Quadro corrente
+    SerieAgr series[SINAL_NUM];
+} Agregador;
+
+// Faixa de cada sinal (valores fora dela caem nas classes extremas)
+static const float FAIXAS_SINAIS[SINAL_NUM][2] = {
+    { 0.0f, 256.0f },        // km/h
+    { 0.0f, 8960.0f },       // RPM
+    { 0.0f, 160.0f },        // °C
+};
+
+static inline uint32_t deque_pos(const DequeAgr *d, uint32_t i, uint32_t cap) {
+    return (d->inicio + i) % cap;
+}
+
+static inline void quadro_reset(QuadroAgr *q, uint32_t id) {
+    q->id = id;
+    q->n = 0;
+    q->min = INFINITY;
+    q->max = -INFINITY;
+    q->soma = 0.0;
+}
+
+/**
+ * @brief Aloca as janelas de todos os sinais.
+ *
+ * @param t0_ns Instante (CLOCK_MONOTONIC) do quadro 0.
+ */
+static inline void agregador_init(Agregador *ag, uint64_t t0_ns) {
+    memset(ag, 0, sizeof(*ag));
+    ag->t0_ns = t0_ns;
+    for (int s = 0; s < SINAL_NUM; s++) {
+        SerieAgr *serie = &ag->series[s];
+        serie->lo = FAIXAS_SINAIS[s][0];
+        serie->hi = FAIXAS_SINAIS[s][1];
+        quadro_reset(&serie->atual, 0);
+        for (int j = 0; j < AGR_NUM_JANELAS; j++) {
+            JanelaAgr *w = &serie->janelas[j];
+            w->quadros = (uint32_t)(JANELAS_AGR_S[j] * 1000000000ull / AGR_QUADRO_NS);
+            w->quadros_painel = w->quadros / AGR_PAINEIS;
+            w->anel = (QuadroAgr *)calloc(w->quadros, sizeof(QuadroAgr));
+            w->dq_min.ids = (uint32_t *)calloc(w->quadros, sizeof(uint32_t));
+            w->dq_max.ids = (uint32_t *)calloc(w->quadros, sizeof(uint32_t));
+            if (!w->anel || !w->dq_min.ids || !w->dq_max.ids) {
+                perror("Erro ao alocar as janelas de estatísticas");
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Retira da janela os quadros que ficaram velhos no quadro q.
+ *
+ * Um quadro id está na janela enquanto id > q - quadros.
+ */
+static inline void janela_expirar(JanelaAgr *w, uint32_t q) {
+    if (q < w->quadros) return;
+    uint32_t limite = q - w->quadros;        // Último id que sai
+
+    if (limite >= w->expirar + w->quadros) {
+        // Lacuna maior que a janela (processo parado): nada continua nela
+        w->soma = 0.0;
+        w->n = 0;
+        w->dq_min.tamanho = w->dq_max.tamanho = 0;
+        w->expirar = limite + 1;
+        return;
+    }
+    for (; w->expirar <= limite; w->expirar++) {
+        const QuadroAgr *f = &w->anel[w->expirar % w->quadros];
+        if (f->id == w->expirar && f->n > 0) {
+            w->soma -= f->soma;
+            w->n -= f->n;
+        }
+    }
+    while (w->dq_min.tamanho > 0 && w->dq_min.ids[w->dq_min.inicio] <= limite) {
+        w->dq_min.inicio = (w->dq_min.inicio + 1) % w->quadros;
+        w->dq_min.tamanho--;
+    }
+    while (w->dq_max.tamanho > 0 && w->dq_max.ids[w->dq_max.inicio] <= limite) {
+        w->dq_max.inicio = (w->dq_max.inicio + 1) % w->quadros;
+        w->dq_max.tamanho--;
+    }
+}
+
+/**
+ * @brief Insere na janela um quadro concluído.
+ */
+static inline void janela_inserir(JanelaAgr *w, const QuadroAgr *f) {
+    w->anel[f->id % w->quadros] = *f;
+    if (f->n == 0) return;
+    w->soma += f->soma;
+    w->n += f->n;
+
+    // Quem é maior (menor) que o novo mínimo (máximo) nunca mais será o extremo
+    DequeAgr *d = &w->dq_min;
+    while (d->tamanho > 0 &&
+           w->anel[d->ids[deque_pos(d, d->tamanho - 1, w->quadros)] % w->quadros].min >= f->min) {
+        d->tamanho--;
+    }
+    d->ids[deque_pos(d, d->tamanho++, w->quadros)] = f->id;
+
+    d = &w->dq_max;
+    while (d->tamanho > 0 &&
+           w->anel[d->ids[deque_pos(d, d->tamanho - 1, w->quadros)] % w->quadros].max <= f->max) {
+        d->tamanho--;
+    }
+    d->ids[deque_pos(d, d->tamanho++, w->quadros)] = f->id;
+}
+
+/**
+ * @brief Avança o histograma da janela para o painel do quadro q,
+ *        descontando os painéis que saíram.
+ */
+static inline void janela_avancar_painel(JanelaAgr *w, uint32_t q) {
+    uint32_t p = q / w->quadros_painel;
+    if (p == w->painel) return;
+    uint32_t passos = p - w->painel;
+    if (passos > AGR_PAINEIS + 1) passos = AGR_PAINEIS + 1;
+    for (uint32_t k = 1; k <= passos; k++) {
+        uint32_t *painel = w->paineis[(p - passos + k) % (AGR_PAINEIS + 1)];
+        for (int b = 0; b < AGR_BINS; b++) {
+            w->total[b] -= painel[b];
+            w->hist_n -= painel[b];
+        }
+        memset(painel, 0, sizeof(w->paineis[0]));
+    }
+    w->painel = p;
+}
+
+/**
+ * @brief Registra uma amostra de cada sinal (O(1)).
+ *
+ * @param t_ns Instante da amostra (CLOCK_MONOTONIC).
+ * @param valores Valor de cada SinalId.
+ */
+static inline void agregador_amostra(Agregador *ag, uint64_t t_ns, const float valores[SINAL_NUM]) {
+    uint32_t q = (uint32_t)((t_ns - ag->t0_ns) / AGR_QUADRO_NS);
+
+    for (int s = 0; s < SINAL_NUM; s++) {
+        SerieAgr *serie = &ag->series[s];
+        if (q != ag->quadro) {
+            for (int j = 0; j < AGR_NUM_JANELAS; j++) {
+                JanelaAgr *w = &serie->janelas[j];
+                janela_expirar(w, q);
+                // Depois de uma lacuna, o quadro que se fecha pode já estar fora
+                if (serie->atual.id + w->quadros > q) janela_inserir(w, &serie->atual);
+                janela_avancar_painel(w, q);
+            }
+            quadro_reset(&serie->atual, q);
+        }
+
+        float v = valores[s];
+        QuadroAgr *f = &serie->atual;
+        f->n++;
+        f->soma += v;
+        if (v < f->min) f->min = v;
+        if (v > f->max) f->max = v;
+
+        int b = (int)((v - serie->lo) * AGR_BINS / (serie->hi - serie->lo));
+        if (b < 0) b = 0;
+        if (b >= AGR_BINS) b = AGR_BINS - 1;
+        for (int j = 0; j < AGR_NUM_JANELAS; j++) {
+            JanelaAgr *w = &serie->janelas[j];
+            w->paineis[w->painel % (AGR_PAINEIS + 1)][b]++;
+            w->total[b]++;
+            w->hist_n++;
+        }
+    }
+    ag->quadro = q;
+}
+
+/**
+ * @brief Percentil p (0..1) pelo histograma, interpolado dentro da classe.
+ */
+static inline float janela_percentil(const JanelaAgr *w, float lo, float hi, double p) {
+    if (w->hist_n == 0) return 0.0f;
+    double alvo = p * (double)w->hist_n;
+    double largura = (hi - lo) / AGR_BINS;
+    uint64_t acumulado = 0;
+    for (int b = 0; b < AGR_BINS; b++) {
+        if (w->total[b] == 0) continue;
+        if ((double)(acumulado + w->total[b]) >= alvo) {
+            double fracao = (alvo - (double)acumulado) / w->total[b];
+            return (float)(lo + (b + fracao) * largura);
+        }
+        acumulado += w->total[b];
+    }
+    return hi;
+}
+
+/**
+ * @brief Calcula os agregados de uma janela, incluindo o quadro em formação.
+ */
+static inline void janela_resumo(JanelaAgr *w, const SerieAgr *serie, uint32_t q,
+                                 AgregadoJanela *saida) {
+    janela_expirar(w, q);
+    const QuadroAgr *f = &serie->atual;
+    uint64_t n = w->n + f->n;
+    memset(saida, 0, sizeof(*saida));
+    saida->amostras = (uint32_t)n;
+    if (n == 0) return;
+
+    float min = f->min, max = f->max;
+    if (w->dq_min.tamanho > 0) {
+        float m = w->anel[w->dq_min.ids[w->dq_min.inicio] % w->quadros].min;
+        if (m < min) min = m;
+    }
+    if (w->dq_max.tamanho > 0) {
+        float m = w->anel[w->dq_max.ids[w->dq_max.inicio] % w->quadros].max;
+        if (m > max) max = m;
+    }
+    saida->min = min;
+    saida->max = max;
+    saida->media = (float)((w->soma + f->soma) / (double)n);
+
+    // A classe limita o erro; o resultado nunca sai do intervalo observado
+    float *pcts[3] = { &saida->p50, &saida->p95, &saida->p99 };
+    static const double PS[3] = { 0.50, 0.95, 0.99 };
+    for (int i = 0; i < 3; i++) {
+        float v = janela_percentil(w, serie->lo, serie->hi, PS[i]);
+        *pcts[i] = fminf(fmaxf(v, min), max);
+    }
+}
+
+/**
+ * @brief Publica os agregados de todas as janelas no segmento de
+ *        estatísticas, sob o seqlock agregados_seq.
+ *
+ * @param t_ns Instante atual (expira os quadros antigos mesmo sem amostras).
+ */
+static inline void agregador_publicar(Agregador *ag, uint64_t t_ns, ControllerStats *stats) {
+    uint32_t q = (uint32_t)((t_ns - ag->t0_ns) / AGR_QUADRO_NS);
+    AgregadoJanela resumo[SINAL_NUM][AGR_NUM_JANELAS];
+    for (int s = 0; s < SINAL_NUM; s++) {
+        for (int j = 0; j < AGR_NUM_JANELAS; j++) {
+            janela_resumo(&ag->series[s].janelas[j], &ag->series[s], q, &resumo[s][j]);
+        }
+    }
+
+    uint32_t seq = atomic_load_explicit(&stats->agregados_seq, memory_order_relaxed);
+    atomic_store_explicit(&stats->agregados_seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy(stats->agregados, resumo, sizeof(resumo));
+    atomic_store_explicit(&stats->agregados_seq, seq + 2, memory_order_release);
+}
+
+#endif // AGREGADOS_H
@@ -0,0 +1,380 @@
+#ifndef ANEL_COMANDOS_H
+#define ANEL_COMANDOS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "ipc_shared.h"
+
+/*
+ * Anel de comandos em memória compartilhada (vários produtores, um
+ * consumidor), alternativa opcional à fila de mensagens para os clientes
+ * registrados.
+ *
+ * Os painéis reservam uma posição com um compare-and-swap na cauda e
+ * escrevem o comando diretamente no slot; o controlador consome em lote,
+ * na tarefa de comandos, sem nenhuma chamada de sistema. Cada slot tem uma
+ * sequência: vale `pos` quando a posição pos está livre para um produtor e
+ * `pos + 1` quando o comando dela está pronto para o consumidor. Cabeça e
+ * cauda ficam em linhas de cache separadas.
+ *
+ * O consumidor é periódico e não precisa ser acordado. Quem espera é o
+ * produtor com o anel cheio: ele dorme no futex `espaco`, que o
+ * controlador só sinaliza quando há produtores esperando.
+ *
+ * As confirmações também ficam no segmento: cada cliente tem uma caixa de
+ * confirmações (um anel com um produtor, o controlador, e um consumidor,
+ * o cliente), indicada no slot de cada comando. O cliente lê a caixa sem
+ * chamada de sistema; para esperar, dorme no futex `escritas` da caixa,
+ * que o controlador só sinaliza quando o cliente está dormindo.
+ *
+ * Um produtor que morre entre reservar e publicar deixaria o consumidor
+ * parado na posição dele. Logo depois de avançar a cauda, o produtor toma
+ * o slot com um compare-and-swap na sequência, de `pos` para uma marca
+ * com o próprio PID (ANEL_CMD_RESERVADO); só depois escreve o comando. O
+ * consumidor descarta a reserva marcada quando esse PID não existe mais,
+ * e a não marcada depois de ANEL_CMD_RESERVA_MS; nesse caso o
+ * compare-and-swap do produtor atrasado falha e ele reserva outra posição
+ * sem ter tocado no slot, que talvez já seja de outro produtor.
+ */
+
+#define SHM_KEY_COMANDOS 5434         // Chave do anel de comandos
+
+#define ANEL_CMD_MAGIC  0x434D4441u   // "CMDA"
+#define ANEL_CMD_VERSAO 3
+#define ANEL_CMD_SLOTS  256           // Comandos pendentes (potência de 2)
+#define ANEL_CMD_RESERVA_MS 1000      // Reserva sem marca de dono descartada após esse tempo
+#define ANEL_CMD_RESERVADO (1ull << 63) // Sequência de um slot tomado por um produtor
+#define ANEL_CONF_SLOTS 256           // Confirmações pendentes por cliente (potência de 2)
+#define ANEL_CONF_NENHUMA 0xFF        // Slot sem caixa de confirmações
+
+// Um comando no anel (o equivalente compacto de uma Message)
+typedef struct {
+    _Atomic uint64_t seq;    // pos: livre; marca: sendo escrito; pos + 1: pronto
+    int32_t pid;             // PID do cliente registrado
+    uint32_t seq_cmd;        // Sequência do comando, ecoada na confirmação
+    uint64_t t_envio_ns;     // CLOCK_MONOTONIC do envio
+    uint8_t comando;         // ComandoId
+    uint8_t lote_tamanho;    // Itens em lote[] (CMD_LOTE)
+    uint8_t confirmacao;     // Caixa de confirmações do cliente, ou ANEL_CONF_NENHUMA
+    uint8_t lote[MAX_LOTE];
+} __attribute__((aligned(64))) SlotComando;
+
+// Uma confirmação (o equivalente compacto de um "Ack")
+typedef struct {
+    uint32_t seq_cmd;        // Sequência do comando confirmado
+    uint32_t status;         // ResultadoComando
+    uint64_t t_envio_ns;     // Instante de envio do comando, para a latência
+} ConfirmacaoAnel;
+
+// Caixa de confirmações de um cliente
+typedef struct {
+    _Atomic int32_t pid;            // Cliente dono da caixa (0: livre)
+    _Atomic uint32_t escritas;      // Futex: confirmações publicadas (controlador)
+    _Atomic uint32_t lidas;         // Confirmações consumidas (cliente)
+    _Atomic uint32_t esperando;     // O cliente dorme em `escritas`
+    ConfirmacaoAnel itens[ANEL_CONF_SLOTS];
+} __attribute__((aligned(64))) CaixaConfirmacoes;
+
+typedef struct {
+    uint32_t magic;                      // ANEL_CMD_MAGIC quando pronto
+    uint32_t versao;                     // ANEL_CMD_VERSAO
+    int32_t pid;                         // PID do controlador (consumidor)
+
+    _Atomic uint64_t cauda __attribute__((aligned(64)));   // Produtores
+    _Atomic uint64_t cabeca __attribute__((aligned(64)));  // Consumidor
+    _Atomic uint32_t espaco;             // Futex: muda quando o consumidor libera slots
+    _Atomic uint32_t esperando;          // Produtores dormindo em `espaco`
+    uint64_t parado_pos;                 // Consumidor: posição com reserva sem publicação
+    uint64_t parado_desde_ns;            // Consumidor: desde quando (0: não está parado)
+
+    SlotComando slots[ANEL_CMD_SLOTS];
+    CaixaConfirmacoes caixas[MAX_CLIENTES];
+} AnelComandos;
+
+/**
+ * @brief Inicializa um anel vazio (somente o controlador, antes do magic).
+ */
+static inline void anel_cmd_init(AnelComandos *anel) {
+    for (uint64_t i = 0; i < ANEL_CMD_SLOTS; i++) {
+        atomic_store_explicit(&anel->slots[i].seq, i, memory_order_relaxed);
+    }
+    atomic_store_explicit(&anel->cauda, 0, memory_order_relaxed);
+    atomic_store_explicit(&anel->cabeca, 0, memory_order_relaxed);
+}
+
+/**
+ * @brief Sequência de um slot tomado pelo produtor @p pid na posição @p pos.
+ */
+static inline uint64_t anel_cmd_marca(uint64_t pos, int32_t pid) {
+    return ANEL_CMD_RESERVADO | ((pos & 0x7FFFFFFFu) << 32) | (uint32_t)pid;
+}
+
+/**
+ * @brief Reserva uma posição para escrever um comando (produtores).
+ *
+ * Se o consumidor descartar a posição entre o avanço da cauda e a marca
+ * (produtor parado por mais de ANEL_CMD_RESERVA_MS), tenta a seguinte.
+ *
+ * @param pid PID do produtor, marcado na sequência do slot.
+ * @param pos Posição reservada, a ser passada para anel_cmd_publicar().
+ * @return O slot a preencher, só deste produtor até a publicação, ou NULL
+ *         se o anel está cheio.
+ */
+static inline SlotComando *anel_cmd_reservar(AnelComandos *anel, int32_t pid, uint64_t *pos) {
+    uint64_t p = atomic_load_explicit(&anel->cauda, memory_order_relaxed);
+    for (;;) {
+        SlotComando *slot = &anel->slots[p % ANEL_CMD_SLOTS];
+        uint64_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        int64_t dif = (int64_t)(seq - p);
+        if (seq & ANEL_CMD_RESERVADO) {
+            // Tomado por outro produtor: nesta posição (cauda desatualizada)
+            // ou na volta anterior, ainda não consumido (anel cheio)
+            uint64_t cauda = atomic_load_explicit(&anel->cauda, memory_order_relaxed);
+            if (cauda == p) return NULL;
+            p = cauda;
+        } else if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&anel->cauda, &p, p + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                uint64_t esperado = p;
+                if (atomic_compare_exchange_strong_explicit(&slot->seq, &esperado,
+                                                            anel_cmd_marca(p, pid),
+                                                            memory_order_acquire,
+                                                            memory_order_relaxed)) {
+                    *pos = p;
+                    return slot;
+                }
+                p = atomic_load_explicit(&anel->cauda, memory_order_relaxed);
+            }
+        } else if (dif < 0) {
+            return NULL;    // O consumidor ainda não liberou este slot
+        } else {
+            p = atomic_load_explicit(&anel->cauda, memory_order_relaxed);
+        }
+    }
+}
+
+/**
+ * @brief Entrega ao consumidor o comando escrito no slot reservado.
+ *
+ * O slot marcado só é descartado pelo consumidor depois que o produtor
+ * morre, então a publicação não disputa com ninguém.
+ */
+static inline void anel_cmd_publicar(SlotComando *slot, uint64_t pos) {
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+}
+
+/**
+ * @brief Espera o consumidor liberar espaço no anel (produtores).
+ *
+ * @param timeout_ms Tempo máximo de espera.
+ * @return true se há espaço (ou pode haver) para uma nova tentativa.
+ */
+static inline bool anel_cmd_esperar_espaco(AnelComandos *anel, int timeout_ms) {
+    atomic_fetch_add_explicit(&anel->esperando, 1, memory_order_seq_cst);
+    uint32_t espaco = atomic_load_explicit(&anel->espaco, memory_order_seq_cst);
+    uint64_t cauda = atomic_load_explicit(&anel->cauda, memory_order_relaxed);
+    uint64_t cabeca = atomic_load_explicit(&anel->cabeca, memory_order_acquire);
+    bool cheio = cauda - cabeca >= ANEL_CMD_SLOTS;
+    if (cheio) {
+        struct timespec ts = { timeout_ms / 1000, (long)(timeout_ms % 1000) * 1000000L };
+        syscall(SYS_futex, &anel->espaco, FUTEX_WAIT, espaco, &ts, NULL, 0);
+        cabeca = atomic_load_explicit(&anel->cabeca, memory_order_acquire);
+        cheio = cauda - cabeca >= ANEL_CMD_SLOTS;
+    }
+    atomic_fetch_sub_explicit(&anel->esperando, 1, memory_order_seq_cst);
+    return !cheio;
+}
+
+/**
+ * @brief Próximo comando pronto (somente o consumidor).
+ *
+ * @return O slot, a ser liberado com anel_cmd_liberar() depois de copiado,
+ *         ou NULL se não há comando pronto.
+ */
+static inline const SlotComando *anel_cmd_proximo(AnelComandos *anel) {
+    uint64_t pos = atomic_load_explicit(&anel->cabeca, memory_order_relaxed);
+    const SlotComando *slot = &anel->slots[pos % ANEL_CMD_SLOTS];
+    if (atomic_load_explicit(&slot->seq, memory_order_acquire) != pos + 1) return NULL;
+    return slot;
+}
+
+/**
+ * @brief Descarta a reserva de um produtor morto que trava a cabeça do
+ *        anel (somente o consumidor).
+ *
+ * Chamada quando anel_cmd_proximo() não encontra comando pronto. Se a
+ * cabeça está reservada e não publicada, descarta a reserva quando o PID
+ * que a marcou não existe mais, ou depois de ANEL_CMD_RESERVA_MS sem
+ * marca. A posição é devolvida aos produtores como se tivesse sido
+ * consumida; um produtor vivo que ainda não marcou o slot perde o
+ * compare-and-swap da marca e não o escreve.
+ *
+ * @param agora_ns Instante atual (CLOCK_MONOTONIC).
+ * @param dono Recebe o PID do produtor da reserva descartada (0 se não marcou).
+ * @return true se uma reserva foi descartada.
+ */
+static inline bool anel_cmd_recuperar(AnelComandos *anel, uint64_t agora_ns, int32_t *dono) {
+    uint64_t pos = atomic_load_explicit(&anel->cabeca, memory_order_relaxed);
+    if (atomic_load_explicit(&anel->cauda, memory_order_relaxed) == pos) {
+        anel->parado_desde_ns = 0;
+        return false;  // Anel vazio
+    }
+    SlotComando *slot = &anel->slots[pos % ANEL_CMD_SLOTS];
+    uint64_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    bool marcada = (seq & ~0xFFFFFFFFull) == (anel_cmd_marca(pos, 0) & ~0xFFFFFFFFull);
+    if (!marcada && seq != pos) return false;
+
+    if (anel->parado_desde_ns == 0 || anel->parado_pos != pos) {
+        anel->parado_pos = pos;
+        anel->parado_desde_ns = agora_ns;
+    }
+    *dono = marcada ? (int32_t)(seq & 0xFFFFFFFFu) : 0;
+    bool morto = marcada && kill(*dono, 0) < 0 && errno == ESRCH;
+    if (!morto && (marcada || agora_ns - anel->parado_desde_ns < ANEL_CMD_RESERVA_MS * 1000000ull)) {
+        return false;
+    }
+
+    // Devolve a posição; a marca atrasada do produtor, se houver, falha
+    uint64_t esperado = seq;
+    if (!atomic_compare_exchange_strong_explicit(&slot->seq, &esperado, pos + ANEL_CMD_SLOTS,
+                                                 memory_order_acq_rel, memory_order_acquire)) {
+        return false;  // Marcado ou publicado nesse meio-tempo
+    }
+    atomic_store_explicit(&anel->cabeca, pos + 1, memory_order_release);
+    anel->parado_desde_ns = 0;
+    return true;
+}
+
+/**
+ * @brief Devolve aos produtores o slot obtido com anel_cmd_proximo().
+ */
+static inline void anel_cmd_liberar(AnelComandos *anel, const SlotComando *slot) {
+    uint64_t pos = atomic_load_explicit(&anel->cabeca, memory_order_relaxed);
+    atomic_store_explicit((_Atomic uint64_t *)&slot->seq, pos + ANEL_CMD_SLOTS,
+                          memory_order_release);
+    atomic_store_explicit(&anel->cabeca, pos + 1, memory_order_release);
+}
+
+/**
+ * @brief Acorda os produtores que esperam espaço (somente o consumidor).
+ *
+ * Só faz a chamada de sistema se algum produtor estiver dormindo.
+ */
+static inline void anel_cmd_acordar_produtores(AnelComandos *anel) {
+    atomic_fetch_add_explicit(&anel->espaco, 1, memory_order_seq_cst);
+    if (atomic_load_explicit(&anel->esperando, memory_order_seq_cst) > 0) {
+        syscall(SYS_futex, &anel->espaco, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+    }
+}
+
+/**
+ * @brief Obtém uma caixa de confirmações para o cliente (somente clientes).
+ *
+ * Reaproveita a caixa que já é do cliente, ocupa uma livre ou toma a de
+ * um cliente que não existe mais. As confirmações antigas são descartadas.
+ *
+ * @return Índice da caixa, ou ANEL_CONF_NENHUMA se todas estão ocupadas.
+ */
+static inline uint8_t anel_conf_abrir(AnelComandos *anel, int32_t pid) {
+    for (int passo = 0; passo < 2; passo++) {
+        for (int i = 0; i < MAX_CLIENTES; i++) {
+            CaixaConfirmacoes *c = &anel->caixas[i];
+            int32_t atual = atomic_load_explicit(&c->pid, memory_order_acquire);
+            bool livre = atual == 0 || atual == pid ||
+                         (passo == 1 && kill(atual, 0) < 0 && errno == ESRCH);
+            if (!livre || !atomic_compare_exchange_strong_explicit(&c->pid, &atual, pid,
+                                                                   memory_order_acq_rel,
+                                                                   memory_order_relaxed)) {
+                continue;
+            }
+            atomic_store_explicit(&c->lidas, atomic_load_explicit(&c->escritas, memory_order_acquire),
+                                  memory_order_release);
+            return (uint8_t)i;
+        }
+    }
+    return ANEL_CONF_NENHUMA;
+}
+
+/**
+ * @brief Devolve a caixa de confirmações do cliente @p pid, se for dele.
+ */
+static inline void anel_conf_fechar(AnelComandos *anel, uint8_t caixa, int32_t pid) {
+    if (caixa >= MAX_CLIENTES) return;
+    int32_t esperado = pid;
+    atomic_compare_exchange_strong_explicit(&anel->caixas[caixa].pid, &esperado, 0,
+                                            memory_order_release, memory_order_relaxed);
+}
+
+/**
+ * @brief Publica a confirmação de um comando na caixa do cliente
+ *        (somente o controlador).
+ *
+ * Faz a chamada de sistema só se o cliente estiver dormindo na caixa.
+ *
+ * @return false se a caixa não é do cliente @p pid ou está cheia (a
+ *         confirmação se perde, como com a fila cheia).
+ */
+static inline bool anel_conf_publicar(AnelComandos *anel, uint8_t caixa, int32_t pid,
+                                      const ConfirmacaoAnel *conf) {
+    if (caixa >= MAX_CLIENTES) return false;
+    CaixaConfirmacoes *c = &anel->caixas[caixa];
+    if (atomic_load_explicit(&c->pid, memory_order_acquire) != pid) return false;
+
+    uint32_t escritas = atomic_load_explicit(&c->escritas, memory_order_relaxed);
+    if (escritas - atomic_load_explicit(&c->lidas, memory_order_acquire) >= ANEL_CONF_SLOTS) {
+        return false;
+    }
+    c->itens[escritas % ANEL_CONF_SLOTS] = *conf;
+    atomic_store_explicit(&c->escritas, escritas + 1, memory_order_seq_cst);
+    if (atomic_load_explicit(&c->esperando, memory_order_seq_cst)) {
+        syscall(SYS_futex, &c->escritas, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+    }
+    return true;
+}
+
+/**
+ * @brief Próxima confirmação da caixa (somente o cliente dono).
+ *
+ * @return false se não há confirmação nova.
+ */
+static inline bool anel_conf_proxima(AnelComandos *anel, uint8_t caixa, ConfirmacaoAnel *conf) {
+    CaixaConfirmacoes *c = &anel->caixas[caixa];
+    uint32_t lidas = atomic_load_explicit(&c->lidas, memory_order_relaxed);
+    if (lidas == atomic_load_explicit(&c->escritas, memory_order_acquire)) return false;
+    *conf = c->itens[lidas % ANEL_CONF_SLOTS];
+    atomic_store_explicit(&c->lidas, lidas + 1, memory_order_release);
+    return true;
+}
+
+/**
+ * @brief Espera uma confirmação nova na caixa (somente o cliente dono).
+ *
+ * @param timeout_ms Tempo máximo de espera.
+ * @return true se há (ou pode haver) confirmação para ler.
+ */
+static inline bool anel_conf_esperar(AnelComandos *anel, uint8_t caixa, int timeout_ms) {
+    CaixaConfirmacoes *c = &anel->caixas[caixa];
+    atomic_store_explicit(&c->esperando, 1, memory_order_seq_cst);
+    uint32_t escritas = atomic_load_explicit(&c->escritas, memory_order_seq_cst);
+    bool vazia = escritas == atomic_load_explicit(&c->lidas, memory_order_relaxed);
+    if (vazia) {
+        struct timespec ts = { timeout_ms / 1000, (long)(timeout_ms % 1000) * 1000000L };
+        syscall(SYS_futex, &c->escritas, FUTEX_WAIT, escritas, &ts, NULL, 0);
+        vazia = atomic_load_explicit(&c->escritas, memory_order_acquire) ==
+                atomic_load_explicit(&c->lidas, memory_order_relaxed);
+    }
+    atomic_store_explicit(&c->esperando, 0, memory_order_seq_cst);
+    return !vazia;
+}
+
+#endif // ANEL_COMANDOS_H
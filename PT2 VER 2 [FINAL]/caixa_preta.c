@@ -0,0 +1,327 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <time.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ipc_shared.h"
+#include "caixa_preta.h"
+#include "perfil_limitador.h"
+
+static const char *const NOMES_RESULTADOS[] = { "OK", "inválido", "lotado" };
+
+/**
+ * @brief Mapeia o arquivo da caixa-preta somente para leitura.
+ *
+ * Funciona tanto depois de uma queda quanto com o controlador gravando:
+ * nada é escrito no arquivo.
+ *
+ * @return Ponteiro para a caixa-preta mapeada.
+ */
+const CaixaPreta *open_recording(const char *arquivo) {
+    int fd = open(arquivo, O_RDONLY);
+    if (fd < 0) {
+        perror("Erro ao abrir o arquivo da caixa-preta");
+        exit(EXIT_FAILURE);
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(CaixaPreta)) {
+        fprintf(stderr, "%s não é uma caixa-preta (tamanho inesperado)\n", arquivo);
+        exit(EXIT_FAILURE);
+    }
+    const CaixaPreta *c = (const CaixaPreta *)mmap(NULL, sizeof(CaixaPreta), PROT_READ,
+                                                   MAP_SHARED, fd, 0);
+    close(fd);
+    if (c == MAP_FAILED) {
+        perror("Erro ao mapear a caixa-preta");
+        exit(EXIT_FAILURE);
+    }
+    if (__atomic_load_n(&c->magic, __ATOMIC_ACQUIRE) != CAIXA_MAGIC ||
+        c->versao != CAIXA_VERSAO || c->capacidade != CAIXA_REGISTROS) {
+        fprintf(stderr, "Caixa-preta incompatível (versão %u, esperada %u)\n",
+                c->versao, CAIXA_VERSAO);
+        exit(EXIT_FAILURE);
+    }
+    return c;
+}
+
+/**
+ * @brief Copia o registro n, se ele estiver completo.
+ *
+ * A sequência é conferida antes e depois da cópia: um registro
+ * interrompido por uma queda, ou reescrito durante a leitura, é rejeitado.
+ */
+bool read_record(const CaixaPreta *c, uint64_t n, RegistroCaixa *saida) {
+    const RegistroCaixa *r = &c->registros[n % CAIXA_REGISTROS];
+    if (atomic_load_explicit(&r->seq, memory_order_acquire) != n + 1) return false;
+    memcpy((char *)saida + sizeof(saida->seq), (const char *)r + sizeof(r->seq),
+           sizeof(RegistroCaixa) - sizeof(r->seq));
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&r->seq, memory_order_relaxed) == n + 1;
+}
+
+/**
+ * @brief Formata o horário (CLOCK_REALTIME) de um registro.
+ */
+void format_time(const CaixaPreta *c, uint64_t t_ns, char *buf, size_t tamanho) {
+    int64_t real_ns = c->inicio_real_ns + (int64_t)(t_ns - c->inicio_mono_ns);
+    time_t seg = (time_t)(real_ns / 1000000000ll);
+    struct tm tm;
+    localtime_r(&seg, &tm);
+    size_t n = strftime(buf, tamanho, "%H:%M:%S", &tm);
+    snprintf(buf + n, tamanho - n, ".%03lld", (long long)(real_ns % 1000000000ll) / 1000000);
+}
+
+/**
+ * @brief Imprime um registro em uma linha de texto.
+ *
+ * @param t_fim_ns Instante do último registro, referência do tempo relativo.
+ */
+void print_record(const CaixaPreta *c, const RegistroCaixa *r, uint64_t t_fim_ns) {
+    char hora[32];
+    format_time(c, r->t_ns, hora, sizeof(hora));
+    printf("%s %+9.3f s  ", hora, -(double)(t_fim_ns - r->t_ns) / 1e9);
+
+    switch (r->tipo) {
+    case CAIXA_AMOSTRA:
+        printf("amostra  %6.1f km/h %7.1f rpm %6.1f °C", r->amostra.velocidade,
+               r->amostra.rpm, r->amostra.temperatura);
+        break;
+    case CAIXA_COMANDO: {
+        const char *nome = r->comando.comando < CMD_NUM ? NOMES_COMANDOS[r->comando.comando]
+                                                        : "(inválido)";
+        const char *resultado = r->comando.resultado <= RESULTADO_LOTADO
+                              ? NOMES_RESULTADOS[r->comando.resultado] : "?";
+        printf("comando  %s", nome);
+        if (r->comando.lote > 0) printf(" (%u itens)", r->comando.lote);
+        if (r->comando.legado) {
+            printf(" do painel legado -> %s", resultado);
+        } else {
+            printf(" do PID %d, seq %u -> %s", (int)r->comando.pid, r->comando.seq, resultado);
+        }
+        break;
+    }
+    case CAIXA_ALERTA:
+        printf("ALERTA   %s (%.1f)", r->alerta.alerta < ALERTA_NUM ? NOMES_ALERTAS[r->alerta.alerta]
+                                                                   : "?", r->alerta.valor);
+        break;
+    case CAIXA_MARCA:
+        printf("-------- %s da gravação (PID %d)",
+               r->marca.encerramento ? "encerramento" : "início", (int)r->marca.pid);
+        break;
+    default:
+        printf("(tipo %u desconhecido)", r->tipo);
+        break;
+    }
+    printf("  | motor %2d freio %2d %c\n", r->motor_duty, r->freio_duty,
+           r->direcao ? r->direcao : '?');
+}
+
+/**
+ * @brief Imprime um registro como uma linha CSV.
+ */
+void print_record_csv(const CaixaPreta *c, const RegistroCaixa *r, uint64_t t_fim_ns) {
+    int64_t real_ns = c->inicio_real_ns + (int64_t)(r->t_ns - c->inicio_mono_ns);
+    printf("%lld,%.6f,%u,", (long long)real_ns, -(double)(t_fim_ns - r->t_ns) / 1e9, r->tipo);
+    if (r->tipo == CAIXA_AMOSTRA) {
+        printf("%.2f,%.1f,%.2f,", r->amostra.velocidade, r->amostra.rpm, r->amostra.temperatura);
+    } else {
+        printf(",,,");
+    }
+    if (r->tipo == CAIXA_COMANDO) {
+        printf("%d,%d,%u,%u,", r->comando.comando < CMD_NUM ? (int)r->comando.comando : -1,
+               (int)r->comando.pid, r->comando.seq, r->comando.resultado);
+    } else {
+        printf(",,,,");
+    }
+    if (r->tipo == CAIXA_ALERTA) {
+        printf("%u,%.2f,", r->alerta.alerta, r->alerta.valor);
+    } else {
+        printf(",,");
+    }
+    printf("%d,%d,%c\n", r->motor_duty, r->freio_duty, r->direcao ? r->direcao : '?');
+}
+
+/**
+ * @brief Reavalia as amostras gravadas com as regras de um perfil.
+ *
+ * As amostras são avaliadas em lote (uma coluna por entrada) pelo programa
+ * compilado, como se o perfil estivesse em uso durante a gravação. Só as
+ * condições são reavaliadas: as ações não alteram as amostras gravadas.
+ *
+ * @param colunas Velocidade, RPM e temperatura das amostras.
+ * @param n Número de amostras.
+ */
+void replay_rules(const char *arquivo, const float *const colunas[ENTRADA_NUM], size_t n) {
+    PerfilLimitador *perfil = malloc(sizeof(*perfil));
+    uint32_t *mascaras = malloc((n ? n : 1) * sizeof(*mascaras));
+    if (!perfil || !mascaras) {
+        perror("Erro ao alocar a reavaliação das regras");
+        exit(EXIT_FAILURE);
+    }
+    if (!perfil_ler(arquivo, perfil)) exit(EXIT_FAILURE);
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    regras_avaliar_lote(&perfil->programa, colunas, n, mascaras);
+    uint64_t disparos[REGRAS_MAX] = {0};
+    regras_contar(mascaras, n, disparos);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double ns = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+
+    const ProgramaRegras *prog = &perfil->programa;
+    printf("Regras do perfil \"%s\" (%s) nas %zu amostras (%.1f ns por amostra):\n",
+           perfil->nome, arquivo, n, n ? ns / n : 0.0);
+    for (uint32_t i = 0; i < prog->num_regras; i++) {
+        printf("  %-10s %-28s %llu\n", prog->nome[i], prog->descricao[i],
+               (unsigned long long)disparos[i]);
+    }
+    free(mascaras);
+    free(perfil);
+}
+
+/**
+ * @brief Exibe as opções de linha de comando.
+ */
+void print_usage(const char *prog) {
+    printf("Uso: %s [opções] [arquivo]   (padrão: %s)\n", prog, CAIXA_ARQUIVO_PADRAO);
+    printf("  -s, --segundos <s>  Apenas os últimos <s> segundos da gravação\n");
+    printf("  -e, --eventos       Omite as amostras (somente comandos, alertas e marcas)\n");
+    printf("  -c, --csv           Saída em CSV\n");
+    printf("  -l, --limites <arq> Reavalia as amostras com as regras de um perfil\n");
+    printf("  -h, --help          Mostra esta ajuda\n");
+}
+
+/**
+ * @brief Ponto de entrada do decodificador da caixa-preta.
+ *
+ * Lê o arquivo gravado pelo controlador (depois de uma queda, de um
+ * encerramento por "O motor apagou" ou com o controlador ainda rodando) e
+ * imprime, em ordem, os registros retidos no anel.
+ *
+ * @return 0 ao encerrar.
+ */
+int main(int argc, char *argv[]) {
+    static const struct option opcoes[] = {
+        {"segundos", required_argument, NULL, 's'},
+        {"eventos",  no_argument,       NULL, 'e'},
+        {"csv",      no_argument,       NULL, 'c'},
+        {"limites",  required_argument, NULL, 'l'},
+        {"help",     no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+    double segundos = 0;
+    bool so_eventos = false, csv = false;
+    const char *limites = NULL;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "s:ecl:h", opcoes, NULL)) != -1) {
+        switch (opt) {
+        case 's': segundos = atof(optarg); break;
+        case 'e': so_eventos = true; break;
+        case 'c': csv = true; break;
+        case 'l': limites = optarg; break;
+        case 'h':
+            print_usage(argv[0]);
+            return 0;
+        default:
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (segundos < 0 || argc - optind > 1) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    const char *arquivo = optind < argc ? argv[optind] : CAIXA_ARQUIVO_PADRAO;
+    const CaixaPreta *c = open_recording(arquivo);
+
+    // O contador pode ter ficado um registro atrás se a queda aconteceu
+    // entre a conclusão do registro e a atualização do contador
+    uint64_t fim = atomic_load_explicit(&c->escritos, memory_order_acquire);
+    while (c->registros[fim % CAIXA_REGISTROS].seq == fim + 1) fim++;
+    uint64_t inicio = fim > CAIXA_REGISTROS ? fim - CAIXA_REGISTROS : 0;
+
+    RegistroCaixa r;
+    uint64_t t_fim_ns = 0;
+    for (uint64_t n = fim; n > inicio; n--) {
+        if (read_record(c, n - 1, &r)) {
+            t_fim_ns = r.t_ns;
+            break;
+        }
+    }
+    uint64_t t_corte_ns = 0;
+    if (segundos > 0 && t_fim_ns > (uint64_t)(segundos * 1e9)) {
+        t_corte_ns = t_fim_ns - (uint64_t)(segundos * 1e9);
+    }
+
+    if (csv) {
+        printf("t_real_ns,t_rel_s,tipo,velocidade,rpm,temperatura,comando,pid,seq,resultado,"
+               "alerta,valor,motor_duty,freio_duty,direcao\n");
+    }
+
+    uint64_t validos = 0, incompletos = 0, por_tipo[CAIXA_MARCA + 1] = {0};
+    uint64_t alertas[ALERTA_NUM] = {0};
+    uint64_t t_ini_ns = 0;
+
+    // Colunas das amostras, para a reavaliação com --limites
+    float *colunas[ENTRADA_NUM] = { NULL };
+    size_t amostras = 0;
+    if (limites) {
+        for (int e = 0; e < ENTRADA_NUM; e++) {
+            colunas[e] = malloc(CAIXA_REGISTROS * sizeof(float));
+            if (!colunas[e]) {
+                perror("Erro ao alocar as amostras");
+                return EXIT_FAILURE;
+            }
+        }
+    }
+    for (uint64_t n = inicio; n < fim; n++) {
+        if (!read_record(c, n, &r)) {
+            incompletos++;
+            continue;
+        }
+        if (r.t_ns < t_corte_ns) continue;
+        if (validos++ == 0) t_ini_ns = r.t_ns;
+        if (r.tipo <= CAIXA_MARCA) por_tipo[r.tipo]++;
+        if (r.tipo == CAIXA_ALERTA && r.alerta.alerta < ALERTA_NUM) alertas[r.alerta.alerta]++;
+        if (limites && r.tipo == CAIXA_AMOSTRA) {
+            colunas[ENTRADA_VELOCIDADE][amostras] = r.amostra.velocidade;
+            colunas[ENTRADA_RPM][amostras] = r.amostra.rpm;
+            colunas[ENTRADA_TEMPERATURA][amostras] = r.amostra.temperatura;
+            amostras++;
+        }
+        if (so_eventos && r.tipo == CAIXA_AMOSTRA) continue;
+        if (csv) {
+            print_record_csv(c, &r, t_fim_ns);
+        } else {
+            print_record(c, &r, t_fim_ns);
+        }
+    }
+    if (csv) return 0;
+
+    bool vivo = !(kill(c->pid, 0) < 0 && errno == ESRCH);
+    printf("\n======== CAIXA-PRETA (%s) ========\n", arquivo);
+    printf("Controlador PID %d: %s\n", (int)c->pid,
+           atomic_load_explicit(&c->encerrado, memory_order_acquire) ? "encerrou a gravação normalmente"
+           : vivo ? "ainda gravando"
+                  : "não encerrou a gravação (queda do processo)");
+    printf("Registros: %llu exibidos de %llu gravados (%.3f s), %llu incompletos\n",
+           (unsigned long long)validos, (unsigned long long)fim,
+           validos ? (t_fim_ns - t_ini_ns) / 1e9 : 0.0, (unsigned long long)incompletos);
+    printf("Amostras: %llu, comandos: %llu, alertas: %llu\n",
+           (unsigned long long)por_tipo[CAIXA_AMOSTRA], (unsigned long long)por_tipo[CAIXA_COMANDO],
+           (unsigned long long)por_tipo[CAIXA_ALERTA]);
+    for (int i = 0; i < ALERTA_NUM; i++) {
+        if (alertas[i]) printf("  %-28s %llu\n", NOMES_ALERTAS[i], (unsigned long long)alertas[i]);
+    }
+    if (limites) replay_rules(limites, (const float *const *)colunas, amostras);
+    return 0;
+}
@@ -0,0 +1,235 @@
+#ifndef CAIXA_PRETA_H
+#define CAIXA_PRETA_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ * Caixa-preta do controlador: registro circular, em um arquivo mapeado em
+ * memória, das amostras dos sensores na taxa da tarefa de coleta, dos
+ * comandos recebidos e das intervenções dos limitadores, sempre com as
+ * saídas dos atuadores no instante do registro.
+ *
+ * Como o mapeamento é MAP_SHARED sobre um arquivo, o que foi escrito fica
+ * no page cache mesmo que o controlador morra (kill -9, falha de
+ * segmentação) e é lido depois pelo decodificador `caixa_preta`. Cada
+ * registro tem uma sequência, escrita por último: vale n + 1 quando o
+ * registro n está completo e 0 enquanto ele é reescrito, de modo que um
+ * registro interrompido pela queda é reconhecido e descartado.
+ *
+ * Há um único escritor (a thread de controle); gravar um registro são
+ * algumas escritas na memória, sem trava e sem chamada de sistema.
+ */
+
+#define CAIXA_MAGIC     0x43585054u   // "CXPT"
+#define CAIXA_VERSAO    1
+#define CAIXA_REGISTROS 65536         // ~65 s de amostras a 1 kHz (potência de 2)
+
+#define CAIXA_ARQUIVO_PADRAO "caixa_preta.bin"
+
+typedef enum {
+    CAIXA_AMOSTRA = 1,       // Amostra dos sensores (tarefa de coleta)
+    CAIXA_COMANDO,           // Comando recebido de um cliente
+    CAIXA_ALERTA,            // Intervenção de um limitador
+    CAIXA_MARCA              // Início ou encerramento da gravação
+} TipoRegistroCaixa;
+
+typedef enum {
+    ALERTA_VEL_SUP = 0,
+    ALERTA_VEL_INF,
+    ALERTA_RPM_SUP,
+    ALERTA_MOTOR_APAGOU,
+    ALERTA_TEMPERATURA,
+    ALERTA_TEMP_TENDENCIA,   // Mudança de nível do detector de superaquecimento
+    ALERTA_TEMP_PREVENTIVO,  // Redução preventiva do duty do motor
+    ALERTA_TEMP_ANOMALIA,    // Temperatura fora da previsão
+    ALERTA_REGRA,            // Regra do perfil sem alerta próprio (valor: entrada da regra)
+    ALERTA_NUM
+} AlertaCaixa;
+
+static const char *const NOMES_ALERTAS[ALERTA_NUM] = {
+    "velocidade acima do limite", "velocidade abaixo do limite",
+    "RPM acima do limite", "o motor apagou", "temperatura do motor",
+    "tendência de superaquecimento", "corte preventivo do motor",
+    "anomalia de temperatura", "regra do perfil"
+};
+
+// Um registro (32 bytes). As saídas dos atuadores acompanham todos os tipos.
+typedef struct {
+    _Atomic uint64_t seq;    // n + 1: registro n completo; 0: sendo escrito
+    uint64_t t_ns;           // CLOCK_MONOTONIC
+    uint8_t tipo;            // TipoRegistroCaixa
+    int8_t motor_duty;
+    int8_t freio_duty;
+    char direcao;
+    union {
+        struct { float velocidade, rpm, temperatura; } amostra;
+        struct { uint8_t comando, resultado, legado, lote; int32_t pid; uint32_t seq; } comando;
+        struct { uint8_t alerta; float valor; } alerta;
+        struct { uint8_t encerramento; int32_t pid; } marca;
+    };
+} __attribute__((aligned(32))) RegistroCaixa;
+
+typedef struct {
+    uint32_t magic;                      // CAIXA_MAGIC quando pronto
+    uint32_t versao;                     // CAIXA_VERSAO
+    uint32_t capacidade;                 // CAIXA_REGISTROS
+    int32_t pid;                         // PID do controlador que grava
+    int64_t inicio_real_ns;              // CLOCK_REALTIME na abertura
+    uint64_t inicio_mono_ns;             // CLOCK_MONOTONIC no mesmo instante
+
+    _Atomic uint64_t escritos __attribute__((aligned(64)));  // Próximo registro
+    _Atomic uint32_t encerrado;          // 1 se o controlador fechou a gravação
+
+    RegistroCaixa registros[CAIXA_REGISTROS] __attribute__((aligned(64)));
+} CaixaPreta;
+
+/**
+ * @brief Reserva o próximo registro e o marca como incompleto.
+ */
+static inline RegistroCaixa *caixa_reservar(CaixaPreta *c, uint64_t t_ns, uint8_t tipo,
+                                            int motor, int freio, char direcao) {
+    uint64_t n = atomic_load_explicit(&c->escritos, memory_order_relaxed);
+    RegistroCaixa *r = &c->registros[n % CAIXA_REGISTROS];
+    atomic_store_explicit(&r->seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    r->t_ns = t_ns;
+    r->tipo = tipo;
+    r->motor_duty = (int8_t)motor;
+    r->freio_duty = (int8_t)freio;
+    r->direcao = direcao;
+    return r;
+}
+
+/**
+ * @brief Marca como completo o registro obtido com caixa_reservar().
+ */
+static inline void caixa_concluir(CaixaPreta *c, RegistroCaixa *r) {
+    uint64_t n = atomic_load_explicit(&c->escritos, memory_order_relaxed);
+    atomic_store_explicit(&r->seq, n + 1, memory_order_release);
+    atomic_store_explicit(&c->escritos, n + 1, memory_order_release);
+}
+
+/**
+ * @brief Registra uma amostra dos sensores. Não faz nada se c for NULL.
+ */
+static inline void caixa_amostra(CaixaPreta *c, uint64_t t_ns, float velocidade, float rpm,
+                                 float temperatura, int motor, int freio, char direcao) {
+    if (!c) return;
+    RegistroCaixa *r = caixa_reservar(c, t_ns, CAIXA_AMOSTRA, motor, freio, direcao);
+    r->amostra.velocidade = velocidade;
+    r->amostra.rpm = rpm;
+    r->amostra.temperatura = temperatura;
+    caixa_concluir(c, r);
+}
+
+/**
+ * @brief Registra um comando recebido e o resultado enviado ao cliente.
+ */
+static inline void caixa_comando(CaixaPreta *c, uint64_t t_ns, int comando, int resultado,
+                                 bool legado, int lote, int32_t pid, uint32_t seq,
+                                 int motor, int freio, char direcao) {
+    if (!c) return;
+    RegistroCaixa *r = caixa_reservar(c, t_ns, CAIXA_COMANDO, motor, freio, direcao);
+    r->comando.comando = (uint8_t)comando;
+    r->comando.resultado = (uint8_t)resultado;
+    r->comando.legado = legado;
+    r->comando.lote = (uint8_t)lote;
+    r->comando.pid = pid;
+    r->comando.seq = seq;
+    caixa_concluir(c, r);
+}
+
+/**
+ * @brief Registra uma intervenção de limitador, com o valor que a causou.
+ */
+static inline void caixa_alerta(CaixaPreta *c, uint64_t t_ns, AlertaCaixa alerta, float valor,
+                                int motor, int freio, char direcao) {
+    if (!c) return;
+    RegistroCaixa *r = caixa_reservar(c, t_ns, CAIXA_ALERTA, motor, freio, direcao);
+    r->alerta.alerta = (uint8_t)alerta;
+    r->alerta.valor = valor;
+    caixa_concluir(c, r);
+}
+
+/**
+ * @brief Abre (ou cria) o arquivo da caixa-preta e o mapeia para escrita.
+ *
+ * Uma gravação anterior válida é renomeada para "<arquivo>.1" antes de ser
+ * substituída, para que reiniciar o controlador depois de uma queda não
+ * apague o registro dela.
+ *
+ * @param arquivo Caminho do arquivo.
+ * @param pid PID do controlador.
+ * @return A caixa-preta mapeada, ou NULL em caso de erro (já informado).
+ */
+static inline CaixaPreta *caixa_abrir(const char *arquivo, int32_t pid) {
+    int fd = open(arquivo, O_RDONLY);
+    if (fd >= 0) {
+        uint32_t magic = 0;
+        bool anterior = read(fd, &magic, sizeof(magic)) == (ssize_t)sizeof(magic) &&
+                        magic == CAIXA_MAGIC;
+        close(fd);
+        if (anterior) {
+            char antigo[4096];
+            snprintf(antigo, sizeof(antigo), "%s.1", arquivo);
+            if (rename(arquivo, antigo) < 0) perror("Aviso: gravação anterior da caixa-preta não preservada");
+        }
+    }
+
+    fd = open(arquivo, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || ftruncate(fd, sizeof(CaixaPreta)) < 0) {
+        perror("Erro ao criar o arquivo da caixa-preta");
+        if (fd >= 0) close(fd);
+        return NULL;
+    }
+    CaixaPreta *c = (CaixaPreta *)mmap(NULL, sizeof(CaixaPreta), PROT_READ | PROT_WRITE,
+                                       MAP_SHARED | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (c == MAP_FAILED) {
+        perror("Erro ao mapear a caixa-preta");
+        return NULL;
+    }
+
+    struct timespec real, mono;
+    clock_gettime(CLOCK_REALTIME, &real);
+    clock_gettime(CLOCK_MONOTONIC, &mono);
+    c->versao = CAIXA_VERSAO;
+    c->capacidade = CAIXA_REGISTROS;
+    c->pid = pid;
+    c->inicio_real_ns = (int64_t)real.tv_sec * 1000000000ll + real.tv_nsec;
+    c->inicio_mono_ns = (uint64_t)mono.tv_sec * 1000000000ull + (uint64_t)mono.tv_nsec;
+    atomic_store_explicit(&c->escritos, 0, memory_order_relaxed);
+    atomic_store_explicit(&c->encerrado, 0, memory_order_relaxed);
+    __atomic_store_n(&c->magic, CAIXA_MAGIC, __ATOMIC_RELEASE);
+
+    RegistroCaixa *r = caixa_reservar(c, c->inicio_mono_ns, CAIXA_MARCA, 0, 0, 'N');
+    r->marca.encerramento = 0;
+    r->marca.pid = pid;
+    caixa_concluir(c, r);
+    return c;
+}
+
+/**
+ * @brief Registra o encerramento, grava o arquivo em disco e o desmapeia.
+ */
+static inline void caixa_fechar(CaixaPreta *c, uint64_t t_ns, int motor, int freio, char direcao) {
+    if (!c) return;
+    RegistroCaixa *r = caixa_reservar(c, t_ns, CAIXA_MARCA, motor, freio, direcao);
+    r->marca.encerramento = 1;
+    r->marca.pid = c->pid;
+    caixa_concluir(c, r);
+    atomic_store_explicit(&c->encerrado, 1, memory_order_release);
+    msync(c, sizeof(CaixaPreta), MS_SYNC);
+    munmap(c, sizeof(CaixaPreta));
+}
+
+#endif // CAIXA_PRETA_H
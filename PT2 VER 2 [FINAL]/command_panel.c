@@ -3,20 +3,143 @@
 #include <string.h>
 #include <sys/ipc.h>
 #include <sys/msg.h>
+#include <sys/shm.h>
 #include <unistd.h>
 #include <signal.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <termios.h>
+#include <stdint.h>
+#include <time.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
 
-// Definições
-#define MSG_KEY 5678 // Chave da fila de mensagens
+#include "ipc_shared.h"
+#include "anel_comandos.h"
 
-// Estrutura para mensagens do painel
+// Número de opções do menu (0 a 16)
+#define NUM_OPCOES 17
+
+// Comando enviado por cada opção do menu (a opção 0 encerra)
+static const ComandoId OPCOES[NUM_OPCOES] = {
+    CMD_ENCERRAR,
+    CMD_LIGAR_SETA_ESQ,
+    CMD_LIGAR_SETA_DIR,
+    CMD_LIGAR_PISCA_ALERTA,
+    CMD_LIGAR_FAROL_BAIXO,
+    CMD_LIGAR_FAROL_ALTO,
+    CMD_PEDAL_ACELERADOR,
+    CMD_PEDAL_FREIO,
+    CMD_DESLIGAR_SETA_ESQ,
+    CMD_DESLIGAR_SETA_DIR,
+    CMD_DESLIGAR_PISCA_ALERTA,
+    CMD_DESLIGAR_FAROL_BAIXO,
+    CMD_DESLIGAR_FAROL_ALTO,
+    CMD_DESLIGAR_FAROL,
+    CMD_PAUSAR,
+    CMD_RETOMAR,
+    CMD_PASSO,
+};
+
+// Tecla de cada opção no modo tecla a tecla (uma tecla por opção)
+static const char TECLAS[NUM_OPCOES] = {
+    '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'p', 'r', 's',
+};
+
+// Mistura sintética do gerador de carga (comandos repetidos pesam mais)
+static const ComandoId MISTURA_CARGA[] = {
+    CMD_PEDAL_ACELERADOR, CMD_PEDAL_ACELERADOR, CMD_PEDAL_ACELERADOR,
+    CMD_PEDAL_FREIO,
+    CMD_LIGAR_SETA_ESQ, CMD_DESLIGAR_SETA_ESQ,
+    CMD_LIGAR_SETA_DIR, CMD_DESLIGAR_SETA_DIR,
+    CMD_LIGAR_FAROL_BAIXO, CMD_DESLIGAR_FAROL_BAIXO,
+    CMD_LIGAR_FAROL_ALTO, CMD_DESLIGAR_FAROL_ALTO,
+};
+#define NUM_MISTURA_CARGA (sizeof(MISTURA_CARGA) / sizeof(MISTURA_CARGA[0]))
+
+#define MAX_PROCESSOS_CARGA 64
+
+// Parâmetros do modo gerador de carga (--carga)
+typedef struct {
+    double taxa;             // Mensagens/s somando todos os processos (0 = sem limite)
+    int rajada;              // Mensagens enviadas em sequência a cada liberação
+    int processos;           // Processos remetentes
+    int lote;                // Comandos por mensagem (1 = sem lote)
+    double duracao_s;        // Duração do teste (se total == 0)
+    long total;              // Total de mensagens (0 = usa a duração)
+    bool descartar;          // Com a fila cheia, descarta em vez de bloquear
+    const char *script;      // Arquivo de comandos (NULL = mistura sintética)
+} ConfigCarga;
+
+// Resultado de um processo remetente (em memória compartilhada com o pai)
 typedef struct {
-    long msg_type;        // Tipo da mensagem (1 para comandos)
-    char command[100];    // Comando enviado pelo painel
-} Message;
+    uint64_t enviadas;
+    uint64_t eagain;         // Envios recusados com a fila cheia
+    uint64_t descartadas;
+    uint64_t bloqueio_ns;    // Tempo total bloqueado em msgsnd
+    uint64_t bloqueio_max_ns;
+    uint64_t inicio_ns, fim_ns;
+    uint64_t acks;           // Confirmações recebidas do controlador
+    uint64_t recusadas;      // Confirmações com resultado diferente de OK
+    uint64_t lat_total_ns;   // Soma das latências de ida e volta
+    uint64_t lat_max_ns;
+    uint64_t lat_hist[64];   // Histograma da latência em faixas de potência de 2 (ns)
+} ResultadoCarga;
+
+// Tempo máximo de espera pela confirmação do registro
+#define TEMPO_REGISTRO_MS 1000
 
 // Variáveis globais para facilitar o uso no handler
-static int msg_queue_id; 
+static int msg_queue_id;
+static volatile sig_atomic_t interrompido = 0;
+
+// Respostas do controlador repassadas pela thread leitora ao loop de eventos
+static int pipe_respostas[2];
+
+// Canal do cliente: após o registro, comandos e respostas usam tipos
+// próprios (derivados do PID); sem registro, o canal legado (tipos 1 e 2)
+static bool registrado = false;
+static pid_t meu_pid = 0;
+static long tipo_comando = MSG_TIPO_COMANDO;
+static long tipo_resposta = MSG_TIPO_RESPOSTA;
+static uint32_t proximo_seq = 1;
+static bool encerrando = false;  // Este painel pediu o encerramento do controlador
+
+// Tempo máximo de espera pelo "Encerrar" depois de pedir o encerramento
+#define TEMPO_ENCERRAMENTO_MS 2000
+
+// Modo tecla a tecla: stdin é um terminal, colocado em modo não canônico
+static bool modo_tecla = false;
+static struct termios termios_original;
+
+// Último estado recebido do controlador (linha de status)
+static EstadoPainel ultimo_estado;
+static bool tem_estado = false;
+static double ultima_latencia_ms = -1.0; // Latência da última confirmação
+
+// Anel de comandos (--anel): usado no lugar da fila depois do registro,
+// com as confirmações na caixa do cliente no mesmo segmento
+static AnelComandos *anel_cmd = NULL;
+static uint8_t caixa_conf = ANEL_CONF_NENHUMA;
+#define TEMPO_ANEL_CHEIO_MS 100   // Espera por espaço antes de checar o controlador
+
+// Lote em composição no modo tecla a tecla (tecla 'l')
+static bool compondo_lote = false;
+static ComandoId lote_atual[MAX_LOTE];
+static int lote_atual_tamanho = 0;
+
+
+/**
+ * @brief Retorna o tempo monotônico atual em nanossegundos.
+ */
+static inline uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
 
 
 /**
@@ -25,27 +148,120 @@ static int msg_queue_id;
  * A função display_menu() imprime o menu de opções do painel de comando
  * na saida padrão do usuário. Ela lista todas as opções possíveis para o usuário
  * e aguarda a escolha da opção desejada.
- * 
+ *
+ * No modo tecla a tecla cada opção é acionada por uma única tecla (as
+ * opções 10 a 13 usam as letras 'a' a 'd'; pausar, retomar e avançar um
+ * passo usam 'p', 'r' e 's') e 'm' mostra o menu novamente.
+ *
  * @note Foram adicionados alguns comandos com relação ao trabalho 1, como
  * ligar/desligar o farol (ambos) e ligar/desligar o pisca-alerta.
  */
 void display_menu() {
     printf("\n==== PAINEL DE COMANDOS ====\n");
-    printf("1  - Ligar Seta Esquerda\n");
-    printf("2  - Ligar Seta Direita\n");
-    printf("3  - Ligar Pisca-Alerta\n");
-    printf("4  - Ligar Farol Baixo\n");
-    printf("5  - Ligar Farol Alto\n");
-    printf("6  - Acionar Pedal do Acelerador\n");
-    printf("7  - Acionar Pedal do Freio\n");
-    printf("8  - Desligar Seta Esquerda\n");
-    printf("9  - Desligar Seta Direita\n");
-    printf("10 - Desligar Pisca-Alerta\n");
-    printf("11 - Desligar Farol Baixo\n");
-    printf("12 - Desligar Farol Alto\n");
-    printf("13 - Desligar Farol (ambos)\n");
-    printf("0  - Sair\n");
-    printf("Escolha uma opção: ");
+    for (int i = 1; i < NUM_OPCOES; i++) {
+        if (modo_tecla) {
+            printf("%c  - %s\n", TECLAS[i], NOMES_COMANDOS[OPCOES[i]]);
+        } else {
+            printf("%-2d - %s\n", i, NOMES_COMANDOS[OPCOES[i]]);
+        }
+    }
+    if (modo_tecla) {
+        printf("0  - Sair (encerra o controlador)\n");
+        printf("l  - Compor um lote (vários comandos aplicados juntos)\n");
+        printf("m  - Mostrar o menu / q - Sair sem encerrar o controlador\n");
+    } else {
+        printf("0  - Sair (várias opções na mesma linha formam um lote)\n");
+        printf("Escolha uma opção: ");
+    }
+    fflush(stdout);
+}
+
+
+/**
+ * @brief Redesenha a linha de status com o último estado do controlador.
+ *
+ * A linha é reescrita no lugar (retorno de carro + limpeza de linha), por
+ * isso só é usada no modo tecla a tecla.
+ */
+void draw_status() {
+    if (!modo_tecla || !tem_estado) return;
+    const EstadoPainel *e = &ultimo_estado;
+    printf("\r\033[K[%6.1f km/h | %5.0f rpm | %5.1f ºC | motor %2d freio %2d | "
+           "setas %c%c | farol %c%c]",
+           e->velocidade, e->rpm, e->temperatura, (int)e->motor_duty, (int)e->freio_duty,
+           e->seta_esq ? '<' : '-', e->seta_dir ? '>' : '-',
+           e->farol_baixo ? 'B' : '-', e->farol_alto ? 'A' : '-');
+    if (ultima_latencia_ms >= 0.0) {
+        printf(" ack %.1f ms", ultima_latencia_ms);
+    }
+    printf(" ");
+    fflush(stdout);
+}
+
+
+/**
+ * @brief Apaga a linha de status antes de imprimir uma mensagem comum.
+ */
+void clear_status() {
+    if (modo_tecla && tem_estado) {
+        printf("\r\033[K");
+    }
+}
+
+
+/**
+ * @brief Anexa o anel de comandos criado pelo controlador.
+ *
+ * @return O anel, ou NULL (com aviso) se o controlador não o publicou.
+ */
+AnelComandos *attach_command_ring() {
+    int shm_id = shmget(SHM_KEY_COMANDOS, sizeof(AnelComandos), 0);
+    AnelComandos *anel = shm_id < 0 ? (void *)-1 : shmat(shm_id, NULL, 0);
+    if (anel == (void *)-1) {
+        perror("Anel de comandos indisponível; usando a fila de mensagens");
+        return NULL;
+    }
+    if (__atomic_load_n(&anel->magic, __ATOMIC_ACQUIRE) != ANEL_CMD_MAGIC ||
+        anel->versao != ANEL_CMD_VERSAO) {
+        fprintf(stderr, "Anel de comandos incompatível; usando a fila de mensagens\n");
+        shmdt(anel);
+        return NULL;
+    }
+    return anel;
+}
+
+
+/**
+ * @brief Escreve um comando diretamente em um slot do anel de comandos.
+ *
+ * Nenhuma chamada de sistema no caminho normal. Com o anel cheio, pode
+ * dormir no futex do anel até o controlador consumir comandos. A
+ * confirmação chega na caixa de confirmações do painel.
+ *
+ * @param msg Comando com pid, sequência, instante de envio e lote preenchidos.
+ * @param bloquear Com o anel cheio, espera espaço em vez de desistir.
+ * @return true se o comando foi entregue; false com o anel cheio (sem
+ *         bloquear), se o painel foi interrompido ou se o controlador saiu.
+ */
+bool ring_send(const Message *msg, bool bloquear) {
+    uint64_t pos;
+    SlotComando *slot;
+    while ((slot = anel_cmd_reservar(anel_cmd, msg->pid, &pos)) == NULL) {
+        if (!bloquear || interrompido) return false;
+        if (!anel_cmd_esperar_espaco(anel_cmd, TEMPO_ANEL_CHEIO_MS) &&
+            kill(anel_cmd->pid, 0) < 0 && errno == ESRCH) {
+            return false;
+        }
+    }
+    slot->pid = msg->pid;
+    slot->seq_cmd = msg->seq;
+    slot->t_envio_ns = msg->t_envio_ns;
+    slot->comando = (uint8_t)comando_id(msg->command);
+    slot->lote_tamanho = msg->lote_tamanho;
+    slot->confirmacao = caixa_conf;
+    memcpy(slot->lote, msg->lote, sizeof(slot->lote));
+    anel_cmd_publicar(slot, pos);
+    return true;
 }
 
 
@@ -58,25 +274,137 @@ void display_menu() {
  * MSG_KEY e o tipo de mensagem definido em msg_type. Ela também imprime na
  * saída padrão o comando enviado.
  *
- * @note Com a msg_queue_id como variável global, 
+ * @note Com a msg_queue_id como variável global,
  *       acabei removendo esse argumento.
- * 
+ *
  * @param msg Mensagem a ser enviada com o comando.
  */
 void send_message(Message msg) {
-    if (msgsnd(msg_queue_id, &msg, sizeof(msg) - sizeof(long), 0) < 0) {
+    msg.msg_type = tipo_comando;
+    msg.pid = registrado ? meu_pid : 0;
+    msg.seq = proximo_seq++;
+    msg.t_envio_ns = now_ns();
+    if (anel_cmd && registrado) {
+        if (!ring_send(&msg, true)) {
+            clear_status();
+            printf("Comando não entregue pelo anel de comandos.\n");
+            draw_status();
+            return;
+        }
+    } else if (msgsnd(msg_queue_id, &msg, sizeof(msg) - sizeof(long), 0) < 0) {
         perror("Erro ao enviar comando para a fila de mensagens");
         exit(EXIT_FAILURE);
+    }
+
+    clear_status();
+    if (msg.lote_tamanho > 0) {
+        printf("Comando enviado: Lote [");
+        for (int i = 0; i < msg.lote_tamanho; i++) {
+            printf("%s%s", i ? " + " : "", NOMES_COMANDOS[msg.lote[i]]);
+        }
+        printf("]\n");
     } else {
         printf("Comando enviado: %s\n", msg.command);
     }
+    draw_status();
+}
+
+
+/**
+ * @brief Envia um comando identificado pelo seu ComandoId.
+ */
+void send_command(ComandoId cmd) {
+    Message msg;
+    memset(&msg, 0, sizeof(msg));
+    strcpy(msg.command, NOMES_COMANDOS[cmd]);
+    send_message(msg);
+}
+
+
+/**
+ * @brief Envia vários comandos em uma única mensagem "Lote".
+ *
+ * O controlador aplica o lote inteiro em uma só seção crítica e o
+ * confirma como uma unidade (ou recusa tudo, se algum item for inválido).
+ */
+void send_batch(const ComandoId *cmds, int n) {
+    Message msg;
+    memset(&msg, 0, sizeof(msg));
+    strcpy(msg.command, NOMES_COMANDOS[CMD_LOTE]);
+    msg.lote_tamanho = (uint8_t)n;
+    for (int i = 0; i < n; i++) {
+        msg.lote[i] = (uint8_t)cmds[i];
+    }
+    send_message(msg);
+}
+
+
+/**
+ * @brief Registra este processo como cliente do controlador.
+ *
+ * Envia o pedido pelo canal legado com o próprio PID e aguarda a
+ * confirmação no tipo de resposta do cliente. Com o registro aceito, os
+ * comandos passam a usar o tipo próprio do cliente, as respostas chegam
+ * só a ele e cada comando é confirmado. Sem resposta (controlador ainda
+ * não iniciado), o pedido é cancelado e o canal legado continua em uso.
+ *
+ * @param cmd CMD_CONECTAR (com estado ao vivo) ou CMD_REGISTRAR.
+ * @return true se o registro foi aceito.
+ */
+bool register_client(ComandoId cmd) {
+    Message msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_type = MSG_TIPO_COMANDO;
+    msg.pid = getpid();
+    msg.t_envio_ns = now_ns();
+    strcpy(msg.command, NOMES_COMANDOS[cmd]);
+    if (msgsnd(msg_queue_id, &msg, sizeof(msg) - sizeof(long), 0) < 0) {
+        perror("Erro ao enviar registro para a fila de mensagens");
+        exit(EXIT_FAILURE);
+    }
+
+    long resposta = msg_tipo_cliente_resposta(msg.pid);
+    uint64_t limite = now_ns() + TEMPO_REGISTRO_MS * 1000000ull;
+    while (now_ns() < limite && !interrompido) {
+        if (msgrcv(msg_queue_id, &msg, sizeof(msg) - sizeof(long), resposta, IPC_NOWAIT) < 0) {
+            usleep(2000);
+            continue;
+        }
+        if (strcmp(msg.command, "Ack") != 0 || msg.seq != 0) continue;
+        if (msg.status != RESULTADO_OK) {
+            fprintf(stderr, "Registro recusado pelo controlador (%s); usando o canal legado.\n",
+                    msg.status == RESULTADO_LOTADO ? "limite de clientes atingido" : "pedido inválido");
+            return false;
+        }
+        registrado = true;
+        meu_pid = getpid();
+        tipo_comando = msg_tipo_cliente_comando(meu_pid);
+        tipo_resposta = resposta;
+        if (anel_cmd) {
+            caixa_conf = anel_conf_abrir(anel_cmd, meu_pid);
+            if (caixa_conf == ANEL_CONF_NENHUMA) {
+                fprintf(stderr, "Sem caixa de confirmações livre no anel; usando a fila de mensagens\n");
+                shmdt(anel_cmd);
+                anel_cmd = NULL;
+            }
+        }
+        return true;
+    }
+
+    // Cancela o pedido caso o controlador o processe mais tarde
+    fprintf(stderr, "Controlador não respondeu ao registro; usando o canal legado.\n");
+    msg.msg_type = MSG_TIPO_COMANDO;
+    msg.pid = getpid();
+    strcpy(msg.command, NOMES_COMANDOS[CMD_DESCONECTAR]);
+    msgsnd(msg_queue_id, &msg, sizeof(msg) - sizeof(long), IPC_NOWAIT);
+    return false;
 }
 
 
 /**
  * @brief Handler para o sinal SIGINT (Ctrl + C)
  *
- * Caso o sinal seja SIGINT, o handler imprime uma mensagem de encerramento,
+ * Apenas sinaliza o loop de eventos, que interrompe o poll() com EINTR,
  * envia o comando "Encerrar" para o controller e finaliza o programa
  * com o status 0.
  *
@@ -84,31 +412,700 @@ void send_message(Message msg) {
  */
 void sigint_handler(int signal) {
     if (signal == SIGINT) {
-        printf("\nEncerrando via Ctrl + C...\n");
-        
-        // Enviar o comando "Encerrar" para o controller
-        Message msg;
-        msg.msg_type = 1; 
-        strcpy(msg.command, "Encerrar");
-        send_message(msg);
+        interrompido = 1;
+    }
+}
+
 
-        // Sair do programa
-        exit(0);
+/**
+ * @brief Restaura o modo original do terminal (registrada com atexit).
+ */
+void restore_terminal() {
+    if (modo_tecla) {
+        tcsetattr(STDIN_FILENO, TCSANOW, &termios_original);
     }
 }
 
 
 /**
- * @brief Limpa o buffer de entrada padrão (stdin) até encontrar um '\n' ou EOF.
+ * @brief Coloca o terminal em modo tecla a tecla, se stdin for um terminal.
  *
- * Essa função é útil para limpar o buffer de entrada
- * quando se lê um caractere com scanf e não se deseja
- * que o caractere seja lido novamente na próxima
- * interação com o usuário.
+ * Desliga o modo canônico e o eco, de modo que cada tecla chega ao painel
+ * assim que é pressionada. Ctrl + C continua gerando SIGINT. Quando stdin
+ * não é um terminal (arquivo ou pipe), o painel lê linhas com números,
+ * como antes.
  */
-void clear_input_buffer() {
-    int c;
-    while ((c = getchar()) != '\n' && c != EOF);
+void setup_terminal() {
+    if (!isatty(STDIN_FILENO) || tcgetattr(STDIN_FILENO, &termios_original) < 0) {
+        return;
+    }
+
+    struct termios t = termios_original;
+    t.c_lflag &= ~(ICANON | ECHO);
+    t.c_cc[VMIN] = 1;
+    t.c_cc[VTIME] = 0;
+    if (tcsetattr(STDIN_FILENO, TCSANOW, &t) < 0) {
+        perror("Erro ao configurar o terminal");
+        return;
+    }
+    modo_tecla = true;
+    atexit(restore_terminal);
+}
+
+
+/**
+ * @brief Thread leitora das respostas do controlador.
+ *
+ * Fica bloqueada em msgrcv() no tipo de resposta do cliente (ou em
+ * MSG_TIPO_RESPOSTA, no canal legado) e repassa cada uma pelo pipe, que o
+ * loop de eventos acompanha com poll() junto com stdin. Se a fila for
+ * removida, repassa um "Encerrar".
+ */
+void *thread_respostas(void *arg) {
+    (void)arg;
+    Message msg;
+
+    while (1) {
+        if (msgrcv(msg_queue_id, &msg, sizeof(msg) - sizeof(long), tipo_resposta, 0) < 0) {
+            if (errno == EINTR) continue;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_type = MSG_TIPO_RESPOSTA;
+            strcpy(msg.command, "Encerrar");
+            if (write(pipe_respostas[1], &msg, sizeof(msg)) < 0) {}
+            break;
+        }
+        // Mensagens menores que PIPE_BUF são escritas atomicamente
+        if (write(pipe_respostas[1], &msg, sizeof(msg)) < 0) break;
+    }
+    return NULL;
+}
+
+
+/**
+ * @brief Thread leitora das confirmações do anel de comandos (--anel).
+ *
+ * Dorme no futex da caixa de confirmações do painel e repassa cada
+ * confirmação pelo mesmo pipe das respostas, como um "Ack".
+ */
+void *thread_confirmacoes(void *arg) {
+    (void)arg;
+    Message msg;
+    memset(&msg, 0, sizeof(msg));
+    strcpy(msg.command, "Ack");
+
+    while (1) {
+        ConfirmacaoAnel conf;
+        if (!anel_conf_proxima(anel_cmd, caixa_conf, &conf)) {
+            anel_conf_esperar(anel_cmd, caixa_conf, TEMPO_ANEL_CHEIO_MS);
+            continue;
+        }
+        msg.seq = conf.seq_cmd;
+        msg.status = (ResultadoComando)conf.status;
+        msg.t_envio_ns = conf.t_envio_ns;
+        if (write(pipe_respostas[1], &msg, sizeof(msg)) < 0) break;
+    }
+    return NULL;
+}
+
+
+/**
+ * @brief Executa uma opção do menu.
+ *
+ * @param opcao Número da opção (0 a 16).
+ * @return false se o painel deve encerrar.
+ */
+bool handle_option(int opcao) {
+    if (opcao < 0 || opcao >= NUM_OPCOES) {
+        clear_status();
+        printf("Opção inválida. Tente novamente.\n");
+        draw_status();
+        return true;
+    }
+    if (opcao == 0) {
+        clear_status();
+        tem_estado = false;
+        printf("Encerrando Painel de Comandos...\n");
+        printf("Encerrando controlador...\n\n");
+        send_command(CMD_ENCERRAR);
+        encerrando = true;
+        return false;
+    }
+    send_command(OPCOES[opcao]);
+    return true;
+}
+
+
+/**
+ * @brief Trata uma tecla durante a composição de um lote.
+ */
+void handle_batch_key(char c) {
+    if (c == '\n' || c == '\r' || c == 'l') {
+        compondo_lote = false;
+        clear_status();
+        if (lote_atual_tamanho > 0) {
+            send_batch(lote_atual, lote_atual_tamanho);
+        } else {
+            printf("Lote vazio descartado.\n");
+            draw_status();
+        }
+        return;
+    }
+    if (c == 27) { // Esc
+        compondo_lote = false;
+        clear_status();
+        printf("Lote cancelado.\n");
+        draw_status();
+        return;
+    }
+
+    const char *p = memchr(TECLAS, c, NUM_OPCOES);
+    if (p == NULL) return;
+    clear_status();
+    if (p == TECLAS) {
+        printf("Sair não pode fazer parte de um lote.\n");
+    } else if (!comando_em_lote(OPCOES[p - TECLAS])) {
+        printf("%s não pode fazer parte de um lote.\n", NOMES_COMANDOS[OPCOES[p - TECLAS]]);
+    } else if (lote_atual_tamanho == MAX_LOTE) {
+        printf("Lote cheio (%d comandos); Enter envia.\n", MAX_LOTE);
+    } else {
+        ComandoId cmd = OPCOES[p - TECLAS];
+        lote_atual[lote_atual_tamanho++] = cmd;
+        printf("Lote: + %s\n", NOMES_COMANDOS[cmd]);
+    }
+}
+
+
+/**
+ * @brief Trata as teclas lidas no modo tecla a tecla.
+ *
+ * @return false se o painel deve encerrar.
+ */
+bool handle_keys(const char *teclas, ssize_t n) {
+    for (ssize_t i = 0; i < n; i++) {
+        char c = teclas[i];
+        if (compondo_lote) {
+            handle_batch_key(c);
+            continue;
+        }
+        if (c == 'l') {
+            compondo_lote = true;
+            lote_atual_tamanho = 0;
+            clear_status();
+            printf("Lote: escolha até %d comandos, Enter envia, Esc cancela\n", MAX_LOTE);
+            continue;
+        }
+        if (c == 'm' || c == '?') {
+            clear_status();
+            display_menu();
+            draw_status();
+            continue;
+        }
+        if (c == 'q') {
+            clear_status();
+            tem_estado = false;
+            printf("Saindo do Painel de Comandos (controlador continua em execução)...\n");
+            if (registrado) send_command(CMD_DESCONECTAR);
+            return false;
+        }
+        const char *p = memchr(TECLAS, c, NUM_OPCOES);
+        if (p == NULL) continue; // Ignora teclas sem função (setas, espaço, ...)
+        if (!handle_option((int)(p - TECLAS))) return false;
+    }
+    return true;
+}
+
+
+/**
+ * @brief Trata as linhas completas lidas no modo linha (stdin não é terminal).
+ *
+ * @param buffer Dados acumulados; linhas incompletas ficam para a próxima leitura.
+ * @param tam Quantidade de bytes válidos em buffer (atualizada).
+ * @return false se o painel deve encerrar.
+ */
+bool handle_lines(char *buffer, size_t *tam) {
+    char *inicio = buffer;
+    char *fim;
+    bool ativo = true;
+
+    while (ativo && (fim = memchr(inicio, '\n', *tam - (size_t)(inicio - buffer))) != NULL) {
+        *fim = '\0';
+
+        // Uma linha com vários números (separados por espaço ou vírgula)
+        // vira um único lote
+        long opcoes[MAX_LOTE + 1];
+        int n = 0;
+        bool valida = true;
+        char *p = inicio;
+        while (valida) {
+            while (*p == ' ' || *p == '\t' || *p == '\r' || *p == ',') p++;
+            if (*p == '\0') break;
+            char *resto;
+            long opcao = strtol(p, &resto, 10);
+            if (resto == p || n == MAX_LOTE + 1) {
+                valida = false;
+                break;
+            }
+            opcoes[n++] = opcao;
+            p = resto;
+        }
+
+        if (!valida || n == 0) {
+            fprintf(stderr, "Entrada inválida. Por favor, insira um número.\n");
+        } else if (n == 1) {
+            ativo = handle_option((int)opcoes[0]);
+            if (ativo) display_menu();
+        } else if (n > MAX_LOTE) {
+            fprintf(stderr, "Lote com mais de %d comandos.\n", MAX_LOTE);
+        } else {
+            ComandoId lote[MAX_LOTE];
+            for (int i = 0; i < n && valida; i++) {
+                valida = opcoes[i] >= 1 && opcoes[i] < NUM_OPCOES &&
+                         comando_em_lote(OPCOES[opcoes[i]]);
+                if (valida) lote[i] = OPCOES[opcoes[i]];
+            }
+            if (valida) {
+                send_batch(lote, n);
+                display_menu();
+            } else {
+                printf("Opção inválida no lote (apenas acionadores, 1 a 13). Tente novamente.\n");
+            }
+        }
+        inicio = fim + 1;
+    }
+
+    // Mantém a linha incompleta no início do buffer; uma linha maior que o
+    // buffer é descartada
+    *tam -= (size_t)(inicio - buffer);
+    memmove(buffer, inicio, *tam);
+    if (*tam == 255) {
+        fprintf(stderr, "Entrada inválida. Por favor, insira um número.\n");
+        *tam = 0;
+    }
+    return ativo;
+}
+
+
+/**
+ * @brief Carrega o roteiro de comandos do gerador de carga.
+ *
+ * Cada linha contém o número de uma opção do menu (1 a 16) ou o texto
+ * exato de um comando; linhas vazias e iniciadas por '#' são ignoradas.
+ *
+ * @param caminho Arquivo do roteiro.
+ * @param n Recebe a quantidade de comandos.
+ * @return Vetor alocado com os comandos (liberado ao fim do processo).
+ */
+ComandoId *load_script(const char *caminho, size_t *n) {
+    FILE *f = fopen(caminho, "r");
+    if (!f) {
+        perror("Erro ao abrir o roteiro de comandos");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t capacidade = 64;
+    ComandoId *cmds = malloc(capacidade * sizeof(ComandoId));
+    char linha[128];
+    int num_linha = 0;
+    *n = 0;
+
+    while (fgets(linha, sizeof(linha), f)) {
+        num_linha++;
+        linha[strcspn(linha, "\r\n")] = '\0';
+        char *texto = linha;
+        while (*texto == ' ' || *texto == '\t') texto++;
+        if (*texto == '\0' || *texto == '#') continue;
+
+        char *resto;
+        long opcao = strtol(texto, &resto, 10);
+        ComandoId cmd;
+        if (resto != texto && *resto == '\0') {
+            cmd = (opcao >= 1 && opcao < NUM_OPCOES) ? OPCOES[opcao] : CMD_INVALIDO;
+        } else {
+            cmd = comando_id(texto);
+        }
+        if (cmd == CMD_INVALIDO) {
+            fprintf(stderr, "%s:%d: comando inválido: %s\n", caminho, num_linha, texto);
+            exit(EXIT_FAILURE);
+        }
+
+        if (*n == capacidade) {
+            capacidade *= 2;
+            cmds = realloc(cmds, capacidade * sizeof(ComandoId));
+        }
+        cmds[(*n)++] = cmd;
+    }
+    fclose(f);
+
+    if (*n == 0) {
+        fprintf(stderr, "%s: roteiro sem comandos\n", caminho);
+        exit(EXIT_FAILURE);
+    }
+    return cmds;
+}
+
+
+/**
+ * @brief Consome as confirmações pendentes e acumula a latência.
+ *
+ * @param res Resultado do processo remetente.
+ */
+void load_collect_acks(ResultadoCarga *res) {
+    Message msg;
+    ConfirmacaoAnel conf;
+    for (;;) {
+        // Com o anel, as confirmações chegam na caixa do processo
+        if (anel_cmd && registrado) {
+            if (!anel_conf_proxima(anel_cmd, caixa_conf, &conf)) break;
+            msg.t_envio_ns = conf.t_envio_ns;
+            msg.status = (ResultadoComando)conf.status;
+        } else {
+            if (msgrcv(msg_queue_id, &msg, sizeof(msg) - sizeof(long), tipo_resposta, IPC_NOWAIT) <= 0) {
+                break;
+            }
+            if (strcmp(msg.command, "Ack") != 0) continue;
+        }
+        uint64_t lat = now_ns() - msg.t_envio_ns;
+        res->acks++;
+        if (msg.status != RESULTADO_OK) res->recusadas++;
+        res->lat_total_ns += lat;
+        if (lat > res->lat_max_ns) res->lat_max_ns = lat;
+        res->lat_hist[63 - __builtin_clzll(lat | 1)]++;
+    }
+}
+
+
+/**
+ * @brief Envia um comando do gerador de carga pelo canal em uso.
+ *
+ * Usa o anel de comandos quando disponível (--anel e registro aceito) e a
+ * fila de mensagens nos demais casos.
+ *
+ * @return 0, EAGAIN (canal cheio, sem bloquear) ou EINTR (interrompido).
+ */
+int load_send(Message *msg, bool bloquear) {
+    if (anel_cmd && registrado) {
+        if (ring_send(msg, bloquear)) return 0;
+        return bloquear ? EINTR : EAGAIN;
+    }
+    if (msgsnd(msg_queue_id, msg, sizeof(*msg) - sizeof(long), bloquear ? 0 : IPC_NOWAIT) == 0) {
+        return 0;
+    }
+    if (errno == EINTR || errno == EAGAIN) return errno;
+    perror("Erro ao enviar comando para a fila de mensagens");
+    exit(EXIT_FAILURE);
+}
+
+
+/**
+ * @brief Laço de um processo remetente do gerador de carga.
+ *
+ * Envia comandos em rajadas liberadas em prazos absolutos (malha aberta:
+ * o ritmo não depende do controlador). Cada envio tenta primeiro sem
+ * bloquear; com a fila (ou o anel) cheia, o EAGAIN é contado e a mensagem
+ * é descartada ou enviada de forma bloqueante, medindo o tempo bloqueado.
+ *
+ * Cada processo se registra como cliente; as confirmações são coletadas
+ * entre as rajadas e, ao final, aguardadas por até TEMPO_ENCERRAMENTO_MS,
+ * dando a latência de ida e volta de cada comando.
+ *
+ * @param indice Índice do processo (0 a processos - 1).
+ * @param cfg Parâmetros do teste.
+ * @param cmds Roteiro (NULL para a mistura sintética).
+ * @param n_cmds Tamanho do roteiro.
+ * @param res Slot de resultado deste processo.
+ */
+void load_sender(int indice, const ConfigCarga *cfg, const ComandoId *cmds, size_t n_cmds,
+                 ResultadoCarga *res) {
+    register_client(CMD_REGISTRAR);
+
+    Message msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_type = tipo_comando;
+    msg.pid = registrado ? meu_pid : 0;
+    if (cfg->lote > 1) {
+        strcpy(msg.command, NOMES_COMANDOS[CMD_LOTE]);
+        msg.lote_tamanho = (uint8_t)cfg->lote;
+    }
+
+    // Cota deste processo
+    uint64_t limite = UINT64_MAX;
+    if (cfg->total > 0) {
+        limite = (uint64_t)(cfg->total / cfg->processos) +
+                 ((uint64_t)indice < (uint64_t)(cfg->total % cfg->processos) ? 1 : 0);
+    }
+    uint64_t intervalo_ns = 0;
+    if (cfg->taxa > 0.0) {
+        intervalo_ns = (uint64_t)(cfg->rajada * 1e9 * cfg->processos / cfg->taxa);
+    }
+
+    uint64_t estado_rng = 0x9E3779B97F4A7C15ull ^ ((uint64_t)getpid() << 16) ^ (uint64_t)indice;
+    size_t cursor = (size_t)indice;
+    uint64_t feitas = 0;
+
+    res->inicio_ns = now_ns();
+    uint64_t fim_ns = res->inicio_ns + (uint64_t)(cfg->duracao_s * 1e9);
+    uint64_t proximo_ns = res->inicio_ns;
+
+    while (!interrompido && feitas < limite && (cfg->total > 0 || now_ns() < fim_ns)) {
+        for (int b = 0; b < cfg->rajada && feitas < limite && !interrompido; b++) {
+            // Com --lote, cada mensagem leva cfg->lote comandos
+            for (int k = 0; k < cfg->lote; k++) {
+                ComandoId cmd;
+                if (cmds) {
+                    cmd = cmds[cursor++ % n_cmds];
+                } else {
+                    // xorshift64: barato e suficiente para sortear a mistura
+                    estado_rng ^= estado_rng << 13;
+                    estado_rng ^= estado_rng >> 7;
+                    estado_rng ^= estado_rng << 17;
+                    cmd = MISTURA_CARGA[estado_rng % NUM_MISTURA_CARGA];
+                }
+                if (cfg->lote == 1) {
+                    strcpy(msg.command, NOMES_COMANDOS[cmd]);
+                } else {
+                    msg.lote[k] = (uint8_t)cmd;
+                }
+            }
+            msg.seq = proximo_seq++;
+            msg.t_envio_ns = now_ns();
+            feitas++;
+
+            int r = load_send(&msg, false);
+            if (r == 0) {
+                res->enviadas++;
+                continue;
+            }
+            if (r == EINTR) break;
+
+            res->eagain++;
+            if (cfg->descartar) {
+                res->descartadas++;
+                continue;
+            }
+            uint64_t t0 = now_ns();
+            if (load_send(&msg, true) != 0) break;
+            uint64_t dt = now_ns() - t0;
+            res->enviadas++;
+            res->bloqueio_ns += dt;
+            if (dt > res->bloqueio_max_ns) res->bloqueio_max_ns = dt;
+        }
+
+        if (registrado) load_collect_acks(res);
+
+        // Próxima rajada no prazo absoluto; atrasos não alteram o ritmo
+        if (intervalo_ns > 0) {
+            proximo_ns += intervalo_ns;
+            struct timespec ts = {
+                .tv_sec = (time_t)(proximo_ns / 1000000000ull),
+                .tv_nsec = (long)(proximo_ns % 1000000000ull),
+            };
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR &&
+                   !interrompido) {}
+        }
+    }
+    res->fim_ns = now_ns();
+
+    if (registrado) {
+        uint64_t limite = now_ns() + TEMPO_ENCERRAMENTO_MS * 1000000ull;
+        while (res->acks < res->enviadas && now_ns() < limite) {
+            load_collect_acks(res);
+            usleep(1000);
+        }
+        msg.seq = proximo_seq++;
+        strcpy(msg.command, NOMES_COMANDOS[CMD_DESCONECTAR]);
+        msg.lote_tamanho = 0;
+        load_send(&msg, true);
+    }
+}
+
+
+/**
+ * @brief Percentil aproximado pelo histograma em potências de 2.
+ *
+ * @return Limite superior (ns) da faixa que contém o percentil, limitado
+ *         ao máximo observado.
+ */
+uint64_t hist_percentile(const uint64_t hist[64], uint64_t total, double p, uint64_t max) {
+    uint64_t alvo = (uint64_t)(p * total + 0.5), acumulado = 0;
+    if (alvo == 0) alvo = 1;
+    for (int i = 0; i < 64; i++) {
+        acumulado += hist[i];
+        if (acumulado >= alvo) {
+            uint64_t limite = (i >= 63) ? UINT64_MAX : (1ull << (i + 1));
+            return limite < max ? limite : max;
+        }
+    }
+    return max;
+}
+
+
+/**
+ * @brief Executa o modo gerador de carga e imprime o relatório.
+ *
+ * Cria os processos remetentes com fork(); cada um escreve seu resultado
+ * em uma região anônima compartilhada, somada pelo processo pai ao final.
+ *
+ * @return 0 em caso de sucesso.
+ */
+int run_load(const ConfigCarga *cfg) {
+    size_t n_cmds = 0;
+    ComandoId *cmds = cfg->script ? load_script(cfg->script, &n_cmds) : NULL;
+    for (size_t i = 0; cfg->lote > 1 && i < n_cmds; i++) {
+        if (!comando_em_lote(cmds[i])) {
+            fprintf(stderr, "%s: \"%s\" não pode fazer parte de um lote\n", cfg->script,
+                    NOMES_COMANDOS[cmds[i]]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    ResultadoCarga *res = mmap(NULL, sizeof(ResultadoCarga) * cfg->processos,
+                               PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (res == MAP_FAILED) {
+        perror("Erro ao alocar resultados");
+        exit(EXIT_FAILURE);
+    }
+    memset(res, 0, sizeof(ResultadoCarga) * cfg->processos);
+
+    printf("==== GERADOR DE CARGA ====\n");
+    printf("Processos: %d, rajada: %d, lote: %d, taxa alvo: ", cfg->processos, cfg->rajada,
+           cfg->lote);
+    if (cfg->taxa > 0.0) printf("%.0f msgs/s", cfg->taxa);
+    else printf("sem limite");
+    if (cfg->total > 0) printf(", total: %ld mensagens", cfg->total);
+    else printf(", duração: %.1f s", cfg->duracao_s);
+    printf(", origem: %s, canal: %s, canal cheio: %s\n",
+           cfg->script ? cfg->script : "mistura sintética",
+           anel_cmd ? "anel de comandos" : "fila de mensagens",
+           cfg->descartar ? "descarta" : "bloqueia");
+    fflush(stdout);
+
+    pid_t filhos[MAX_PROCESSOS_CARGA];
+    for (int i = 0; i < cfg->processos; i++) {
+        filhos[i] = fork();
+        if (filhos[i] < 0) {
+            perror("Erro ao criar processo remetente");
+            exit(EXIT_FAILURE);
+        }
+        if (filhos[i] == 0) {
+            load_sender(i, cfg, cmds, n_cmds, &res[i]);
+            _exit(0);
+        }
+    }
+    for (int i = 0; i < cfg->processos; i++) {
+        while (waitpid(filhos[i], NULL, 0) < 0 && errno == EINTR) {}
+    }
+
+    // Consolidar
+    ResultadoCarga total = { .inicio_ns = UINT64_MAX };
+    printf("\n%-9s %12s %12s %10s %12s %12s %12s\n", "processo", "enviadas", "msgs/s",
+           "EAGAIN", "descartadas", "bloq_total", "bloq_max");
+    for (int i = 0; i < cfg->processos; i++) {
+        const ResultadoCarga *r = &res[i];
+        double dur = (r->fim_ns - r->inicio_ns) / 1e9;
+        printf("%-9d %12llu %12.0f %10llu %12llu %10.1fms %10.1fms\n", i,
+               (unsigned long long)r->enviadas, dur > 0 ? r->enviadas / dur : 0.0,
+               (unsigned long long)r->eagain, (unsigned long long)r->descartadas,
+               r->bloqueio_ns / 1e6, r->bloqueio_max_ns / 1e6);
+        total.enviadas += r->enviadas;
+        total.eagain += r->eagain;
+        total.descartadas += r->descartadas;
+        total.bloqueio_ns += r->bloqueio_ns;
+        if (r->bloqueio_max_ns > total.bloqueio_max_ns) total.bloqueio_max_ns = r->bloqueio_max_ns;
+        if (r->inicio_ns < total.inicio_ns) total.inicio_ns = r->inicio_ns;
+        if (r->fim_ns > total.fim_ns) total.fim_ns = r->fim_ns;
+        total.acks += r->acks;
+        total.recusadas += r->recusadas;
+        total.lat_total_ns += r->lat_total_ns;
+        if (r->lat_max_ns > total.lat_max_ns) total.lat_max_ns = r->lat_max_ns;
+        for (int b = 0; b < 64; b++) total.lat_hist[b] += r->lat_hist[b];
+    }
+    double dur = (total.fim_ns - total.inicio_ns) / 1e9;
+    printf("%-9s %12llu %12.0f %10llu %12llu %10.1fms %10.1fms\n", "total",
+           (unsigned long long)total.enviadas, dur > 0 ? total.enviadas / dur : 0.0,
+           (unsigned long long)total.eagain, (unsigned long long)total.descartadas,
+           total.bloqueio_ns / 1e6, total.bloqueio_max_ns / 1e6);
+
+    if (cfg->lote > 1) {
+        printf("\nComandos enviados: %llu (%d por mensagem)\n",
+               (unsigned long long)total.enviadas * cfg->lote, cfg->lote);
+    }
+
+    if (total.acks > 0) {
+        printf("\nConfirmações: %llu de %llu (%llu recusadas, %llu sem resposta)\n",
+               (unsigned long long)total.acks, (unsigned long long)total.enviadas,
+               (unsigned long long)total.recusadas,
+               (unsigned long long)(total.enviadas - total.acks));
+        printf("Latência ida e volta: média %.3f ms, p50 <= %.3f ms, p99 <= %.3f ms, "
+               "máx %.3f ms\n",
+               total.lat_total_ns / 1e6 / total.acks,
+               hist_percentile(total.lat_hist, total.acks, 0.50, total.lat_max_ns) / 1e6,
+               hist_percentile(total.lat_hist, total.acks, 0.99, total.lat_max_ns) / 1e6,
+               total.lat_max_ns / 1e6);
+    } else {
+        printf("\nSem confirmações do controlador (registro indisponível): latência não medida.\n");
+    }
+
+    struct msqid_ds info;
+    if (msgctl(msg_queue_id, IPC_STAT, &info) == 0) {
+        printf("\nFila ao final: %lu mensagens, %lu de %lu bytes\n",
+               (unsigned long)info.msg_qnum, (unsigned long)info.__msg_cbytes,
+               (unsigned long)info.msg_qbytes);
+    }
+
+    munmap(res, sizeof(ResultadoCarga) * cfg->processos);
+    free(cmds);
+    return 0;
+}
+
+
+/**
+ * @brief Exibe a ajuda da linha de comando.
+ */
+void print_usage(const char *prog) {
+    printf("Uso: %s [opções]\n", prog);
+    printf("Sem opções, abre o painel interativo.\n\n");
+    printf("Modo gerador de carga:\n");
+    printf("  -c, --carga              Envia comandos sem interação e mede a vazão\n");
+    printf("  -s, --script <arquivo>   Roteiro de comandos (número da opção ou texto\n");
+    printf("                           do comando, um por linha); padrão: mistura sintética\n");
+    printf("  -r, --taxa <msgs/s>      Taxa alvo somando os processos (0 = sem limite)\n");
+    printf("  -b, --rajada <n>         Mensagens enviadas em sequência por liberação (padrão 1)\n");
+    printf("  -P, --processos <n>      Processos remetentes (padrão 1, máximo %d)\n",
+           MAX_PROCESSOS_CARGA);
+    printf("  -d, --duracao <s>        Duração do teste (padrão 5 s)\n");
+    printf("  -n, --total <n>          Total de mensagens (substitui --duracao)\n");
+    printf("  -x, --descartar          Com a fila cheia, descarta em vez de bloquear\n");
+    printf("  -L, --lote <n>           Comandos por mensagem \"Lote\" (padrão 1, máximo %d)\n",
+           MAX_LOTE);
+    printf("\nOpções gerais:\n");
+    printf("  -A, --anel               Envia os comandos pelo anel de memória compartilhada\n");
+    printf("                           em vez da fila de mensagens (após o registro)\n");
+    printf("  -h, --help               Mostra esta ajuda\n");
+}
+
+
+/**
+ * @brief Consome as respostas até o "Encerrar" do controlador (ou até
+ *        TEMPO_ENCERRAMENTO_MS).
+ *
+ * @param fd_respostas pollfd do pipe de respostas.
+ */
+void wait_shutdown(struct pollfd fd_respostas) {
+    uint64_t limite = now_ns() + TEMPO_ENCERRAMENTO_MS * 1000000ull;
+    uint64_t agora;
+    while ((agora = now_ns()) < limite) {
+        int espera_ms = (int)((limite - agora) / 1000000ull) + 1;
+        if (poll(&fd_respostas, 1, espera_ms) <= 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        Message msg;
+        if (read(fd_respostas.fd, &msg, sizeof(msg)) != (ssize_t)sizeof(msg)) break;
+        if (strcmp(msg.command, "Encerrar") == 0) {
+            printf("Controlador encerrado.\n");
+            return;
+        }
+    }
 }
 
 
@@ -118,24 +1115,69 @@ void clear_input_buffer() {
  * Instala um tratador para o sinal SIGINT (Ctrl + C) e
  * cria ou acessa a fila de mensagens com a chave MSG_KEY.
  *
- * Então, o programa entra em um loop principal que verifica
- * constantemente se o controlador enviou uma mensagem de
- * encerramento (tipo 2). Se sim, o programa sai com status 0.
- *
- * Caso contrário, o programa mostra o menu de opções para o
- * usuário e lê a entrada do usuário. Se a entrada for inválida,
- * o programa descarta a entrada e volta para o início do loop.
+ * O painel é um loop de eventos sobre poll(): stdin e o pipe alimentado
+ * pela thread leitora das respostas do controlador. Assim, um
+ * "Encerrar" do controlador é tratado imediatamente, mesmo que o usuário
+ * não digite nada, e as atualizações de estado enviadas pelo controlador
+ * aparecem ao vivo na linha de status.
  *
- * Se a entrada for válida, o programa preenche a mensagem com o
- * tipo 1 (do Painel) e o comando escolhido pelo usuário, e
- * envia a mensagem para a fila de mensagens.
+ * Quando stdin é um terminal, cada tecla é um comando (sem Enter); caso
+ * contrário, o painel lê números, um por linha, como antes.
  *
  * O loop principal continua até que o usuário escolha a opção
- * 0 (Encerrar) ou o controlador envie uma mensagem de
- * encerramento.
+ * 0 (Encerrar), o controlador envie uma mensagem de encerramento ou a
+ * entrada termine.
+ *
+ * Com --carga (ou --script), o painel não é interativo: vira o gerador de
+ * carga usado nos testes de capacidade do controlador (ver run_load()).
  */
-int main() {
-    // Instalar o tratador de sinal SIGINT
+int main(int argc, char *argv[]) {
+    static const struct option opcoes[] = {
+        {"carga",     no_argument,       NULL, 'c'},
+        {"script",    required_argument, NULL, 's'},
+        {"taxa",      required_argument, NULL, 'r'},
+        {"rajada",    required_argument, NULL, 'b'},
+        {"processos", required_argument, NULL, 'P'},
+        {"duracao",   required_argument, NULL, 'd'},
+        {"total",     required_argument, NULL, 'n'},
+        {"descartar", no_argument,       NULL, 'x'},
+        {"lote",      required_argument, NULL, 'L'},
+        {"anel",      no_argument,       NULL, 'A'},
+        {"help",      no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+    ConfigCarga carga = { .taxa = 0.0, .rajada = 1, .processos = 1, .lote = 1, .duracao_s = 5.0 };
+    bool modo_carga = false, usar_anel = false;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "cs:r:b:P:d:n:xL:Ah", opcoes, NULL)) != -1) {
+        switch (opt) {
+        case 'c': modo_carga = true; break;
+        case 's': carga.script = optarg; modo_carga = true; break;
+        case 'r': carga.taxa = atof(optarg); break;
+        case 'b': carga.rajada = atoi(optarg); break;
+        case 'P': carga.processos = atoi(optarg); break;
+        case 'd': carga.duracao_s = atof(optarg); break;
+        case 'n': carga.total = atol(optarg); break;
+        case 'x': carga.descartar = true; break;
+        case 'L': carga.lote = atoi(optarg); break;
+        case 'A': usar_anel = true; break;
+        case 'h':
+            print_usage(argv[0]);
+            return 0;
+        default:
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (carga.taxa < 0.0 || carga.rajada < 1 || carga.processos < 1 ||
+        carga.lote < 1 || carga.lote > MAX_LOTE ||
+        carga.processos > MAX_PROCESSOS_CARGA || carga.duracao_s <= 0.0 || carga.total < 0) {
+        fprintf(stderr, "Parâmetros de carga inválidos\n");
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // Instalar o tratador de sinal SIGINT (sem SA_RESTART, para interromper o poll)
     struct sigaction sa;
     sa.sa_handler = sigint_handler;
     sa.sa_flags = 0;
@@ -152,90 +1194,119 @@ int main() {
         exit(EXIT_FAILURE);
     }
 
-    Message msg;
-    int option;
-    int scan_result;
+    if (usar_anel) {
+        anel_cmd = attach_command_ring();
+    }
 
-    // Loop principal
-    while (1) {
-        // Verificar se o controlador enviou uma mensagem de encerramento
-        // (tipo 2)
-        if (msgrcv(msg_queue_id, &msg, sizeof(msg) - sizeof(long), 2, IPC_NOWAIT) > 0) {
-            if (strcmp(msg.command, "Encerrar") == 0) {
-                printf("\nControlador solicitou encerramento. Encerrando Painel de Comando...\n");
-                return 0;
-            }
-        }
+    if (modo_carga) {
+        return run_load(&carga);
+    }
 
-        // Mostrar o menu e ler opção do usuário
-        display_menu();
+    setup_terminal();
 
-        // Ler a entrada do usuário e verificar o retorno de scanf
-        scan_result = scanf("%d", &option);
-        if (scan_result != 1) {
-            fprintf(stderr, "Entrada inválida. Por favor, insira um número.\n");
-            clear_input_buffer(); // Limpar o buffer de entrada
-            continue; // Voltar para o início do loop
+    // Registro: o painel interativo também assina o estado ao vivo
+    register_client(modo_tecla ? CMD_CONECTAR : CMD_REGISTRAR);
+
+    // Canal das respostas do controlador
+    if (pipe(pipe_respostas) < 0) {
+        perror("Erro ao criar pipe de respostas");
+        exit(EXIT_FAILURE);
+    }
+    pthread_t th_respostas;
+    if (pthread_create(&th_respostas, NULL, thread_respostas, NULL) != 0) {
+        perror("Erro ao criar thread de respostas");
+        exit(EXIT_FAILURE);
+    }
+    pthread_detach(th_respostas);
+    if (anel_cmd && registrado) {
+        pthread_t th_confirmacoes;
+        if (pthread_create(&th_confirmacoes, NULL, thread_confirmacoes, NULL) != 0) {
+            perror("Erro ao criar thread de confirmações");
+            exit(EXIT_FAILURE);
         }
+        pthread_detach(th_confirmacoes);
+    }
 
-        clear_input_buffer(); // Descartar o '\n' do buffer
+    display_menu();
 
-        // Preencher a mensagem com o tipo 1 (do Painel)
-        msg.msg_type = 1;
+    struct pollfd fds[2] = {
+        { .fd = STDIN_FILENO,      .events = POLLIN },
+        { .fd = pipe_respostas[0], .events = POLLIN },
+    };
+    char linha[256];          // Precisa ter 255 + 1 bytes (ver handle_lines)
+    size_t tam_linha = 0;
+    bool ativo = true;
 
-        switch (option) {
-        case 1:
-            strcpy(msg.command, "Ligar Seta Esquerda");
-            break;
-        case 2:
-            strcpy(msg.command, "Ligar Seta Direita");
-            break;
-        case 3:
-            strcpy(msg.command, "Ligar Pisca-Alerta");
-            break;
-        case 4:
-            strcpy(msg.command, "Ligar Farol Baixo");
-            break;
-        case 5:
-            strcpy(msg.command, "Ligar Farol Alto");
-            break;
-        case 6:
-            strcpy(msg.command, "Acionar Pedal do Acelerador");
-            break;
-        case 7:
-            strcpy(msg.command, "Acionar Pedal do Freio");
-            break;
-        case 8:
-            strcpy(msg.command, "Desligar Seta Esquerda");
-            break;
-        case 9:
-            strcpy(msg.command, "Desligar Seta Direita");
+    // Loop de eventos
+    while (ativo && !interrompido) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            perror("Erro no poll");
             break;
-        case 10:
-            strcpy(msg.command, "Desligar Pisca-Alerta");
-            break;
-        case 11:
-            strcpy(msg.command, "Desligar Farol Baixo");
-            break;
-        case 12:
-            strcpy(msg.command, "Desligar Farol Alto");
-            break;
-        case 13:
-            strcpy(msg.command, "Desligar Farol");
-            break;
-        case 0:
-            printf("Encerrando Painel de Comandos...\n");
-            printf("Encerrando controlador...\n\n");
-            strcpy(msg.command, "Encerrar");
-            send_message(msg);
-            return 0;
-        default:
-            printf("Opção inválida. Tente novamente.\n");
-            continue;
         }
 
-        // Enviar a mensagem com o comando escolhido
-        send_message(msg);
+        // Resposta do controlador
+        if (fds[1].revents & POLLIN) {
+            Message msg;
+            if (read(pipe_respostas[0], &msg, sizeof(msg)) == (ssize_t)sizeof(msg)) {
+                if (strcmp(msg.command, "Encerrar") == 0) {
+                    clear_status();
+                    printf("\nControlador solicitou encerramento. Encerrando Painel de Comando...\n");
+                    return 0;
+                }
+                if (strcmp(msg.command, "Estado") == 0) {
+                    ultimo_estado = msg.estado;
+                    tem_estado = true;
+                    draw_status();
+                }
+                if (strcmp(msg.command, "Ack") == 0) {
+                    ultima_latencia_ms = (now_ns() - msg.t_envio_ns) / 1e6;
+                    if (msg.status != RESULTADO_OK) {
+                        clear_status();
+                        printf("Comando #%u recusado pelo controlador (resultado %d)\n",
+                               msg.seq, (int)msg.status);
+                    }
+                    draw_status();
+                }
+            }
+        }
+
+        // Entrada do usuário
+        if (fds[0].revents & (POLLIN | POLLHUP)) {
+            ssize_t n = read(STDIN_FILENO, linha + tam_linha, sizeof(linha) - 1 - tam_linha);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                perror("Erro ao ler a entrada");
+                break;
+            }
+            if (n == 0) {
+                // Fim da entrada: sai sem encerrar o controlador
+                if (registrado) send_command(CMD_DESCONECTAR);
+                break;
+            }
+            if (modo_tecla) {
+                ativo = handle_keys(linha, n);
+            } else {
+                tam_linha += (size_t)n;
+                ativo = handle_lines(linha, &tam_linha);
+            }
+        }
+    }
+
+    if (interrompido) {
+        clear_status();
+        tem_estado = false;
+        printf("\nEncerrando via Ctrl + C...\n");
+
+        // Enviar o comando "Encerrar" para o controller
+        send_command(CMD_ENCERRAR);
+        encerrando = true;
+    }
+
+    // Aguarda o aviso de encerramento, para não deixar respostas deste
+    // cliente esquecidas na fila
+    if (encerrando && registrado) {
+        wait_shutdown(fds[1]);
     }
 
     return 0;
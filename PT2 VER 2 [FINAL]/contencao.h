@@ -0,0 +1,282 @@
+#ifndef CONTENCAO_H
+#define CONTENCAO_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+/*
+ * Perfil de contenção da trava dos dados compartilhados, por ponto de
+ * aquisição. Cada chamada de sync_lock() no controlador é um sítio,
+ * identificado por "função:linha", com o número de aquisições e dois
+ * histogramas: o tempo esperando a trava e o tempo com a trava (da
+ * aquisição à liberação).
+ *
+ * Os histogramas têm classes logarítmicas no estilo do HdrHistogram: 8
+ * classes por potência de 2, ou seja, erro relativo de no máximo 12,5% em
+ * qualquer escala, de nanossegundos a dezenas de segundos, com tamanho fixo.
+ *
+ * A tabela fica no segmento de estatísticas, para que o ctlstat mostre o
+ * ranking ao vivo. Os contadores usam atômicos relaxados: as threads de
+ * controle, das setas, do dash e de recarga podem passar pelo mesmo sítio.
+ */
+
+#define HIST_SUB_BITS 3                                 // log2 das classes por potência de 2
+#define HIST_SUB (1u << HIST_SUB_BITS)
+#define HIST_MAX_BITS 36                                // Até 2^36 ns (~68 s); acima disso cai na última classe
+#define HIST_CLASSES ((HIST_MAX_BITS - HIST_SUB_BITS + 2) << HIST_SUB_BITS)
+
+#define CONTENCAO_SITIOS_MAX 32    // Sítios por processo; o último acumula os excedentes
+#define CONTENCAO_NOME_MAX 48      // "função:linha" (com o '\0')
+
+// Um ponto de aquisição da trava
+typedef struct {
+    char nome[CONTENCAO_NOME_MAX];
+    _Atomic uint64_t aquisicoes;
+    _Atomic uint64_t espera_total_ns;
+    _Atomic uint64_t espera_max_ns;
+    _Atomic uint64_t posse_total_ns;
+    _Atomic uint64_t posse_max_ns;
+    _Atomic uint64_t espera[HIST_CLASSES];
+    _Atomic uint64_t posse[HIST_CLASSES];
+} __attribute__((aligned(64))) SitioContencao;
+
+// Sítios de um processo. Um sítio só passa a contar em `num` depois de o
+// nome estar escrito (release), então quem lê até `num` vê nomes completos.
+typedef struct {
+    char processo[16];                   // Nome do processo, para o ranking combinado
+    _Atomic uint32_t num;
+    SitioContencao sitios[CONTENCAO_SITIOS_MAX];
+} TabelaContencao;
+
+// Descritor estático de um ponto de aquisição, criado por PONTO_CONTENCAO()
+// no local da chamada. O slot na tabela é escolhido no primeiro uso.
+typedef struct {
+    SitioContencao *_Atomic sitio;
+    const char *funcao;
+    int linha;
+} PontoContencao;
+
+/**
+ * @brief Descritor do ponto de aquisição em que a macro é expandida.
+ *
+ * Usada dentro de macros como sync_lock(), para que cada chamada no código
+ * tenha o próprio sítio.
+ */
+#define PONTO_CONTENCAO() \
+    ({ static PontoContencao ponto_contencao_ = { NULL, __func__, __LINE__ }; &ponto_contencao_; })
+
+static pthread_mutex_t contencao_registro = PTHREAD_MUTEX_INITIALIZER;
+
+// Aquisição em andamento na thread corrente (a trava não é reentrante)
+static __thread SitioContencao *contencao_sitio_atual = NULL;
+static __thread uint64_t contencao_espera_ns = 0;
+static __thread uint64_t contencao_obtida_ns = 0;
+
+/**
+ * @brief Classe do histograma de um valor em nanossegundos.
+ */
+static inline uint32_t hist_classe(uint64_t v) {
+    if (v < HIST_SUB) return (uint32_t)v;
+    uint32_t msb = 63u - (uint32_t)__builtin_clzll(v);
+    uint32_t c = ((msb - HIST_SUB_BITS + 1) << HIST_SUB_BITS) |
+                 (uint32_t)((v >> (msb - HIST_SUB_BITS)) & (HIST_SUB - 1));
+    return c < HIST_CLASSES ? c : HIST_CLASSES - 1;
+}
+
+/**
+ * @brief Maior valor em nanossegundos que cai na classe @p c.
+ */
+static inline uint64_t hist_limite(uint32_t c) {
+    if (c < HIST_SUB) return c;
+    uint32_t k = c >> HIST_SUB_BITS;
+    uint64_t inicio = (uint64_t)(HIST_SUB + (c & (HIST_SUB - 1))) << (k - 1);
+    return inicio + (1ull << (k - 1)) - 1;
+}
+
+/**
+ * @brief Inicializa uma tabela recém-criada (zerada) com o nome do processo.
+ */
+static inline void contencao_iniciar(TabelaContencao *t, const char *processo) {
+    snprintf(t->processo, sizeof(t->processo), "%s", processo);
+    atomic_store_explicit(&t->num, 0, memory_order_release);
+}
+
+/**
+ * @brief Slot de um ponto de aquisição, registrado no primeiro uso.
+ *
+ * @param t Tabela do processo (NULL se ainda não existe: nada é registrado).
+ * @param p Descritor do ponto.
+ * @return O sítio, ou NULL sem tabela.
+ */
+static inline SitioContencao *contencao_sitio(TabelaContencao *t, PontoContencao *p) {
+    SitioContencao *s = atomic_load_explicit(&p->sitio, memory_order_acquire);
+    if (s != NULL || t == NULL) return s;
+
+    pthread_mutex_lock(&contencao_registro);
+    s = atomic_load_explicit(&p->sitio, memory_order_relaxed);
+    if (s == NULL) {
+        uint32_t n = atomic_load_explicit(&t->num, memory_order_relaxed);
+        if (n < CONTENCAO_SITIOS_MAX - 1) {
+            s = &t->sitios[n];
+            snprintf(s->nome, sizeof(s->nome), "%s:%d", p->funcao, p->linha);
+            atomic_store_explicit(&t->num, n + 1, memory_order_release);
+        } else {
+            s = &t->sitios[CONTENCAO_SITIOS_MAX - 1];
+            if (n < CONTENCAO_SITIOS_MAX) {
+                snprintf(s->nome, sizeof(s->nome), "(demais)");
+                atomic_store_explicit(&t->num, CONTENCAO_SITIOS_MAX, memory_order_release);
+            }
+        }
+        atomic_store_explicit(&p->sitio, s, memory_order_release);
+    }
+    pthread_mutex_unlock(&contencao_registro);
+    return s;
+}
+
+/**
+ * @brief Atualiza um máximo compartilhado entre threads.
+ */
+static inline void contencao_max(_Atomic uint64_t *max, uint64_t v) {
+    uint64_t atual = atomic_load_explicit(max, memory_order_relaxed);
+    while (v > atual &&
+           !atomic_compare_exchange_weak_explicit(max, &atual, v, memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+    }
+}
+
+/**
+ * @brief Marca a trava como obtida pela thread corrente.
+ *
+ * Só guarda os instantes; os contadores são atualizados em
+ * contencao_saiu(), depois de liberar a trava, para não alongar a seção
+ * crítica.
+ *
+ * @param s Sítio da aquisição (NULL: não contabiliza).
+ * @param espera_ns Tempo esperando a trava.
+ * @param obtida_ns Instante em que a trava foi obtida.
+ */
+static inline void contencao_entrou(SitioContencao *s, uint64_t espera_ns, uint64_t obtida_ns) {
+    contencao_sitio_atual = s;
+    contencao_espera_ns = espera_ns;
+    contencao_obtida_ns = obtida_ns;
+}
+
+/**
+ * @brief Contabiliza a aquisição da thread corrente, já com a trava liberada.
+ *
+ * @param liberada_ns Instante tomado imediatamente antes de liberar a trava.
+ */
+static inline void contencao_saiu(uint64_t liberada_ns) {
+    SitioContencao *s = contencao_sitio_atual;
+    if (s == NULL) return;
+    contencao_sitio_atual = NULL;
+    uint64_t posse = liberada_ns - contencao_obtida_ns;
+
+    atomic_fetch_add_explicit(&s->aquisicoes, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s->espera_total_ns, contencao_espera_ns, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s->posse_total_ns, posse, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s->espera[hist_classe(contencao_espera_ns)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s->posse[hist_classe(posse)], 1, memory_order_relaxed);
+    contencao_max(&s->espera_max_ns, contencao_espera_ns);
+    contencao_max(&s->posse_max_ns, posse);
+}
+
+/**
+ * @brief Percentil de um histograma, em nanossegundos (limite superior da classe).
+ *
+ * @param hist Histograma publicado.
+ * @param max Maior valor observado (limita a última classe).
+ * @param q Fração entre 0 e 1.
+ */
+static inline uint64_t contencao_percentil(const _Atomic uint64_t *hist, uint64_t max, double q) {
+    uint64_t total = 0;
+    for (uint32_t c = 0; c < HIST_CLASSES; c++) {
+        total += atomic_load_explicit((_Atomic uint64_t *)&hist[c], memory_order_relaxed);
+    }
+    if (total == 0) return 0;
+
+    uint64_t alvo = (uint64_t)(q * (double)total);
+    if (alvo == 0) alvo = 1;
+    uint64_t acumulado = 0;
+    for (uint32_t c = 0; c < HIST_CLASSES; c++) {
+        acumulado += atomic_load_explicit((_Atomic uint64_t *)&hist[c], memory_order_relaxed);
+        if (acumulado >= alvo) {
+            uint64_t limite = hist_limite(c);
+            return limite < max ? limite : max;
+        }
+    }
+    return max;
+}
+
+// Sítio no ranking combinado
+typedef struct {
+    const char *processo;
+    const SitioContencao *sitio;
+    uint64_t espera_total_ns;
+} EntradaContencao;
+
+/**
+ * @brief Ordena pelo tempo total de espera, do maior para o menor.
+ */
+static inline int contencao_comparar(const void *a, const void *b) {
+    uint64_t ea = ((const EntradaContencao *)a)->espera_total_ns;
+    uint64_t eb = ((const EntradaContencao *)b)->espera_total_ns;
+    return (ea < eb) - (ea > eb);
+}
+
+/**
+ * @brief Imprime os sítios de uma ou mais tabelas, ordenados pelo tempo total
+ *        de espera.
+ *
+ * @param f Destino.
+ * @param tabelas Tabelas publicadas (entradas NULL são ignoradas).
+ * @param num_tabelas Quantidade de tabelas.
+ */
+static inline void contencao_relatorio(FILE *f, const TabelaContencao *const *tabelas, int num_tabelas) {
+    EntradaContencao entradas[num_tabelas * CONTENCAO_SITIOS_MAX + 1];
+    int n = 0;
+    for (int t = 0; t < num_tabelas; t++) {
+        if (tabelas[t] == NULL) continue;
+        uint32_t num = atomic_load_explicit((_Atomic uint32_t *)&tabelas[t]->num, memory_order_acquire);
+        if (num > CONTENCAO_SITIOS_MAX) num = CONTENCAO_SITIOS_MAX;
+        for (uint32_t i = 0; i < num; i++) {
+            const SitioContencao *s = &tabelas[t]->sitios[i];
+            entradas[n].processo = tabelas[t]->processo;
+            entradas[n].sitio = s;
+            entradas[n].espera_total_ns = atomic_load_explicit((_Atomic uint64_t *)&s->espera_total_ns,
+                                                               memory_order_relaxed);
+            n++;
+        }
+    }
+    if (n == 0) {
+        fprintf(f, "Contenção da trava: nenhuma aquisição registrada\n");
+        return;
+    }
+    qsort(entradas, (size_t)n, sizeof(entradas[0]), contencao_comparar);
+
+    fprintf(f, "%-10s %-30s %10s %11s | %9s %9s %9s | %9s %9s %9s\n",
+            "processo", "sitio", "aquisicoes", "espera(ms)",
+            "esp.p50", "esp.p99", "esp.max", "posse.p50", "posse.p99", "posse.max");
+    for (int i = 0; i < n; i++) {
+        const SitioContencao *s = entradas[i].sitio;
+        uint64_t espera_max = atomic_load_explicit((_Atomic uint64_t *)&s->espera_max_ns, memory_order_relaxed);
+        uint64_t posse_max = atomic_load_explicit((_Atomic uint64_t *)&s->posse_max_ns, memory_order_relaxed);
+        fprintf(f, "%-10s %-30s %10llu %11.3f | %7.1fus %7.1fus %7.1fus | %7.1fus %7.1fus %7.1fus\n",
+                entradas[i].processo, s->nome,
+                (unsigned long long)atomic_load_explicit((_Atomic uint64_t *)&s->aquisicoes,
+                                                         memory_order_relaxed),
+                entradas[i].espera_total_ns / 1e6,
+                contencao_percentil(s->espera, espera_max, 0.50) / 1e3,
+                contencao_percentil(s->espera, espera_max, 0.99) / 1e3,
+                espera_max / 1e3,
+                contencao_percentil(s->posse, posse_max, 0.50) / 1e3,
+                contencao_percentil(s->posse, posse_max, 0.99) / 1e3,
+                posse_max / 1e3);
+    }
+}
+
+#endif // CONTENCAO_H
@@ -1,3 +1,5 @@
+#define _GNU_SOURCE // pthread_setaffinity_np, pthread_setattr_default_np
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <signal.h>
@@ -6,22 +8,35 @@
 #include <sys/shm.h>
 #include <sys/msg.h>
 #include <sys/types.h>
-#include <semaphore.h>
 #include <fcntl.h>
 #include <string.h>
 #include <pthread.h>
 #include <stdbool.h>
 #include <math.h>
 #include <time.h>
+#include <stdint.h>
+#include <errno.h>
+#include <getopt.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <semaphore.h>
+
+#include "ipc_shared.h"
+#include "difusao.h"
+#include "anel_comandos.h"
+#include "trava_robusta.h"
+#include "caixa_preta.h"
+#include "agregados.h"
+#include "perfil_limitador.h"
+#include "rastreio.h"
 
 // >>> Adicionados para GPIO e PWM <<<
 #include <wiringPi.h>
 #include <softPwm.h>
 
-// Definições de chaves IPC
+// Definições de chaves IPC (MSG_KEY e SHM_KEY_STATS em ipc_shared.h)
 #define SHM_KEY_SENSORS 1234
 #define SHM_KEY_TRIGGERS 4321
-#define MSG_KEY 5678
 
 // Definições de pinos para os componentes
 
@@ -66,11 +81,87 @@
 #define MAX_TEMP_MOTOR 140
 #define BASE_TEMP 80
 
-// Estrutura para os dados dos sensores
+// Detector de superaquecimento (tendência da temperatura)
+#define TEMP_ALFA 0.2                 // Suavização do nível (EWMA)
+#define TEMP_BETA 0.05                // Suavização da inclinação
+#define TEMP_GAMA 0.05                // Suavização da variância do erro de previsão
+#define TEMP_ANOMALIA_SIGMAS 4.0      // Erro de previsão que caracteriza uma anomalia
+#define TEMP_DESVIO_MIN 0.5           // Desvio mínimo considerado (°C)
+#define LIMIAR_ATENCAO_C 125.0        // Nível que por si só gera atenção
+#define LIMIAR_ALERTA_C 132.0         // Nível que por si só gera alerta
+#define HORIZONTE_ATENCAO_S 20.0      // Projeção até MAX_TEMP_MOTOR que gera atenção
+#define HORIZONTE_ALERTA_S 8.0        // Projeção até MAX_TEMP_MOTOR que gera alerta
+#define LIMIAR_PROJECAO_C 105.0       // Abaixo disso a projeção não gera aviso (aquecimento normal)
+#define TEMP_HISTERESE 3.0            // Folga (°C, e 50% no horizonte) para sair de um nível
+#define TEMP_PERMANENCIA_NS 2000000000ull // Tempo mínimo em um nível antes de baixá-lo
+#define TETO_DUTY_ATENCAO 7           // Duty máximo do motor em atenção
+#define TETO_DUTY_ALERTA 4            // Duty máximo do motor em alerta
+#define PISCA_ALERTA_NS 250000000ull  // Luz de temperatura piscando em alerta
+
+// Períodos padrão das tarefas do escalonador (ms)
+#define PERIODO_COLETA_MS 1           // Coleta de pulsos (1 kHz)
+#define PERIODO_LIMITADOR_MS 10       // Limitadores (100 Hz)
+#define PERIODO_TEMPERATURA_MS 100    // Temperatura (10 Hz)
+#define PERIODO_PUBLICACAO_MS 10      // Memória compartilhada (100 Hz)
+#define PERIODO_COMANDOS_MS 10        // Fila de mensagens (100 Hz)
+#define PERIODO_EXIBICAO_MS 500       // Console (2 Hz)
+#define PERIODO_CLIENTES_MS 100       // Estado enviado aos clientes (10 Hz)
+#define PERIODO_AGREGADOS_MS 100      // Estatísticas das janelas deslizantes (10 Hz)
+#define PERIODO_MIN_MS 1              // Menor período aceito
+#define INTERVALO_INTERVENCAO_MS 2000 // Mínimo entre duas intervenções dos limitadores
+                                      // (o ritmo do loop original)
+#define COMANDOS_POR_ATIVACAO 16      // Máximo de mensagens por ativação
+
+// Vigia de prazos
+#define PRAZO_CONTROLE_MS 50          // Folga padrão de cada thread supervisionada
+#define PRAZO_SETAS_MS 100
+#define PRAZO_DASH_MS 100
+#define VIGIA_PERIODO_MS 5            // Intervalo entre as conferências do vigia
+#define VIGIA_SEGURO_PRAZOS 1         // Folgas além do limite até o estado seguro
+#define VIGIA_ENCERRAR_PRAZOS 10      // Folgas além do limite até o encerramento
+#define VIGIA_SAIDA_MS 1000           // Tempo com todas as threads em dia para deixar o estado seguro
+#define VIGIA_GRACA_MS 2000           // Espera pelo encerramento normal antes de forçar a saída
+
+// Janela deslizante das medições dos sensores Hall
+#define JANELA_CALIBRACAO_S 2.0       // Janela em que as constantes empíricas
+                                      // de RPM/velocidade foram levantadas
+#define JANELA_MEDICAO_S 0.25         // Duração da janela deslizante
+#define JANELA_SLOTS 1024             // Coletas guardadas (>= janela / período)
+
+#define SENSORES_MAGIC  0x53454E53u  // "SENS"
+#define SENSORES_VERSAO 1
+
+// Cliente registrado (painel, gerador de carga)
 typedef struct {
+    pid_t pid;
+    bool estado;             // Recebe o estado do veículo a cada 100 ms
+} Cliente;
+
+// Estrutura para os dados dos sensores. A trava embutida protege estes
+// campos e o status dos acionadores, entre threads e processos.
+//
+// Além dos sensores, o segmento guarda o que um controlador reiniciado
+// com --warm precisa para continuar de onde o anterior parou: o estado
+// dos atuadores e os clientes registrados. O cabeçalho só é publicado
+// depois da inicialização e é conferido antes de o estado ser adotado.
+typedef struct {
+    uint32_t magic;          // SENSORES_MAGIC depois da inicialização
+    uint32_t versao;         // SENSORES_VERSAO
+    int32_t pid;             // PID do controlador que inicializou ou adotou
+    uint32_t reinicios;      // Reinícios a quente que adotaram o segmento
     float velocidade; 
     float rpm;          
     float temperatura;
+    TravaCompartilhada trava;
+
+    // Estado do controlador, atualizado pela tarefa de publicação e pelo
+    // registro de clientes
+    int32_t motor_duty;
+    int32_t freio_duty;
+    char direcao;            // Última direção do motor ('D', 'R', 'B', 'N')
+    bool legado_ativo;
+    int32_t num_clientes;
+    Cliente clientes[MAX_CLIENTES];
 } SensorData;
 
 // Estrutura para o status dos acionadores
@@ -79,40 +170,161 @@ typedef struct {
     bool farol_baixo, farol_alto;
 } Status_trigg;
 
-// Estrutura para mensagens do painel
-typedef struct {
-    long msg_type;
-    char command[100];
-} Message;
-
 // Variáveis globais
 SensorData *shared_data;      
 Status_trigg *status_trigg;
 int shm_id_sensors, shm_id_triggers;
 int msg_queue_id;
-sem_t *sem_sync;
 volatile sig_atomic_t running = 1; 
+volatile sig_atomic_t alternar_pausa = 0; // SIGUSR1 recebidos (lidos pela thread de controle)
+static bool reinicio_quente = false;  // --warm: adota o estado deixado por outro controlador
+static bool preservar_estado = false; // --preservar: mantém os segmentos ao encerrar
+
+// Clientes registrados (painéis, geradores de carga). A fila legada
+// (MSG_TIPO_COMANDO) é atendida como uma fonte a mais no rodízio.
+static Cliente clientes[MAX_CLIENTES];
+static int num_clientes = 0;
+static int rodizio = 0;            // Próxima fonte a ser atendida
+static bool legado_ativo = false;  // Já houve comando sem registro (tipo 1)
 
 // Variáveis para PWM e Contadores
-static int motorDuty = 0;   // Duty cycle motor (0-10)
+// Saída do motor: o duty (0-10) e, no bit MOTOR_SEGURO, o estado seguro do
+// vigia, na mesma palavra atômica para que uma escrita do duty nunca passe
+// por cima do estado seguro (ver motor_write())
+#define MOTOR_SEGURO 0x80000000u
+static _Atomic uint32_t motor_saida = 0;
 static int freioDuty = 0;   // Duty cycle freio (0-10)
+static char direcaoMotor = 'N'; // Última direção escrita nos pinos do motor
 
-// Tempo de referência
-struct timespec ultimoTempoMotor;
-struct timespec ultimoTempoRoda_a;
-struct timespec ultimoTempoRoda_b;
+// Janela deslizante de pulsos de um sensor Hall: cada slot guarda os
+// pulsos lidos em uma coleta e o instante dessa coleta
+typedef struct {
+    uint64_t t_ns[JANELA_SLOTS];
+    uint32_t pulsos[JANELA_SLOTS];
+    unsigned int inicio, quantidade;
+    uint64_t soma;           // Pulsos dentro da janela
+    uint64_t t_base_ns;      // Instante em que a janela começa
+    uint64_t t_ultimo_ns;    // Instante da coleta mais recente
+} JanelaPulsos;
+
+static JanelaPulsos janelaMotor, janelaRoda_a, janelaRoda_b;
+
+// Estado da lei de controle, compartilhado apenas entre as tarefas da
+// thread de controle (não precisa da trava)
+typedef struct {
+    float velocidade;
+    float rpm;
+    float temperatura;
+} EstadoControle;
+
+static EstadoControle estado = { 0.0, 800.0, 0.0 };
+
+// Detector de superaquecimento: nível e inclinação suavizados da
+// temperatura (método de Holt), projeção do tempo até MAX_TEMP_MOTOR e
+// nível de aviso. Atualizado pela tarefa de temperatura e aplicado pelos
+// limitadores, ambos na thread de controle.
+typedef struct {
+    bool iniciado;
+    uint64_t t_ns;           // Amostra anterior
+    double nivel;            // °C
+    double tendencia;        // °C/s
+    double var_residuo;      // EWMA do quadrado do erro de previsão
+    double ate_limite_s;     // INFINITY se a temperatura não está subindo
+    NivelTemp aviso;         // TEMP_NORMAL, TEMP_ATENCAO ou TEMP_ALERTA
+    uint64_t aviso_desde_ns; // Última entrada ou confirmação do nível
+} DetectorTemp;
+
+static DetectorTemp detector_temp;
+
+// Estatísticas de 1 s, 10 s e 60 s dos sensores, alimentadas pela tarefa
+// de coleta e publicadas em stats->agregados
+static Agregador agregador;
+
+// Tarefa periódica do escalonador multi-taxa
+typedef struct {
+    TarefaId id;
+    void (*executar)(void);
+    uint32_t periodo_ms;
+    uint64_t proximo_ns;     // Próxima liberação (fase fixa)
+    bool controle;           // Congela quando a execução está pausada
+} Tarefa;
+
+// Estado de execução das tarefas de controle. Só a thread de controle o
+// altera (comandos e SIGUSR1 são tratados nela); o ctlstat o lê em
+// stats->execucao.
+static EstadoExecucao execucao = EXEC_RODANDO;
+static uint32_t passos_pendentes = 0;     // Ciclos liberados no estado EXEC_PASSO
+static sig_atomic_t pausas_tratadas = 0;  // SIGUSR1 já convertidos em transição
+
+static uint32_t periodo_tarefa_ms[TAREFA_NUM] = {
+    PERIODO_COLETA_MS, PERIODO_LIMITADOR_MS, PERIODO_TEMPERATURA_MS,
+    PERIODO_PUBLICACAO_MS, PERIODO_COMANDOS_MS, PERIODO_EXIBICAO_MS,
+    PERIODO_CLIENTES_MS, PERIODO_AGREGADOS_MS,
+};
 
 // Contadores para sensor Hall (RPM, velocidade)
 static volatile unsigned long motorPulsos = 0;  
 static volatile unsigned long rodaPulsos_a = 0;
 static volatile unsigned long rodaPulsos_b = 0;   
 
-// Contadores para relatório de acionamentos
-int cont_vel_sup = 0;
-int cont_vel_inf = 0;
-int cont_rpm_sup = 0;
-int cont_rpm_inf = 0;
-int cont_max_temp = 0;
+// Estatísticas publicadas em memória compartilhada (contadores do relatório,
+// iterações, comandos, fila e espera pela trava)
+ControllerStats *stats;
+int shm_id_stats = -1;
+static __thread ThreadStats *stats_thread = NULL; // Slot da thread corrente
+
+// Anel de difusão do estado do veículo (leitores não usam a trava)
+AnelDifusao *difusao;
+int shm_id_difusao = -1;
+static EstadoPainel estado_publicado;   // Última publicação (thread de controle)
+
+// Anel de comandos (alternativa à fila de mensagens, opção --anel do painel)
+AnelComandos *anel_cmd;
+int shm_id_anel_cmd = -1;
+
+// Caixa-preta: amostras, comandos e alertas dos últimos segundos em um
+// arquivo mapeado (NULL com --sem-caixa-preta). Só a thread de controle grava.
+static CaixaPreta *caixa = NULL;
+static const char *arquivo_caixa = CAIXA_ARQUIVO_PADRAO;
+
+// Perfil dos limitadores: lido de --limites e recarregado com SIGHUP pela
+// thread de recarga; a tarefa dos limitadores lê o perfil publicado sem trava
+static PublicacaoPerfil perfil;
+static TabelaContadores contadores_regras;   // Disparos por regra (relatório)
+// Por contador de regra: contador das estatísticas e alerta da caixa-preta
+// correspondentes (os cinco limitadores originais)
+static _Atomic uint64_t *estatistica_regra[REGRAS_MAX * 2];
+static AlertaCaixa alerta_regra[REGRAS_MAX * 2];
+static const char *arquivo_perfil = NULL;
+static sem_t sem_recarga;              // Postado pelo handler de SIGHUP
+
+// Perfil de tempo real (opcional, habilitado com --rt <arquivo>)
+#define RT_PWM STATS_NUM_THREADS          // Threads criadas pela WiringPi (PWM/ISR)
+#define RT_NUM_THREADS (STATS_NUM_THREADS + 1)
+#define RT_STACK_SIZE (256 * 1024)        // Pilha das threads no modo tempo real
+#define RT_STACK_PREFAULT (64 * 1024)     // Porção da pilha tocada antecipadamente
+
+typedef struct {
+    int prioridade; // Prioridade SCHED_FIFO (0 = manter o escalonador padrão)
+    int cpu;        // CPU fixa (-1 = sem afinidade)
+} RtThreadConfig;
+
+static bool rt_ativo = false;
+
+// Sem saída periódica no console (--headless): o estado é acompanhado pelo
+// dashboard, que lê o anel de difusão
+static bool sem_console = false;
+static RtThreadConfig rt_config[RT_NUM_THREADS];
+
+// Vigia de prazos (--vigia, --prazo). Cada thread supervisionada renova o
+// próprio limite a cada espera periódica; a thread do vigia confere os
+// limites e escala as perdas até o nível configurado.
+static NivelVigia vigia_escalada = VIGIA_SEGURO;
+static uint32_t prazo_thread_ms[VIGIA_NUM_THREADS] = {
+    PRAZO_CONTROLE_MS, PRAZO_SETAS_MS, PRAZO_SETAS_MS, PRAZO_DASH_MS,
+};
+static atomic_bool controle_encerrado = false;  // process_control terminou
+static __thread VigiaThreadStats *vigia_thread = NULL; // Slot da thread corrente, se supervisionada
 
 
 /**
@@ -121,7 +333,7 @@ int cont_max_temp = 0;
  * Incrementa o contador de pulsos do motor.
  */
 void motor_hall_callback(void) {
-    motorPulsos++;
+    __atomic_fetch_add(&motorPulsos, 1, __ATOMIC_RELAXED);
 }
 /**
  * @brief Função callback para o sensor Hall da roda A.
@@ -129,7 +341,7 @@ void motor_hall_callback(void) {
  * Incrementa o contador de pulsos da roda A.
  */
 void roda_a_hall_callback(void) {
-    rodaPulsos_a++;
+    __atomic_fetch_add(&rodaPulsos_a, 1, __ATOMIC_RELAXED);
 }
 /**
  * @brief Fun o callback para o sensor Hall da roda B.
@@ -137,48 +349,41 @@ void roda_a_hall_callback(void) {
  * Incrementa o contador de pulsos da roda B.
  */
 void roda_b_hall_callback(void) {
-    rodaPulsos_b++;
+    __atomic_fetch_add(&rodaPulsos_b, 1, __ATOMIC_RELAXED);
 }
 
 /**
  * @brief Função callback para tratar sinais recebidos pelo programa.
  * 
- * Trata os sinais SIGUSR1, SIGUSR2 e SIGINT.
+ * Trata os sinais SIGUSR1, SIGUSR2, SIGINT e SIGHUP.
  * 
- * Se o sinal for SIGUSR1, pausa o loop principal do programa.
+ * Se o sinal for SIGUSR1, pausa ou retoma as tarefas de controle. O
+ * handler apenas conta o sinal; a transição é feita pela thread de
+ * controle (ver run_state_poll_signal()).
  * Se o sinal for SIGUSR2 ou SIGINT, envia uma mensagem "Encerrar" para o
  * Painel de Comando e sinaliza para encerrar o programa.
+ * Se o sinal for SIGHUP, acorda a thread que recarrega o perfil dos
+ * limitadores.
  * 
  * @note Essa função foi incrementada com relação ao trabalho 1, com a inclusão
  * do tratamento do sinal SIGINT.
  */
 void signal_handler(int signal) {
     if (signal == SIGUSR1) {
-        printf("Teste pausado (SIGUSR1)\n");
-        sem_wait(sem_sync); 
+        alternar_pausa++;
     } else if (signal == SIGUSR2) {
         printf("Encerrando o programa (SIGUSR2)\n");
         
-        // Enviar mensagem "Encerrar" ao Painel de Comando
-        Message msg;
-        msg.msg_type = 2; 
-        strcpy(msg.command, "Encerrar");
-        if (msgsnd(msg_queue_id, &msg, sizeof(msg) - sizeof(long), 0) < 0) {
-            perror("Erro ao enviar mensagem de encerramento para o Painel");
-        }
+        // O "Encerrar" aos painéis é enviado por broadcast_shutdown(),
+        // depois que o loop termina
         running = 0; // Sinaliza para encerrar
     } else if (signal == SIGINT) {
         printf("\nRecebido Ctrl + C (SIGINT). Encerrando...\n");
-        
-        // Enviar "Encerrar" ao painel também
-        Message msg;
-        msg.msg_type = 2;
-        strcpy(msg.command, "Encerrar");
-        if (msgsnd(msg_queue_id, &msg, sizeof(msg) - sizeof(long), 0) < 0) {
-            perror("Erro ao enviar mensagem de encerramento para o Painel");
-        }
-
         running = 0;
+    } else if (signal == SIGHUP) {
+        sem_post(&sem_recarga); // Recarga feita por threadRecargaPerfil
+    } else if (signal == SIGPROF) {
+        rastreio_pedir_exportacao(); // Exportação feita pela thread do rastreio
     }
     
 }
@@ -186,17 +391,23 @@ void signal_handler(int signal) {
 /**
  * @brief Instala os handlers para os sinais SIGUSR1, SIGUSR2 e SIGINT.
  *
- * SIGUSR1: Pausa o loop principal do programa. O programa pode ser
- *          retomado com um sinal SIGUSR1.
+ * SIGUSR1: Pausa as tarefas de controle. A execução é retomada com
+ *          outro SIGUSR1 (ou com o comando "Retomar").
  * SIGUSR2: Encerra o programa. O painel de comando também recebe uma
  *          mensagem de encerramento.
  * SIGINT: Encerra o programa. O painel de comando também recebe uma
  *         mensagem de encerramento.
+ * SIGHUP: Relê o arquivo do perfil dos limitadores (--limites).
+ * SIGPROF: Exporta o rastreio das threads (--rastreio).
  * 
  * @note Essa função foi incrementada com relação ao trabalho 1, com a inclusão
  * do tratamento do sinal SIGINT.
  */
 void setup_signals() {
+    if (sem_init(&sem_recarga, 0, 0) == -1) {
+        perror("Erro ao criar o semáforo de recarga do perfil");
+        exit(EXIT_FAILURE);
+    }
     struct sigaction sa;
     sa.sa_handler = signal_handler;
     sa.sa_flags = SA_RESTART;
@@ -213,17 +424,166 @@ void setup_signals() {
         perror("Erro ao ativar handler SIGINT");
         exit(EXIT_FAILURE);
     }
+    if (sigaction(SIGHUP, &sa, NULL) == -1) {
+        perror("Erro ao ativar handler SIGHUP");
+        exit(EXIT_FAILURE);
+    }
+    if (sigaction(SIGPROF, &sa, NULL) == -1) {
+        perror("Erro ao ativar handler SIGPROF");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * @brief Traz os dados compartilhados de volta às faixas válidas.
+ *
+ * Chamada com a trava já tomada. Leituras dos sensores fora de faixa voltam
+ * aos valores iniciais (a próxima coleta dos sensores Hall as corrige), os
+ * duties e o número de clientes são limitados e os acionadores são
+ * normalizados para true/false.
+ */
+void sanitize_shared_state() {
+    if (!isfinite(shared_data->velocidade) || shared_data->velocidade < 0.0f) {
+        shared_data->velocidade = 0.0f;
+    }
+    if (!isfinite(shared_data->rpm) || shared_data->rpm < 0.0f) {
+        shared_data->rpm = 800.0f;
+    }
+    if (!isfinite(shared_data->temperatura)) {
+        shared_data->temperatura = 0.0f;
+    }
+    if (shared_data->motor_duty < 0 || shared_data->motor_duty > 10) shared_data->motor_duty = 0;
+    if (shared_data->freio_duty < 0 || shared_data->freio_duty > 10) shared_data->freio_duty = 0;
+    if (!strchr("DRBN", shared_data->direcao) || shared_data->direcao == '\0') {
+        shared_data->direcao = 'N';
+    }
+    if (shared_data->num_clientes < 0 || shared_data->num_clientes > MAX_CLIENTES) {
+        shared_data->num_clientes = 0;
+    }
+
+    // Um bool com outro byte que não 0/1 é comportamento indefinido
+    uint8_t *bytes = (uint8_t *)status_trigg;
+    for (size_t i = 0; i < sizeof(Status_trigg); i++) bytes[i] = bytes[i] != 0;
+    bytes = (uint8_t *)&shared_data->legado_ativo;
+    *bytes = *bytes != 0;
+}
+
+/**
+ * @brief Revalida os dados compartilhados deixados por um dono morto da trava.
+ *
+ * Chamada com a trava já tomada (callback de trava_lock()).
+ */
+void revalidate_shared_state() {
+    fprintf(stderr, "Aviso: dono da trava morreu na seção crítica; revalidando os dados\n");
+    sanitize_shared_state();
+}
+
+/**
+ * @brief Anexa um segmento já existente, conferindo o tamanho.
+ *
+ * @param chave Chave do segmento.
+ * @param tamanho Tamanho esperado (o do layout compilado).
+ * @param shm_id Recebe o ID do segmento.
+ * @return Endereço do segmento, ou NULL se ele não existe ou tem outro tamanho.
+ */
+void *attach_existing_segment(key_t chave, size_t tamanho, int *shm_id) {
+    int id = shmget(chave, 0, 0);
+    if (id < 0) return NULL;
+    struct shmid_ds info;
+    if (shmctl(id, IPC_STAT, &info) < 0 || info.shm_segsz != tamanho) return NULL;
+    void *p = shmat(id, NULL, 0);
+    if (p == (void *)-1) return NULL;
+    *shm_id = id;
+    return p;
+}
+
+/**
+ * @brief Adota sensores, acionadores, atuadores e clientes deixados por um
+ *        controlador anterior (--warm).
+ *
+ * Os dois segmentos precisam existir com o tamanho deste executável e o
+ * cabeçalho dos sensores precisa ter o magic e a versão atuais. O duty do
+ * motor e do freio, a direção e a tabela de clientes voltam para as
+ * variáveis locais; as saídas físicas são reescritas depois de init_gpio()
+ * (ver restore_outputs()). Se o controlador anterior morreu com a trava,
+ * ela é recuperada aqui. Os valores passam sempre pelas mesmas faixas da
+ * revalidação antes de serem adotados: o segmento é gravável por todos.
+ *
+ * @return true se o estado foi adotado; false para seguir com a
+ *         inicialização normal.
+ */
+bool adopt_shared_memory() {
+    shared_data = attach_existing_segment(SHM_KEY_SENSORS, sizeof(SensorData), &shm_id_sensors);
+    if (shared_data == NULL) {
+        fprintf(stderr, "Reinício a quente: memória dos sensores ausente ou de outro tamanho\n");
+        return false;
+    }
+    if (__atomic_load_n(&shared_data->magic, __ATOMIC_ACQUIRE) != SENSORES_MAGIC ||
+        shared_data->versao != SENSORES_VERSAO) {
+        fprintf(stderr, "Reinício a quente: cabeçalho dos sensores inválido (versão %u, esperada %u)\n",
+                shared_data->versao, SENSORES_VERSAO);
+        shmdt(shared_data);
+        shared_data = NULL;
+        return false;
+    }
+    status_trigg = attach_existing_segment(SHM_KEY_TRIGGERS, sizeof(Status_trigg), &shm_id_triggers);
+    if (status_trigg == NULL) {
+        fprintf(stderr, "Reinício a quente: memória dos acionadores ausente ou de outro tamanho\n");
+        shmdt(shared_data);
+        shared_data = NULL;
+        return false;
+    }
+
+    trava_init(&shared_data->trava);  // Já pronta: não reinicializa
+    trava_lock(&shared_data->trava, revalidate_shared_state);
+    int32_t anterior = shared_data->pid;
+    // Com o anterior vivo, os dois controladores disputariam as mesmas
+    // saídas e o mesmo estado (EPERM: existe, mas é de outro usuário)
+    if (anterior > 0 && anterior != getpid() && (kill(anterior, 0) == 0 || errno == EPERM)) {
+        trava_unlock(&shared_data->trava);
+        fprintf(stderr, "Reinício a quente: o controlador PID %d ainda está em execução.\n"
+                "Encerre-o com --preservar (ou deixe-o cair) antes de iniciar com --warm.\n",
+                anterior);
+        exit(EXIT_FAILURE);
+    }
+    shared_data->pid = getpid();
+    shared_data->reinicios++;
+    sanitize_shared_state();
+
+    estado.velocidade = shared_data->velocidade;
+    estado.rpm = shared_data->rpm;
+    estado.temperatura = shared_data->temperatura;
+    atomic_store_explicit(&motor_saida, (uint32_t)shared_data->motor_duty, memory_order_relaxed);
+    freioDuty = shared_data->freio_duty;
+    direcaoMotor = shared_data->direcao;
+    legado_ativo = shared_data->legado_ativo;
+    num_clientes = shared_data->num_clientes;
+    memcpy(clientes, shared_data->clientes, sizeof(Cliente) * (size_t)num_clientes);
+    trava_unlock(&shared_data->trava);
+
+    printf("Estado adotado do controlador PID %d (reinício a quente nº %u): "
+           "%.2f km/h, %.0f RPM, motor %d, freio %d, %d clientes\n",
+           anterior, shared_data->reinicios, estado.velocidade, estado.rpm,
+           shared_data->motor_duty, freioDuty, num_clientes);
+    return true;
 }
 
 /**
  * @brief Inicializa memórias compartilhadas para sensores e acionadores.
  *
  * Cria memória compartilhada para SensorData e Status_trigg, associa-as e
- * inicializa os campos com valores padrão.
+ * inicializa os campos com valores padrão. Com --warm, tenta antes adotar
+ * o estado existente (ver adopt_shared_memory()).
  *
  * @return Nada.
  */
 void init_shared_memory() {
+    if (reinicio_quente) {
+        if (adopt_shared_memory()) return;
+        fprintf(stderr, "Reinício a quente indisponível; inicializando o estado\n");
+        reinicio_quente = false;
+    }
+
     // SensorData
     shm_id_sensors = shmget(SHM_KEY_SENSORS, sizeof(SensorData), IPC_CREAT | 0666);
     if (shm_id_sensors < 0) {
@@ -236,6 +596,7 @@ void init_shared_memory() {
         shmctl(shm_id_sensors, IPC_RMID, NULL);
         exit(EXIT_FAILURE);
     }
+    trava_init(&shared_data->trava);
 
     // Status_trigg
     shm_id_triggers = shmget(SHM_KEY_TRIGGERS, sizeof(Status_trigg), IPC_CREAT | 0666);
@@ -252,15 +613,28 @@ void init_shared_memory() {
         exit(EXIT_FAILURE);
     }
 
-    // Inicializar valores
+    // Inicializar valores. O magic só é publicado no fim, para que um
+    // --warm nunca adote um estado pela metade
+    trava_lock(&shared_data->trava, NULL);
+    __atomic_store_n(&shared_data->magic, 0, __ATOMIC_RELAXED);
+    shared_data->versao = SENSORES_VERSAO;
+    shared_data->pid = getpid();
+    shared_data->reinicios = 0;
     shared_data->velocidade = 0.0;
     shared_data->rpm = 800;
     shared_data->temperatura = 0.0;
+    shared_data->motor_duty = 0;
+    shared_data->freio_duty = 0;
+    shared_data->direcao = 'N';
+    shared_data->legado_ativo = false;
+    shared_data->num_clientes = 0;
 
     status_trigg->seta_dir = false;
     status_trigg->seta_esq = false;
     status_trigg->farol_baixo = false;
     status_trigg->farol_alto = false;
+    __atomic_store_n(&shared_data->magic, SENSORES_MAGIC, __ATOMIC_RELEASE);
+    trava_unlock(&shared_data->trava);
 
     printf("============= Memórias compartilhadas inicializadas. ===============\n");
 }
@@ -269,7 +643,9 @@ void init_shared_memory() {
  * @brief Inicializa fila de mensagens para comunicação com o painel
  *
  * Cria a fila de mensagens com a chave MSG_KEY e remove mensagens residuais
- * que por ventura tenham sido enviadas anteriormente.
+ * que por ventura tenham sido enviadas anteriormente. No reinício a quente
+ * a fila é mantida: os comandos pendentes dos clientes adotados são
+ * processados normalmente.
  *
  * @return Nada.
  */
@@ -279,26 +655,445 @@ void init_message_queue() {
         perror("Erro ao criar fila de mensagens");
         exit(EXIT_FAILURE);
     }
-    
+
+    if (reinicio_quente) {
+        struct msqid_ds info;
+        if (msgctl(msg_queue_id, IPC_STAT, &info) == 0) {
+            printf("Mensagens pendentes na fila adotadas: %lu\n", (unsigned long)info.msg_qnum);
+        }
+        return;
+    }
+
     // Limpar mensagens residuais
     Message msg;
     while (msgrcv(msg_queue_id, &msg, sizeof(msg) - sizeof(long), 0, IPC_NOWAIT) > 0) {}
 }
 
 /**
- * @brief Inicializa o semáforo de sincronização entre threads
+ * @brief Cria o segmento de estatísticas lido pelo ctlstat.
+ *
+ * O segmento é zerado e só recebe o STATS_MAGIC depois de inicializado,
+ * para que leitores nunca vejam um layout incompleto.
+ *
+ * @return Nada.
+ */
+void init_stats_memory() {
+    shm_id_stats = shmget(SHM_KEY_STATS, sizeof(ControllerStats), IPC_CREAT | 0644);
+    if (shm_id_stats < 0) {
+        perror("Erro ao criar memória para estatísticas");
+        exit(EXIT_FAILURE);
+    }
+    stats = (ControllerStats *)shmat(shm_id_stats, NULL, 0);
+    if (stats == (void *)-1) {
+        perror("Erro ao associar memória para estatísticas");
+        shmctl(shm_id_stats, IPC_RMID, NULL);
+        exit(EXIT_FAILURE);
+    }
+
+    memset(stats, 0, sizeof(ControllerStats));
+    stats->versao = STATS_VERSAO;
+    stats->pid = getpid();
+    stats->clientes = (uint32_t)num_clientes;   // Adotados no reinício a quente
+    stats->temp_ate_limite_ms = UINT32_MAX;
+    contencao_iniciar(&stats->contencao, "controller");
+    for (int i = 0; i < VIGIA_NUM_THREADS; i++) stats->vigia[i].prazo_ms = prazo_thread_ms[i];
+    stats->vigia_escalada = vigia_escalada;
+    __atomic_store_n(&stats->magic, STATS_MAGIC, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Cria o anel de difusão do estado do veículo.
+ *
+ * Os leitores anexam o segmento para leitura e escrita apenas para se
+ * registrarem como esperando no futex; os slots só são escritos aqui.
+ *
+ * @return Nada.
+ */
+void init_broadcast_memory() {
+    // Reinício a quente: os leitores continuam no mesmo anel, a partir da
+    // próxima publicação
+    if (reinicio_quente) {
+        difusao = attach_existing_segment(SHM_KEY_DIFUSAO, sizeof(AnelDifusao), &shm_id_difusao);
+        if (difusao && __atomic_load_n(&difusao->magic, __ATOMIC_ACQUIRE) == DIFUSAO_MAGIC &&
+            difusao->versao == DIFUSAO_VERSAO) {
+            difusao->pid = getpid();
+            difusao->periodo_us = periodo_tarefa_ms[TAREFA_PUBLICACAO] * 1000u;
+            return;
+        }
+        if (difusao) shmdt(difusao);
+    }
+
+    shm_id_difusao = shmget(SHM_KEY_DIFUSAO, sizeof(AnelDifusao), IPC_CREAT | 0666);
+    if (shm_id_difusao < 0) {
+        perror("Erro ao criar memória para o anel de difusão");
+        exit(EXIT_FAILURE);
+    }
+    difusao = (AnelDifusao *)shmat(shm_id_difusao, NULL, 0);
+    if (difusao == (void *)-1) {
+        perror("Erro ao associar memória para o anel de difusão");
+        shmctl(shm_id_difusao, IPC_RMID, NULL);
+        exit(EXIT_FAILURE);
+    }
+
+    memset(difusao, 0, sizeof(AnelDifusao));
+    difusao->versao = DIFUSAO_VERSAO;
+    difusao->pid = getpid();
+    difusao->periodo_us = periodo_tarefa_ms[TAREFA_PUBLICACAO] * 1000u;
+    __atomic_store_n(&difusao->magic, DIFUSAO_MAGIC, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Cria o anel de comandos usado pelos painéis com --anel.
+ *
+ * @return Nada.
+ */
+void init_command_ring_memory() {
+    // Reinício a quente: os comandos já escritos no anel são consumidos
+    // normalmente e os painéis anexados continuam produzindo
+    if (reinicio_quente) {
+        anel_cmd = attach_existing_segment(SHM_KEY_COMANDOS, sizeof(AnelComandos), &shm_id_anel_cmd);
+        if (anel_cmd && __atomic_load_n(&anel_cmd->magic, __ATOMIC_ACQUIRE) == ANEL_CMD_MAGIC &&
+            anel_cmd->versao == ANEL_CMD_VERSAO) {
+            anel_cmd->pid = getpid();
+            return;
+        }
+        if (anel_cmd) shmdt(anel_cmd);
+    }
+
+    shm_id_anel_cmd = shmget(SHM_KEY_COMANDOS, sizeof(AnelComandos), IPC_CREAT | 0666);
+    if (shm_id_anel_cmd < 0) {
+        perror("Erro ao criar memória para o anel de comandos");
+        exit(EXIT_FAILURE);
+    }
+    anel_cmd = (AnelComandos *)shmat(shm_id_anel_cmd, NULL, 0);
+    if (anel_cmd == (void *)-1) {
+        perror("Erro ao associar memória para o anel de comandos");
+        shmctl(shm_id_anel_cmd, IPC_RMID, NULL);
+        exit(EXIT_FAILURE);
+    }
+
+    memset(anel_cmd, 0, sizeof(AnelComandos));
+    anel_cmd_init(anel_cmd);
+    anel_cmd->versao = ANEL_CMD_VERSAO;
+    anel_cmd->pid = getpid();
+    __atomic_store_n(&anel_cmd->magic, ANEL_CMD_MAGIC, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Associa a thread corrente ao seu slot de contadores, ao seu prazo
+ *        no vigia (threads supervisionadas) e, com o rastreio ligado, ao
+ *        seu anel de eventos.
+ *
+ * @param id Slot da thread no segmento de estatísticas.
+ */
+void stats_register_thread(StatsThread id) {
+    stats_thread = &stats->threads[id];
+    if (id < VIGIA_NUM_THREADS) vigia_thread = &stats->vigia[id];
+    rastreio_registrar_thread(NOMES_THREADS[id]);
+}
+
+/**
+ * @brief Retorna o instante atual do relógio monotônico em nanossegundos.
+ */
+static inline uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Entra na seção crítica dos dados compartilhados contabilizando a espera.
+ *
+ * O tempo de espera é somado ao slot da thread corrente (threads que não se
+ * registraram, ex.: a thread principal durante a limpeza, não contabilizam)
+ * e ao sítio @p ponto do perfil de contenção. Use pela macro sync_lock(),
+ * que cria um ponto por chamada.
+ */
+void sync_lock_em(PontoContencao *ponto) {
+    RASTREIO_ESCOPO("trava");
+    uint64_t inicio = now_ns();
+    trava_lock(&shared_data->trava, revalidate_shared_state);
+    uint64_t obtida = now_ns();
+    uint64_t espera = obtida - inicio;
+    contencao_entrou(contencao_sitio(stats ? &stats->contencao : NULL, ponto), espera, obtida);
+    if (stats_thread == NULL) return;
+
+    stats_inc(&stats_thread->lock_aquisicoes);
+    stats_add(&stats_thread->lock_espera_ns, espera);
+    if (espera > stats_get(&stats_thread->lock_espera_max_ns)) {
+        atomic_store_explicit(&stats_thread->lock_espera_max_ns, espera, memory_order_relaxed);
+    }
+}
+
+#define sync_lock() sync_lock_em(PONTO_CONTENCAO())
+
+/**
+ * @brief Sai da seção crítica dos dados compartilhados.
+ *
+ * O tempo com a trava vai para o sítio da aquisição depois de liberá-la.
+ */
+void sync_unlock() {
+    uint64_t liberada = now_ns();
+    trava_unlock(&shared_data->trava);
+    contencao_saiu(liberada);
+}
+
+/**
+ * @brief Atualiza a profundidade da fila de mensagens nas estatísticas.
+ */
+void stats_update_queue_depth() {
+    struct msqid_ds info;
+    if (msgctl(msg_queue_id, IPC_STAT, &info) < 0) return;
+
+    uint32_t profundidade = (uint32_t)info.msg_qnum;
+    atomic_store_explicit(&stats->fila_profundidade, profundidade, memory_order_relaxed);
+    if (profundidade > atomic_load_explicit(&stats->fila_profundidade_max, memory_order_relaxed)) {
+        atomic_store_explicit(&stats->fila_profundidade_max, profundidade, memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Retorna o nome usado no arquivo de configuração de tempo real.
+ */
+const char *rt_thread_name(int id) {
+    return (id == RT_PWM) ? "pwm" : NOMES_THREADS[id];
+}
+
+/**
+ * @brief Carrega o arquivo de configuração do modo de tempo real.
  *
- * Limpa o nome do semáforo e o cria com o valor inicial de 1.
+ * Cada linha não vazia tem o formato "<thread> <prioridade> <cpu>", onde
+ * <thread> é um de: controle, seta_esq, seta_dir, dash, vigia ou pwm
+ * (threads de PWM e interrupção criadas pela WiringPi). Prioridade 0 mantém o
+ * escalonador padrão e cpu -1 não fixa a thread. Linhas iniciadas por '#'
+ * são comentários.
  *
- * @return Nenhum
+ * @param arquivo Caminho do arquivo de configuração.
  */
-void init_semaphore() {
-    sem_unlink("/sem_sync");
-    sem_sync = sem_open("/sem_sync", O_CREAT | O_EXCL, 0666, 1);
-    if (sem_sync == SEM_FAILED) {
-        perror("Erro ao criar semáforo");
+void rt_load_config(const char *arquivo) {
+    for (int i = 0; i < RT_NUM_THREADS; i++) {
+        rt_config[i].prioridade = 0;
+        rt_config[i].cpu = -1;
+    }
+
+    FILE *f = fopen(arquivo, "r");
+    if (f == NULL) {
+        perror("Erro ao abrir configuração de tempo real");
         exit(EXIT_FAILURE);
     }
+
+    int prio_min = sched_get_priority_min(SCHED_FIFO);
+    int prio_max = sched_get_priority_max(SCHED_FIFO);
+    char linha[128];
+    int num_linha = 0;
+    while (fgets(linha, sizeof(linha), f) != NULL) {
+        char nome[32];
+        int prioridade, cpu;
+        num_linha++;
+
+        char *p = linha + strspn(linha, " \t");
+        if (*p == '#' || *p == '\n' || *p == '\0') continue;
+
+        if (sscanf(p, "%31s %d %d", nome, &prioridade, &cpu) != 3) {
+            fprintf(stderr, "%s:%d: linha inválida\n", arquivo, num_linha);
+            exit(EXIT_FAILURE);
+        }
+
+        int id = -1;
+        for (int i = 0; i < RT_NUM_THREADS; i++) {
+            if (strcmp(nome, rt_thread_name(i)) == 0) id = i;
+        }
+        if (id < 0) {
+            fprintf(stderr, "%s:%d: thread desconhecida '%s'\n", arquivo, num_linha, nome);
+            exit(EXIT_FAILURE);
+        }
+        if (prioridade != 0 && (prioridade < prio_min || prioridade > prio_max)) {
+            fprintf(stderr, "%s:%d: prioridade fora de [%d, %d]\n",
+                    arquivo, num_linha, prio_min, prio_max);
+            exit(EXIT_FAILURE);
+        }
+        if (cpu < -1 || cpu >= CPU_SETSIZE) {
+            fprintf(stderr, "%s:%d: cpu inválida\n", arquivo, num_linha);
+            exit(EXIT_FAILURE);
+        }
+
+        rt_config[id].prioridade = prioridade;
+        rt_config[id].cpu = cpu;
+    }
+    fclose(f);
+    rt_ativo = true;
+}
+
+/**
+ * @brief Toca uma região de memória para que as páginas já estejam
+ *        residentes antes do loop de controle.
+ *
+ * Apenas lê cada página, portanto é seguro em segmentos compartilhados.
+ */
+void rt_prefault_region(const void *inicio, size_t tamanho) {
+    const volatile char *p = (const volatile char *)inicio;
+    long pagina = sysconf(_SC_PAGESIZE);
+    for (size_t i = 0; i < tamanho; i += (size_t)pagina) {
+        (void)p[i];
+    }
+}
+
+/**
+ * @brief Toca antecipadamente a pilha da thread corrente.
+ */
+__attribute__((noinline)) void rt_prefault_stack() {
+    volatile char pilha[RT_STACK_PREFAULT];
+    for (size_t i = 0; i < sizeof(pilha); i += 4096) {
+        pilha[i] = 0;
+    }
+}
+
+/**
+ * @brief Bloqueia e pré-carrega toda a memória do processo.
+ *
+ * Deve ser chamada depois de anexar as memórias compartilhadas e antes de
+ * criar threads: mlockall(MCL_CURRENT) trava os segmentos já anexados e
+ * MCL_FUTURE trava as pilhas das threads criadas depois. O tamanho padrão
+ * de pilha é reduzido para que as pilhas travadas (inclusive as das threads
+ * da WiringPi) não ocupem 8 MiB cada.
+ */
+void rt_lock_memory() {
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, RT_STACK_SIZE);
+    if (pthread_setattr_default_np(&attr) != 0) {
+        fprintf(stderr, "Aviso: não foi possível reduzir a pilha padrão das threads\n");
+    }
+    pthread_attr_destroy(&attr);
+
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0) {
+        perror("Aviso: mlockall falhou (memória não travada)");
+    }
+
+    rt_prefault_region(shared_data, sizeof(SensorData));
+    rt_prefault_region(status_trigg, sizeof(Status_trigg));
+    rt_prefault_region(stats, sizeof(ControllerStats));
+    rt_prefault_stack();
+}
+
+/**
+ * @brief Aplica prioridade e afinidade configuradas à thread corrente.
+ *
+ * Sem o modo de tempo real habilitado, não faz nada. Falhas (ex.: falta de
+ * permissão para SCHED_FIFO) geram apenas um aviso.
+ *
+ * @param id Thread na configuração (StatsThread ou RT_PWM).
+ */
+void rt_apply_thread(int id) {
+    if (!rt_ativo) return;
+
+    const RtThreadConfig *cfg = &rt_config[id];
+    if (cfg->cpu >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(cfg->cpu, &cpus);
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if (err != 0) {
+            fprintf(stderr, "Aviso: afinidade da thread %s: %s\n", rt_thread_name(id), strerror(err));
+        }
+    }
+
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = cfg->prioridade;
+    int politica = (cfg->prioridade > 0) ? SCHED_FIFO : SCHED_OTHER;
+    int err = pthread_setschedparam(pthread_self(), politica, &param);
+    if (err != 0) {
+        fprintf(stderr, "Aviso: prioridade da thread %s: %s\n", rt_thread_name(id), strerror(err));
+    }
+
+    rt_prefault_stack();
+}
+
+/**
+ * @brief Dorme até um instante absoluto medindo o atraso ao despertar.
+ *
+ * O atraso (instante real de retorno menos o instante pedido) é o jitter
+ * de escalonamento observado pela thread; o pior caso é publicado nas
+ * estatísticas. Retorna antes do prazo se o programa estiver encerrando.
+ *
+ * Em uma thread supervisionada, cada espera é também o batimento para o
+ * vigia: a thread promete voltar a esperar até o despertar mais a sua folga.
+ *
+ * @param alvo_ns Instante de despertar no relógio monotônico (ns).
+ */
+void rt_sleep_until_ns(uint64_t alvo_ns) {
+    if (vigia_thread != NULL) {
+        uint64_t folga = (uint64_t)atomic_load_explicit(&vigia_thread->prazo_ms, memory_order_relaxed) * 1000000ull;
+        stats_inc(&vigia_thread->batimentos);
+        atomic_store_explicit(&vigia_thread->limite_ns, alvo_ns + folga, memory_order_release);
+    }
+    struct timespec alvo = {
+        .tv_sec = (time_t)(alvo_ns / 1000000000ull),
+        .tv_nsec = (long)(alvo_ns % 1000000000ull),
+    };
+    {
+        RASTREIO_ESCOPO("dormir");
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &alvo, NULL) == EINTR) {
+            if (!running) return;
+        }
+    }
+
+    if (stats_thread == NULL) return;
+    uint64_t atraso = now_ns() - alvo_ns;
+    stats_inc(&stats_thread->despertares);
+    stats_add(&stats_thread->atraso_total_ns, atraso);
+    if (atraso > stats_get(&stats_thread->atraso_max_ns)) {
+        atomic_store_explicit(&stats_thread->atraso_max_ns, atraso, memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Dorme por um intervalo medindo o atraso ao despertar.
+ *
+ * @param intervalo_ns Duração da espera em nanossegundos.
+ */
+void rt_sleep_ns(uint64_t intervalo_ns) {
+    rt_sleep_until_ns(now_ns() + intervalo_ns);
+}
+
+/**
+ * @brief Indica se o vigia colocou os atuadores no estado seguro.
+ *
+ * Enquanto estiver ativo, o acelerador (pedal e comando do painel) e os
+ * limitadores não tiram o motor do 0.
+ */
+static inline bool safe_state_active() {
+    return atomic_load_explicit(&motor_saida, memory_order_acquire) & MOTOR_SEGURO;
+}
+
+/**
+ * @brief Duty cycle atual do motor (0-10).
+ */
+static inline int motor_duty() {
+    return (int)(atomic_load_explicit(&motor_saida, memory_order_relaxed) & ~MOTOR_SEGURO);
+}
+
+/**
+ * @brief Escreve o duty cycle do motor, a não ser no estado seguro do vigia.
+ *
+ * Única forma de mudar o motor fora do vigia. A troca do duty é um
+ * compare-and-swap que falha se o vigia marcou o estado seguro, então uma
+ * thread que conferiu o estado antes de travar não o desfaz ao voltar. Se o
+ * estado seguro começar entre a troca e a escrita no PWM, o PWM volta a 0.
+ *
+ * @param duty Novo duty cycle (0-10).
+ * @return false se o estado seguro está ativo (nada foi escrito).
+ */
+static bool motor_write(int duty) {
+    uint32_t atual = atomic_load_explicit(&motor_saida, memory_order_acquire);
+    do {
+        if (atual & MOTOR_SEGURO) return false;
+    } while (!atomic_compare_exchange_weak_explicit(&motor_saida, &atual, (uint32_t)duty,
+                                                    memory_order_acq_rel, memory_order_acquire));
+    RASTREIO_CHAMADA("softPwmWrite", softPwmWrite(MOTOR_POT, duty));
+    if (safe_state_active()) softPwmWrite(MOTOR_POT, 0);
+    return true;
 }
 
 /**
@@ -316,83 +1111,126 @@ float calculate_engine_temp(float velocidade, float rpm) {
     return (float)fmin(MAX_TEMP_MOTOR, temp);
 }
 
+/**
+ * @brief Reinicia uma janela de pulsos a partir do instante dado.
+ */
+void pulse_window_reset(JanelaPulsos *j, uint64_t agora_ns) {
+    j->inicio = 0;
+    j->quantidade = 0;
+    j->soma = 0;
+    j->t_base_ns = agora_ns;
+    j->t_ultimo_ns = agora_ns;
+}
+
+/**
+ * @brief Acrescenta uma coleta à janela e descarta as que expiraram.
+ *
+ * Os pulsos de um slot foram contados entre a coleta anterior e a dele;
+ * ao descartar um slot, o início da janela avança para o seu instante.
+ * Custo O(1) amortizado por coleta.
+ *
+ * @param j Janela do sensor.
+ * @param pulsos Pulsos lidos nesta coleta.
+ * @param agora_ns Instante da coleta.
+ */
+void pulse_window_push(JanelaPulsos *j, uint32_t pulsos, uint64_t agora_ns) {
+    const uint64_t duracao_ns = (uint64_t)(JANELA_MEDICAO_S * 1e9);
+
+    if (j->quantidade == JANELA_SLOTS) {
+        j->t_base_ns = j->t_ns[j->inicio];
+        j->soma -= j->pulsos[j->inicio];
+        j->inicio = (j->inicio + 1) % JANELA_SLOTS;
+        j->quantidade--;
+    }
+    unsigned int fim = (j->inicio + j->quantidade) % JANELA_SLOTS;
+    j->t_ns[fim] = agora_ns;
+    j->pulsos[fim] = pulsos;
+    j->quantidade++;
+    j->soma += pulsos;
+    j->t_ultimo_ns = agora_ns;
+
+    while (j->quantidade > 1 && agora_ns - j->t_ns[j->inicio] > duracao_ns) {
+        j->t_base_ns = j->t_ns[j->inicio];
+        j->soma -= j->pulsos[j->inicio];
+        j->inicio = (j->inicio + 1) % JANELA_SLOTS;
+        j->quantidade--;
+    }
+}
+
+/**
+ * @brief Converte os pulsos da janela para pulsos por janela de calibração.
+ *
+ * @param j Janela do sensor.
+ * @param valida Recebe false enquanto a janela ainda não cobre
+ *               JANELA_MEDICAO_S (início da execução).
+ * @return Pulsos normalizados para JANELA_CALIBRACAO_S segundos.
+ */
+double pulse_window_rate(const JanelaPulsos *j, bool *valida) {
+    double span = (double)(j->t_ultimo_ns - j->t_base_ns) / 1e9;
+    *valida = span >= JANELA_MEDICAO_S * 0.99;
+    if (span <= 0.0) return 0.0;
+    return (double)j->soma * (JANELA_CALIBRACAO_S / span);
+}
+
 /**
  * Calcula o valor do RPM do motor, baseado em uma fórmula empírica.
  *
- * Essa fórmula utiliza a quantidade de pulsos do motor nos últimos segundos
- * e aplica uma constante de conversão para obter o valor do RPM.
+ * Essa fórmula utiliza a quantidade de pulsos do motor na janela
+ * deslizante alimentada pela tarefa de coleta e aplica uma constante de
+ * conversão para obter o valor do RPM. As constantes foram levantadas com
+ * uma janela de JANELA_CALIBRACAO_S segundos, por isso a contagem é
+ * normalizada pelo intervalo realmente coberto pela janela.
  *
- * A cada chamada, o valor do RPM é calculado e o contador de pulsos é
- * resetado.
+ * Enquanto a janela ainda não estiver completa (início da execução), a
+ * marcha lenta (800 RPM) é assumida.
  *
  * @return O valor do RPM do motor.
  */
 float motor_rpm() {
-    float rpm = 0.0;
-    
-    // Debug
-    //printf("Motor pulsos pré calculo RPM: %ld\n", motorPulsos);
-    
     // Constantes empregadas no cálculo do RPM
     const int RPM_CONST1 = 2285;
     const int RPM_CONST2 = 800;
     const int PULSE_CONST1 = 76;
     const int PULSE_CONST2 = 26;
     const float EMP_CONST = ((RPM_CONST1 / PULSE_CONST1) + (RPM_CONST2 / PULSE_CONST2)) / 2;
-    
-    rpm = motorPulsos * EMP_CONST;
-    
-    // Reset dos pulsos e atualização do tempo
-    motorPulsos = 0;
-    
-    // Debug
-    //printf("Motor pulsos post calculo RPM: %ld\n", motorPulsos);
 
-    return rpm;
+    bool valida;
+    double pulsos = pulse_window_rate(&janelaMotor, &valida);
+    if (!valida) return 800.0;
+
+    return (float)(pulsos * EMP_CONST);
 }
 
 /**
  * Calcula a velocidade média com base nos pulsos dos sensores Hall das rodas.
  *
- * A função utiliza contadores de pulsos de duas rodas (A e B) para 
+ * A função utiliza as janelas de pulsos de duas rodas (A e B) para 
  * calcular a velocidade individual de cada roda com uma constante 
  * empiricamente definida. A média das velocidades das duas rodas é 
  * então calculada para dar a velocidade final do veículo.
  *
- * Após o cálculo, os contadores de pulsos são resetados.
+ * Assim como em motor_rpm(), a contagem é normalizada pelo intervalo
+ * coberto pela janela; enquanto ela não estiver completa, retorna 0.
  *
  * @return A velocidade média do veículo.
  */
 float velocidade() {
-    float velocidade_media = 0.0;
-    float velocidade_a = 0.0;
-    float velocidade_b = 0.0;
-    
-    // Debug
-    //printf("roda_a pulsos pré calculo  %ld\n", rodaPulsos_a);
-    //printf("roda_b pulsos pré calculo  %ld\n", rodaPulsos_b);
-
     // Constantes empregadas no cálculo da velocidade
     const int VEL_CONST1 = 144;
     const int PULSE_CONST1 = 20;
     const int PULSE_CONST2 = 21;
     const float EMP_CONST = VEL_CONST1 / ((PULSE_CONST1 + PULSE_CONST2) / 2);
-    
-    // Cálculo empirico
-    velocidade_a = rodaPulsos_a * EMP_CONST;
-    velocidade_b = rodaPulsos_b * EMP_CONST;
 
-    velocidade_media = ((velocidade_a + velocidade_b) / 2.0);
+    bool valida_a, valida_b;
+    double pulsos_a = pulse_window_rate(&janelaRoda_a, &valida_a);
+    double pulsos_b = pulse_window_rate(&janelaRoda_b, &valida_b);
+    if (!valida_a || !valida_b) return 0.0;
 
-    // Reset dos pulsos e atualização do tempo
-    rodaPulsos_a = 0;
-    rodaPulsos_b = 0;
-
-    // Debug
-    //printf("roda_a pulsos post calculo  %ld\n", rodaPulsos_a);
-    //printf("roda_b pulsos post calculo  %ld\n", rodaPulsos_b);
+    // Cálculo empirico
+    float velocidade_a = (float)(pulsos_a * EMP_CONST);
+    float velocidade_b = (float)(pulsos_b * EMP_CONST);
 
-    return velocidade_media;
+    return ((velocidade_a + velocidade_b) / 2.0);
 }
 
 /**
@@ -407,6 +1245,7 @@ float velocidade() {
  *  'B' = freio (brake), 'N' = neutro)
  */
 void motor_set_direction(char direction) {
+    direcaoMotor = direction;
     switch (direction) {
         case 'D':
             digitalWrite(MOTOR_DIR1, HIGH);
@@ -510,7 +1349,12 @@ void init_gpio() {
     gpio_pin_setup(SENSOR_HALL_RODA_A, INPUT);
     gpio_pin_setup(SENSOR_HALL_RODA_B, INPUT);
     
-    // Configurar interrupções para sensor Hall
+    // Configurar interrupções para sensor Hall (as janelas de contagem
+    // começam aqui)
+    uint64_t agora = now_ns();
+    pulse_window_reset(&janelaMotor, agora);
+    pulse_window_reset(&janelaRoda_a, agora);
+    pulse_window_reset(&janelaRoda_b, agora);
     if (wiringPiISR(SENSOR_HALL_MOTOR, INT_EDGE_RISING, &motor_hall_callback) < 0) {
         fprintf(stderr, "Erro ao configurar interrupção para SENSOR_HALL_MOTOR\n");
         exit(EXIT_FAILURE);
@@ -527,6 +1371,24 @@ void init_gpio() {
     printf("========== GPIO inicializada. ==========\n");
 }
 
+/**
+ * @brief Reescreve nas saídas físicas o estado adotado com --warm.
+ *
+ * Chamada depois de init_gpio(), que cria os PWM zerados.
+ */
+void restore_outputs() {
+    motor_set_direction(direcaoMotor);
+    softPwmWrite(MOTOR_POT, motor_duty());
+    softPwmWrite(FREIO_INT, freioDuty);
+    digitalWrite(LUZ_FREIO, direcaoMotor == 'B' ? HIGH : LOW);
+
+    sync_lock();
+    Status_trigg copia = *status_trigg;
+    sync_unlock();
+    digitalWrite(FAROL_BAIXO, copia.farol_baixo ? HIGH : LOW);
+    digitalWrite(FAROL_ALTO, copia.farol_alto ? HIGH : LOW);
+}
+
 
 /**
  * @brief Thread para piscar seta esquerda
@@ -545,21 +1407,24 @@ void init_gpio() {
  */
 void *threadPiscaSetaEsq(void *arg) {
     (void)arg; // Silenciar warning de parâmetro não utilizado
+    stats_register_thread(STATS_TH_SETA_ESQ);
+    rt_apply_thread(STATS_TH_SETA_ESQ);
 
     while (running) {
-        sem_wait(sem_sync);
+        stats_inc(&stats_thread->iteracoes);
+        sync_lock();
         bool ligada = status_trigg->seta_esq;
-        sem_post(sem_sync);
+        sync_unlock();
 
         if (ligada) {
-            digitalWrite(LUZ_SETA_ESQ, HIGH);
-            sleep(1);
-            digitalWrite(LUZ_SETA_ESQ, LOW);
-            sleep(1);
+            RASTREIO_CHAMADA("digitalWrite", digitalWrite(LUZ_SETA_ESQ, HIGH));
+            rt_sleep_ns(1000000000ull);
+            RASTREIO_CHAMADA("digitalWrite", digitalWrite(LUZ_SETA_ESQ, LOW));
+            rt_sleep_ns(1000000000ull);
         } else {
             // Se seta não estiver ativa, garante desligado
-            digitalWrite(LUZ_SETA_ESQ, LOW);
-            usleep(200000); 
+            RASTREIO_CHAMADA("digitalWrite", digitalWrite(LUZ_SETA_ESQ, LOW));
+            rt_sleep_ns(200000000ull);
         }
     }
     return NULL;
@@ -582,20 +1447,23 @@ void *threadPiscaSetaEsq(void *arg) {
  */
 void *threadPiscaSetaDir(void *arg) {
     (void)arg;
+    stats_register_thread(STATS_TH_SETA_DIR);
+    rt_apply_thread(STATS_TH_SETA_DIR);
 
     while (running) {
-        sem_wait(sem_sync);
+        stats_inc(&stats_thread->iteracoes);
+        sync_lock();
         bool ligada = status_trigg->seta_dir;
-        sem_post(sem_sync);
+        sync_unlock();
 
         if (ligada) {
-            digitalWrite(LUZ_SETA_DIR, HIGH);
-            sleep(1);
-            digitalWrite(LUZ_SETA_DIR, LOW);
-            sleep(1);
+            RASTREIO_CHAMADA("digitalWrite", digitalWrite(LUZ_SETA_DIR, HIGH));
+            rt_sleep_ns(1000000000ull);
+            RASTREIO_CHAMADA("digitalWrite", digitalWrite(LUZ_SETA_DIR, LOW));
+            rt_sleep_ns(1000000000ull);
         } else {
-            digitalWrite(LUZ_SETA_DIR, LOW);
-            usleep(200000);
+            RASTREIO_CHAMADA("digitalWrite", digitalWrite(LUZ_SETA_DIR, LOW));
+            rt_sleep_ns(200000000ull);
         }
     }
     return NULL;
@@ -615,69 +1483,1228 @@ void *threadPiscaSetaDir(void *arg) {
  */
 void *threadComandosDash(void *arg) {
     (void)arg;
+    stats_register_thread(STATS_TH_DASH);
+    rt_apply_thread(STATS_TH_DASH);
 
     while (running) {
-        // Leitura dos pedais
-        if (digitalRead(PEDAL_AC)) {
+        stats_inc(&stats_thread->iteracoes);
+
+        // Leitura dos pedais (no estado seguro do vigia o acelerador é ignorado)
+        if (digitalRead(PEDAL_AC) && !safe_state_active()) {
             freioDuty = 0;
-            softPwmWrite(FREIO_INT, freioDuty);
-            digitalWrite(LUZ_FREIO, LOW);
+            RASTREIO_CHAMADA("softPwmWrite", softPwmWrite(FREIO_INT, freioDuty));
+            RASTREIO_CHAMADA("digitalWrite", digitalWrite(LUZ_FREIO, LOW));
             motor_set_direction('D');
-            motorDuty = (motorDuty < 10) ? motorDuty + 1 : 10;
-            softPwmWrite(MOTOR_POT, motorDuty);
+            motor_write(motor_duty() < 10 ? motor_duty() + 1 : 10);
         } else if (digitalRead(PEDAL_FR)) {
-            motorDuty = 0;
-            softPwmWrite(MOTOR_POT, motorDuty);
-            digitalWrite(LUZ_FREIO, HIGH);
+            motor_write(0);
+            RASTREIO_CHAMADA("digitalWrite", digitalWrite(LUZ_FREIO, HIGH));
             motor_set_direction('B');
             freioDuty = (freioDuty < 10) ? freioDuty + 1 : 10;
-            softPwmWrite(FREIO_INT, freioDuty);
+            RASTREIO_CHAMADA("softPwmWrite", softPwmWrite(FREIO_INT, freioDuty));
         }
         if (digitalRead(COMANDO_FAROL_BAIXO)) {
-            sem_wait(sem_sync);
+            sync_lock();
             status_trigg->farol_baixo = !status_trigg->farol_baixo;
-            digitalWrite(FAROL_BAIXO, status_trigg->farol_baixo ? HIGH : LOW);
-            sem_post(sem_sync);
+            RASTREIO_CHAMADA("digitalWrite", digitalWrite(FAROL_BAIXO, status_trigg->farol_baixo ? HIGH : LOW));
+            sync_unlock();
         } 
         if (digitalRead(COMANDO_FAROL_ALTO)) {
-            sem_wait(sem_sync);
+            sync_lock();
             status_trigg->farol_alto = !status_trigg->farol_alto;
-            digitalWrite(FAROL_ALTO, status_trigg->farol_alto ? HIGH : LOW);
-            sem_post(sem_sync);
+            RASTREIO_CHAMADA("digitalWrite", digitalWrite(FAROL_ALTO, status_trigg->farol_alto ? HIGH : LOW));
+            sync_unlock();
         } 
         if (digitalRead(COMANDO_SETA_ESQ)) {
-            sem_wait(sem_sync);
+            sync_lock();
             status_trigg->seta_esq = !status_trigg->seta_esq;
-            sem_post(sem_sync);
+            sync_unlock();
         }
         if (digitalRead(COMANDO_SETA_DIR)) {
-            sem_wait(sem_sync);
+            sync_lock();
             status_trigg->seta_dir = !status_trigg->seta_dir;
-            sem_post(sem_sync);
+            sync_unlock();
         }
-        usleep(50000); // Intervalo para evitar polling agressivo
+        rt_sleep_ns(50000000ull); // Intervalo para evitar polling agressivo
     }
 
     return NULL;
 }
 
 /**
- * @brief Executa o controle principal do sistema.
+ * @brief Aplica um comando recebido do painel aos acionadores.
+ *
+ * Atualiza o status_trigg e as saídas físicas correspondentes ao
+ * comando. Deve ser chamada com a trava já adquirida (ver
+ * apply_commands()).
+ *
+ * @param cmd Comando já convertido por comando_id().
+ */
+void apply_command_locked(ComandoId cmd) {
+    switch (cmd) {
+    case CMD_LIGAR_SETA_ESQ:
+        status_trigg->seta_esq = true;
+        break;
+    case CMD_DESLIGAR_SETA_ESQ:
+        status_trigg->seta_esq = false;
+        break;
+    case CMD_LIGAR_SETA_DIR:
+        status_trigg->seta_dir = true;
+        break;
+    case CMD_DESLIGAR_SETA_DIR:
+        status_trigg->seta_dir = false;
+        break;
+    case CMD_LIGAR_PISCA_ALERTA:
+        status_trigg->seta_esq = true;
+        status_trigg->seta_dir = true;
+        break;
+    case CMD_DESLIGAR_PISCA_ALERTA:
+        status_trigg->seta_esq = false;
+        status_trigg->seta_dir = false;
+        break;
+    case CMD_LIGAR_FAROL_BAIXO:
+        digitalWrite(FAROL_BAIXO, HIGH);
+        status_trigg->farol_baixo = true;
+        break;
+    case CMD_DESLIGAR_FAROL_BAIXO:
+        digitalWrite(FAROL_BAIXO, LOW);
+        status_trigg->farol_baixo = false;
+        break;
+    case CMD_LIGAR_FAROL_ALTO:
+        digitalWrite(FAROL_ALTO, HIGH);
+        status_trigg->farol_alto = true;
+        break;
+    case CMD_DESLIGAR_FAROL_ALTO:
+        digitalWrite(FAROL_ALTO, LOW);
+        status_trigg->farol_alto = false;
+        break;
+    case CMD_DESLIGAR_FAROL:
+        digitalWrite(FAROL_BAIXO, LOW);
+        digitalWrite(FAROL_ALTO, LOW);
+        status_trigg->farol_baixo = false;
+        status_trigg->farol_alto = false;
+        break;
+    case CMD_PEDAL_ACELERADOR:
+        if (safe_state_active()) break; // Estado seguro do vigia: acelerador ignorado
+
+        // Desabilitar freio
+        freioDuty = 0;
+        softPwmWrite(FREIO_INT, freioDuty);
+        digitalWrite(LUZ_FREIO, LOW);
+
+        // Ajustar direção para frente
+        motor_set_direction('D');
+
+        // Aumentar duty cycle do motor
+        motor_write(motor_duty() < 10 ? motor_duty() + 1 : 10);
+        break;
+    case CMD_PEDAL_FREIO:
+        // Desabilitar motor
+        motor_write(0);
+        digitalWrite(LUZ_FREIO, HIGH);
+
+        // Setar motor em 'B' (freio ativo)
+        motor_set_direction('B');
+
+        // Aumentar duty cycle do freio
+        freioDuty = (freioDuty < 10) ? freioDuty + 1 : 10;
+        softPwmWrite(FREIO_INT, freioDuty);
+        break;
+    case CMD_ENCERRAR:
+        raise(SIGUSR2);
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Aplica uma sequência de comandos em uma única seção crítica.
+ *
+ * Os demais processos e threads que leem status_trigg sob a trava
+ * enxergam o estado anterior ou o estado final, nunca um intermediário.
+ *
+ * @param cmds Comandos, na ordem de aplicação.
+ * @param n Quantidade de comandos.
+ */
+void apply_commands(const ComandoId *cmds, int n) {
+    sync_lock();
+    for (int i = 0; i < n; i++) {
+        apply_command_locked(cmds[i]);
+    }
+    sync_unlock();
+}
+
+/**
+ * @brief Aplica um único comando (ver apply_commands()).
+ */
+void apply_command(ComandoId cmd) {
+    apply_commands(&cmd, 1);
+}
+
+/**
+ * @brief Tarefa de coleta: lê e zera os contadores dos sensores Hall.
+ *
+ * Roda na maior taxa do escalonador, de modo que as janelas deslizantes
+ * tenham resolução fina e as estimativas de RPM e velocidade estejam
+ * sempre atualizadas para as demais tarefas.
+ */
+void task_harvest_pulses() {
+    uint64_t agora = now_ns();
+    pulse_window_push(&janelaMotor,
+                      (uint32_t)__atomic_exchange_n(&motorPulsos, 0, __ATOMIC_RELAXED), agora);
+    pulse_window_push(&janelaRoda_a,
+                      (uint32_t)__atomic_exchange_n(&rodaPulsos_a, 0, __ATOMIC_RELAXED), agora);
+    pulse_window_push(&janelaRoda_b,
+                      (uint32_t)__atomic_exchange_n(&rodaPulsos_b, 0, __ATOMIC_RELAXED), agora);
+
+    estado.velocidade = velocidade();
+    estado.rpm = motor_rpm();
+    caixa_amostra(caixa, agora, estado.velocidade, estado.rpm, estado.temperatura,
+                  motor_duty(), freioDuty, direcaoMotor);
+
+    const float valores[SINAL_NUM] = { estado.velocidade, estado.rpm, estado.temperatura };
+    agregador_amostra(&agregador, agora, valores);
+}
+
+/**
+ * @brief Registra na caixa-preta a intervenção de um limitador, já com o
+ *        duty cycle resultante.
+ */
+static inline void limiter_record(AlertaCaixa alerta, float valor, int duty) {
+    caixa_alerta(caixa, now_ns(), alerta, valor, duty, freioDuty, direcaoMotor);
+}
+
+/**
+ * @brief Nível de aviso do detector de superaquecimento.
+ *
+ * Cada nível é atingido pela temperatura suavizada ou, com o motor já
+ * quente (LIMIAR_PROJECAO_C), pelo tempo projetado até MAX_TEMP_MOTOR. Para
+ * permanecer nele basta uma condição mais branda (histerese); a descida
+ * de nível é decidida em overheat_update().
+ */
+NivelTemp overheat_classify(const DetectorTemp *d) {
+    static const double limiares[] = { 0.0, LIMIAR_ATENCAO_C, LIMIAR_ALERTA_C };
+    static const double horizontes[] = { 0.0, HORIZONTE_ATENCAO_S, HORIZONTE_ALERTA_S };
+
+    NivelTemp novo = TEMP_NORMAL;
+    for (int k = TEMP_ATENCAO; k <= TEMP_ALERTA; k++) {
+        bool mantendo = (int)d->aviso >= k;
+        double limiar = limiares[k] - (mantendo ? TEMP_HISTERESE : 0.0);
+        double horizonte = horizontes[k] * (mantendo ? 1.5 : 1.0);
+        bool projecao = d->nivel >= LIMIAR_PROJECAO_C && d->ate_limite_s <= horizonte;
+        if (d->nivel >= limiar || projecao) novo = (NivelTemp)k;
+    }
+    return novo;
+}
+
+/**
+ * @brief Atualiza o detector de superaquecimento com uma nova amostra (O(1)).
+ *
+ * A amostra é comparada com a previsão do estado anterior: um erro acima
+ * de TEMP_ANOMALIA_SIGMAS desvios é contado como anomalia. Em seguida o
+ * nível e a inclinação são suavizados e o tempo até MAX_TEMP_MOTOR é
+ * projetado pela reta atual.
+ *
+ * @param temp Temperatura calculada (°C).
+ * @param agora Instante da amostra.
+ */
+void overheat_update(float temp, uint64_t agora) {
+    DetectorTemp *d = &detector_temp;
+    if (!d->iniciado) {
+        d->iniciado = true;
+        d->t_ns = agora;
+        d->nivel = temp;
+        d->tendencia = 0.0;
+        d->var_residuo = TEMP_DESVIO_MIN * TEMP_DESVIO_MIN;
+        d->ate_limite_s = INFINITY;
+        return;
+    }
+    double dt = (agora - d->t_ns) / 1e9;
+    if (dt <= 0.0) return;
+    d->t_ns = agora;
+
+    double previsto = d->nivel + d->tendencia * dt;
+    double residuo = temp - previsto;
+    if (fabs(residuo) > TEMP_ANOMALIA_SIGMAS * fmax(sqrt(d->var_residuo), TEMP_DESVIO_MIN)) {
+        stats_inc(&stats->temp_anomalias);
+        limiter_record(ALERTA_TEMP_ANOMALIA, temp, motor_duty());
+    }
+    d->var_residuo += TEMP_GAMA * (residuo * residuo - d->var_residuo);
+
+    double nivel_anterior = d->nivel;
+    d->nivel = previsto + TEMP_ALFA * residuo;
+    d->tendencia += TEMP_BETA * ((d->nivel - nivel_anterior) / dt - d->tendencia);
+    d->ate_limite_s = d->tendencia > 1e-3
+                    ? fmax(0.0, (MAX_TEMP_MOTOR - d->nivel) / d->tendencia) : INFINITY;
+
+    // Sobe de nível imediatamente; desce só depois de TEMP_PERMANENCIA_NS
+    // sem a condição do nível atual
+    NivelTemp novo = overheat_classify(d);
+    if (novo >= d->aviso) d->aviso_desde_ns = agora;
+    if (novo < d->aviso && agora - d->aviso_desde_ns < TEMP_PERMANENCIA_NS) novo = d->aviso;
+    if (novo != d->aviso) {
+        if (novo > d->aviso) stats_inc(&stats->temp_entradas[novo]);
+        limiter_record(ALERTA_TEMP_TENDENCIA, (float)d->nivel, motor_duty());
+        if (!sem_console) {
+            printf("\n===== AVISO DE TEMPERATURA: %s (%.1f °C, %+.2f °C/s",
+                   NOMES_NIVEIS_TEMP[novo], d->nivel, d->tendencia);
+            if (isfinite(d->ate_limite_s)) printf(", limite em %.1f s", d->ate_limite_s);
+            printf(") =====\n");
+        }
+        d->aviso = novo;
+    }
+
+    atomic_store_explicit(&stats->temp_tendencia_mc_s, (int32_t)lround(d->tendencia * 1000.0),
+                          memory_order_relaxed);
+    atomic_store_explicit(&stats->temp_ate_limite_ms,
+                          isfinite(d->ate_limite_s) && d->ate_limite_s < UINT32_MAX / 1000.0
+                              ? (uint32_t)(d->ate_limite_s * 1000.0) : UINT32_MAX,
+                          memory_order_relaxed);
+}
+
+/**
+ * @brief Tarefa dos limitadores: aplica as regras de velocidade, RPM e
+ *        temperatura ao duty cycle do motor.
+ *
+ * As regras vêm do programa compilado do perfil publicado, lido sem trava
+ * uma vez por ativação: a avaliação devolve a máscara das regras
+ * disparadas, cujas ações alteram o duty do motor na ordem do perfil.
+ * Depois delas, o detector de superaquecimento reduz o duty do motor um
+ * passo até o teto do nível de aviso; uma regra com `alerta` acende a luz
+ * de temperatura.
+ *
+ * A tarefa roda a cada PERIODO_LIMITADOR_MS, mas as intervenções (regras e
+ * corte preventivo) são aplicadas no máximo uma vez a cada
+ * INTERVALO_INTERVENCAO_MS, o período do loop original: cada intervenção
+ * move o duty um passo, então o ganho do controle e os contadores não
+ * dependem do período da tarefa. Um ciclo liberado por "Avançar Passo"
+ * sempre intervém. A luz de temperatura mantém o estado da última
+ * intervenção.
+ */
+void task_limiter() {
+    static int luz_temp = -1;              // Último nível escrito na luz de temperatura
+    static uint64_t ultima_intervencao_ns; // 0: ainda não interveio
+    static bool alerta_aceso = false;      // Alguma regra com `alerta` na última intervenção
+
+    const uint64_t agora = now_ns();
+    const bool intervir = execucao == EXEC_PASSO || ultima_intervencao_ns == 0 ||
+                          agora - ultima_intervencao_ns >= INTERVALO_INTERVENCAO_MS * 1000000ull;
+    const int duty_anterior = motor_duty();
+    int duty = duty_anterior;
+
+    if (intervir) {
+        const PerfilLimitador *lim = perfil_atual(&perfil);
+        const ProgramaRegras *prog = &lim->programa;
+        const float entradas[ENTRADA_NUM] = { estado.velocidade, estado.rpm, estado.temperatura };
+        float saidas[ALVO_NUM] = { estado.velocidade, estado.rpm, (float)duty };
+        unsigned int eventos = 0;
+        bool interveio = false;
+
+        // Regras disparadas, na ordem do perfil
+        for (uint32_t m = regras_avaliar(prog, entradas); m; m &= m - 1) {
+            uint32_t i = (uint32_t)__builtin_ctz(m);
+            unsigned int ev = regras_aplicar(prog, i, saidas);
+            saidas[ALVO_DUTY] = fminf(10.0f, fmaxf(0.0f, saidas[ALVO_DUTY]));
+            duty = (int)saidas[ALVO_DUTY];
+            uint16_t c = prog->contador[i];
+            contadores_regras.c[c].disparos++;
+            if (estatistica_regra[c]) stats_inc(estatistica_regra[c]);
+            limiter_record(alerta_regra[c], entradas[prog->entrada[i]], duty);
+            if ((ev & EVENTO_ALERTA) && !sem_console) printf("\n========= ALERTA DE TEMPERATURA =========\n");
+            if (ev & EVENTO_DESLIGAR) {
+                if (!sem_console) printf("\n========= O motor apagou =========\n");
+                raise(SIGUSR2);
+            }
+            eventos |= ev;
+            interveio = true;
+        }
+
+        NivelTemp aviso = detector_temp.aviso;
+        int teto = aviso == TEMP_ALERTA ? TETO_DUTY_ALERTA
+                 : aviso == TEMP_ATENCAO ? TETO_DUTY_ATENCAO : 10;
+        if (duty > teto) {
+            duty--;
+            stats_inc(&stats->temp_cortes);
+            limiter_record(ALERTA_TEMP_PREVENTIVO, estado.temperatura, duty);
+            interveio = true;
+        }
+
+        if (interveio) ultima_intervencao_ns = agora;
+        alerta_aceso = (eventos & EVENTO_ALERTA) != 0;
+    }
+    if (duty != duty_anterior) motor_write(duty); // Recusado no estado seguro do vigia
+
+    NivelTemp aviso = detector_temp.aviso;
+    int nivel = LOW;
+    if (alerta_aceso) {
+        nivel = HIGH;
+        aviso = TEMP_CRITICO;
+    } else if (aviso == TEMP_ALERTA) {
+        nivel = (agora / PISCA_ALERTA_NS) & 1 ? HIGH : LOW;
+    }
+    atomic_store_explicit(&stats->temp_nivel, aviso, memory_order_relaxed);
+    // Só escreve na GPIO quando o estado da luz muda
+    if (nivel != luz_temp) {
+        RASTREIO_CHAMADA("digitalWrite", digitalWrite(LUZ_TEMP_MOTOR, nivel));
+        luz_temp = nivel;
+    }
+}
+
+/**
+ * @brief Tarefa de temperatura: recalcula a temperatura do motor e
+ *        atualiza o detector de superaquecimento.
+ */
+void task_temperature() {
+    estado.temperatura = calculate_engine_temp(estado.velocidade, estado.rpm);
+    overheat_update(estado.temperatura, now_ns());
+}
+
+/**
+ * @brief Tarefa dos agregados: publica min/máx/média/percentis das janelas
+ *        deslizantes para o ctlstat e o relatório final.
+ */
+void task_aggregates() {
+    agregador_publicar(&agregador, now_ns(), stats);
+}
+
+/**
+ * @brief Tarefa de publicação: atualiza os sensores na memória compartilhada
+ *        e publica o estado do veículo no anel de difusão.
+ *
+ * O estado dos acionadores é lido na mesma seção crítica em que os sensores
+ * são escritos; a publicação no anel acontece fora dela e não espera por
+ * nenhum leitor.
+ */
+void task_publish() {
+    EstadoPainel *e = &estado_publicado;
+    e->velocidade = estado.velocidade;
+    e->rpm = estado.rpm;
+    e->temperatura = estado.temperatura;
+    e->motor_duty = motor_duty();
+    e->freio_duty = freioDuty;
+
+    sync_lock();
+    shared_data->velocidade  = estado.velocidade;
+    shared_data->rpm         = estado.rpm;
+    shared_data->temperatura = estado.temperatura;
+    shared_data->motor_duty  = motor_duty();
+    shared_data->freio_duty  = freioDuty;
+    shared_data->direcao     = direcaoMotor;
+    shared_data->legado_ativo = legado_ativo;
+    e->seta_esq = status_trigg->seta_esq;
+    e->seta_dir = status_trigg->seta_dir;
+    e->farol_baixo = status_trigg->farol_baixo;
+    e->farol_alto = status_trigg->farol_alto;
+    sync_unlock();
+
+    difusao_publicar(difusao, e, now_ns());
+}
+
+/**
+ * @brief Copia a tabela de clientes para a memória compartilhada.
+ *
+ * Chamada a cada registro e remoção, para que um reinício a quente
+ * continue atendendo os clientes já registrados.
+ */
+void persist_clients() {
+    sync_lock();
+    shared_data->num_clientes = num_clientes;
+    memcpy(shared_data->clientes, clientes, sizeof(Cliente) * (size_t)num_clientes);
+    sync_unlock();
+}
+
+/**
+ * @brief Procura um cliente registrado pelo PID.
+ *
+ * @return Índice em clientes[] ou -1.
+ */
+int client_find(pid_t pid) {
+    for (int i = 0; i < num_clientes; i++) {
+        if (clientes[i].pid == pid) return i;
+    }
+    return -1;
+}
+
+/**
+ * @brief Registra um cliente (ou atualiza a assinatura do estado).
+ *
+ * @return RESULTADO_OK ou RESULTADO_LOTADO.
+ */
+ResultadoComando client_register(pid_t pid, bool estado) {
+    if (pid <= 0) return RESULTADO_INVALIDO;
+    int i = client_find(pid);
+    if (i < 0) {
+        if (num_clientes == MAX_CLIENTES) return RESULTADO_LOTADO;
+        i = num_clientes++;
+        clientes[i].pid = pid;
+        printf("Cliente %d registrado.\n", (int)pid);
+    }
+    clientes[i].estado = estado;
+    atomic_store_explicit(&stats->clientes, (uint32_t)num_clientes, memory_order_relaxed);
+    persist_clients();
+    return RESULTADO_OK;
+}
+
+/**
+ * @brief Remove um cliente, descarta as mensagens dele que ainda estão na
+ *        fila e libera a sua caixa de confirmações do anel.
+ */
+void client_remove(int i) {
+    Message msg;
+    pid_t pid = clientes[i].pid;
+    while (msgrcv(msg_queue_id, &msg, sizeof(msg) - sizeof(long),
+                  msg_tipo_cliente_comando(pid), IPC_NOWAIT) > 0) {}
+    while (msgrcv(msg_queue_id, &msg, sizeof(msg) - sizeof(long),
+                  msg_tipo_cliente_resposta(pid), IPC_NOWAIT) > 0) {}
+    for (int c = 0; c < MAX_CLIENTES; c++) anel_conf_fechar(anel_cmd, (uint8_t)c, pid);
+
+    clientes[i] = clientes[--num_clientes];
+    atomic_store_explicit(&stats->clientes, (uint32_t)num_clientes, memory_order_relaxed);
+    persist_clients();
+}
+
+/**
+ * @brief Envia uma resposta a um cliente sem bloquear o escalonador.
+ *
+ * @return true se a mensagem coube na fila.
+ */
+bool client_reply(pid_t pid, Message *msg) {
+    msg->msg_type = msg_tipo_cliente_resposta(pid);
+    msg->pid = getpid();
+    return msgsnd(msg_queue_id, msg, sizeof(*msg) - sizeof(long), IPC_NOWAIT) == 0;
+}
+
+/**
+ * @brief Valida e aplica um lote de comandos ("Lote").
+ *
+ * O lote é tudo ou nada: se algum item não for um comando de acionador,
+ * nenhum é aplicado. Os itens válidos são aplicados sob uma única
+ * aquisição da trava e contados individualmente nas estatísticas.
+ *
+ * @param lote ComandoId de cada item, na ordem de aplicação.
+ * @param n Número de itens.
+ * @return RESULTADO_OK ou RESULTADO_INVALIDO.
+ */
+ResultadoComando apply_batch(const uint8_t *lote, int n) {
+    ComandoId cmds[MAX_LOTE];
+    if (n < 1 || n > MAX_LOTE) return RESULTADO_INVALIDO;
+
+    for (int i = 0; i < n; i++) {
+        if (!comando_em_lote(lote[i])) return RESULTADO_INVALIDO;
+        cmds[i] = (ComandoId)lote[i];
+    }
+
+    apply_commands(cmds, n);
+    for (int i = 0; i < n; i++) {
+        stats_inc(&stats->comandos[cmds[i]]);
+    }
+    return RESULTADO_OK;
+}
+
+/**
+ * @brief Muda o estado de execução das tarefas de controle.
+ *
+ * @param novo Novo estado.
+ * @param origem Quem pediu a transição (exibido no console).
+ */
+void run_state_set(EstadoExecucao novo, const char *origem) {
+    if (novo != EXEC_PASSO) passos_pendentes = 0;
+    if (novo == execucao) return;
+    printf("Execução: %s -> %s (%s)\n", NOMES_EXECUCAO[execucao], NOMES_EXECUCAO[novo], origem);
+    execucao = novo;
+    atomic_store_explicit(&stats->execucao, (uint32_t)novo, memory_order_relaxed);
+}
+
+/**
+ * @brief Trata um comando de estado de execução.
+ *
+ * "Pausar" congela as tarefas de controle; "Retomar" as libera; "Avançar
+ * Passo" pausa (se necessário) e libera exatamente um ciclo de controle a
+ * mais. Passos pedidos antes de o ciclo anterior executar se acumulam.
+ */
+void run_state_command(ComandoId cmd) {
+    switch (cmd) {
+    case CMD_PAUSAR:
+        if (execucao == EXEC_RODANDO) run_state_set(EXEC_PAUSADO, "comando");
+        break;
+    case CMD_RETOMAR:
+        run_state_set(EXEC_RODANDO, "comando");
+        break;
+    case CMD_PASSO:
+        run_state_set(EXEC_PASSO, "comando");
+        passos_pendentes++;
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Converte os SIGUSR1 recebidos em transições pausa/retomada.
+ *
+ * O handler só incrementa um contador; cada sinal ainda não tratado
+ * alterna entre rodando e pausado.
+ */
+void run_state_poll_signal() {
+    while (pausas_tratadas != alternar_pausa) {
+        pausas_tratadas++;
+        run_state_set(execucao == EXEC_RODANDO ? EXEC_PAUSADO : EXEC_RODANDO, "SIGUSR1");
+    }
+}
+
+/**
+ * @brief Indica se um ciclo de controle pode executar agora.
+ */
+static inline bool run_state_allows_control() {
+    return execucao == EXEC_RODANDO || (execucao == EXEC_PASSO && passos_pendentes > 0);
+}
+
+/**
+ * @brief Contabiliza um ciclo de controle executado.
+ *
+ * No modo passo a passo, o último ciclo liberado volta o estado para
+ * pausado.
+ */
+void run_state_control_done() {
+    if (execucao != EXEC_PASSO) return;
+    stats_inc(&stats->passos);
+    if (--passos_pendentes == 0) run_state_set(EXEC_PAUSADO, "passo concluído");
+}
+
+/**
+ * @brief Executa um comando já identificado, vindo da fila ou do anel.
+ *
+ * @param cmd Comando (CMD_INVALIDO é só contado).
+ * @param pid Remetente (0 se não identificado).
+ * @param lote Itens do lote (CMD_LOTE).
+ * @param lote_tamanho Número de itens do lote.
+ * @param legado true se veio da fila legada (MSG_TIPO_COMANDO).
+ * @return Resultado a confirmar ao remetente.
+ */
+ResultadoComando execute_command(ComandoId cmd, pid_t pid, const uint8_t *lote, int lote_tamanho,
+                                 bool legado) {
+    if (!sem_console) {
+        printf("\n ===== Comando recebido do Painel: %s =====\n",
+               cmd == CMD_INVALIDO ? "?" : NOMES_COMANDOS[cmd]);
+    }
+
+    ResultadoComando resultado = RESULTADO_OK;
+    if (cmd == CMD_INVALIDO) {
+        stats_inc(&stats->comandos_invalidos);
+        resultado = RESULTADO_INVALIDO;
+    } else {
+        stats_inc(&stats->comandos[cmd]);
+        switch (cmd) {
+        case CMD_CONECTAR:
+        case CMD_REGISTRAR:
+            resultado = client_register(pid, cmd == CMD_CONECTAR);
+            break;
+        case CMD_DESCONECTAR: {
+            int i = client_find(pid);
+            if (i >= 0) {
+                printf("Cliente %d desconectado.\n", (int)pid);
+                client_remove(i);
+            }
+            break;
+        }
+        case CMD_LOTE:
+            if (legado) legado_ativo = true;
+            resultado = apply_batch(lote, lote_tamanho);
+            break;
+        case CMD_PAUSAR:
+        case CMD_RETOMAR:
+        case CMD_PASSO:
+            if (legado) legado_ativo = true;
+            run_state_command(cmd);
+            break;
+        default:
+            if (legado) legado_ativo = true;
+            apply_command(cmd);
+            break;
+        }
+    }
+    return resultado;
+}
+
+/**
+ * @brief Processa um comando recebido pela fila e confirma ao remetente.
+ *
+ * A confirmação ("Ack") ecoa a sequência e o instante de envio do
+ * comando e informa o resultado. Só é enviada a remetentes identificados
+ * (pid > 0), que leem o próprio tipo de resposta. O pedido de registro
+ * chega pelo canal legado e é confirmado já no tipo do novo cliente.
+ *
+ * @param msg Mensagem recebida.
+ * @param legado true se veio da fila legada (MSG_TIPO_COMANDO).
+ */
+void handle_command(Message *msg, bool legado) {
+    ComandoId cmd = comando_id(msg->command);
+    ResultadoComando resultado = execute_command(cmd, msg->pid, msg->lote, msg->lote_tamanho,
+                                                 legado);
+
+    caixa_comando(caixa, now_ns(), cmd, resultado, legado,
+                  cmd == CMD_LOTE ? msg->lote_tamanho : 0, msg->pid, msg->seq,
+                  motor_duty(), freioDuty, direcaoMotor);
+
+    // Quem se desconecta não lê mais o tipo de resposta
+    if (msg->pid > 0 && cmd != CMD_DESCONECTAR) {
+        pid_t pid = msg->pid;
+        strcpy(msg->command, "Ack");
+        msg->status = resultado;
+        if (client_reply(pid, msg)) {
+            stats_inc(&stats->acks);
+        } else {
+            stats_inc(&stats->acks_perdidos);
+        }
+    }
+}
+
+/**
+ * @brief Tarefa dos clientes: envia o estado aos assinantes e remove
+ *        clientes que terminaram sem se desconectar.
+ *
+ * O envio usa IPC_NOWAIT, de modo que uma fila cheia descarta a
+ * atualização em vez de bloquear o escalonador. As mensagens de um
+ * cliente morto são descartadas para que a fila não acumule mensagens
+ * que ninguém vai ler.
+ */
+void task_clients() {
+    if (num_clientes == 0) return;
+
+    // Reaproveita a última publicação do anel (no máximo um período de
+    // publicação atrás), sem tomar a trava de novo
+    Message msg;
+    memset(&msg, 0, sizeof(msg));
+    strcpy(msg.command, "Estado");
+    msg.estado = estado_publicado;
+
+    for (int i = num_clientes - 1; i >= 0; i--) {
+        if (kill(clientes[i].pid, 0) < 0 && errno == ESRCH) {
+            printf("Cliente %d encerrado sem se desconectar.\n", (int)clientes[i].pid);
+            client_remove(i);
+            continue;
+        }
+        if (clientes[i].estado) {
+            client_reply(clientes[i].pid, &msg);
+        }
+    }
+}
+
+/**
+ * @brief Consome os comandos pendentes no anel de comandos.
+ *
+ * Até COMANDOS_POR_ATIVACAO comandos por ativação, em ordem de chegada.
+ * Cada comando é executado direto do slot, pelo ComandoId, e confirmado na
+ * caixa de confirmações do cliente, no mesmo segmento: sem chamadas de
+ * sistema, exceto para acordar quem dorme (produtores esperando espaço ou
+ * o cliente esperando a confirmação). Comandos de quem não está mais
+ * registrado (cliente que terminou com comandos no anel) são aplicados sem
+ * confirmação. Uma reserva deixada por um produtor morto é descartada
+ * (anel_cmd_recuperar()).
+ */
+void drain_command_ring() {
+    const SlotComando *slot;
+    int n = 0;
+
+    while (n < COMANDOS_POR_ATIVACAO && (slot = anel_cmd_proximo(anel_cmd)) != NULL) {
+        pid_t pid = client_find(slot->pid) >= 0 ? slot->pid : 0;
+        ComandoId cmd = slot->comando < CMD_NUM ? (ComandoId)slot->comando : CMD_INVALIDO;
+        int lote_tamanho = slot->lote_tamanho <= MAX_LOTE ? slot->lote_tamanho : 0;
+
+        stats_inc(&stats->comandos_anel);
+        ResultadoComando resultado = execute_command(cmd, pid, slot->lote, lote_tamanho, false);
+        caixa_comando(caixa, now_ns(), cmd, resultado, false,
+                      cmd == CMD_LOTE ? lote_tamanho : 0, slot->pid, slot->seq_cmd,
+                      motor_duty(), freioDuty, direcaoMotor);
+
+        // Quem se desconecta não lê mais a caixa
+        if (pid > 0 && cmd != CMD_DESCONECTAR) {
+            const ConfirmacaoAnel conf = { slot->seq_cmd, resultado, slot->t_envio_ns };
+            if (anel_conf_publicar(anel_cmd, slot->confirmacao, pid, &conf)) {
+                stats_inc(&stats->acks);
+            } else {
+                stats_inc(&stats->acks_perdidos);
+            }
+        }
+        anel_cmd_liberar(anel_cmd, slot);
+        n++;
+    }
+
+    int32_t dono;
+    if (slot == NULL && anel_cmd_recuperar(anel_cmd, now_ns(), &dono)) {
+        stats_inc(&stats->reservas_descartadas);
+        if (dono) {
+            fprintf(stderr, "Anel de comandos: reserva do produtor %d (encerrado) descartada\n", (int)dono);
+        } else {
+            fprintf(stderr, "Anel de comandos: reserva sem dono há %d ms descartada\n",
+                    ANEL_CMD_RESERVA_MS);
+        }
+        n++;
+    }
+    if (n > 0) anel_cmd_acordar_produtores(anel_cmd);
+}
+
+/**
+ * @brief Tarefa de comandos: consome os comandos pendentes dos clientes.
+ *
+ * Atende as fontes (cada cliente registrado e a fila legada) em rodízio,
+ * uma mensagem por vez, até COMANDOS_POR_ATIVACAO mensagens por ativação
+ * ou até todas as fontes estarem vazias. Assim um cliente que inunda a
+ * fila não impede que os outros sejam atendidos, e uma rajada de comandos
+ * não atrasa as demais tarefas. O anel de comandos é consumido antes,
+ * com orçamento próprio (drain_command_ring()).
+ */
+void task_commands() {
+    stats_update_queue_depth();
+    drain_command_ring();
+
+    Message msg;
+    int orcamento = COMANDOS_POR_ATIVACAO;
+    int vazias = 0; // Fontes vazias consecutivas
+
+    while (orcamento > 0 && vazias <= num_clientes) {
+        int fontes = num_clientes + 1;
+        int f = rodizio % fontes;
+        bool legado = (f == num_clientes);
+        long tipo = legado ? MSG_TIPO_COMANDO : msg_tipo_cliente_comando(clientes[f].pid);
+        rodizio = (f + 1) % fontes;
+
+        ssize_t lidos;
+        RASTREIO_CHAMADA("msgrcv", lidos = msgrcv(msg_queue_id, &msg, sizeof(msg) - sizeof(long), tipo, IPC_NOWAIT));
+        if (lidos <= 0) {
+            vazias++;
+            continue;
+        }
+        vazias = 0;
+        orcamento--;
+        handle_command(&msg, legado);
+    }
+}
+
+/**
+ * @brief Envia "Encerrar" aos clientes ao fim da execução.
+ *
+ * Os comandos ainda não processados são descartados antes, para liberar
+ * espaço na fila e no anel de comandos. O canal legado (MSG_TIPO_RESPOSTA) só
+ * recebe o aviso se algum painel não registrado enviou comandos.
+ */
+void broadcast_shutdown() {
+    const SlotComando *slot;
+    while ((slot = anel_cmd_proximo(anel_cmd)) != NULL) anel_cmd_liberar(anel_cmd, slot);
+    anel_cmd_acordar_produtores(anel_cmd);
+
+    Message msg;
+    while (msgrcv(msg_queue_id, &msg, sizeof(msg) - sizeof(long), MSG_TIPO_COMANDO, IPC_NOWAIT) > 0) {}
+    for (int i = 0; i < num_clientes; i++) {
+        while (msgrcv(msg_queue_id, &msg, sizeof(msg) - sizeof(long),
+                      msg_tipo_cliente_comando(clientes[i].pid), IPC_NOWAIT) > 0) {}
+    }
+
+    memset(&msg, 0, sizeof(msg));
+    strcpy(msg.command, "Encerrar");
+    for (int i = 0; i < num_clientes; i++) {
+        if (kill(clientes[i].pid, 0) < 0 && errno == ESRCH) continue;
+        if (!client_reply(clientes[i].pid, &msg)) {
+            perror("Erro ao enviar mensagem de encerramento para o Painel");
+        }
+    }
+    if (legado_ativo) {
+        msg.msg_type = MSG_TIPO_RESPOSTA;
+        msg.pid = getpid();
+        if (msgsnd(msg_queue_id, &msg, sizeof(msg) - sizeof(long), IPC_NOWAIT) < 0) {
+            perror("Erro ao enviar mensagem de encerramento para o Painel");
+        }
+    }
+}
+
+/**
+ * @brief Tarefa de exibição: mostra sensores e acionadores no console.
+ */
+void task_display() {
+    if (sem_console) return;
+
+    // Mostrar dados
+    {
+        RASTREIO_ESCOPO("printf");
+        printf("\n===== Dados dos Sensores =====\n");
+        printf("Velocidade: %.2f km/h\n", estado.velocidade);
+        printf("RPM: %.2f\n", estado.rpm);
+        printf("Temperatura: %.2f ºC\n", estado.temperatura);
+        if (execucao != EXEC_RODANDO) {
+            printf("Controle %s (limitadores congelados)\n", NOMES_EXECUCAO[execucao]);
+        }
+    }
+
+    // Exibir status das luzes (cópia sob a trava, impressão fora dele)
+    sync_lock();
+    Status_trigg copia = *status_trigg;
+    sync_unlock();
+    RASTREIO_ESCOPO("printf");
+    printf("\n===== Dados dos Acionadores =====\n");
+    printf("Seta Direita: %s\n", copia.seta_dir ? "Ligado" : "Desligado");
+    printf("Seta Esquerda: %s\n", copia.seta_esq ? "Ligado" : "Desligado");
+    printf("Farol Baixo: %s\n", copia.farol_baixo ? "Ligado" : "Desligado");
+    printf("Farol Alto: %s\n", copia.farol_alto ? "Ligado" : "Desligado");
+}
+
+/**
+ * @brief Monta a tabela de tarefas em ordem rate-monotonic.
+ *
+ * Tarefas de menor período têm maior prioridade e executam primeiro
+ * quando várias são liberadas no mesmo instante; em caso de empate vale a
+ * ordem de declaração. A prioridade resultante é publicada nas estatísticas.
+ *
+ * @param tarefas Vetor com TAREFA_NUM posições a preencher.
+ * @param inicio_ns Instante da primeira liberação de todas as tarefas.
+ */
+void scheduler_init(Tarefa tarefas[], uint64_t inicio_ns) {
+    static void (*const funcoes[TAREFA_NUM])(void) = {
+        task_harvest_pulses, task_limiter, task_temperature,
+        task_publish, task_commands, task_display, task_clients, task_aggregates,
+    };
+
+    for (int i = 0; i < TAREFA_NUM; i++) {
+        tarefas[i].id = (TarefaId)i;
+        tarefas[i].executar = funcoes[i];
+        tarefas[i].periodo_ms = periodo_tarefa_ms[i];
+        tarefas[i].proximo_ns = inicio_ns;
+        tarefas[i].controle = (i == TAREFA_LIMITADOR);
+    }
+
+    // Ordenação por inserção (estável) pelo período
+    for (int i = 1; i < TAREFA_NUM; i++) {
+        Tarefa t = tarefas[i];
+        int j = i - 1;
+        while (j >= 0 && tarefas[j].periodo_ms > t.periodo_ms) {
+            tarefas[j + 1] = tarefas[j];
+            j--;
+        }
+        tarefas[j + 1] = t;
+    }
+
+    for (int i = 0; i < TAREFA_NUM; i++) {
+        TarefaStats *ts = &stats->tarefas[tarefas[i].id];
+        atomic_store_explicit(&ts->periodo_us, tarefas[i].periodo_ms * 1000u, memory_order_relaxed);
+        atomic_store_explicit(&ts->prioridade, (uint32_t)i, memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Executa uma tarefa liberada e atualiza suas estatísticas.
+ *
+ * Mede o atraso de liberação e o tempo de execução. Se, ao terminar, a
+ * próxima liberação já passou, conta um overrun e descarta as liberações
+ * perdidas, mantendo a fase da tarefa.
+ */
+void scheduler_run_task(Tarefa *t) {
+    TarefaStats *ts = &stats->tarefas[t->id];
+    const uint64_t periodo_ns = (uint64_t)t->periodo_ms * 1000000ull;
+
+    uint64_t inicio = now_ns();
+    uint64_t atraso = inicio - t->proximo_ns;
+    {
+        RASTREIO_ESCOPO(NOMES_TAREFAS[t->id]);
+        t->executar();
+    }
+    uint64_t fim = now_ns();
+    uint64_t duracao = fim - inicio;
+
+    stats_inc(&ts->execucoes);
+    stats_add(&ts->tempo_total_ns, duracao);
+    if (duracao > stats_get(&ts->tempo_max_ns)) {
+        atomic_store_explicit(&ts->tempo_max_ns, duracao, memory_order_relaxed);
+    }
+    if (atraso > stats_get(&ts->atraso_max_ns)) {
+        atomic_store_explicit(&ts->atraso_max_ns, atraso, memory_order_relaxed);
+    }
+
+    t->proximo_ns += periodo_ns;
+    if (fim >= t->proximo_ns) {
+        RASTREIO_MARCA("overrun");
+        stats_inc(&ts->overruns);
+        stats_inc(&stats->overruns);
+        t->proximo_ns += ((fim - t->proximo_ns) / periodo_ns + 1) * periodo_ns;
+    }
+}
+
+/**
+ * @brief Pula a liberação de uma tarefa de controle congelada.
+ *
+ * A tarefa mantém a fase: a próxima liberação é a primeira depois de
+ * agora, e a liberação pulada não conta como overrun.
+ */
+void scheduler_skip_task(Tarefa *t, uint64_t agora) {
+    const uint64_t periodo_ns = (uint64_t)t->periodo_ms * 1000000ull;
+    t->proximo_ns += ((agora - t->proximo_ns) / periodo_ns + 1) * periodo_ns;
+    stats_inc(&stats->ciclos_congelados);
+}
+
+/**
+ * @brief Vincula as regras de um programa aos contadores de disparos.
+ *
+ * Os contadores com o nome de um dos limitadores originais (vel_sup,
+ * vel_inf, rpm_sup, rpm_inf, temp) também alimentam as estatísticas lidas
+ * pelo ctlstat e pelo dashboard e usam o alerta correspondente na
+ * caixa-preta; os demais são registrados como ALERTA_REGRA.
+ *
+ * @return false se não há contadores livres.
+ */
+bool bind_rule_counters(ProgramaRegras *prog) {
+    static const char *const NOMES[] = { "vel_sup", "vel_inf", "rpm_sup", "rpm_inf", "temp" };
+    static const AlertaCaixa ALERTAS[] = {
+        ALERTA_VEL_SUP, ALERTA_VEL_INF, ALERTA_RPM_SUP, ALERTA_MOTOR_APAGOU, ALERTA_TEMPERATURA
+    };
+    static uint32_t vinculados = 0;   // Contadores já associados
+    _Atomic uint64_t *const estatisticas[] = {
+        &stats->cont_vel_sup, &stats->cont_vel_inf, &stats->cont_rpm_sup,
+        &stats->cont_rpm_inf, &stats->cont_max_temp
+    };
+
+    if (!regras_vincular(prog, &contadores_regras)) return false;
+    for (; vinculados < contadores_regras.num; vinculados++) {
+        estatistica_regra[vinculados] = NULL;
+        alerta_regra[vinculados] = ALERTA_REGRA;
+        for (int k = 0; k < 5; k++) {
+            if (strcmp(contadores_regras.c[vinculados].nome, NOMES[k]) == 0) {
+                estatistica_regra[vinculados] = estatisticas[k];
+                alerta_regra[vinculados] = ALERTAS[k];
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Relê o arquivo do perfil dos limitadores e publica o novo perfil.
+ *
+ * Um arquivo inválido é rejeitado e o perfil em uso continua valendo. O
+ * perfil substituído é liberado depois do período de graça.
+ */
+void reload_profile() {
+    if (arquivo_perfil == NULL) {
+        fprintf(stderr, "SIGHUP ignorado: nenhum arquivo de perfil dos limitadores (use --limites)\n");
+        return;
+    }
+    PerfilLimitador *novo = malloc(sizeof(*novo));
+    if (novo == NULL) {
+        perror("Erro ao alocar o perfil dos limitadores");
+        return;
+    }
+    if (!perfil_ler(arquivo_perfil, novo) || !bind_rule_counters(&novo->programa)) {
+        free(novo);
+        perfil.rejeitados++;
+        fprintf(stderr, "Perfil dos limitadores mantido (geração %u).\n", perfil_atual(&perfil)->geracao);
+        return;
+    }
+    uint64_t graca_ns = perfil_trocar(&perfil, novo, &running);
+    perfil_imprimir(novo);
+    printf("Perfil anterior liberado após %.2f ms de período de graça.\n", graca_ns / 1e6);
+}
+
+/**
+ * @brief Thread de recarga do perfil dos limitadores: espera o SIGHUP e
+ *        faz a leitura do arquivo e a troca fora da thread de controle.
+ *
+ * É criada antes da configuração de tempo real e não a aplica: roda em
+ * SCHED_OTHER, sem competir com as tarefas de controle.
+ */
+void *threadRecargaPerfil(void *arg) {
+    (void)arg;
+    rastreio_registrar_thread("recarga");
+    while (running) {
+        if (sem_wait(&sem_recarga) == -1) continue; // EINTR
+        if (!running) break;
+        RASTREIO_CHAMADA("reload_profile", reload_profile());
+    }
+    return NULL;
+}
+
+/**
+ * @brief Leva os atuadores ao estado seguro: motor em 0 e luz de freio acesa.
+ *
+ * Chamada pela thread do vigia, sem a trava (a thread atrasada pode estar
+ * com ela). Zera o duty e marca MOTOR_SEGURO na mesma troca atômica: daí
+ * em diante motor_write() recusa qualquer escrita. A direção e o duty do
+ * freio não mudam.
+ */
+void enter_safe_state() {
+    atomic_store_explicit(&motor_saida, MOTOR_SEGURO, memory_order_release);
+    softPwmWrite(MOTOR_POT, 0);
+    digitalWrite(LUZ_FREIO, HIGH);
+    atomic_store_explicit(&stats->vigia_seguro, 1, memory_order_relaxed);
+    stats_inc(&stats->vigia_estados_seguros);
+    fprintf(stderr, "[Vigia] Estado seguro: motor em 0 e luz de freio acesa\n");
+}
+
+/**
+ * @brief Deixa o estado seguro depois de todas as threads voltarem ao prazo.
+ *
+ * O motor continua em 0 até o próximo comando do acelerador.
+ */
+void leave_safe_state() {
+    atomic_store_explicit(&motor_saida, 0, memory_order_release);
+    digitalWrite(LUZ_FREIO, direcaoMotor == 'B' ? HIGH : LOW);
+    atomic_store_explicit(&stats->vigia_seguro, 0, memory_order_relaxed);
+    fprintf(stderr, "[Vigia] Threads em dia há %d ms; estado seguro desfeito\n", VIGIA_SAIDA_MS);
+}
+
+/**
+ * @brief Confere o limite de cada thread supervisionada.
+ *
+ * Uma thread além do limite perde o prazo: a perda é contada e registrada
+ * uma vez por travamento, com o instante da detecção, e o seu atraso e o
+ * nível atingido são atualizados até a thread voltar.
+ *
+ * @param agora Instante da conferência.
+ * @param em_curso Registro da perda em curso de cada thread (UINT64_MAX: nenhuma).
+ * @return O maior nível de escalada pedido pelas threads atrasadas, ou -1 se
+ *         todas estão em dia.
+ */
+int watchdog_check(uint64_t agora, uint64_t em_curso[]) {
+    int pior = -1;
+    uint32_t atrasadas = 0;
+    for (int i = 0; i < VIGIA_NUM_THREADS; i++) {
+        VigiaThreadStats *v = &stats->vigia[i];
+        uint64_t limite = atomic_load_explicit(&v->limite_ns, memory_order_acquire);
+        if (limite == 0 || agora <= limite) {
+            if (em_curso[i] != UINT64_MAX) {
+                fprintf(stderr, "[Vigia] %s voltou ao prazo\n", NOMES_THREADS[i]);
+                em_curso[i] = UINT64_MAX;
+            }
+            continue;
+        }
+
+        uint64_t atraso = agora - limite;
+        uint64_t folga = (uint64_t)atomic_load_explicit(&v->prazo_ms, memory_order_relaxed) * 1000000ull;
+        int nivel = atraso >= VIGIA_ENCERRAR_PRAZOS * folga ? VIGIA_ENCERRAR
+                  : atraso >= VIGIA_SEGURO_PRAZOS * folga ? VIGIA_SEGURO : VIGIA_REGISTRAR;
+        if (nivel > (int)vigia_escalada) nivel = (int)vigia_escalada;
+        if (nivel > pior) pior = nivel;
+        atrasadas++;
+
+        uint64_t n = stats_get(&stats->vigia_perdas);
+        if (em_curso[i] == UINT64_MAX) {
+            PerdaPrazo *r = &stats->vigia_registro[n % VIGIA_REGISTROS];
+            atomic_store_explicit(&r->t_ns, agora, memory_order_relaxed);
+            atomic_store_explicit(&r->thread, (uint32_t)i, memory_order_relaxed);
+            atomic_store_explicit(&r->nivel, VIGIA_REGISTRAR, memory_order_relaxed);
+            atomic_store_explicit(&r->atraso_ns, atraso, memory_order_relaxed);
+            atomic_store_explicit(&stats->vigia_perdas, n + 1, memory_order_release);
+            stats_inc(&v->perdas);
+            em_curso[i] = n++;
+            fprintf(stderr, "[Vigia] %s perdeu o prazo: sem batimento há %.1f ms além da folga de %u ms\n",
+                    NOMES_THREADS[i], atraso / 1e6, (unsigned)(folga / 1000000ull));
+        }
+        // Registro ainda no anel: atualiza o atraso e o nível atingido
+        if (n - em_curso[i] <= VIGIA_REGISTROS) {
+            PerdaPrazo *r = &stats->vigia_registro[em_curso[i] % VIGIA_REGISTROS];
+            atomic_store_explicit(&r->atraso_ns, atraso, memory_order_relaxed);
+            if ((uint32_t)nivel > atomic_load_explicit(&r->nivel, memory_order_relaxed)) {
+                atomic_store_explicit(&r->nivel, (uint32_t)nivel, memory_order_relaxed);
+            }
+        }
+        if (atraso > stats_get(&v->pior_atraso_ns)) {
+            atomic_store_explicit(&v->pior_atraso_ns, atraso, memory_order_relaxed);
+        }
+    }
+    atomic_store_explicit(&stats->vigia_atrasadas, atrasadas, memory_order_relaxed);
+    return pior;
+}
+
+/**
+ * @brief Thread do vigia de prazos.
+ *
+ * A cada VIGIA_PERIODO_MS confere os limites das threads supervisionadas
+ * (controle, setas e dash) e escala as perdas até o nível de --vigia:
+ * registrar sempre; estado seguro quando a thread passa do limite por mais
+ * VIGIA_SEGURO_PRAZOS folgas, desfeito depois de VIGIA_SAIDA_MS com todas
+ * em dia; encerramento depois de VIGIA_ENCERRAR_PRAZOS folgas. Se o
+ * encerramento normal não terminar em VIGIA_GRACA_MS (uma thread continua
+ * travada), o processo sai com os atuadores no estado seguro.
+ *
+ * @param arg Argumento da thread (não utilizado)
+ * @return NULL
+ */
+void *threadVigia(void *arg) {
+    (void)arg;
+    stats_register_thread(STATS_TH_VIGIA);
+    rt_apply_thread(STATS_TH_VIGIA);
+
+    const uint64_t periodo_ns = VIGIA_PERIODO_MS * 1000000ull;
+    uint64_t em_curso[VIGIA_NUM_THREADS];
+    for (int i = 0; i < VIGIA_NUM_THREADS; i++) em_curso[i] = UINT64_MAX;
+    uint64_t ultimo_atraso_ns = 0;
+    bool encerrar = false;
+
+    uint64_t proximo_ns = now_ns();
+    while (running) {
+        stats_inc(&stats_thread->iteracoes);
+        uint64_t agora = now_ns();
+        int pior = watchdog_check(agora, em_curso);
+
+        if (pior >= 0) ultimo_atraso_ns = agora;
+        if (pior >= VIGIA_SEGURO && !safe_state_active()) {
+            enter_safe_state();
+        } else if (pior < 0 && safe_state_active() &&
+                   agora - ultimo_atraso_ns >= VIGIA_SAIDA_MS * 1000000ull) {
+            leave_safe_state();
+        }
+        if (pior == VIGIA_ENCERRAR) {
+            fprintf(stderr, "[Vigia] Encerrando o controlador\n");
+            encerrar = true;
+            running = 0;
+            break;
+        }
+
+        proximo_ns += periodo_ns;
+        if (proximo_ns <= agora) proximo_ns = agora + periodo_ns; // Vigia atrasado: mantém o período
+        rt_sleep_until_ns(proximo_ns);
+    }
+    if (!encerrar) return NULL;
+
+    uint64_t prazo_ns = now_ns() + VIGIA_GRACA_MS * 1000000ull;
+    while (!atomic_load(&controle_encerrado) && now_ns() < prazo_ns) {
+        rt_sleep_ns(periodo_ns);
+    }
+    if (!atomic_load(&controle_encerrado)) {
+        // Uma thread segue travada e process_control não volta: sai sem a
+        // limpeza normal (os segmentos ficam para um --warm)
+        softPwmWrite(MOTOR_POT, 0);
+        digitalWrite(LUZ_FREIO, HIGH);
+        fprintf(stderr, "[Vigia] Encerramento não concluído em %d ms; saindo com o motor em 0\n",
+                VIGIA_GRACA_MS);
+        usleep(20000); // Um ciclo do PWM por software com o duty já em 0
+        _exit(EXIT_FAILURE);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Executa o controle principal do sistema.
+ *
+ * A função process_control é responsável por criar e gerenciar threads
+ * para piscar setas, ler comandos do painel e vigiar os prazos. Em seguida, executa o
+ * escalonador multi-taxa da thread de controle: coleta dos sensores Hall,
+ * limitadores, temperatura, publicação na memória compartilhada, comandos
+ * do painel e exibição são tarefas independentes, cada uma com seu
+ * período e prioridade (rate-monotonic).
+ *
+ * A cada despertar, todas as tarefas liberadas executam em ordem de
+ * prioridade, exceto as de controle quando a execução está pausada; a thread
+ * então dorme até a próxima liberação (prazo absoluto), de modo que as
+ * tarefas rápidas continuam rápidas e as lentas não executam mais do que o
+ * necessário.
  *
- * A função process_control é responsável por criar e gerenciar threads
- * para piscar setas e ler comandos do painel. Ela executa o loop principal
- * que monitora dados de sensores como velocidade, RPM e temperatura,
- * aplicando regras de segurança e limites. A função também processa
- * comandos recebidos do painel de controle, permitindo a interação
- * com diversos acionadores, como setas, faróis, e pedais do veículo.
- * 
- * A função garante a correta sincronização de dados compartilhados
- * utilizando semáforos e gerencia o estado dos acionadores do veículo.
- * 
  * @note A função foi incrementada com a Thread do Dashboard,
  * para ler os comandos do painel e executar as ações correspondentes.
  */
 void process_control() {
+    // A thread principal passa a ser a thread de controle; as threads
+    // criadas abaixo herdam essa configuração até aplicarem a própria
+    stats_register_thread(STATS_TH_CONTROLE);
+    rt_apply_thread(STATS_TH_CONTROLE);
+
     // Criar threads para piscar setas
     pthread_t th_esq, th_dir, th_comandos;
     if (pthread_create(&th_esq, NULL, threadPiscaSetaEsq, NULL) != 0) {
@@ -692,171 +2719,49 @@ void process_control() {
         perror("Erro ao criar thread comandos do dashboard");
         exit(EXIT_FAILURE);
     }
+    pthread_t th_vigia;
+    if (pthread_create(&th_vigia, NULL, threadVigia, NULL) != 0) {
+        perror("Erro ao criar thread do vigia de prazos");
+        exit(EXIT_FAILURE);
+    }
 
-    // Loop principal
-    while (running) {
-        float aux_vel, aux_temp, aux_rpm;
-
-        // Obter dados da memória
-        sem_wait(sem_sync);
-        aux_vel = shared_data->velocidade;
-        aux_rpm = shared_data->rpm;
-        aux_temp = shared_data->temperatura;
-        sem_post(sem_sync);
+    // Escalonador multi-taxa: todas as tarefas em fase a partir de agora
+    Tarefa tarefas[TAREFA_NUM];
+    scheduler_init(tarefas, now_ns());
 
-        // Mostrar dados
-        printf("\n===== Dados dos Sensores =====\n");
-        printf("Velocidade: %.2f km/h\n", aux_vel);
-        printf("RPM: %.2f\n", aux_rpm);
-        printf("Temperatura: %.2f ºC\n", aux_temp);
-
-        // Atualizar velocidade e RPM
-        clock_gettime(CLOCK_MONOTONIC, &ultimoTempoRoda_a);
-        clock_gettime(CLOCK_MONOTONIC, &ultimoTempoRoda_b);
-        clock_gettime(CLOCK_MONOTONIC, &ultimoTempoMotor);
-        aux_vel = velocidade();
-        aux_rpm = motor_rpm();
-
-        // Regras de limite
-        if (aux_vel > 200.0) {
-            motorDuty = (motorDuty > 0) ? motorDuty - 1 : 0;
-            softPwmWrite(MOTOR_POT, motorDuty);
-            cont_vel_sup++;
-        } else if (aux_vel < 20.0 && aux_vel > 0.0) {
-            motorDuty = (motorDuty < 10) ? motorDuty + 1 : 10;
-            softPwmWrite(MOTOR_POT, motorDuty); 
-            cont_vel_inf++;
-        }
-        if (aux_rpm > 7000) {
-            motorDuty = (motorDuty > 0) ? motorDuty - 1 : 0;
-            softPwmWrite(MOTOR_POT, motorDuty);
-            cont_rpm_sup++;
-        } else if (aux_rpm < 780) {
-            motorDuty = 0;
-            softPwmWrite(MOTOR_POT, motorDuty); 
-            cont_rpm_inf++;
-            printf("\n========= O motor apagou =========\n");
-            raise(SIGUSR2);
-        }
-        if (aux_temp >= MAX_TEMP_MOTOR) {
-            printf("\n========= ALERTA DE TEMPERATURA =========\n");
-            cont_max_temp++;
-            motorDuty = (motorDuty > 0) ? motorDuty - 1 : 0;
-            softPwmWrite(MOTOR_POT, motorDuty);
-            digitalWrite(LUZ_TEMP_MOTOR, HIGH);
-        } else {
-            digitalWrite(LUZ_TEMP_MOTOR, LOW);
-        }
-
-        // Atualizar memória
-        sem_wait(sem_sync);
-        shared_data->velocidade  = aux_vel;
-        shared_data->rpm         = aux_rpm;
-        shared_data->temperatura = calculate_engine_temp(aux_vel, aux_rpm);
-        sem_post(sem_sync);
-
-        // Exibir status das luzes
-        sem_wait(sem_sync);
-        printf("\n===== Dados dos Acionadores =====\n");
-        printf("Seta Direita: %s\n", status_trigg->seta_dir ? "Ligado" : "Desligado");
-        printf("Seta Esquerda: %s\n", status_trigg->seta_esq ? "Ligado" : "Desligado");
-        printf("Farol Baixo: %s\n", status_trigg->farol_baixo ? "Ligado" : "Desligado");
-        printf("Farol Alto: %s\n", status_trigg->farol_alto ? "Ligado" : "Desligado");
-        sem_post(sem_sync);
-
-        // Ler comandos do painel
-        Message msg;
-        if (msgrcv(msg_queue_id, &msg, sizeof(msg) - sizeof(long), 1, IPC_NOWAIT) > 0) {
-            printf("\n ===== Comando recebido do Painel: %s =====\n", msg.command);
-
-            // Processar comando
-            if (strcmp(msg.command, "Ligar Seta Esquerda") == 0) {
-                sem_wait(sem_sync);
-                status_trigg->seta_esq = true;
-                sem_post(sem_sync);
-            } else if (strcmp(msg.command, "Desligar Seta Esquerda") == 0) {
-                sem_wait(sem_sync);
-                status_trigg->seta_esq = false;
-                sem_post(sem_sync);
-            } else if (strcmp(msg.command, "Ligar Seta Direita") == 0) {
-                sem_wait(sem_sync);
-                status_trigg->seta_dir = true;
-                sem_post(sem_sync);
-            } else if (strcmp(msg.command, "Desligar Seta Direita") == 0) {
-                sem_wait(sem_sync);
-                status_trigg->seta_dir = false;
-                sem_post(sem_sync);
-            } else if (strcmp(msg.command, "Ligar Pisca-Alerta") == 0) {
-                sem_wait(sem_sync);
-                status_trigg->seta_esq= true;
-                status_trigg->seta_dir = true;
-                sem_post(sem_sync);
-            } else if (strcmp(msg.command, "Desligar Pisca-Alerta") == 0) {
-                sem_wait(sem_sync);
-                status_trigg->seta_esq = false;
-                status_trigg->seta_dir = false;
-                sem_post(sem_sync);
-            } else if (strcmp(msg.command, "Ligar Farol Baixo") == 0) {
-                digitalWrite(FAROL_BAIXO, HIGH);
-                sem_wait(sem_sync);
-                status_trigg->farol_baixo = true;
-                sem_post(sem_sync);
-            } else if (strcmp(msg.command, "Desligar Farol Baixo") == 0) {
-                digitalWrite(FAROL_BAIXO, LOW);
-                sem_wait(sem_sync);
-                status_trigg->farol_baixo = false;
-                sem_post(sem_sync);
-            } else if (strcmp(msg.command, "Ligar Farol Alto") == 0) {
-                digitalWrite(FAROL_ALTO, HIGH);
-                sem_wait(sem_sync);
-                status_trigg->farol_alto = true;
-                sem_post(sem_sync);
-            } else if (strcmp(msg.command, "Desligar Farol Alto") == 0) {
-                digitalWrite(FAROL_ALTO, LOW);
-                sem_wait(sem_sync);
-                status_trigg->farol_alto = false;
-                sem_post(sem_sync);
-            } else if (strcmp(msg.command, "Desligar Farol") == 0) {
-                digitalWrite(FAROL_BAIXO, LOW);
-                digitalWrite(FAROL_ALTO, LOW);
-                sem_wait(sem_sync);
-                status_trigg->farol_baixo = false;
-                status_trigg->farol_alto = false;
-                sem_post(sem_sync);
-            } else if (strcmp(msg.command, "Acionar Pedal do Acelerador") == 0) {
-                // Desabilitar freio
-                freioDuty = 0;
-                softPwmWrite(FREIO_INT, freioDuty);
-                digitalWrite(LUZ_FREIO, LOW);
-
-                // Ajustar direção para frente
-                motor_set_direction('D');
-
-                // Aumentar duty cycle do motor
-                motorDuty = (motorDuty < 10) ? motorDuty + 1 : 10;
-                softPwmWrite(MOTOR_POT, motorDuty);
-
-            } else if (strcmp(msg.command, "Acionar Pedal do Freio") == 0) {
-                // Desabilitar motor
-                motorDuty = 0;
-                softPwmWrite(MOTOR_POT, motorDuty);
-                digitalWrite(LUZ_FREIO, HIGH);
-                
-                // Setar motor em 'B' (freio ativo)
-                motor_set_direction('B');
-
-                // Aumentar duty cycle do freio
-                freioDuty = (freioDuty < 10) ? freioDuty + 1 : 10;
-                softPwmWrite(FREIO_INT, freioDuty);
-
-            } else if (strcmp(msg.command, "Encerrar") == 0) {
-                raise(SIGUSR2);
+    while (running) {
+        stats_inc(&stats_thread->iteracoes);
+        run_state_poll_signal();
+
+        // Pausado, as tarefas de controle são puladas; as demais (sensores,
+        // publicação, comandos) seguem no próprio período
+        uint64_t agora = now_ns();
+        for (int i = 0; i < TAREFA_NUM && running; i++) {
+            Tarefa *t = &tarefas[i];
+            if (agora < t->proximo_ns) continue;
+            if (t->controle && !run_state_allows_control()) {
+                scheduler_skip_task(t, agora);
+                continue;
             }
+            scheduler_run_task(t);
+            if (t->controle) run_state_control_done();
         }
-        
-        // Simular tempo de processamento
-        sleep(2);
+        perfil_quiescente(&perfil); // Nenhum perfil lido até aqui segue em uso
+
+        // Dormir até a próxima liberação
+        uint64_t proximo_ns = tarefas[0].proximo_ns;
+        for (int i = 1; i < TAREFA_NUM; i++) {
+            if (tarefas[i].proximo_ns < proximo_ns) proximo_ns = tarefas[i].proximo_ns;
+        }
+        rt_sleep_until_ns(proximo_ns);
     }
+
+    // Aguardar as threads antes que cleanup() desanexe as memórias
+    pthread_join(th_esq, NULL);
+    pthread_join(th_dir, NULL);
+    pthread_join(th_comandos, NULL);
+    atomic_store(&controle_encerrado, true);
+    pthread_join(th_vigia, NULL);
 }
 
 
@@ -869,7 +2774,6 @@ void process_control() {
  *  - Desligar todos os faróis, setas e outras luzes associadas.
  *  - Desanexar e remover a memória compartilhada utilizada para armazenar
  *    dados dos sensores e acionadores (SensorData e Status_trigg).
- *  - Fechar e desvincular o semáforo usado para sincronização entre threads.
  *
  * A função é protegida contra múltiplas execuções por meio de uma verificação
  * interna, garantindo que os recursos sejam liberados apenas uma vez.
@@ -896,6 +2800,15 @@ void cleanup() {
 
     printf("======== Limpando recursos...========\n");
 
+    // Fechar a caixa-preta com as saídas ainda no estado final
+    if (caixa) {
+        uint64_t registros = atomic_load_explicit(&caixa->escritos, memory_order_relaxed) + 1;
+        caixa_fechar(caixa, now_ns(), motor_duty(), freioDuty, direcaoMotor);
+        caixa = NULL;
+        printf("Caixa-preta: %llu registros gravados em %s (decodifique com ./caixa_preta).\n",
+               (unsigned long long)registros, arquivo_caixa);
+    }
+
     // Zerar PWM
     softPwmWrite(MOTOR_POT, 0);
     softPwmWrite(FREIO_INT, 0);
@@ -909,25 +2822,224 @@ void cleanup() {
     digitalWrite(LUZ_TEMP_MOTOR, LOW);
     digitalWrite(LUZ_FREIO, LOW);
 
-    // Desanexar e remover memória compartilhada
+    // Desanexar e remover memória compartilhada. Com --preservar, os
+    // segmentos que um --warm adota (sensores, acionadores e os anéis) são
+    // apenas desanexados
     if (shared_data) {
         shmdt(shared_data);
-        shmctl(shm_id_sensors, IPC_RMID, NULL);
+        if (!preservar_estado) shmctl(shm_id_sensors, IPC_RMID, NULL);
     }
     if (status_trigg) {
         shmdt(status_trigg);
-        shmctl(shm_id_triggers, IPC_RMID, NULL);
+        if (!preservar_estado) shmctl(shm_id_triggers, IPC_RMID, NULL);
     }
 
-    // Fechar semáforo
-    if (sem_sync) {
-        sem_close(sem_sync);
-        sem_unlink("/sem_sync");
+    // Remover o segmento de estatísticas (leitores anexados mantêm a cópia
+    // até se desanexarem)
+    if (stats) {
+        shmdt(stats);
+        shmctl(shm_id_stats, IPC_RMID, NULL);
     }
 
+    if (difusao) {
+        shmdt(difusao);
+        if (!preservar_estado) shmctl(shm_id_difusao, IPC_RMID, NULL);
+    }
+    if (anel_cmd) {
+        shmdt(anel_cmd);
+        if (!preservar_estado) shmctl(shm_id_anel_cmd, IPC_RMID, NULL);
+    }
+    if (preservar_estado) printf("Estado preservado para um reinício a quente (--warm).\n");
+
     printf("======== Recursos liberados com sucesso!========\n");
 }
 
+/**
+ * @brief Exibe, no relatório final, as estatísticas dos sensores em cada
+ *        janela deslizante, calculadas no instante do encerramento.
+ */
+void print_aggregates_report() {
+    task_aggregates();
+    AgregadoJanela a[SINAL_NUM][AGR_NUM_JANELAS];
+    stats_read_aggregates(stats, a);
+
+    printf("\nEstatísticas dos sensores (janelas deslizantes até o encerramento):\n");
+    printf("%-12s %6s %9s %9s %9s %9s %9s %9s\n", "sinal", "janela", "mín", "média", "máx",
+           "p50", "p95", "p99");
+    for (int s = 0; s < SINAL_NUM; s++) {
+        for (int j = 0; j < AGR_NUM_JANELAS; j++) {
+            const AgregadoJanela *w = &a[s][j];
+            printf("%-12s %5us %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f\n",
+                   j == 0 ? NOMES_SINAIS[s] : "", JANELAS_AGR_S[j], w->min, w->media, w->max,
+                   w->p50, w->p95, w->p99);
+        }
+    }
+}
+
+/**
+ * @brief Exibe o pior atraso ao despertar medido em cada thread periódica.
+ */
+void print_jitter_report() {
+    printf("======== LATÊNCIA DE DESPERTAR (%s) ========\n\n",
+           rt_ativo ? "modo tempo real" : "escalonador padrão");
+    for (int i = 0; i < STATS_NUM_THREADS; i++) {
+        uint64_t n = stats_get(&stats->threads[i].despertares);
+        uint64_t total = stats_get(&stats->threads[i].atraso_total_ns);
+        uint64_t max = stats_get(&stats->threads[i].atraso_max_ns);
+        printf("%-9s %8llu despertares, atraso médio %8.1f us, pior caso %8.1f us\n",
+               NOMES_THREADS[i], (unsigned long long)n,
+               n ? total / 1000.0 / n : 0.0, max / 1000.0);
+    }
+    printf("===================================================\n\n");
+}
+
+/**
+ * @brief Exibe, por tarefa do escalonador, período, prioridade, tempo de
+ *        execução e overruns.
+ */
+void print_scheduler_report() {
+    printf("======== ESCALONADOR MULTI-TAXA ========\n\n");
+    printf("%-12s %8s %4s %10s %10s %10s %11s %9s\n", "tarefa", "período", "prio",
+           "execuções", "exec_méd", "exec_máx", "atraso_máx", "overruns");
+    for (int i = 0; i < TAREFA_NUM; i++) {
+        const TarefaStats *ts = &stats->tarefas[i];
+        uint64_t n = stats_get(&ts->execucoes);
+        printf("%-12s %6.1fms %4u %10llu %8.1fus %8.1fus %9.1fus %9llu\n", NOMES_TAREFAS[i],
+               atomic_load_explicit((_Atomic uint32_t *)&ts->periodo_us, memory_order_relaxed) / 1000.0,
+               atomic_load_explicit((_Atomic uint32_t *)&ts->prioridade, memory_order_relaxed),
+               (unsigned long long)n,
+               n ? stats_get(&ts->tempo_total_ns) / 1000.0 / n : 0.0,
+               stats_get(&ts->tempo_max_ns) / 1000.0,
+               stats_get(&ts->atraso_max_ns) / 1000.0,
+               (unsigned long long)stats_get(&ts->overruns));
+    }
+    printf("===================================================\n\n");
+}
+
+/**
+ * @brief Exibe os pontos de aquisição da trava, ordenados pelo tempo total
+ *        de espera, com os percentis de espera e de posse.
+ */
+void print_contention_report() {
+    printf("======== CONTENÇÃO DA TRAVA ========\n\n");
+    const TabelaContencao *tabela = &stats->contencao;
+    contencao_relatorio(stdout, &tabela, 1);
+    printf("===================================================\n\n");
+}
+
+/**
+ * @brief Exibe, por thread supervisionada, a folga, os batimentos, as perdas
+ *        de prazo e o pior atraso, seguidos das últimas perdas registradas.
+ */
+void print_watchdog_report() {
+    printf("======== VIGIA DE PRAZOS (escalada até \"%s\") ========\n\n",
+           NOMES_NIVEIS_VIGIA[vigia_escalada]);
+    printf("%-9s %7s %11s %7s %12s\n", "thread", "folga", "batimentos", "perdas", "pior_atraso");
+    for (int i = 0; i < VIGIA_NUM_THREADS; i++) {
+        const VigiaThreadStats *v = &stats->vigia[i];
+        printf("%-9s %5ums %11llu %7llu %10.1fms\n", NOMES_THREADS[i],
+               atomic_load_explicit((_Atomic uint32_t *)&v->prazo_ms, memory_order_relaxed),
+               (unsigned long long)stats_get(&v->batimentos),
+               (unsigned long long)stats_get(&v->perdas),
+               stats_get(&v->pior_atraso_ns) / 1e6);
+    }
+    printf("Estado seguro: %llu vezes.\n", (unsigned long long)stats_get(&stats->vigia_estados_seguros));
+
+    // Instantes no relógio monotônico, os mesmos do rastreio (--rastreio)
+    uint64_t perdas = stats_get(&stats->vigia_perdas);
+    uint64_t primeira = perdas > VIGIA_REGISTROS ? perdas - VIGIA_REGISTROS : 0;
+    if (perdas > 0) printf("Últimas perdas:\n");
+    for (uint64_t n = primeira; n < perdas; n++) {
+        const PerdaPrazo *r = &stats->vigia_registro[n % VIGIA_REGISTROS];
+        printf("  t=%.3f s  %-9s %8.1f ms além do limite (%s)\n",
+               stats_get(&r->t_ns) / 1e9, NOMES_THREADS[r->thread], stats_get(&r->atraso_ns) / 1e6,
+               NOMES_NIVEIS_VIGIA[r->nivel]);
+    }
+    printf("===================================================\n\n");
+}
+
+/**
+ * @brief Interpreta "thread=ms" de --prazo e ajusta a folga da thread.
+ *
+ * @return true se a thread for supervisionada e a folga for válida.
+ */
+bool parse_thread_deadline(const char *arg) {
+    const char *igual = strchr(arg, '=');
+    if (!igual) return false;
+    size_t tam = (size_t)(igual - arg);
+
+    char *fim;
+    long ms = strtol(igual + 1, &fim, 10);
+    if (*fim != '\0' || ms < 1 || ms > 60000) return false;
+
+    for (int i = 0; i < VIGIA_NUM_THREADS; i++) {
+        if (strlen(NOMES_THREADS[i]) == tam && strncmp(arg, NOMES_THREADS[i], tam) == 0) {
+            prazo_thread_ms[i] = (uint32_t)ms;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Interpreta "nome=ms" de --tarefa e ajusta o período da tarefa.
+ *
+ * @return true se a tarefa existir e o período for válido.
+ */
+bool parse_task_period(const char *arg) {
+    const char *igual = strchr(arg, '=');
+    if (!igual) return false;
+    size_t tam = (size_t)(igual - arg);
+
+    char *fim;
+    long ms = strtol(igual + 1, &fim, 10);
+    if (*fim != '\0' || ms < PERIODO_MIN_MS || ms > 60000) return false;
+
+    for (int i = 0; i < TAREFA_NUM; i++) {
+        if (strlen(NOMES_TAREFAS[i]) == tam && strncmp(arg, NOMES_TAREFAS[i], tam) == 0) {
+            periodo_tarefa_ms[i] = (uint32_t)ms;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Exibe a ajuda da linha de comando.
+ */
+void print_usage(const char *prog) {
+    printf("Uso: %s [opções]\n", prog);
+    printf("  -r, --rt <arquivo>     Habilita o modo de tempo real (SCHED_FIFO,\n");
+    printf("                         afinidade de CPU e mlockall) conforme o arquivo\n");
+    printf("  -p, --periodo <ms>     Período da tarefa dos limitadores (padrão %d ms)\n",
+           PERIODO_LIMITADOR_MS);
+    printf("  -t, --tarefa <nome=ms> Período de uma tarefa do escalonador; pode ser\n");
+    printf("                         repetida. Tarefas:");
+    for (int i = 0; i < TAREFA_NUM; i++) printf(" %s", NOMES_TAREFAS[i]);
+    printf("\n");
+    printf("  -H, --headless         Sem saída periódica no console (use o dashboard)\n");
+    printf("  -w, --warm             Reinício a quente: adota sensores, acionadores,\n");
+    printf("                         atuadores, clientes e comandos pendentes deixados\n");
+    printf("                         por outro controlador\n");
+    printf("  -k, --preservar        Ao encerrar, mantém o estado para um --warm\n");
+    printf("  -b, --caixa-preta <arquivo>\n");
+    printf("                         Arquivo da caixa-preta (padrão %s)\n", CAIXA_ARQUIVO_PADRAO);
+    printf("  -B, --sem-caixa-preta  Não grava a caixa-preta\n");
+    printf("  -l, --limites <arquivo>\n");
+    printf("                         Perfil dos limitadores; relido com SIGHUP\n");
+    printf("  -T, --rastreio <arquivo>\n");
+    printf("                         Rastreia as threads e exporta o rastreio (JSON do\n");
+    printf("                         Chrome/Perfetto) com SIGPROF e ao encerrar\n");
+    printf("  -V, --vigia <nível>    Escalada do vigia de prazos: registrar, seguro\n");
+    printf("                         (padrão; motor em 0 e luz de freio) ou encerrar\n");
+    printf("  -P, --prazo <thread=ms>\n");
+    printf("                         Folga de uma thread supervisionada além do despertar;\n");
+    printf("                         pode ser repetida. Threads:");
+    for (int i = 0; i < VIGIA_NUM_THREADS; i++) printf(" %s=%u", NOMES_THREADS[i], prazo_thread_ms[i]);
+    printf("\n");
+    printf("  -h, --help             Mostra esta ajuda\n");
+}
+
 /**
  * @brief Ponto de entrada do programa.
  *
@@ -935,37 +3047,188 @@ void cleanup() {
  * programa. Ao final, limpa todos os recursos e exibe um relatório sobre os
  * acionamentos dos limitadores do programa.
  *
+ * @note Com a opção --rt, a memória é travada e pré-carregada antes da
+ * criação de qualquer thread, e as threads criadas pela WiringPi herdam a
+ * configuração "pwm" da thread principal.
+ *
  * @return 0 se o programa for executado com sucesso.
  */
-int main() {
+int main(int argc, char *argv[]) {
+    static const struct option opcoes[] = {
+        {"rt",      required_argument, NULL, 'r'},
+        {"periodo", required_argument, NULL, 'p'},
+        {"tarefa",  required_argument, NULL, 't'},
+        {"headless", no_argument,      NULL, 'H'},
+        {"warm",    no_argument,       NULL, 'w'},
+        {"preservar", no_argument,     NULL, 'k'},
+        {"caixa-preta", required_argument, NULL, 'b'},
+        {"sem-caixa-preta", no_argument, NULL, 'B'},
+        {"limites", required_argument, NULL, 'l'},
+        {"rastreio", required_argument, NULL, 'T'},
+        {"vigia",   required_argument, NULL, 'V'},
+        {"prazo",   required_argument, NULL, 'P'},
+        {"help",    no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+    uint64_t inicio_ns = now_ns();
+    int opt;
+    while ((opt = getopt_long(argc, argv, "r:p:t:Hwkb:Bl:T:V:P:h", opcoes, NULL)) != -1) {
+        switch (opt) {
+        case 'r':
+            rt_load_config(optarg);
+            break;
+        case 'p': {
+            char *fim;
+            long ms = strtol(optarg, &fim, 10);
+            if (*fim != '\0' || ms < PERIODO_MIN_MS || ms > 60000) {
+                fprintf(stderr, "Período inválido: %s (use %d a 60000 ms)\n", optarg, PERIODO_MIN_MS);
+                return EXIT_FAILURE;
+            }
+            periodo_tarefa_ms[TAREFA_LIMITADOR] = (uint32_t)ms;
+            break;
+        }
+        case 't':
+            if (!parse_task_period(optarg)) {
+                fprintf(stderr, "Tarefa inválida: %s (use nome=ms, %d a 60000 ms)\n",
+                        optarg, PERIODO_MIN_MS);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'H':
+            sem_console = true;
+            break;
+        case 'w':
+            reinicio_quente = true;
+            break;
+        case 'k':
+            preservar_estado = true;
+            break;
+        case 'b':
+            arquivo_caixa = optarg;
+            break;
+        case 'B':
+            arquivo_caixa = NULL;
+            break;
+        case 'l':
+            arquivo_perfil = optarg;
+            break;
+        case 'T':
+            rastreio_arquivo = optarg;
+            break;
+        case 'V': {
+            int n = 0;
+            while (n < VIGIA_NUM_NIVEIS && strcmp(optarg, NOMES_NIVEIS_VIGIA[n]) != 0) n++;
+            if (n == VIGIA_NUM_NIVEIS) {
+                fprintf(stderr, "Nível do vigia inválido: %s (use registrar, seguro ou encerrar)\n", optarg);
+                return EXIT_FAILURE;
+            }
+            vigia_escalada = (NivelVigia)n;
+            break;
+        }
+        case 'P':
+            if (!parse_thread_deadline(optarg)) {
+                fprintf(stderr, "Prazo inválido: %s (use thread=ms, 1 a 60000 ms)\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'h':
+            print_usage(argv[0]);
+            return 0;
+        default:
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Perfil inicial dos limitadores (o padrão sem --limites)
+    PerfilLimitador *inicial = malloc(sizeof(*inicial));
+    if (inicial == NULL) {
+        perror("Erro ao alocar o perfil dos limitadores");
+        return EXIT_FAILURE;
+    }
+    if (arquivo_perfil != NULL ? !perfil_ler(arquivo_perfil, inicial) : !perfil_padrao(inicial)) {
+        return EXIT_FAILURE;
+    }
+    perfil_iniciar(&perfil, inicial);
+    perfil_imprimir(inicial);
+
     setup_signals();
 
     // Inicializar IPC
     init_shared_memory();
     init_message_queue();
-    init_semaphore();
+    init_stats_memory();
+    if (!bind_rule_counters(&inicial->programa)) exit(EXIT_FAILURE);
+    init_broadcast_memory();
+    init_command_ring_memory();
+    agregador_init(&agregador, now_ns());
+    if (arquivo_caixa) caixa = caixa_abrir(arquivo_caixa, getpid());
+
+    // A thread de recarga e a de exportação do rastreio são criadas antes
+    // da configuração de tempo real, para não herdar a prioridade da thread
+    // principal
+    if (rastreio_arquivo) rastreio_iniciar(rastreio_arquivo, "controller");
+    pthread_t th_recarga;
+    if (pthread_create(&th_recarga, NULL, threadRecargaPerfil, NULL) != 0) {
+        perror("Erro ao criar thread de recarga do perfil");
+        exit(EXIT_FAILURE);
+    }
+
+    // Travar a memória antes de criar as threads (modo tempo real)
+    if (rt_ativo) {
+        rt_lock_memory();
+        rt_apply_thread(RT_PWM);
+    }
 
     // Inicializar GPIO e PWM
     init_gpio();
+    if (reinicio_quente) {
+        restore_outputs();   // Retoma os atuadores de onde o controlador anterior parou
+        printf("Reinício a quente concluído em %.2f ms.\n", (now_ns() - inicio_ns) / 1e6);
+    }
 
     printf("======== Controlador inicializado. Aguardando dados... ========\n");
 
     // Executar loop principal
     process_control();
+    sem_post(&sem_recarga); // Acorda a thread de recarga para que veja running == 0
+    pthread_join(th_recarga, NULL);
+    rastreio_encerrar();
+    if (!preservar_estado) broadcast_shutdown(); // Preservado: os clientes serão adotados
 
     // Exibir relatório
     printf("\n======== RELATÓRIO DOS LIMITADORES ===========\n\n");
-    printf("Limite superior da velocidade %d vezes.\n", cont_vel_sup);
-    printf("Limite inferior da velocidade %d vezes.\n", cont_vel_inf);
-    printf("Limite superior do RPM %d vezes.\n", cont_rpm_sup);
-    printf("Limite inferior do RPM %d vezes.\n", cont_rpm_inf);
-    printf("Limite de temperatura %d vezes.\n", cont_max_temp);
-    printf("Acionamentos Totais: %d.\n",
-          (cont_vel_sup + cont_vel_inf + cont_rpm_sup + cont_rpm_inf + cont_max_temp));
+    uint64_t acionamentos = 0;
+    for (uint32_t c = 0; c < contadores_regras.num; c++) {
+        const ContadorRegra *r = &contadores_regras.c[c];
+        printf("Regra %-8s (%s): %llu vezes.\n", r->nome, r->descricao, (unsigned long long)r->disparos);
+        acionamentos += r->disparos;
+    }
+    printf("Acionamentos Totais: %llu.\n", (unsigned long long)acionamentos);
+    printf("Avisos de superaquecimento: atenção %llu, alerta %llu vezes; %llu cortes preventivos do motor, %llu anomalias de temperatura.\n",
+           (unsigned long long)stats_get(&stats->temp_entradas[TEMP_ATENCAO]),
+           (unsigned long long)stats_get(&stats->temp_entradas[TEMP_ALERTA]),
+           (unsigned long long)stats_get(&stats->temp_cortes),
+           (unsigned long long)stats_get(&stats->temp_anomalias));
+    printf("Perfil dos limitadores: \"%s\" (geração %u), %u trocas, %u arquivos rejeitados.\n",
+           perfil_atual(&perfil)->nome, perfil_atual(&perfil)->geracao, perfil.trocas, perfil.rejeitados);
+    printf("Overruns das tarefas: %llu.\n", (unsigned long long)stats_get(&stats->overruns));
+    printf("Ciclos de controle passo a passo: %llu, congelados na pausa: %llu.\n",
+           (unsigned long long)stats_get(&stats->passos),
+           (unsigned long long)stats_get(&stats->ciclos_congelados));
+    printf("Trava recuperada de um processo morto %llu vezes.\n",
+           (unsigned long long)atomic_load(&shared_data->trava.recuperacoes));
+    print_aggregates_report();
     printf("===================================================\n\n");
 
+    print_scheduler_report();
+    print_jitter_report();
+    print_contention_report();
+    print_watchdog_report();
+
     // Limpar recursos antes de sair
     cleanup();
+    free((void *)perfil_atual(&perfil));
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,294 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include "ipc_shared.h"
+
+volatile sig_atomic_t running = 1;
+
+/**
+ * @brief Handler para SIGINT: encerra o laço de amostragem.
+ */
+void sigint_handler(int signal) {
+    (void)signal;
+    running = 0;
+}
+
+/**
+ * @brief Anexa o segmento de estatísticas do controlador somente para leitura.
+ *
+ * O ctlstat nunca cria o segmento nem escreve nele, portanto não perturba o
+ * controlador. Encerra o programa se o segmento não existir ou se o layout
+ * publicado for de outra versão.
+ *
+ * @return Ponteiro para o segmento anexado.
+ */
+const ControllerStats *attach_stats() {
+    int shm_id = shmget(SHM_KEY_STATS, sizeof(ControllerStats), 0);
+    if (shm_id < 0) {
+        perror("Segmento de estatísticas não encontrado (o controlador está rodando?)");
+        exit(EXIT_FAILURE);
+    }
+    const ControllerStats *stats = (const ControllerStats *)shmat(shm_id, NULL, SHM_RDONLY);
+    if (stats == (void *)-1) {
+        perror("Erro ao associar memória de estatísticas");
+        exit(EXIT_FAILURE);
+    }
+    if (__atomic_load_n(&stats->magic, __ATOMIC_ACQUIRE) != STATS_MAGIC ||
+        stats->versao != STATS_VERSAO) {
+        fprintf(stderr, "Segmento de estatísticas incompatível (versão %u, esperada %u)\n",
+                stats->versao, STATS_VERSAO);
+        exit(EXIT_FAILURE);
+    }
+    return stats;
+}
+
+// Cópia local dos contadores, usada para calcular as taxas por intervalo
+typedef struct {
+    uint64_t iteracoes[STATS_NUM_THREADS];
+    uint64_t lock_aquisicoes[STATS_NUM_THREADS];
+    uint64_t lock_espera_ns[STATS_NUM_THREADS];
+    uint64_t limitadores[5];
+    uint64_t execucoes[TAREFA_NUM];
+    uint64_t comandos[CMD_NUM];
+    uint64_t comandos_invalidos;
+} Amostra;
+
+/**
+ * @brief Copia os contadores publicados para uma amostra local.
+ */
+void read_sample(const ControllerStats *stats, Amostra *a) {
+    for (int i = 0; i < STATS_NUM_THREADS; i++) {
+        a->iteracoes[i] = stats_get(&stats->threads[i].iteracoes);
+        a->lock_aquisicoes[i] = stats_get(&stats->threads[i].lock_aquisicoes);
+        a->lock_espera_ns[i] = stats_get(&stats->threads[i].lock_espera_ns);
+    }
+    a->limitadores[0] = stats_get(&stats->cont_vel_sup);
+    a->limitadores[1] = stats_get(&stats->cont_vel_inf);
+    a->limitadores[2] = stats_get(&stats->cont_rpm_sup);
+    a->limitadores[3] = stats_get(&stats->cont_rpm_inf);
+    a->limitadores[4] = stats_get(&stats->cont_max_temp);
+    for (int i = 0; i < TAREFA_NUM; i++) {
+        a->execucoes[i] = stats_get(&stats->tarefas[i].execucoes);
+    }
+    for (int i = 0; i < CMD_NUM; i++) {
+        a->comandos[i] = stats_get(&stats->comandos[i]);
+    }
+    a->comandos_invalidos = stats_get(&stats->comandos_invalidos);
+}
+
+/**
+ * @brief Imprime as perdas de prazo do vigia por thread e as mais recentes.
+ */
+void print_watchdog(const ControllerStats *stats) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t agora = (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+    uint32_t escalada = atomic_load_explicit((_Atomic uint32_t *)&stats->vigia_escalada, memory_order_relaxed);
+
+    printf("\nVigia de prazos (escalada até \"%s\"): %u threads atrasadas%s, %llu estados seguros\n",
+           escalada < VIGIA_NUM_NIVEIS ? NOMES_NIVEIS_VIGIA[escalada] : "?",
+           atomic_load_explicit((_Atomic uint32_t *)&stats->vigia_atrasadas, memory_order_relaxed),
+           atomic_load_explicit((_Atomic uint32_t *)&stats->vigia_seguro, memory_order_relaxed)
+               ? ", ESTADO SEGURO" : "",
+           (unsigned long long)stats_get(&stats->vigia_estados_seguros));
+    for (int i = 0; i < VIGIA_NUM_THREADS; i++) {
+        const VigiaThreadStats *v = &stats->vigia[i];
+        printf("  %-9s folga %5u ms  %8llu perdas  pior atraso %8.1f ms\n", NOMES_THREADS[i],
+               atomic_load_explicit((_Atomic uint32_t *)&v->prazo_ms, memory_order_relaxed),
+               (unsigned long long)stats_get(&v->perdas), stats_get(&v->pior_atraso_ns) / 1e6);
+    }
+
+    // As quatro perdas mais recentes, da mais nova para a mais antiga
+    uint64_t perdas = atomic_load_explicit((_Atomic uint64_t *)&stats->vigia_perdas, memory_order_acquire);
+    for (uint64_t n = perdas; n > 0 && perdas - n < 4; n--) {
+        const PerdaPrazo *r = &stats->vigia_registro[(n - 1) % VIGIA_REGISTROS];
+        uint32_t thread = atomic_load_explicit((_Atomic uint32_t *)&r->thread, memory_order_relaxed);
+        uint32_t nivel = atomic_load_explicit((_Atomic uint32_t *)&r->nivel, memory_order_relaxed);
+        uint64_t t_ns = stats_get(&r->t_ns);
+        printf("  perda há %7.1f s: %-9s %8.1f ms além do limite (%s)\n",
+               agora > t_ns ? (agora - t_ns) / 1e9 : 0.0,
+               thread < VIGIA_NUM_THREADS ? NOMES_THREADS[thread] : "?",
+               stats_get(&r->atraso_ns) / 1e6,
+               nivel < VIGIA_NUM_NIVEIS ? NOMES_NIVEIS_VIGIA[nivel] : "?");
+    }
+}
+
+/**
+ * @brief Imprime os totais e as taxas do último intervalo.
+ *
+ * @param stats Segmento anexado (para os valores instantâneos).
+ * @param ant Amostra anterior.
+ * @param atual Amostra atual.
+ * @param intervalo Duração do intervalo em segundos.
+ */
+void print_report(const ControllerStats *stats, const Amostra *ant, const Amostra *atual,
+                  double intervalo) {
+    static const char *const nomes_limitadores[5] = {
+        "vel_sup", "vel_inf", "rpm_sup", "rpm_inf", "max_temp",
+    };
+
+    printf("\n===== ctlstat (controlador PID %d) =====\n", stats->pid);
+    printf("%-10s %12s %10s %12s %12s %12s %12s\n",
+           "thread", "iteracoes", "iter/s", "locks/s", "espera_med", "espera_max",
+           "atraso_max");
+    for (int i = 0; i < STATS_NUM_THREADS; i++) {
+        uint64_t d_iter = atual->iteracoes[i] - ant->iteracoes[i];
+        uint64_t d_lock = atual->lock_aquisicoes[i] - ant->lock_aquisicoes[i];
+        uint64_t d_espera = atual->lock_espera_ns[i] - ant->lock_espera_ns[i];
+        double media_us = d_lock ? (double)d_espera / d_lock / 1000.0 : 0.0;
+        double max_us = stats_get(&stats->threads[i].lock_espera_max_ns) / 1000.0;
+        double atraso_us = stats_get(&stats->threads[i].atraso_max_ns) / 1000.0;
+        printf("%-10s %12llu %10.1f %12.1f %10.1fus %10.1fus %10.1fus\n",
+               NOMES_THREADS[i], (unsigned long long)atual->iteracoes[i],
+               d_iter / intervalo, d_lock / intervalo, media_us, max_us, atraso_us);
+    }
+
+    printf("\nLimitadores:");
+    for (int i = 0; i < 5; i++) {
+        printf("  %s=%llu (+%llu)", nomes_limitadores[i],
+               (unsigned long long)atual->limitadores[i],
+               (unsigned long long)(atual->limitadores[i] - ant->limitadores[i]));
+    }
+    printf("\n");
+
+    uint32_t nivel_temp = atomic_load_explicit((_Atomic uint32_t *)&stats->temp_nivel,
+                                               memory_order_relaxed);
+    uint32_t ate_limite = atomic_load_explicit((_Atomic uint32_t *)&stats->temp_ate_limite_ms,
+                                               memory_order_relaxed);
+    printf("Temperatura: %s, tendência %+.2f °C/s, ", nivel_temp < TEMP_NUM_NIVEIS
+               ? NOMES_NIVEIS_TEMP[nivel_temp] : "?",
+           atomic_load_explicit((_Atomic int32_t *)&stats->temp_tendencia_mc_s,
+                                memory_order_relaxed) / 1000.0);
+    if (ate_limite == UINT32_MAX) {
+        printf("sem projeção de limite");
+    } else {
+        printf("limite projetado em %.1f s", ate_limite / 1000.0);
+    }
+    printf(" (atenção %llu, alerta %llu, cortes %llu, anomalias %llu)\n",
+           (unsigned long long)stats_get(&stats->temp_entradas[TEMP_ATENCAO]),
+           (unsigned long long)stats_get(&stats->temp_entradas[TEMP_ALERTA]),
+           (unsigned long long)stats_get(&stats->temp_cortes),
+           (unsigned long long)stats_get(&stats->temp_anomalias));
+
+    AgregadoJanela agr[SINAL_NUM][AGR_NUM_JANELAS];
+    stats_read_aggregates(stats, agr);
+    printf("\n%-12s %6s %9s %9s %9s %9s %9s %9s %8s\n", "sinal", "janela", "mín", "média",
+           "máx", "p50", "p95", "p99", "amostras");
+    for (int s = 0; s < SINAL_NUM; s++) {
+        for (int j = 0; j < AGR_NUM_JANELAS; j++) {
+            const AgregadoJanela *w = &agr[s][j];
+            printf("%-12s %5us %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f %8u\n",
+                   j == 0 ? NOMES_SINAIS[s] : "", JANELAS_AGR_S[j], w->min, w->media, w->max,
+                   w->p50, w->p95, w->p99, w->amostras);
+        }
+    }
+
+    printf("\n%-12s %8s %4s %10s %10s %10s %11s %9s\n", "tarefa", "período", "prio",
+           "exec/s", "exec_méd", "exec_máx", "atraso_máx", "overruns");
+    for (int i = 0; i < TAREFA_NUM; i++) {
+        const TarefaStats *ts = &stats->tarefas[i];
+        uint64_t n = atual->execucoes[i];
+        printf("%-12s %6.1fms %4u %10.1f %8.1fus %8.1fus %9.1fus %9llu\n", NOMES_TAREFAS[i],
+               atomic_load_explicit((_Atomic uint32_t *)&ts->periodo_us, memory_order_relaxed) / 1000.0,
+               atomic_load_explicit((_Atomic uint32_t *)&ts->prioridade, memory_order_relaxed),
+               (n - ant->execucoes[i]) / intervalo,
+               n ? stats_get(&ts->tempo_total_ns) / 1000.0 / n : 0.0,
+               stats_get(&ts->tempo_max_ns) / 1000.0,
+               stats_get(&ts->atraso_max_ns) / 1000.0,
+               (unsigned long long)stats_get(&ts->overruns));
+    }
+    printf("Overruns das tarefas: %llu\n",
+           (unsigned long long)stats_get(&stats->overruns));
+    uint32_t execucao = atomic_load_explicit((_Atomic uint32_t *)&stats->execucao,
+                                             memory_order_relaxed);
+    printf("Execução do controle: %s (passos: %llu, ciclos congelados: %llu)\n",
+           execucao < EXEC_NUM ? NOMES_EXECUCAO[execucao] : "?",
+           (unsigned long long)stats_get(&stats->passos),
+           (unsigned long long)stats_get(&stats->ciclos_congelados));
+    printf("Clientes registrados: %u, confirmações: %llu (%llu perdidas com a fila cheia)\n",
+           atomic_load_explicit((_Atomic uint32_t *)&stats->clientes, memory_order_relaxed),
+           (unsigned long long)stats_get(&stats->acks),
+           (unsigned long long)stats_get(&stats->acks_perdidos));
+    printf("Fila de mensagens: %u mensagens (máx. %u)\n",
+           atomic_load_explicit((_Atomic uint32_t *)&stats->fila_profundidade, memory_order_relaxed),
+           atomic_load_explicit((_Atomic uint32_t *)&stats->fila_profundidade_max, memory_order_relaxed));
+
+    printf("Comandos/s:");
+    for (int i = 0; i < CMD_NUM; i++) {
+        uint64_t d = atual->comandos[i] - ant->comandos[i];
+        if (atual->comandos[i] == 0) continue;
+        printf("\n  %-28s %8llu  %8.1f/s", NOMES_COMANDOS[i],
+               (unsigned long long)atual->comandos[i], d / intervalo);
+    }
+    printf("\n  %-28s %8llu\n", "(inválidos)", (unsigned long long)atual->comandos_invalidos);
+    printf("  %-28s %8llu\n", "(pelo anel de comandos)",
+           (unsigned long long)stats_get(&stats->comandos_anel));
+    printf("  %-28s %8llu\n", "(reservas do anel perdidas)",
+           (unsigned long long)stats_get(&stats->reservas_descartadas));
+
+    print_watchdog(stats);
+
+    printf("\nContenção da trava por ponto de aquisição:\n");
+    const TabelaContencao *tabela = &stats->contencao;
+    contencao_relatorio(stdout, &tabela, 1);
+    fflush(stdout);
+}
+
+/**
+ * @brief Ponto de entrada do ctlstat.
+ *
+ * Uso: ./ctlstat [intervalo_em_segundos]
+ *
+ * Anexa o segmento de estatísticas do controlador em modo somente leitura e,
+ * a cada intervalo (1 s por padrão), imprime os totais e as taxas de cada
+ * contador e o ranking de contenção da trava. Encerra com Ctrl + C ou quando
+ * o controlador remove o segmento.
+ *
+ * @return 0 ao encerrar.
+ */
+int main(int argc, char *argv[]) {
+    double intervalo = 1.0;
+    if (argc > 1) {
+        intervalo = atof(argv[1]);
+        if (intervalo <= 0.0) {
+            fprintf(stderr, "Uso: %s [intervalo_em_segundos]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = sigint_handler;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+
+    const ControllerStats *stats = attach_stats();
+
+    Amostra ant, atual;
+    read_sample(stats, &ant);
+
+    while (running) {
+        usleep((useconds_t)(intervalo * 1000000.0));
+
+        // O controlador marca o segmento para remoção ao encerrar
+        struct shmid_ds info;
+        if (shmctl(shmget(SHM_KEY_STATS, 0, 0), IPC_STAT, &info) < 0) {
+            printf("\nControlador encerrado.\n");
+            break;
+        }
+
+        read_sample(stats, &atual);
+        print_report(stats, &ant, &atual, intervalo);
+        ant = atual;
+    }
+
+    shmdt(stats);
+    return 0;
+}
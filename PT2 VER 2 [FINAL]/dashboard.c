@@ -0,0 +1,490 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <time.h>
+#include <getopt.h>
+#include <sys/ioctl.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include "ipc_shared.h"
+#include "difusao.h"
+
+// Tela lógica (o layout cabe em um terminal 80x24)
+#define TELA_LINHAS 20
+#define TELA_COLUNAS 80
+
+#define FPS_PADRAO 10
+#define AMOSTRA_PADRAO_MS 200     // Período das amostras das sparklines
+#define SPARK_LARGURA 48          // Amostras visíveis em cada sparkline
+#define SEM_DADOS_MS 1000         // Sem publicação nesse tempo, verifica o controlador
+
+// Atributos de exibição de uma célula
+typedef enum {
+    ATR_NORMAL = 0,
+    ATR_NEGRITO,
+    ATR_FRACO,
+    ATR_VERDE,
+    ATR_AMARELO,
+    ATR_VERMELHO,
+    ATR_CIANO,
+} Atributo;
+
+static const char *const SGR[] = {
+    "\033[0m", "\033[0;1m", "\033[0;2m", "\033[0;32m", "\033[0;33m", "\033[0;31m", "\033[0;36m",
+};
+
+// Uma célula da tela: um caractere UTF-8 (até 4 bytes) e o atributo
+typedef struct {
+    char glifo[5];
+    uint8_t atributo;
+} Celula;
+
+// Quadro em composição e quadro já enviado ao terminal
+static Celula quadro[TELA_LINHAS][TELA_COLUNAS];
+static Celula anterior[TELA_LINHAS][TELA_COLUNAS];
+static bool redesenhar_tudo = true;
+
+// Saída de um quadro, enviada com um único write()
+static char saida[TELA_LINHAS * TELA_COLUNAS * 16];
+static size_t saida_tam = 0;
+
+// Histórico de uma grandeza para a sparkline
+typedef struct {
+    float valores[SPARK_LARGURA];
+    int quantidade;
+} Historico;
+
+static const char *const BLOCOS[8] = { "▁", "▂", "▃", "▄", "▅", "▆", "▇", "█" };
+
+volatile sig_atomic_t running = 1;
+volatile sig_atomic_t tela_mudou = 0;
+
+/**
+ * @brief Handler de SIGINT/SIGTERM: encerra o laço de quadros.
+ */
+void sigint_handler(int signal) {
+    (void)signal;
+    running = 0;
+}
+
+/**
+ * @brief Handler de SIGWINCH: o próximo quadro é redesenhado por inteiro.
+ */
+void sigwinch_handler(int signal) {
+    (void)signal;
+    tela_mudou = 1;
+}
+
+/**
+ * @brief Retorna o instante atual de CLOCK_MONOTONIC em nanossegundos.
+ */
+static inline uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Anexa um segmento publicado pelo controlador, somente para leitura.
+ *
+ * @param chave Chave do segmento.
+ * @param tamanho Tamanho esperado.
+ * @return O segmento, ou NULL se ele não existe.
+ */
+const void *attach_readonly(key_t chave, size_t tamanho) {
+    int shm_id = shmget(chave, tamanho, 0);
+    if (shm_id < 0) return NULL;
+    const void *p = shmat(shm_id, NULL, SHM_RDONLY);
+    return p == (void *)-1 ? NULL : p;
+}
+
+/**
+ * @brief Indica se o controlador ainda existe (ver monitor.c).
+ */
+bool publisher_alive(const AnelDifusao *anel) {
+    struct shmid_ds info;
+    if (shmctl(shmget(SHM_KEY_DIFUSAO, 0, 0), IPC_STAT, &info) < 0) return false;
+    return !(kill(anel->pid, 0) < 0 && errno == ESRCH);
+}
+
+/**
+ * @brief Escreve no buffer de saída do quadro.
+ */
+void out(const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(saida + saida_tam, sizeof(saida) - saida_tam, fmt, ap);
+    va_end(ap);
+    if (n > 0) {
+        saida_tam += (size_t)n;
+        if (saida_tam > sizeof(saida) - 1) saida_tam = sizeof(saida) - 1;
+    }
+}
+
+/**
+ * @brief Envia o buffer de saída ao terminal.
+ */
+void flush_out() {
+    size_t enviado = 0;
+    while (enviado < saida_tam) {
+        ssize_t n = write(STDOUT_FILENO, saida + enviado, saida_tam - enviado);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        enviado += (size_t)n;
+    }
+    saida_tam = 0;
+}
+
+/**
+ * @brief Limpa o quadro em composição.
+ */
+void frame_clear() {
+    for (int l = 0; l < TELA_LINHAS; l++) {
+        for (int c = 0; c < TELA_COLUNAS; c++) {
+            strcpy(quadro[l][c].glifo, " ");
+            quadro[l][c].atributo = ATR_NORMAL;
+        }
+    }
+}
+
+/**
+ * @brief Escreve um texto UTF-8 no quadro, um caractere por célula.
+ *
+ * @return Coluna seguinte ao texto.
+ */
+int frame_text(int linha, int coluna, Atributo atr, const char *texto) {
+    const unsigned char *p = (const unsigned char *)texto;
+    while (*p && coluna < TELA_COLUNAS) {
+        int n = (*p >= 0xF0) ? 4 : (*p >= 0xE0) ? 3 : (*p >= 0xC0) ? 2 : 1;
+        if (coluna >= 0 && linha >= 0 && linha < TELA_LINHAS) {
+            Celula *cel = &quadro[linha][coluna];
+            memcpy(cel->glifo, p, (size_t)n);
+            cel->glifo[n] = '\0';
+            cel->atributo = (uint8_t)atr;
+        }
+        p += n;
+        coluna++;
+    }
+    return coluna;
+}
+
+/**
+ * @brief Versão formatada de frame_text().
+ */
+int frame_printf(int linha, int coluna, Atributo atr, const char *fmt, ...) {
+    char texto[256];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(texto, sizeof(texto), fmt, ap);
+    va_end(ap);
+    return frame_text(linha, coluna, atr, texto);
+}
+
+/**
+ * @brief Envia ao terminal apenas as células que mudaram desde o último quadro.
+ *
+ * O cursor só é reposicionado quando a próxima célula alterada não é a
+ * seguinte à última escrita, e o atributo só é reenviado quando muda.
+ *
+ * @return Células alteradas.
+ */
+int frame_flush() {
+    int alteradas = 0;
+    int lin_cursor = -1, col_cursor = -1, atr_atual = -1;
+
+    if (redesenhar_tudo) {
+        out("\033[0m\033[2J");
+        memset(anterior, 0, sizeof(anterior));
+        redesenhar_tudo = false;
+    }
+
+    for (int l = 0; l < TELA_LINHAS; l++) {
+        for (int c = 0; c < TELA_COLUNAS; c++) {
+            Celula *novo = &quadro[l][c], *velho = &anterior[l][c];
+            if (novo->atributo == velho->atributo && strcmp(novo->glifo, velho->glifo) == 0) {
+                continue;
+            }
+            if (l != lin_cursor || c != col_cursor) out("\033[%d;%dH", l + 1, c + 1);
+            if (novo->atributo != atr_atual) {
+                out("%s", SGR[novo->atributo]);
+                atr_atual = novo->atributo;
+            }
+            out("%s", novo->glifo);
+            *velho = *novo;
+            lin_cursor = l;
+            col_cursor = c + 1;
+            alteradas++;
+        }
+    }
+    if (atr_atual != ATR_NORMAL && atr_atual != -1) out("%s", SGR[ATR_NORMAL]);
+    return alteradas;
+}
+
+/**
+ * @brief Acrescenta uma amostra ao histórico (descarta a mais antiga).
+ */
+void history_push(Historico *h, float valor) {
+    if (h->quantidade == SPARK_LARGURA) {
+        memmove(h->valores, h->valores + 1, (SPARK_LARGURA - 1) * sizeof(float));
+        h->quantidade--;
+    }
+    h->valores[h->quantidade++] = valor;
+}
+
+/**
+ * @brief Desenha a sparkline de um histórico, com a escala ajustada à janela.
+ */
+void draw_sparkline(int linha, int coluna, const Historico *h, Atributo atr) {
+    if (h->quantidade == 0) return;
+    float min = h->valores[0], max = h->valores[0];
+    for (int i = 1; i < h->quantidade; i++) {
+        if (h->valores[i] < min) min = h->valores[i];
+        if (h->valores[i] > max) max = h->valores[i];
+    }
+    int inicio = coluna + SPARK_LARGURA - h->quantidade;   // Mais recente à direita
+    for (int i = 0; i < h->quantidade; i++) {
+        int nivel = (max > min) ? (int)((h->valores[i] - min) / (max - min) * 7.0f + 0.5f) : 0;
+        frame_text(linha, inicio + i, atr, BLOCOS[nivel]);
+    }
+    frame_printf(linha, coluna + SPARK_LARGURA + 1, ATR_FRACO, "%.0f–%.0f", min, max);
+}
+
+/**
+ * @brief Desenha uma barra de duty (0 a 10).
+ */
+void draw_duty(int linha, int coluna, const char *nome, int duty, Atributo atr) {
+    coluna = frame_printf(linha, coluna, ATR_NORMAL, "%-6s [", nome);
+    for (int i = 0; i < 10; i++) {
+        coluna = frame_text(linha, coluna, i < duty ? atr : ATR_FRACO, i < duty ? "█" : "·");
+    }
+    frame_printf(linha, coluna, ATR_NORMAL, "] %2d/10", duty);
+}
+
+/**
+ * @brief Desenha um indicador liga/desliga.
+ *
+ * @return Coluna seguinte ao indicador.
+ */
+int draw_lamp(int linha, int coluna, const char *nome, bool ligado, Atributo atr) {
+    coluna = frame_text(linha, coluna, ligado ? atr : ATR_FRACO, "●");
+    return frame_printf(linha, coluna + 1, ligado ? ATR_NEGRITO : ATR_FRACO, "%s", nome) + 3;
+}
+
+/**
+ * @brief Restaura o terminal (tela principal, cursor visível).
+ */
+void restore_terminal() {
+    out("\033[0m\033[?25h\033[?1049l");
+    flush_out();
+}
+
+/**
+ * @brief Exibe as opções de linha de comando.
+ */
+void print_usage(const char *prog) {
+    printf("Uso: %s [opções]\n", prog);
+    printf("  -f, --fps <n>            Quadros por segundo (padrão %d)\n", FPS_PADRAO);
+    printf("  -a, --amostra <ms>       Período das amostras das sparklines (padrão %d ms)\n",
+           AMOSTRA_PADRAO_MS);
+    printf("  -h, --help               Mostra esta ajuda\n");
+}
+
+/**
+ * @brief Ponto de entrada do dashboard.
+ *
+ * Anexa, somente para leitura, o anel de difusão do estado do veículo e o
+ * segmento de estatísticas, e redesenha a tela em uma taxa fixa de quadros
+ * com endereçamento de cursor, enviando apenas as células que mudaram.
+ * Não toma a trava do controlador e não escreve em nenhum segmento, de
+ * modo que o controlador pode rodar com --headless sem perder a visão ao
+ * vivo do veículo.
+ *
+ * @return 0 ao encerrar.
+ */
+int main(int argc, char *argv[]) {
+    static const struct option opcoes[] = {
+        {"fps",     required_argument, NULL, 'f'},
+        {"amostra", required_argument, NULL, 'a'},
+        {"help",    no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+    int fps = FPS_PADRAO, amostra_ms = AMOSTRA_PADRAO_MS;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "f:a:h", opcoes, NULL)) != -1) {
+        switch (opt) {
+        case 'f': fps = atoi(optarg); break;
+        case 'a': amostra_ms = atoi(optarg); break;
+        case 'h':
+            print_usage(argv[0]);
+            return 0;
+        default:
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (fps < 1 || fps > 100 || amostra_ms < 1) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const AnelDifusao *anel = attach_readonly(SHM_KEY_DIFUSAO, sizeof(AnelDifusao));
+    if (!anel || __atomic_load_n(&anel->magic, __ATOMIC_ACQUIRE) != DIFUSAO_MAGIC ||
+        anel->versao != DIFUSAO_VERSAO) {
+        fprintf(stderr, "Anel de difusão indisponível (o controlador está rodando?)\n");
+        return EXIT_FAILURE;
+    }
+    const ControllerStats *stats = attach_readonly(SHM_KEY_STATS, sizeof(ControllerStats));
+    if (stats && (__atomic_load_n(&stats->magic, __ATOMIC_ACQUIRE) != STATS_MAGIC ||
+                  stats->versao != STATS_VERSAO)) {
+        stats = NULL;   // Apenas o estado do veículo, sem os contadores
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = sigint_handler;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sa.sa_handler = sigwinch_handler;
+    sigaction(SIGWINCH, &sa, NULL);
+
+    // O leitor só lê o segmento (o anel foi anexado com SHM_RDONLY)
+    LeitorDifusao leitor;
+    difusao_leitor_init(&leitor, (AnelDifusao *)anel, false);
+
+    // Tela alternativa, cursor oculto
+    out("\033[?1049h\033[?25l");
+    flush_out();
+
+    Historico hist_vel = {0}, hist_rpm = {0}, hist_temp = {0};
+    SlotDifusao pub;
+    bool tem_estado = false;
+    EstadoPainel e = {0};
+    uint64_t ultima_pub_ns = now_ns();
+
+    uint64_t periodo_ns = 1000000000ull / (uint64_t)fps;
+    uint64_t amostra_ns = (uint64_t)amostra_ms * 1000000ull;
+    uint64_t proximo_ns = now_ns(), proxima_amostra_ns = proximo_ns;
+    uint64_t quadros = 0, bytes_total = 0;
+    size_t bytes_quadro = 0;
+    int alteradas = 0;
+    bool controlador_saiu = false;
+
+    while (running) {
+        uint64_t agora = now_ns();
+
+        // Publicações desde o último quadro: fica com a mais recente
+        while (difusao_ler(&leitor, &pub)) {
+            e = pub.estado;
+            tem_estado = true;
+            ultima_pub_ns = agora;
+        }
+        if (agora - ultima_pub_ns > SEM_DADOS_MS * 1000000ull) {
+            if (!publisher_alive(anel)) {
+                controlador_saiu = true;
+                break;
+            }
+            ultima_pub_ns = agora;
+        }
+        if (tem_estado && agora >= proxima_amostra_ns) {
+            history_push(&hist_vel, e.velocidade);
+            history_push(&hist_rpm, e.rpm);
+            history_push(&hist_temp, e.temperatura);
+            proxima_amostra_ns += amostra_ns;
+            if (proxima_amostra_ns < agora) proxima_amostra_ns = agora + amostra_ns;
+        }
+        if (tela_mudou) {
+            tela_mudou = 0;
+            redesenhar_tudo = true;
+        }
+
+        // Compor o quadro
+        frame_clear();
+        int c = frame_printf(0, 0, ATR_NEGRITO, "PAINEL DO VEÍCULO");
+        frame_printf(0, c + 2, ATR_FRACO, "controlador PID %d", anel->pid);
+        frame_printf(0, 50, ATR_FRACO, "%2d fps %5zu B/quadro %4d cél",
+                     fps, bytes_quadro, alteradas);
+
+        if (!tem_estado) {
+            frame_text(2, 0, ATR_AMARELO, "Aguardando a primeira publicação do controlador...");
+        } else {
+            frame_printf(2, 0, ATR_NORMAL, "Velocidade  %7.1f km/h", e.velocidade);
+            draw_sparkline(2, 24, &hist_vel, ATR_CIANO);
+            frame_printf(3, 0, ATR_NORMAL, "RPM         %7.0f rpm", e.rpm);
+            draw_sparkline(3, 24, &hist_rpm, ATR_CIANO);
+            frame_printf(4, 0, ATR_NORMAL, "Temperatura %7.1f °C", e.temperatura);
+            draw_sparkline(4, 24, &hist_temp, ATR_AMARELO);
+
+            draw_duty(6, 0, "Motor", e.motor_duty, ATR_VERDE);
+            draw_duty(6, 40, "Freio", e.freio_duty, ATR_VERMELHO);
+
+            c = draw_lamp(8, 0, "Seta esq.", e.seta_esq, ATR_AMARELO);
+            c = draw_lamp(8, c, "Seta dir.", e.seta_dir, ATR_AMARELO);
+            c = draw_lamp(8, c, "Farol baixo", e.farol_baixo, ATR_VERDE);
+            draw_lamp(8, c, "Farol alto", e.farol_alto, ATR_CIANO);
+        }
+
+        if (stats) {
+            frame_printf(10, 0, ATR_NEGRITO, "Limitadores");
+            frame_printf(11, 0, ATR_NORMAL,
+                         "vel_sup %-6llu vel_inf %-6llu rpm_sup %-6llu rpm_inf %-6llu max_temp %-6llu",
+                         (unsigned long long)stats_get(&stats->cont_vel_sup),
+                         (unsigned long long)stats_get(&stats->cont_vel_inf),
+                         (unsigned long long)stats_get(&stats->cont_rpm_sup),
+                         (unsigned long long)stats_get(&stats->cont_rpm_inf),
+                         (unsigned long long)stats_get(&stats->cont_max_temp));
+            uint64_t comandos = stats_get(&stats->comandos_invalidos);
+            for (int i = 0; i < CMD_NUM; i++) comandos += stats_get(&stats->comandos[i]);
+            uint64_t overruns = stats_get(&stats->overruns);
+            frame_printf(13, 0, overruns ? ATR_AMARELO : ATR_NORMAL, "Overruns %-8llu",
+                         (unsigned long long)overruns);
+            frame_printf(13, 18, ATR_NORMAL, "Clientes %-4u Comandos %-9llu Fila %u (máx. %u)",
+                         atomic_load_explicit((_Atomic uint32_t *)&stats->clientes,
+                                              memory_order_relaxed),
+                         (unsigned long long)comandos,
+                         atomic_load_explicit((_Atomic uint32_t *)&stats->fila_profundidade,
+                                              memory_order_relaxed),
+                         atomic_load_explicit((_Atomic uint32_t *)&stats->fila_profundidade_max,
+                                              memory_order_relaxed));
+        }
+
+        frame_printf(15, 0, leitor.perdidas ? ATR_AMARELO : ATR_FRACO,
+                     "Publicações lidas %llu, perdidas %llu", (unsigned long long)leitor.lidas,
+                     (unsigned long long)leitor.perdidas);
+        frame_text(17, 0, ATR_FRACO, "Ctrl + C para sair");
+
+        // Enviar apenas o que mudou
+        alteradas = frame_flush();
+        bytes_quadro = saida_tam;
+        bytes_total += saida_tam;
+        quadros++;
+        flush_out();
+
+        // Próximo quadro em prazo absoluto
+        proximo_ns += periodo_ns;
+        if (proximo_ns < now_ns()) proximo_ns = now_ns();
+        struct timespec ts = {
+            .tv_sec = (time_t)(proximo_ns / 1000000000ull),
+            .tv_nsec = (long)(proximo_ns % 1000000000ull),
+        };
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR && running) {}
+    }
+
+    restore_terminal();
+    if (controlador_saiu) printf("Controlador encerrado.\n");
+    printf("%llu quadros, média de %.0f bytes por quadro.\n", (unsigned long long)quadros,
+           quadros ? (double)bytes_total / quadros : 0.0);
+
+    shmdt(anel);
+    if (stats) shmdt(stats);
+    return 0;
+}
@@ -0,0 +1,167 @@
+#ifndef DIFUSAO_H
+#define DIFUSAO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "ipc_shared.h"
+
+/*
+ * Anel de difusão do estado do veículo (um escritor, vários leitores).
+ *
+ * O controlador publica o estado dos sensores e dos acionadores em um anel
+ * de DIFUSAO_SLOTS posições na memória compartilhada SHM_KEY_DIFUSAO. Cada
+ * leitor (monitor, dashboard, registradores) mantém o próprio cursor, fora
+ * do segmento, e nunca bloqueia o escritor: quem fica para trás perde as
+ * publicações mais antigas, e a perda é detectada e contada pelo leitor.
+ *
+ * Cada slot funciona como um seqlock: `seq` vale 2n+1 enquanto a publicação
+ * n é escrita e 2n+2 quando ela está pronta. Assim o leitor sabe se leu a
+ * publicação que esperava ou uma que a sobrescreveu. O contador `sinal` é a
+ * palavra de futex em que leitores em dia podem dormir; o escritor só faz a
+ * chamada de sistema de despertar quando há alguém esperando.
+ */
+
+#define SHM_KEY_DIFUSAO 5433          // Chave do anel de difusão
+
+#define DIFUSAO_MAGIC  0x44494655u    // "DIFU"
+#define DIFUSAO_VERSAO 1
+#define DIFUSAO_SLOTS  1024           // Publicações retidas (potência de 2)
+
+// Uma publicação do estado do veículo
+typedef struct {
+    _Atomic uint64_t seq;    // 2n+1 durante a escrita da publicação n, 2n+2 pronta
+    uint64_t numero;         // n
+    uint64_t t_ns;           // CLOCK_MONOTONIC da publicação
+    EstadoPainel estado;
+} __attribute__((aligned(64))) SlotDifusao;
+
+// Segmento do anel. O escritor e os leitores atualizam linhas de cache
+// diferentes (publicados/sinal e esperando).
+typedef struct {
+    uint32_t magic;                      // DIFUSAO_MAGIC quando pronto
+    uint32_t versao;                     // DIFUSAO_VERSAO
+    int32_t pid;                         // PID do controlador (escritor)
+    uint32_t periodo_us;                 // Período de publicação
+
+    _Atomic uint64_t publicados __attribute__((aligned(64))); // Próxima publicação
+    _Atomic uint32_t sinal;              // Palavra de futex (muda a cada publicação)
+
+    _Atomic uint32_t esperando __attribute__((aligned(64)));  // Leitores dormindo
+
+    SlotDifusao slots[DIFUSAO_SLOTS];
+} AnelDifusao;
+
+// Cursor de um leitor (memória local do processo leitor)
+typedef struct {
+    AnelDifusao *anel;
+    uint64_t cursor;         // Próxima publicação a ler
+    uint64_t lidas;
+    uint64_t perdidas;       // Publicações sobrescritas antes da leitura
+} LeitorDifusao;
+
+/**
+ * @brief Publica um novo estado no anel (somente o escritor).
+ *
+ * Nunca espera pelos leitores.
+ */
+static inline void difusao_publicar(AnelDifusao *anel, const EstadoPainel *estado,
+                                    uint64_t t_ns) {
+    uint64_t n = atomic_load_explicit(&anel->publicados, memory_order_relaxed);
+    SlotDifusao *slot = &anel->slots[n % DIFUSAO_SLOTS];
+
+    atomic_store_explicit(&slot->seq, 2 * n + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    slot->numero = n;
+    slot->t_ns = t_ns;
+    slot->estado = *estado;
+    atomic_store_explicit(&slot->seq, 2 * n + 2, memory_order_release);
+
+    atomic_store_explicit(&anel->publicados, n + 1, memory_order_release);
+    atomic_fetch_add_explicit(&anel->sinal, 1, memory_order_seq_cst);
+    if (atomic_load_explicit(&anel->esperando, memory_order_seq_cst) > 0) {
+        syscall(SYS_futex, &anel->sinal, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+    }
+}
+
+/**
+ * @brief Posiciona um leitor no anel.
+ *
+ * @param do_inicio true para começar pela publicação mais antiga retida,
+ *                  false para receber apenas as próximas.
+ */
+static inline void difusao_leitor_init(LeitorDifusao *l, AnelDifusao *anel, bool do_inicio) {
+    memset(l, 0, sizeof(*l));
+    l->anel = anel;
+    uint64_t publicados = atomic_load_explicit(&anel->publicados, memory_order_acquire);
+    l->cursor = publicados;
+    if (do_inicio) {
+        l->cursor = publicados >= DIFUSAO_SLOTS ? publicados - DIFUSAO_SLOTS + 1 : 0;
+    }
+}
+
+/**
+ * @brief Lê a próxima publicação, sem bloquear.
+ *
+ * Se o escritor já sobrescreveu as publicações do cursor, elas são contadas
+ * em `perdidas` e a leitura continua pela mais antiga ainda retida.
+ *
+ * @param saida Cópia da publicação lida.
+ * @return true se uma publicação foi lida, false se o leitor está em dia.
+ */
+static inline bool difusao_ler(LeitorDifusao *l, SlotDifusao *saida) {
+    for (;;) {
+        uint64_t publicados = atomic_load_explicit(&l->anel->publicados, memory_order_acquire);
+        if (l->cursor == publicados) return false;
+
+        // O slot do cursor pode estar sendo reescrito pela publicação seguinte
+        if (publicados - l->cursor >= DIFUSAO_SLOTS) {
+            uint64_t novo = publicados - DIFUSAO_SLOTS + 1;
+            l->perdidas += novo - l->cursor;
+            l->cursor = novo;
+        }
+
+        const SlotDifusao *slot = &l->anel->slots[l->cursor % DIFUSAO_SLOTS];
+        uint64_t s1 = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        if (s1 != 2 * l->cursor + 2) continue;   // Já sobrescrito: recalcula
+        saida->numero = slot->numero;
+        saida->t_ns = slot->t_ns;
+        saida->estado = slot->estado;
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&slot->seq, memory_order_relaxed) != s1) continue;
+
+        l->cursor++;
+        l->lidas++;
+        return true;
+    }
+}
+
+/**
+ * @brief Espera uma nova publicação, dormindo no futex do anel.
+ *
+ * @param timeout_ms Tempo máximo de espera (-1 = sem limite).
+ * @return true se há publicação para ler, false se o tempo esgotou.
+ */
+static inline bool difusao_esperar(LeitorDifusao *l, int timeout_ms) {
+    AnelDifusao *anel = l->anel;
+    atomic_fetch_add_explicit(&anel->esperando, 1, memory_order_seq_cst);
+    uint32_t sinal = atomic_load_explicit(&anel->sinal, memory_order_seq_cst);
+    bool pronto = atomic_load_explicit(&anel->publicados, memory_order_acquire) != l->cursor;
+    if (!pronto) {
+        struct timespec ts = { timeout_ms / 1000, (long)(timeout_ms % 1000) * 1000000L };
+        syscall(SYS_futex, &anel->sinal, FUTEX_WAIT, sinal,
+                timeout_ms < 0 ? NULL : &ts, NULL, 0);
+        pronto = atomic_load_explicit(&anel->publicados, memory_order_acquire) != l->cursor;
+    }
+    atomic_fetch_sub_explicit(&anel->esperando, 1, memory_order_seq_cst);
+    return pronto;
+}
+
+#endif // DIFUSAO_H
@@ -0,0 +1,406 @@
+#ifndef IPC_SHARED_H
+#define IPC_SHARED_H
+
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <sys/types.h>
+
+#include "contencao.h"
+
+/*
+ * Layouts compartilhados entre o controlador, o painel de comando e as
+ * ferramentas auxiliares (ctlstat). Qualquer alteração aqui exige recompilar
+ * todos os executáveis da pasta, por isso o campo `versao` do segmento de
+ * estatísticas é verificado ao anexar.
+ */
+
+#define MSG_KEY 5678              // Chave da fila de mensagens
+#define SHM_KEY_STATS 5432        // Chave do segmento de estatísticas
+
+#define STATS_MAGIC  0x53544154u  // "STAT"
+#define STATS_VERSAO 14
+
+// Tipos de mensagem na fila MSG_KEY. Os tipos 1 e 2 formam o canal legado
+// (e o de registro); cada cliente registrado usa um par próprio derivado do
+// seu PID (ver msg_tipo_cliente_comando/msg_tipo_cliente_resposta).
+#define MSG_TIPO_COMANDO  1       // Painel -> controlador
+#define MSG_TIPO_RESPOSTA 2       // Controlador -> painel ("Encerrar", "Estado")
+
+#define MAX_CLIENTES 64           // Clientes registrados simultaneamente
+#define MAX_LOTE 16               // Comandos em uma mensagem "Lote"
+
+// Resultado informado nas confirmações ("Ack")
+typedef enum {
+    RESULTADO_OK = 0,
+    RESULTADO_INVALIDO,      // Comando desconhecido
+    RESULTADO_LOTADO,        // Tabela de clientes cheia (registro recusado)
+} ResultadoComando;
+
+/**
+ * @brief Tipo das mensagens de comando enviadas por um cliente registrado.
+ */
+static inline long msg_tipo_cliente_comando(pid_t pid) {
+    return 2L * (long)pid + 1;
+}
+
+/**
+ * @brief Tipo das respostas (confirmações, estado, encerramento) de um cliente.
+ */
+static inline long msg_tipo_cliente_resposta(pid_t pid) {
+    return 2L * (long)pid + 2;
+}
+
+// Comandos reconhecidos pelo controlador (mesma ordem da tabela de nomes)
+typedef enum {
+    CMD_LIGAR_SETA_ESQ = 0,
+    CMD_DESLIGAR_SETA_ESQ,
+    CMD_LIGAR_SETA_DIR,
+    CMD_DESLIGAR_SETA_DIR,
+    CMD_LIGAR_PISCA_ALERTA,
+    CMD_DESLIGAR_PISCA_ALERTA,
+    CMD_LIGAR_FAROL_BAIXO,
+    CMD_DESLIGAR_FAROL_BAIXO,
+    CMD_LIGAR_FAROL_ALTO,
+    CMD_DESLIGAR_FAROL_ALTO,
+    CMD_DESLIGAR_FAROL,
+    CMD_PEDAL_ACELERADOR,
+    CMD_PEDAL_FREIO,
+    CMD_ENCERRAR,
+    CMD_CONECTAR,            // Registra o cliente e assina o estado do veículo
+    CMD_DESCONECTAR,         // Cancela o registro do cliente
+    CMD_REGISTRAR,           // Registra o cliente sem assinar o estado
+    CMD_LOTE,                // Lista de comandos aplicada de uma só vez
+    CMD_PAUSAR,              // Congela as tarefas de controle
+    CMD_RETOMAR,             // Volta a executar as tarefas de controle
+    CMD_PASSO,               // Pausa e executa um único ciclo de controle
+    CMD_NUM,
+    CMD_INVALIDO = -1
+} ComandoId;
+
+static const char *const NOMES_COMANDOS[CMD_NUM] = {
+    "Ligar Seta Esquerda",
+    "Desligar Seta Esquerda",
+    "Ligar Seta Direita",
+    "Desligar Seta Direita",
+    "Ligar Pisca-Alerta",
+    "Desligar Pisca-Alerta",
+    "Ligar Farol Baixo",
+    "Desligar Farol Baixo",
+    "Ligar Farol Alto",
+    "Desligar Farol Alto",
+    "Desligar Farol",
+    "Acionar Pedal do Acelerador",
+    "Acionar Pedal do Freio",
+    "Encerrar",
+    "Conectar",
+    "Desconectar",
+    "Registrar",
+    "Lote",
+    "Pausar",
+    "Retomar",
+    "Avançar Passo",
+};
+
+// Estado do veículo enviado ao painel conectado (resposta "Estado")
+typedef struct {
+    float velocidade;
+    float rpm;
+    float temperatura;
+    int32_t motor_duty;
+    int32_t freio_duty;
+    uint8_t seta_esq, seta_dir;
+    uint8_t farol_baixo, farol_alto;
+} EstadoPainel;
+
+// Mensagem trocada entre painel e controlador pela fila MSG_KEY
+typedef struct {
+    long msg_type;           // Canal legado ou tipo do cliente
+    char command[100];       // Comando (NOMES_COMANDOS) ou resposta
+    int32_t pid;             // PID do remetente (0 = cliente não registrado)
+    uint32_t seq;            // Sequência do comando, ecoada na confirmação
+    int32_t status;          // ResultadoComando, nas confirmações
+    uint64_t t_envio_ns;     // CLOCK_MONOTONIC do envio, ecoado na confirmação
+    EstadoPainel estado;     // Preenchido apenas nas respostas "Estado"
+    uint8_t lote_tamanho;    // Comandos em lote[] (mensagens "Lote")
+    uint8_t lote[MAX_LOTE];  // ComandoId de cada comando, na ordem de aplicação
+} Message;
+
+/**
+ * @brief Converte o texto de um comando do painel no seu identificador.
+ *
+ * @param texto Texto recebido na fila de mensagens.
+ * @return O ComandoId correspondente ou CMD_INVALIDO.
+ */
+static inline ComandoId comando_id(const char *texto) {
+    for (int i = 0; i < CMD_NUM; i++) {
+        if (strcmp(texto, NOMES_COMANDOS[i]) == 0) return (ComandoId)i;
+    }
+    return CMD_INVALIDO;
+}
+
+/**
+ * @brief Indica se um comando pode fazer parte de um "Lote".
+ *
+ * Apenas os comandos dos acionadores; encerramento e gerenciamento de
+ * clientes são sempre mensagens próprias.
+ */
+static inline int comando_em_lote(int cmd) {
+    return cmd >= 0 && cmd < CMD_ENCERRAR;
+}
+
+// Threads do controlador que publicam contadores próprios
+typedef enum {
+    STATS_TH_CONTROLE = 0,   // Loop principal (process_control)
+    STATS_TH_SETA_ESQ,       // threadPiscaSetaEsq
+    STATS_TH_SETA_DIR,       // threadPiscaSetaDir
+    STATS_TH_DASH,           // threadComandosDash
+    STATS_TH_VIGIA,          // threadVigia (supervisiona as anteriores)
+    STATS_NUM_THREADS
+} StatsThread;
+
+static const char *const NOMES_THREADS[STATS_NUM_THREADS] = {
+    "controle", "seta_esq", "seta_dir", "dash", "vigia",
+};
+
+// Threads supervisionadas pelo vigia de prazos: todas as anteriores a ele
+#define VIGIA_NUM_THREADS STATS_TH_VIGIA
+
+// Escalada do vigia quando uma thread supervisionada perde o prazo. O nível
+// configurado (--vigia) é o mais alto a que o vigia pode chegar.
+typedef enum {
+    VIGIA_REGISTRAR = 0,     // Conta e registra a perda
+    VIGIA_SEGURO,            // Motor em 0 e luz de freio acesa enquanto durar
+    VIGIA_ENCERRAR,          // Encerra o controlador
+    VIGIA_NUM_NIVEIS
+} NivelVigia;
+
+static const char *const NOMES_NIVEIS_VIGIA[VIGIA_NUM_NIVEIS] = {
+    "registrar", "seguro", "encerrar",
+};
+
+#define VIGIA_REGISTROS 16        // Últimas perdas de prazo publicadas
+
+// Prazo de uma thread supervisionada. A thread renova o limite a cada
+// espera periódica: o instante em que deve acordar mais a folga `prazo_ms`.
+typedef struct {
+    _Atomic uint32_t prazo_ms;           // Folga configurada
+    _Atomic uint64_t limite_ns;          // Próximo batimento esperado até aqui (0: ainda não começou)
+    _Atomic uint64_t batimentos;
+    _Atomic uint64_t perdas;             // Prazos perdidos (um por travamento)
+    _Atomic uint64_t pior_atraso_ns;     // Maior tempo além do limite
+} VigiaThreadStats;
+
+// Uma perda de prazo: quando foi detectada, de quem e por quanto tempo a
+// thread ficou além do limite (atualizado até ela voltar)
+typedef struct {
+    _Atomic uint64_t t_ns;               // CLOCK_MONOTONIC da detecção
+    _Atomic uint32_t thread;             // StatsThread
+    _Atomic uint32_t nivel;              // Maior NivelVigia atingido
+    _Atomic uint64_t atraso_ns;
+} PerdaPrazo;
+
+// Estado de execução das tarefas de controle (comandos "Pausar", "Retomar"
+// e "Avançar Passo", ou SIGUSR1). Sensores, setas, publicação e comandos
+// continuam executando em qualquer estado.
+typedef enum {
+    EXEC_RODANDO = 0,
+    EXEC_PAUSADO,
+    EXEC_PASSO,              // Pausado, com ciclos de controle liberados
+    EXEC_NUM
+} EstadoExecucao;
+
+static const char *const NOMES_EXECUCAO[EXEC_NUM] = {
+    "rodando", "pausado", "passo",
+};
+
+// Tarefas periódicas executadas pelo escalonador da thread de controle
+typedef enum {
+    TAREFA_COLETA = 0,   // Coleta dos pulsos dos sensores Hall
+    TAREFA_LIMITADOR,    // Regras dos limitadores
+    TAREFA_TEMPERATURA,  // Recalcula a temperatura do motor
+    TAREFA_PUBLICACAO,   // Publica os sensores na memória compartilhada
+    TAREFA_COMANDOS,     // Consome os comandos da fila de mensagens
+    TAREFA_EXIBICAO,     // Exibe o estado no console
+    TAREFA_CLIENTES,     // Estado aos clientes e remoção dos que terminaram
+    TAREFA_AGREGADOS,    // Publica as estatísticas das janelas deslizantes
+    TAREFA_NUM
+} TarefaId;
+
+static const char *const NOMES_TAREFAS[TAREFA_NUM] = {
+    "coleta", "limitador", "temperatura", "publicacao", "comandos", "exibicao",
+    "clientes", "agregados",
+};
+
+// Níveis do detector de superaquecimento. Atenção e alerta vêm da
+// tendência da temperatura e limitam o duty do motor; crítico é o limite
+// MAX_TEMP_MOTOR do controlador.
+typedef enum {
+    TEMP_NORMAL = 0,
+    TEMP_ATENCAO,
+    TEMP_ALERTA,
+    TEMP_CRITICO,
+    TEMP_NUM_NIVEIS
+} NivelTemp;
+
+static const char *const NOMES_NIVEIS_TEMP[TEMP_NUM_NIVEIS] = {
+    "normal", "atenção", "alerta", "crítico",
+};
+
+// Sinais com estatísticas em janelas deslizantes
+typedef enum {
+    SINAL_VELOCIDADE = 0,
+    SINAL_RPM,
+    SINAL_TEMPERATURA,
+    SINAL_NUM
+} SinalId;
+
+static const char *const NOMES_SINAIS[SINAL_NUM] = { "velocidade", "rpm", "temperatura" };
+static const char *const UNIDADES_SINAIS[SINAL_NUM] = { "km/h", "rpm", "°C" };
+
+#define AGR_NUM_JANELAS 3
+static const uint32_t JANELAS_AGR_S[AGR_NUM_JANELAS] = { 1, 10, 60 };
+
+// Estatísticas de um sinal em uma janela (valores de 0 sem amostras)
+typedef struct {
+    uint32_t amostras;
+    float min, max, media;
+    float p50, p95, p99;
+} AgregadoJanela;
+
+// Estatísticas de execução de uma tarefa do escalonador
+typedef struct {
+    _Atomic uint32_t periodo_us;         // Período configurado
+    _Atomic uint32_t prioridade;         // Posição na ordem rate-monotonic (0 = maior)
+    _Atomic uint64_t execucoes;
+    _Atomic uint64_t tempo_total_ns;     // Soma dos tempos de execução
+    _Atomic uint64_t tempo_max_ns;       // Pior tempo de execução
+    _Atomic uint64_t atraso_max_ns;      // Maior atraso de liberação
+    _Atomic uint64_t overruns;           // Ativações que perderam o prazo
+} TarefaStats;
+
+// Contadores de uma thread. Cada thread escreve apenas no próprio slot,
+// alinhado em linha de cache para não haver falso compartilhamento.
+typedef struct {
+    _Atomic uint64_t iteracoes;          // Voltas do loop da thread
+    _Atomic uint64_t lock_aquisicoes;    // Aquisições da trava dos dados compartilhados
+    _Atomic uint64_t lock_espera_ns;     // Tempo total esperando a trava
+    _Atomic uint64_t lock_espera_max_ns; // Maior espera observada
+    _Atomic uint64_t despertares;        // Esperas periódicas concluídas
+    _Atomic uint64_t atraso_total_ns;    // Soma dos atrasos ao despertar
+    _Atomic uint64_t atraso_max_ns;      // Pior atraso ao despertar (jitter)
+} __attribute__((aligned(64))) ThreadStats;
+
+// Segmento de estatísticas publicado pelo controlador
+typedef struct {
+    uint32_t magic;                      // STATS_MAGIC quando pronto
+    uint32_t versao;                     // STATS_VERSAO
+    int32_t pid;                         // PID do controlador
+
+    ThreadStats threads[STATS_NUM_THREADS];
+
+    // Limitadores (escritos apenas pela thread de controle)
+    _Atomic uint64_t cont_vel_sup;
+    _Atomic uint64_t cont_vel_inf;
+    _Atomic uint64_t cont_rpm_sup;
+    _Atomic uint64_t cont_rpm_inf;
+    _Atomic uint64_t cont_max_temp;
+
+    // Detector de superaquecimento (tendência da temperatura)
+    _Atomic uint32_t temp_nivel;             // NivelTemp atual
+    _Atomic int32_t temp_tendencia_mc_s;     // Inclinação suavizada (m°C/s)
+    _Atomic uint32_t temp_ate_limite_ms;     // Projeção até MAX_TEMP_MOTOR (UINT32_MAX: não sobe)
+    _Atomic uint64_t temp_entradas[TEMP_NUM_NIVEIS]; // Entradas em cada nível
+    _Atomic uint64_t temp_cortes;            // Reduções preventivas do duty do motor
+    _Atomic uint64_t temp_anomalias;         // Amostras fora da previsão
+
+    // Ativações de tarefas que ultrapassaram o prazo (soma de todas)
+    _Atomic uint64_t overruns;
+
+    // Estado de execução (EstadoExecucao), ciclos de controle executados
+    // passo a passo e liberações de tarefas de controle puladas na pausa
+    _Atomic uint32_t execucao;
+    _Atomic uint64_t passos;
+    _Atomic uint64_t ciclos_congelados;
+
+    // Escalonador multi-taxa da thread de controle
+    TarefaStats tarefas[TAREFA_NUM];
+
+    // Comandos recebidos do painel, por tipo
+    _Atomic uint64_t comandos[CMD_NUM];
+    _Atomic uint64_t comandos_invalidos;
+    _Atomic uint64_t comandos_anel;      // Dos quais chegaram pelo anel de comandos
+    _Atomic uint64_t reservas_descartadas; // Reservas do anel deixadas por produtores mortos
+
+    // Clientes registrados e confirmações enviadas/perdidas (fila cheia)
+    _Atomic uint32_t clientes;
+    _Atomic uint64_t acks;
+    _Atomic uint64_t acks_perdidos;
+
+    // Profundidade da fila de mensagens na última leitura
+    _Atomic uint32_t fila_profundidade;
+    _Atomic uint32_t fila_profundidade_max;
+
+    // Estatísticas dos sensores nas janelas JANELAS_AGR_S (tarefa
+    // agregados). Seqlock: agregados_seq é ímpar durante a escrita.
+    _Atomic uint32_t agregados_seq;
+    AgregadoJanela agregados[SINAL_NUM][AGR_NUM_JANELAS];
+
+    // Contenção da trava dos dados compartilhados, por ponto de aquisição
+    TabelaContencao contencao;
+
+    // Vigia de prazos (escrito pela thread do vigia, exceto limite_ns e
+    // batimentos, escritos pela própria thread supervisionada)
+    VigiaThreadStats vigia[VIGIA_NUM_THREADS];
+    _Atomic uint32_t vigia_escalada;         // NivelVigia configurado
+    _Atomic uint32_t vigia_atrasadas;        // Threads além do limite agora
+    _Atomic uint32_t vigia_seguro;           // 1 enquanto o estado seguro está ativo
+    _Atomic uint64_t vigia_estados_seguros;  // Entradas no estado seguro
+    _Atomic uint64_t vigia_perdas;           // Total de perdas; a perda n está em vigia_registro[n % VIGIA_REGISTROS]
+    PerdaPrazo vigia_registro[VIGIA_REGISTROS];
+} ControllerStats;
+
+/**
+ * @brief Incrementa um contador com escritor único.
+ *
+ * Como cada contador tem uma única thread escritora, basta um load e um
+ * store relaxados, sem instrução atômica de leitura-modificação-escrita.
+ */
+static inline void stats_inc(_Atomic uint64_t *contador) {
+    atomic_store_explicit(contador,
+                          atomic_load_explicit(contador, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+}
+
+/**
+ * @brief Soma um valor a um contador com escritor único.
+ */
+static inline void stats_add(_Atomic uint64_t *contador, uint64_t valor) {
+    atomic_store_explicit(contador,
+                          atomic_load_explicit(contador, memory_order_relaxed) + valor,
+                          memory_order_relaxed);
+}
+
+/**
+ * @brief Lê um contador publicado (para o relatório e para o ctlstat).
+ */
+static inline uint64_t stats_get(const _Atomic uint64_t *contador) {
+    return atomic_load_explicit((_Atomic uint64_t *)contador, memory_order_relaxed);
+}
+
+/**
+ * @brief Copia os agregados publicados sem pegar uma escrita pela metade.
+ */
+static inline void stats_read_aggregates(const ControllerStats *stats,
+                                         AgregadoJanela saida[SINAL_NUM][AGR_NUM_JANELAS]) {
+    _Atomic uint32_t *seq = (_Atomic uint32_t *)&stats->agregados_seq;
+    // Limite de tentativas: o controlador pode ter morrido no meio da escrita
+    for (int tentativa = 0; tentativa < 1000; tentativa++) {
+        uint32_t s1 = atomic_load_explicit(seq, memory_order_acquire);
+        memcpy(saida, (const void *)stats->agregados, sizeof(stats->agregados));
+        atomic_thread_fence(memory_order_acquire);
+        if (!(s1 & 1) && atomic_load_explicit(seq, memory_order_relaxed) == s1) return;
+    }
+}
+
+#endif // IPC_SHARED_H
@@ -0,0 +1,217 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <time.h>
+#include <getopt.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include "ipc_shared.h"
+#include "difusao.h"
+
+#define ESPERA_MAX_MS 500        // Sem publicação nesse tempo, verifica o controlador
+
+volatile sig_atomic_t running = 1;
+
+/**
+ * @brief Handler para SIGINT: encerra a leitura.
+ */
+void sigint_handler(int signal) {
+    (void)signal;
+    running = 0;
+}
+
+/**
+ * @brief Retorna o instante atual de CLOCK_MONOTONIC em nanossegundos.
+ */
+static inline uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Anexa o anel de difusão publicado pelo controlador.
+ *
+ * O monitor nunca escreve nos slots; o acesso de escrita serve apenas para
+ * se registrar como esperando no futex do anel.
+ *
+ * @return Ponteiro para o anel anexado.
+ */
+AnelDifusao *attach_broadcast() {
+    int shm_id = shmget(SHM_KEY_DIFUSAO, sizeof(AnelDifusao), 0);
+    if (shm_id < 0) {
+        perror("Anel de difusão não encontrado (o controlador está rodando?)");
+        exit(EXIT_FAILURE);
+    }
+    AnelDifusao *anel = (AnelDifusao *)shmat(shm_id, NULL, 0);
+    if (anel == (void *)-1) {
+        perror("Erro ao associar o anel de difusão");
+        exit(EXIT_FAILURE);
+    }
+    if (__atomic_load_n(&anel->magic, __ATOMIC_ACQUIRE) != DIFUSAO_MAGIC ||
+        anel->versao != DIFUSAO_VERSAO) {
+        fprintf(stderr, "Anel de difusão incompatível (versão %u, esperada %u)\n",
+                anel->versao, DIFUSAO_VERSAO);
+        exit(EXIT_FAILURE);
+    }
+    return anel;
+}
+
+/**
+ * @brief Indica se o controlador que publica no anel ainda existe.
+ *
+ * O controlador marca o segmento para remoção ao encerrar; se ele morrer
+ * sem isso, o PID deixa de existir.
+ */
+bool publisher_alive(const AnelDifusao *anel) {
+    struct shmid_ds info;
+    if (shmctl(shmget(SHM_KEY_DIFUSAO, 0, 0), IPC_STAT, &info) < 0) return false;
+    return !(kill(anel->pid, 0) < 0 && errno == ESRCH);
+}
+
+/**
+ * @brief Imprime uma publicação em uma linha.
+ */
+void print_state(const SlotDifusao *p) {
+    const EstadoPainel *e = &p->estado;
+    printf("#%-8llu %6.1f km/h %7.1f rpm %6.1f °C  motor %2d  freio %2d  "
+           "setas %c%c  farol %c%c  (%.1f ms)\n",
+           (unsigned long long)p->numero, e->velocidade, e->rpm, e->temperatura,
+           e->motor_duty, e->freio_duty,
+           e->seta_esq ? '<' : '-', e->seta_dir ? '>' : '-',
+           e->farol_baixo ? 'B' : '-', e->farol_alto ? 'A' : '-',
+           (now_ns() - p->t_ns) / 1e6);
+}
+
+/**
+ * @brief Exibe, uma vez por segundo, as taxas de leitura e de perda.
+ *
+ * @param l Leitor com os totais acumulados.
+ * @param idade_max_ns Maior idade de uma publicação ao ser lida.
+ */
+void print_summary(const LeitorDifusao *l, uint64_t idade_max_ns) {
+    static uint64_t resumo_ns = 0, lidas_ant = 0, perdidas_ant = 0;
+    uint64_t agora = now_ns();
+    if (resumo_ns == 0) resumo_ns = agora;
+    if (agora - resumo_ns < 1000000000ull) return;
+
+    double dt = (agora - resumo_ns) / 1e9;
+    printf("lidas %8.1f/s  perdidas %8.1f/s  idade máx %.2f ms  (total %llu lidas, %llu perdidas)\n",
+           (l->lidas - lidas_ant) / dt, (l->perdidas - perdidas_ant) / dt, idade_max_ns / 1e6,
+           (unsigned long long)l->lidas, (unsigned long long)l->perdidas);
+    fflush(stdout);
+    lidas_ant = l->lidas;
+    perdidas_ant = l->perdidas;
+    resumo_ns = agora;
+}
+
+/**
+ * @brief Exibe as opções de linha de comando.
+ */
+void print_usage(const char *prog) {
+    printf("Uso: %s [opções]\n", prog);
+    printf("  -i, --inicio             Começa pela publicação mais antiga retida no anel\n");
+    printf("  -p, --polling <ms>       Consulta o anel a cada <ms> em vez de dormir no futex\n");
+    printf("  -l, --lento <ms>         Atraso artificial por publicação (simula um leitor lento)\n");
+    printf("  -q, --quieto             Exibe apenas o resumo de cada segundo\n");
+    printf("  -h, --help               Mostra esta ajuda\n");
+}
+
+/**
+ * @brief Ponto de entrada do monitor.
+ *
+ * Acompanha o estado do veículo publicado pelo controlador no anel de
+ * difusão, sem tomar a trava do controlador e sem atrasá-lo: o monitor
+ * lê com o próprio cursor e, se ficar para trás, apenas conta as
+ * publicações perdidas. Encerra com Ctrl + C ou quando o controlador sai.
+ *
+ * @return 0 ao encerrar.
+ */
+int main(int argc, char *argv[]) {
+    static const struct option opcoes[] = {
+        {"inicio",  no_argument,       NULL, 'i'},
+        {"polling", required_argument, NULL, 'p'},
+        {"lento",   required_argument, NULL, 'l'},
+        {"quieto",  no_argument,       NULL, 'q'},
+        {"help",    no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+    bool do_inicio = false, quieto = false;
+    int polling_ms = 0, lento_ms = 0;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "ip:l:qh", opcoes, NULL)) != -1) {
+        switch (opt) {
+        case 'i': do_inicio = true; break;
+        case 'p': polling_ms = atoi(optarg); break;
+        case 'l': lento_ms = atoi(optarg); break;
+        case 'q': quieto = true; break;
+        case 'h':
+            print_usage(argv[0]);
+            return 0;
+        default:
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (polling_ms < 0 || lento_ms < 0) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = sigint_handler;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+
+    AnelDifusao *anel = attach_broadcast();
+    LeitorDifusao leitor;
+    difusao_leitor_init(&leitor, anel, do_inicio);
+
+    printf("Monitor anexado ao controlador PID %d (publicação a cada %.1f ms, %d slots)\n",
+           anel->pid, anel->periodo_us / 1000.0, DIFUSAO_SLOTS);
+
+    SlotDifusao pub;
+    uint64_t inicio_ns = now_ns();
+    uint64_t idade_max_ns = 0;
+
+    while (running) {
+        while (running && difusao_ler(&leitor, &pub)) {
+            uint64_t idade = now_ns() - pub.t_ns;
+            if (idade > idade_max_ns) idade_max_ns = idade;
+            if (quieto) {
+                print_summary(&leitor, idade_max_ns);
+            } else {
+                print_state(&pub);
+            }
+            if (lento_ms > 0) usleep((useconds_t)lento_ms * 1000);
+        }
+        if (quieto) print_summary(&leitor, idade_max_ns);
+
+        bool pronto;
+        if (polling_ms > 0) {
+            usleep((useconds_t)polling_ms * 1000);
+            pronto = atomic_load_explicit(&anel->publicados, memory_order_acquire) != leitor.cursor;
+        } else {
+            pronto = difusao_esperar(&leitor, quieto ? 100 : ESPERA_MAX_MS);
+        }
+        if (!pronto && !publisher_alive(anel)) {
+            printf("\nControlador encerrado.\n");
+            break;
+        }
+    }
+
+    double duracao = (now_ns() - inicio_ns) / 1e9;
+    printf("\nPublicações lidas: %llu, perdidas (leitor atrasado): %llu, em %.1f s\n",
+           (unsigned long long)leitor.lidas, (unsigned long long)leitor.perdidas, duracao);
+    printf("Maior idade de uma publicação ao ser lida: %.2f ms\n", idade_max_ns / 1e6);
+
+    shmdt(anel);
+    return 0;
+}
@@ -0,0 +1,324 @@
+#ifndef PERFIL_LIMITADOR_H
+#define PERFIL_LIMITADOR_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <signal.h>
+#include <stdatomic.h>
+
+#include "regras.h"
+
+/*
+ * Perfis dos limitadores (limiares e reações), lidos de um arquivo e
+ * trocados com o controlador em execução, sem reiniciá-lo.
+ *
+ * Um perfil publicado nunca é alterado. A troca segue o esquema RCU: o
+ * novo perfil é alocado e preenchido fora do caminho de controle e
+ * publicado com uma troca atômica do ponteiro. A thread de controle lê o
+ * ponteiro uma vez por ciclo, sem trava, e ao fim do ciclo anuncia um
+ * estado quiescente (um contador de ciclos). O perfil substituído só é
+ * liberado depois que o contador avançou em relação ao instante da troca
+ * (período de graça): a partir daí nenhum ciclo pode estar usando-o.
+ *
+ * A leitura do ponteiro e o anúncio são seq_cst, o que garante que um
+ * ciclo iniciado depois do anúncio observado pela troca já veja o novo
+ * perfil. Em x86 e ARMv8 a leitura seq_cst é a mesma instrução de uma
+ * leitura comum (acquire); o custo fica em um store por ciclo.
+ *
+ * Há uma única thread leitora (a de controle) e uma única escritora (a
+ * thread de recarga do controlador).
+ *
+ * Formato do arquivo: uma chave e um valor por linha, `#` inicia um
+ * comentário. Chaves ausentes mantêm o valor do perfil padrão do
+ * controlador; uma chave desconhecida ou um valor inválido rejeita o
+ * arquivo inteiro, e o perfil em uso continua valendo.
+ *
+ * As regras dos limitadores (ver regras.h) fazem parte do perfil e são
+ * compiladas na leitura, com os parâmetros já resolvidos. Linhas `regra`
+ * no arquivo substituem todas as regras padrão (REGRAS_PADRAO); sem elas,
+ * as regras padrão são compiladas com os parâmetros do arquivo.
+ */
+
+#define PERFIL_NOME_MAX 32
+#define PERFIL_ESPERA_NS 1000000L     // Intervalo entre verificações do período de graça
+#define PERFIL_ALVOS (1u << ALVO_DUTY)  // O controlador atua no duty do motor
+
+typedef struct {
+    char nome[PERFIL_NOME_MAX];
+    float vel_max, vel_min;      // km/h
+    float rpm_max, rpm_min;      // Acima de rpm_max o motor corta; abaixo de rpm_min apagou
+    float temp_max;              // °C
+    float fator_reducao;         // Multiplica velocidade/RPM acima do limite (PT1)
+    float fator_aumento;         // Multiplica a velocidade abaixo do limite (PT1)
+    int passo_duty;              // Passo do duty do motor por intervenção (PT2)
+    unsigned int geracao;        // 1 no perfil inicial, +1 a cada troca
+    ProgramaRegras programa;     // Regras compiladas com os parâmetros acima
+} PerfilLimitador;
+
+// Perfil padrão: os limites originais do controlador
+static const PerfilLimitador PERFIL_PADRAO = {
+    .nome = "padrao", .vel_max = 200.0f, .vel_min = 20.0f,
+    .rpm_max = 7000.0f, .rpm_min = 780.0f, .temp_max = 140.0f,
+    .fator_reducao = 0.9f, .fator_aumento = 1.1f, .passo_duty = 1
+};
+
+// Regras padrão. Velocidade, RPM e temperatura são grupos independentes;
+// a regra de velocidade baixa não age com o veículo parado.
+static const char *const REGRAS_PADRAO[] = {
+    "vel_sup  vel   velocidade   >      vel_max    somar:duty=-passo_duty",
+    "vel_inf  vel   velocidade   entre  0 vel_min  somar:duty=passo_duty",
+    "rpm_sup  rpm   rpm          >      rpm_max    somar:duty=-passo_duty",
+    "rpm_inf  rpm   rpm          <      rpm_min    zerar:duty desligar",
+    "temp     temp  temperatura  >=     temp_max   alerta somar:duty=-passo_duty",
+};
+#define NUM_REGRAS_PADRAO ((int)(sizeof(REGRAS_PADRAO) / sizeof(REGRAS_PADRAO[0])))
+
+typedef struct {
+    _Atomic(const PerfilLimitador *) atual;
+    _Atomic uint64_t quiescentes;    // Ciclos concluídos pela thread de controle
+    unsigned int trocas;             // Perfis publicados depois do inicial
+    unsigned int rejeitados;         // Arquivos recusados na recarga
+} PublicacaoPerfil;
+
+typedef enum { CAMPO_TEXTO, CAMPO_REAL, CAMPO_INTEIRO } TipoCampoPerfil;
+
+typedef struct {
+    const char *chave;
+    size_t deslocamento;
+    TipoCampoPerfil tipo;
+} CampoPerfil;
+
+static const CampoPerfil CAMPOS_PERFIL[] = {
+    { "nome",          offsetof(PerfilLimitador, nome),          CAMPO_TEXTO },
+    { "vel_max",       offsetof(PerfilLimitador, vel_max),       CAMPO_REAL },
+    { "vel_min",       offsetof(PerfilLimitador, vel_min),       CAMPO_REAL },
+    { "rpm_max",       offsetof(PerfilLimitador, rpm_max),       CAMPO_REAL },
+    { "rpm_min",       offsetof(PerfilLimitador, rpm_min),       CAMPO_REAL },
+    { "temp_max",      offsetof(PerfilLimitador, temp_max),      CAMPO_REAL },
+    { "fator_reducao", offsetof(PerfilLimitador, fator_reducao), CAMPO_REAL },
+    { "fator_aumento", offsetof(PerfilLimitador, fator_aumento), CAMPO_REAL },
+    { "passo_duty",    offsetof(PerfilLimitador, passo_duty),    CAMPO_INTEIRO },
+};
+#define NUM_CAMPOS_PERFIL (sizeof(CAMPOS_PERFIL) / sizeof(CAMPOS_PERFIL[0]))
+
+/**
+ * @brief Confere a coerência de um perfil.
+ *
+ * @return NULL se válido, ou a descrição do problema.
+ */
+static inline const char *perfil_validar(const PerfilLimitador *p) {
+    if (!(p->vel_min >= 0.0f && p->vel_min < p->vel_max)) return "exige 0 <= vel_min < vel_max";
+    if (!(p->rpm_min >= 0.0f && p->rpm_min < p->rpm_max)) return "exige 0 <= rpm_min < rpm_max";
+    if (!(p->temp_max > 0.0f && p->temp_max < 1000.0f)) return "exige 0 < temp_max < 1000";
+    if (!(p->fator_reducao > 0.0f && p->fator_reducao < 1.0f)) return "exige 0 < fator_reducao < 1";
+    if (!(p->fator_aumento > 1.0f && p->fator_aumento <= 2.0f)) return "exige 1 < fator_aumento <= 2";
+    if (p->passo_duty < 1 || p->passo_duty > 10) return "exige passo_duty de 1 a 10";
+    return NULL;
+}
+
+/**
+ * @brief Valor de um parâmetro numérico do perfil, para as regras.
+ */
+static inline bool perfil_parametro(const void *ctx, const char *nome, float *valor) {
+    const PerfilLimitador *p = (const PerfilLimitador *)ctx;
+    for (size_t i = 0; i < NUM_CAMPOS_PERFIL; i++) {
+        const CampoPerfil *c = &CAMPOS_PERFIL[i];
+        if (strcmp(nome, c->chave) != 0) continue;
+        const char *origem = (const char *)p + c->deslocamento;
+        if (c->tipo == CAMPO_REAL) memcpy(valor, origem, sizeof(float));
+        else if (c->tipo == CAMPO_INTEIRO) *valor = (float)*(const int *)origem;
+        else return false;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Perfil padrão, com as regras padrão compiladas.
+ */
+static inline bool perfil_padrao(PerfilLimitador *p) {
+    *p = PERFIL_PADRAO;
+    return regras_compilar(&p->programa, REGRAS_PADRAO, NUM_REGRAS_PADRAO, "regras padrão", NULL,
+                           perfil_parametro, p, PERFIL_ALVOS);
+}
+
+/**
+ * @brief Lê um perfil de um arquivo e compila as regras.
+ *
+ * @param arquivo Caminho do arquivo.
+ * @param p Perfil lido (só é válido se a função retornar true).
+ * @return true se o arquivo foi lido e o perfil é válido; os erros são
+ *         informados em stderr.
+ */
+static inline bool perfil_ler(const char *arquivo, PerfilLimitador *p) {
+    FILE *f = fopen(arquivo, "r");
+    if (!f) {
+        perror("Erro ao abrir o perfil dos limitadores");
+        return false;
+    }
+    *p = PERFIL_PADRAO;
+
+    char linha[256];
+    char regras[REGRAS_MAX][REGRA_LINHA_MAX];
+    const char *linhas_regras[REGRAS_MAX];
+    int numeros[REGRAS_MAX];
+    int num = 0, num_regras = 0;
+    bool ok = true;
+    while (ok && fgets(linha, sizeof(linha), f)) {
+        num++;
+        char *comentario = strchr(linha, '#');
+        if (comentario) *comentario = '\0';
+        char *texto = linha + strspn(linha, " \t");
+        if (strncmp(texto, "regra", 5) == 0 && (texto[5] == ' ' || texto[5] == '\t')) {
+            if (num_regras == REGRAS_MAX) {
+                fprintf(stderr, "%s:%d: regras demais (máximo %d)\n", arquivo, num, REGRAS_MAX);
+                ok = false;
+                break;
+            }
+            snprintf(regras[num_regras], REGRA_LINHA_MAX, "%s", texto + 6);
+            linhas_regras[num_regras] = regras[num_regras];
+            numeros[num_regras++] = num;
+            continue;
+        }
+        char chave[32], valor[64], sobra;
+        int lidos = sscanf(linha, "%31s %63s %c", chave, valor, &sobra);
+        if (lidos <= 0) continue;
+        if (lidos != 2) {
+            fprintf(stderr, "%s:%d: esperado \"chave valor\"\n", arquivo, num);
+            ok = false;
+            break;
+        }
+        const CampoPerfil *c = NULL;
+        for (size_t i = 0; i < NUM_CAMPOS_PERFIL; i++) {
+            if (strcmp(chave, CAMPOS_PERFIL[i].chave) == 0) c = &CAMPOS_PERFIL[i];
+        }
+        if (!c) {
+            fprintf(stderr, "%s:%d: chave desconhecida: %s\n", arquivo, num, chave);
+            ok = false;
+            break;
+        }
+        char *destino = (char *)p + c->deslocamento;
+        char *fim;
+        switch (c->tipo) {
+        case CAMPO_TEXTO:
+            if (strlen(valor) >= PERFIL_NOME_MAX) ok = false;
+            else memcpy(destino, valor, strlen(valor) + 1);
+            break;
+        case CAMPO_REAL: {
+            float v = strtof(valor, &fim);
+            if (*fim != '\0' || !isfinite(v)) ok = false;
+            else memcpy(destino, &v, sizeof(v));
+            break;
+        }
+        case CAMPO_INTEIRO: {
+            long v = strtol(valor, &fim, 10);
+            if (*fim != '\0') ok = false;
+            else *(int *)destino = (int)v;
+            break;
+        }
+        }
+        if (!ok) fprintf(stderr, "%s:%d: valor inválido para %s: %s\n", arquivo, num, chave, valor);
+    }
+    fclose(f);
+    if (!ok) return false;
+
+    const char *erro = perfil_validar(p);
+    if (erro) {
+        fprintf(stderr, "%s: perfil inválido (%s)\n", arquivo, erro);
+        return false;
+    }
+    if (num_regras > 0) {
+        return regras_compilar(&p->programa, linhas_regras, num_regras, arquivo, numeros,
+                               perfil_parametro, p, PERFIL_ALVOS);
+    }
+    return regras_compilar(&p->programa, REGRAS_PADRAO, NUM_REGRAS_PADRAO, arquivo, NULL,
+                           perfil_parametro, p, PERFIL_ALVOS);
+}
+
+/**
+ * @brief Publica o perfil inicial, antes de a thread de controle começar.
+ */
+static inline void perfil_iniciar(PublicacaoPerfil *pub, PerfilLimitador *inicial) {
+    inicial->geracao = 1;
+    atomic_store_explicit(&pub->atual, inicial, memory_order_relaxed);
+    atomic_store_explicit(&pub->quiescentes, 0, memory_order_relaxed);
+    pub->trocas = 0;
+    pub->rejeitados = 0;
+}
+
+/**
+ * @brief Perfil em uso. Chamada pela thread de controle uma vez por ciclo;
+ *        o ponteiro não deve ser guardado depois de perfil_quiescente().
+ */
+static inline const PerfilLimitador *perfil_atual(PublicacaoPerfil *pub) {
+    return atomic_load_explicit(&pub->atual, memory_order_seq_cst);
+}
+
+/**
+ * @brief Anuncia o fim de um ciclo da thread de controle: nenhuma
+ *        referência a um perfil lido antes deste ponto continua em uso.
+ */
+static inline void perfil_quiescente(PublicacaoPerfil *pub) {
+    uint64_t n = atomic_load_explicit(&pub->quiescentes, memory_order_relaxed);
+    atomic_store_explicit(&pub->quiescentes, n + 1, memory_order_seq_cst);
+}
+
+/**
+ * @brief Publica um novo perfil e libera o anterior após o período de graça.
+ *
+ * Chamada pela thread de recarga. Se @p ativo zerar durante a espera (o
+ * controlador está encerrando), o perfil anterior não é liberado: a thread
+ * de controle pode estar parada no meio de um ciclo, e o processo termina
+ * em seguida.
+ *
+ * @param novo Perfil alocado com malloc(); passa a pertencer à publicação.
+ * @param ativo Flag de execução do controlador.
+ * @return Tempo de espera pelo período de graça, em ns.
+ */
+static inline uint64_t perfil_trocar(PublicacaoPerfil *pub, PerfilLimitador *novo,
+                                     volatile sig_atomic_t *ativo) {
+    const PerfilLimitador *antigo = atomic_load_explicit(&pub->atual, memory_order_relaxed);
+    novo->geracao = antigo->geracao + 1;
+    atomic_exchange_explicit(&pub->atual, novo, memory_order_seq_cst);
+    pub->trocas++;
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    uint64_t marca = atomic_load_explicit(&pub->quiescentes, memory_order_seq_cst);
+    const struct timespec espera = { 0, PERFIL_ESPERA_NS };
+    while (atomic_load_explicit(&pub->quiescentes, memory_order_acquire) == marca) {
+        if (!*ativo) return 0;
+        nanosleep(&espera, NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    free((void *)antigo);
+    return (uint64_t)(t1.tv_sec - t0.tv_sec) * 1000000000ull + (uint64_t)t1.tv_nsec - (uint64_t)t0.tv_nsec;
+}
+
+/**
+ * @brief Exibe o perfil e as regras compiladas.
+ */
+static inline void perfil_imprimir(const PerfilLimitador *p) {
+    const ProgramaRegras *prog = &p->programa;
+    printf("Perfil dos limitadores \"%s\" (geração %u): %u regras\n", p->nome, p->geracao, prog->num_regras);
+    for (uint32_t i = 0; i < prog->num_regras; i++) {
+        printf("  %-10s %s ->", prog->nome[i], prog->descricao[i]);
+        for (uint32_t a = 0; a < prog->num_acoes[i]; a++) {
+            const AcaoRegra *ac = &prog->acoes[i][a];
+            printf(" %s", NOMES_ACOES[ac->tipo]);
+            if (ac->tipo == ACAO_ZERAR) printf(" %s", NOMES_ALVOS[ac->alvo]);
+            else if (ac->tipo == ACAO_MULTIPLICAR || ac->tipo == ACAO_SOMAR) {
+                printf(" %s %g", NOMES_ALVOS[ac->alvo], ac->valor);
+            }
+        }
+        printf("\n");
+    }
+}
+
+#endif // PERFIL_LIMITADOR_H
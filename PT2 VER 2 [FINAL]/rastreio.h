@@ -0,0 +1,326 @@
+#ifndef RASTREIO_H
+#define RASTREIO_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/syscall.h>
+
+/*
+ * Rastreio das fases do loop de controle e da atividade das threads, para
+ * ver onde o tempo de cada iteração é gasto (espera pela trava, printf,
+ * msgrcv, escritas na GPIO, sono).
+ *
+ * Um ponto de rastreio é um escopo: RASTREIO_ESCOPO("nome") marca o início
+ * e, ao sair do bloco, grava um evento com o início e a duração. Cada thread
+ * registrada grava em um anel próprio, do qual é a única escritora: gravar
+ * um evento são três escritas na memória e um store com release, sem trava
+ * e sem chamadas de sistema além da leitura do relógio. Quando o anel
+ * enche, os eventos mais antigos são sobrescritos.
+ *
+ * Com o rastreio desligado (o padrão), um ponto de rastreio custa a leitura
+ * de uma flag e um desvio; compilado com -DRASTREIO_DESLIGADO, nada.
+ *
+ * A exportação, no formato JSON de rastreio do Chrome (aberto também pelo
+ * Perfetto, https://ui.perfetto.dev), é feita sob demanda por uma thread à
+ * parte, acordada por rastreio_pedir_exportacao() (segura em handlers de
+ * sinal), e mais uma vez no encerramento. O exportador copia cada anel sem
+ * parar a escritora e descarta os eventos que ela possa ter sobrescrito
+ * durante a cópia. Os instantes são os do relógio monotônico, de modo que
+ * os rastreios de processos diferentes podem ser vistos juntos.
+ */
+
+#define RASTREIO_EVENTOS 65536        // Eventos por thread (potência de 2)
+#define RASTREIO_THREADS_MAX 24       // Threads registradas
+#define RASTREIO_NOME_MAX 32
+#define RASTREIO_INSTANTE UINT64_MAX  // Duração de um evento instantâneo
+
+// Um evento: o nome aponta para uma string que vive até o fim do programa
+typedef struct {
+    const char *nome;
+    uint64_t inicio_ns;
+    uint64_t duracao_ns;     // RASTREIO_INSTANTE em uma marca
+} EventoRastreio;
+
+// Anel de uma thread (escrito só por ela)
+typedef struct {
+    char nome[RASTREIO_NOME_MAX];
+    pid_t tid;
+    _Atomic uint64_t escritos;          // Eventos gravados desde o registro
+    EventoRastreio eventos[RASTREIO_EVENTOS];
+} BufferRastreio;
+
+// Início de um escopo em andamento (0 com o rastreio desligado)
+typedef struct {
+    const char *nome;
+    uint64_t inicio_ns;
+} EscopoRastreio;
+
+static bool rastreio_ativo = false;             // --rastreio
+static const char *rastreio_arquivo = NULL;
+static const char *rastreio_processo = "";     // Nome do processo no rastreio
+static BufferRastreio *_Atomic rastreio_buffers[RASTREIO_THREADS_MAX];
+static _Atomic uint32_t rastreio_num_buffers = 0;
+static __thread BufferRastreio *rastreio_buffer = NULL; // Anel da thread corrente
+static sem_t rastreio_sem;                      // Pedidos de exportação
+static volatile sig_atomic_t rastreio_encerrando = 0;
+static pthread_t rastreio_thread;
+
+/**
+ * @brief Instante atual do relógio monotônico em nanossegundos.
+ */
+static inline uint64_t rastreio_agora(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Grava um evento no anel da thread corrente.
+ *
+ * Threads que não se registraram não gravam.
+ */
+static inline void rastreio_evento(const char *nome, uint64_t inicio_ns, uint64_t duracao_ns) {
+    BufferRastreio *b = rastreio_buffer;
+    if (b == NULL) return;
+    uint64_t n = atomic_load_explicit(&b->escritos, memory_order_relaxed);
+    EventoRastreio *e = &b->eventos[n & (RASTREIO_EVENTOS - 1)];
+    e->nome = nome;
+    e->inicio_ns = inicio_ns;
+    e->duracao_ns = duracao_ns;
+    atomic_store_explicit(&b->escritos, n + 1, memory_order_release);
+}
+
+/**
+ * @brief Fecha um escopo (chamada pelo atributo cleanup de RASTREIO_ESCOPO).
+ */
+static inline void rastreio_fim_escopo(EscopoRastreio *e) {
+    if (e->inicio_ns) rastreio_evento(e->nome, e->inicio_ns, rastreio_agora() - e->inicio_ns);
+}
+
+#define RASTREIO_CONCAT2(a, b) a##b
+#define RASTREIO_CONCAT(a, b) RASTREIO_CONCAT2(a, b)
+
+#ifndef RASTREIO_DESLIGADO
+// Rastreia do ponto da declaração até o fim do bloco corrente
+#define RASTREIO_ESCOPO(nome)                                                        \
+    EscopoRastreio RASTREIO_CONCAT(escopo_rastreio_, __LINE__)                       \
+        __attribute__((cleanup(rastreio_fim_escopo))) =                              \
+        { (nome), __builtin_expect(rastreio_ativo, 0) ? rastreio_agora() : 0 }
+// Evento instantâneo (ex.: um overrun)
+#define RASTREIO_MARCA(nome)                                                         \
+    do {                                                                             \
+        if (__builtin_expect(rastreio_ativo, 0))                                     \
+            rastreio_evento((nome), rastreio_agora(), RASTREIO_INSTANTE);            \
+    } while (0)
+#else
+#define RASTREIO_ESCOPO(nome) do { } while (0)
+#define RASTREIO_MARCA(nome) do { } while (0)
+#endif
+
+// Rastreia uma única instrução (ex.: uma chamada à GPIO)
+#define RASTREIO_CHAMADA(nome, instrucao) \
+    do {                                  \
+        RASTREIO_ESCOPO(nome);            \
+        instrucao;                        \
+    } while (0)
+
+/**
+ * @brief Registra a thread corrente e aloca o seu anel.
+ *
+ * Sem efeito com o rastreio desligado ou depois de RASTREIO_THREADS_MAX
+ * threads (as excedentes não são rastreadas).
+ *
+ * @param nome Nome da thread no rastreio (copiado).
+ */
+static inline void rastreio_registrar_thread(const char *nome) {
+    if (!rastreio_ativo || rastreio_buffer != NULL) return;
+    uint32_t i = atomic_fetch_add(&rastreio_num_buffers, 1);
+    if (i >= RASTREIO_THREADS_MAX) return;
+    BufferRastreio *b = calloc(1, sizeof(*b));
+    if (b == NULL) {
+        perror("Erro ao alocar o anel de rastreio");
+        return;
+    }
+    snprintf(b->nome, sizeof(b->nome), "%s", nome);
+    b->tid = (pid_t)syscall(SYS_gettid);
+    atomic_store_explicit(&rastreio_buffers[i], b, memory_order_release);
+    rastreio_buffer = b;
+}
+
+/**
+ * @brief Escreve @p s como string JSON (com aspas e escapes).
+ */
+static inline void rastreio_json_string(FILE *f, const char *s) {
+    fputc('"', f);
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') fprintf(f, "\\%c", c);
+        else if (c < 0x20) fprintf(f, "\\u%04x", c);
+        else fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+/**
+ * @brief Copia o anel @p b para @p copia.
+ *
+ * @param perdidos Eventos sobrescritos antes de serem copiados.
+ * @return Número de eventos válidos em @p copia, do mais antigo ao mais novo.
+ */
+static inline uint64_t rastreio_copiar(BufferRastreio *b, EventoRastreio *copia, uint64_t *perdidos) {
+    uint64_t fim = atomic_load_explicit(&b->escritos, memory_order_acquire);
+    uint64_t inicio = fim > RASTREIO_EVENTOS ? fim - RASTREIO_EVENTOS : 0;
+    for (uint64_t n = inicio; n < fim; n++) {
+        copia[n - inicio] = b->eventos[n & (RASTREIO_EVENTOS - 1)];
+    }
+    // Eventos que a escritora alcançou durante a cópia podem estar rasgados
+    atomic_thread_fence(memory_order_acquire);
+    uint64_t depois = atomic_load_explicit(&b->escritos, memory_order_relaxed);
+    uint64_t intacto = depois > RASTREIO_EVENTOS ? depois - RASTREIO_EVENTOS : 0;
+    if (intacto > inicio) {
+        uint64_t descartados = (intacto < fim ? intacto : fim) - inicio;
+        memmove(copia, copia + descartados, (fim - inicio - descartados) * sizeof(*copia));
+        inicio += descartados;
+    }
+    *perdidos = inicio;
+    return fim - inicio;
+}
+
+/**
+ * @brief Exporta os anéis de todas as threads para o arquivo de rastreio.
+ *
+ * O arquivo é escrito ao lado (`<arquivo>.tmp`) e renomeado no fim, de modo
+ * que um leitor nunca vê uma exportação pela metade.
+ *
+ * @return Eventos exportados, ou -1 em caso de erro.
+ */
+static inline long long rastreio_exportar(void) {
+    char temporario[4096];
+    snprintf(temporario, sizeof(temporario), "%s.tmp", rastreio_arquivo);
+    FILE *f = fopen(temporario, "w");
+    if (f == NULL) {
+        perror("Erro ao criar o arquivo de rastreio");
+        return -1;
+    }
+    EventoRastreio *copia = malloc(RASTREIO_EVENTOS * sizeof(*copia));
+    if (copia == NULL) {
+        perror("Erro ao alocar a cópia do rastreio");
+        fclose(f);
+        return -1;
+    }
+
+    const int pid = (int)getpid();
+    long long total = 0;
+    uint64_t perdidos_total = 0;
+    fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    fprintf(f, "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":", pid, pid);
+    rastreio_json_string(f, rastreio_processo);
+    fprintf(f, "}}");
+
+    uint32_t num = atomic_load_explicit(&rastreio_num_buffers, memory_order_acquire);
+    if (num > RASTREIO_THREADS_MAX) num = RASTREIO_THREADS_MAX;
+    for (uint32_t t = 0; t < num; t++) {
+        BufferRastreio *b = atomic_load_explicit(&rastreio_buffers[t], memory_order_acquire);
+        if (b == NULL) continue;
+        fprintf(f, ",\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":",
+                pid, (int)b->tid);
+        rastreio_json_string(f, b->nome);
+        fprintf(f, "}}");
+
+        uint64_t perdidos;
+        uint64_t n = rastreio_copiar(b, copia, &perdidos);
+        perdidos_total += perdidos;
+        for (uint64_t k = 0; k < n; k++) {
+            const EventoRastreio *e = &copia[k];
+            uint64_t ts = e->inicio_ns;   // Relógio monotônico, comum aos processos
+            fprintf(f, ",\n{\"name\":");
+            rastreio_json_string(f, e->nome);
+            if (e->duracao_ns == RASTREIO_INSTANTE) {
+                fprintf(f, ",\"ph\":\"i\",\"s\":\"t\"");
+            } else {
+                fprintf(f, ",\"ph\":\"X\",\"dur\":%llu.%03llu",
+                        (unsigned long long)(e->duracao_ns / 1000), (unsigned long long)(e->duracao_ns % 1000));
+            }
+            fprintf(f, ",\"ts\":%llu.%03llu,\"pid\":%d,\"tid\":%d}",
+                    (unsigned long long)(ts / 1000), (unsigned long long)(ts % 1000), pid, (int)b->tid);
+        }
+        total += (long long)n;
+    }
+    fprintf(f, "\n]}\n");
+    free(copia);
+
+    if (fclose(f) != 0 || rename(temporario, rastreio_arquivo) != 0) {
+        perror("Erro ao gravar o arquivo de rastreio");
+        return -1;
+    }
+    printf("Rastreio: %lld eventos de %u threads exportados para %s (%llu sobrescritos antes da exportação).\n",
+           total, num, rastreio_arquivo, (unsigned long long)perdidos_total);
+    return total;
+}
+
+/**
+ * @brief Thread de exportação: exporta a cada pedido até o encerramento.
+ */
+static inline void *rastreio_exportador(void *arg) {
+    (void)arg;
+    while (true) {
+        if (sem_wait(&rastreio_sem) == -1) continue; // EINTR
+        if (rastreio_encerrando) break;
+        rastreio_exportar();
+    }
+    return NULL;
+}
+
+/**
+ * @brief Pede uma exportação do rastreio (segura em handlers de sinal).
+ */
+static inline void rastreio_pedir_exportacao(void) {
+    if (rastreio_ativo) sem_post(&rastreio_sem);
+}
+
+/**
+ * @brief Liga o rastreio e cria a thread de exportação.
+ *
+ * Deve ser chamada antes da criação das threads a rastrear.
+ *
+ * @param arquivo Arquivo JSON de destino, reescrito a cada exportação.
+ * @param processo Nome do processo no rastreio.
+ */
+static inline void rastreio_iniciar(const char *arquivo, const char *processo) {
+    rastreio_arquivo = arquivo;
+    rastreio_processo = processo;
+    if (sem_init(&rastreio_sem, 0, 0) == -1) {
+        perror("Erro ao criar o semáforo do rastreio");
+        exit(EXIT_FAILURE);
+    }
+    rastreio_ativo = true;
+    if (pthread_create(&rastreio_thread, NULL, rastreio_exportador, NULL) != 0) {
+        perror("Erro ao criar a thread de exportação do rastreio");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * @brief Encerra a thread de exportação e faz a exportação final.
+ *
+ * Deve ser chamada depois que as threads rastreadas terminaram.
+ */
+static inline void rastreio_encerrar(void) {
+    if (!rastreio_ativo) return;
+    rastreio_encerrando = 1;
+    sem_post(&rastreio_sem);
+    pthread_join(rastreio_thread, NULL);
+    rastreio_exportar();
+    rastreio_ativo = false;
+}
+
+#endif // RASTREIO_H